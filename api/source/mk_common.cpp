@@ -177,7 +177,7 @@ API_EXPORT uint16_t API_CALL mk_http_server_start(uint16_t port, int ssl) {
     try {
         http_server[ssl] = std::make_shared<TcpServer>();
         if(ssl){
-            http_server[ssl]->start<SessionWithSSL<HttpSession> >(port);
+            http_server[ssl]->start<HttpsSession>(port);
         } else{
             http_server[ssl]->start<HttpSession>(port);
         }
@@ -194,7 +194,7 @@ API_EXPORT uint16_t API_CALL mk_rtsp_server_start(uint16_t port, int ssl) {
     try {
         rtsp_server[ssl] = std::make_shared<TcpServer>();
         if(ssl){
-            rtsp_server[ssl]->start<SessionWithSSL<RtspSession> >(port);
+            rtsp_server[ssl]->start<RtspSessionWithSSL>(port);
         }else{
             rtsp_server[ssl]->start<RtspSession>(port);
         }
@@ -211,7 +211,7 @@ API_EXPORT uint16_t API_CALL mk_rtmp_server_start(uint16_t port, int ssl) {
     try {
         rtmp_server[ssl] = std::make_shared<TcpServer>();
         if(ssl){
-            rtmp_server[ssl]->start<SessionWithSSL<RtmpSession> >(port);
+            rtmp_server[ssl]->start<RtmpSessionWithSSL>(port);
         }else{
             rtmp_server[ssl]->start<RtmpSession>(port);
         }
@@ -328,7 +328,7 @@ API_EXPORT uint16_t API_CALL mk_srt_server_start(uint16_t port) {
             }
             auto new_poller = SRT::SrtSession::queryPoller(buf);
             if (!new_poller) {
-                //握手第一阶段
+                //未找到对应的srt对象
                 return Socket::createSocket(poller, false);
             }
             return Socket::createSocket(new_poller, false);
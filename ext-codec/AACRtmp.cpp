@@ -22,7 +22,7 @@ void AACRtmpDecoder::inputRtmp(const RtmpPacket::Ptr &pkt) {
         getTrack()->setExtraData((uint8_t *)pkt->data() + 2, pkt->size() - 2);
         return;
     }
-    RtmpCodec::inputFrame(std::make_shared<FrameFromPtr>(CodecAAC, pkt->buffer.data() + 2, pkt->buffer.size() - 2, pkt->time_stamp));
+    RtmpCodec::inputFrame(ObjectPool::makeShared<FrameFromPtr>(CodecAAC, pkt->buffer.data() + 2, pkt->buffer.size() - 2, pkt->time_stamp));
 }
 
 /////////////////////////////////////////////////////////////////////////////////////
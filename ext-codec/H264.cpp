@@ -17,6 +17,7 @@
 #include "Common/Parser.h"
 #include "Common/config.h"
 #include "Extension/Factory.h"
+#include "Extension/NalScanner.h"
 
 #ifdef ENABLE_MP4
 #include "mpeg4-avc.h"
@@ -50,22 +51,14 @@ bool getAVCInfo(const string &strSps, int &iVideoWidth, int &iVideoHeight, float
     return getAVCInfo(strSps.data(), strSps.size(), iVideoWidth, iVideoHeight, iVideoFps);
 }
 
-static const char *memfind(const char *buf, ssize_t len, const char *subbuf, ssize_t sublen) {
-    for (auto i = 0; i < len - sublen; ++i) {
-        if (memcmp(buf + i, subbuf, sublen) == 0) {
-            return buf + i;
-        }
-    }
-    return NULL;
-}
-
 void splitH264(
     const char *ptr, size_t len, size_t prefix, const std::function<void(const char *, size_t, size_t)> &cb) {
     auto start = ptr + prefix;
     auto end = ptr + len;
     size_t next_prefix;
     while (true) {
-        auto next_start = memfind(start, end - start, "\x00\x00\x01", 3);
+        // 起始码后至少要有1个字节的nal数据
+        auto next_start = findNalStartCode(start, end - 1);
         if (next_start) {
             //找到下一帧
             if (*(next_start - 1) == 0x00) {
@@ -151,7 +144,7 @@ bool H264Track::inputFrame(const Frame::Ptr &frame) {
     //非I/B/P帧情况下，split一下，防止多个帧粘合在一起
     bool ret = false;
     splitH264(frame->data(), frame->size(), frame->prefixSize(), [&](const char *ptr, size_t len, size_t prefix) {
-        H264FrameInternal::Ptr sub_frame = std::make_shared<H264FrameInternal>(frame, (char *)ptr, len, prefix);
+        H264FrameInternal::Ptr sub_frame = ObjectPool::makeShared<H264FrameInternal>(frame, (char *)ptr, len, prefix);
         if (inputFrame_l(sub_frame)) {
             ret = true;
         }
@@ -270,7 +263,7 @@ bool H264Track::inputFrame_l(const Frame::Ptr &frame) {
             // 避免识别不出关键帧
             if (_latest_is_config_frame && !frame->dropAble()) {
                 if (!frame->keyFrame()) {
-                    const_cast<Frame::Ptr &>(frame) = std::make_shared<FrameCacheAble>(frame, true);
+                    const_cast<Frame::Ptr &>(frame) = ObjectPool::makeShared<FrameCacheAble>(frame, true);
                 }
             }
             // 判断是否是I帧, 并且如果是,那判断前面是否插入过config帧, 如果插入过就不插入了
@@ -388,7 +381,7 @@ RtmpCodec::Ptr getRtmpDecoderByTrack(const Track::Ptr &track) {
 }
 
 Frame::Ptr getFrameFromPtr(const char *data, size_t bytes, uint64_t dts, uint64_t pts) {
-    return std::make_shared<H264FrameNoCacheAble>((char *)data, bytes, dts, pts, prefixSize(data, bytes));
+    return ObjectPool::makeShared<H264FrameNoCacheAble>((char *)data, bytes, dts, pts, prefixSize(data, bytes));
 }
 
 } // namespace
@@ -97,7 +97,7 @@ bool H265Track::inputFrame(const Frame::Ptr &frame) {
     bool ret = false;
     splitH264(frame->data(), frame->size(), frame->prefixSize(), [&](const char *ptr, size_t len, size_t prefix) {
         using H265FrameInternal = FrameInternal<H265FrameNoCacheAble>;
-        H265FrameInternal::Ptr sub_frame = std::make_shared<H265FrameInternal>(frame, (char *) ptr, len, prefix);
+        H265FrameInternal::Ptr sub_frame = ObjectPool::makeShared<H265FrameInternal>(frame, (char *) ptr, len, prefix);
         if (inputFrame_l(sub_frame)) {
             ret = true;
         }
@@ -297,7 +297,7 @@ RtmpCodec::Ptr getRtmpDecoderByTrack(const Track::Ptr &track) {
 }
 
 Frame::Ptr getFrameFromPtr(const char *data, size_t bytes, uint64_t dts, uint64_t pts) {
-    return std::make_shared<H265FrameNoCacheAble>((char *)data, bytes, dts, pts, prefixSize(data, bytes));
+    return ObjectPool::makeShared<H265FrameNoCacheAble>((char *)data, bytes, dts, pts, prefixSize(data, bytes));
 }
 
 } // namespace
@@ -85,7 +85,7 @@ RtmpCodec::Ptr getRtmpDecoderByTrack(const Track::Ptr &track) {
 }
 
 Frame::Ptr getFrameFromPtr(const char *data, size_t bytes, uint64_t dts, uint64_t pts) {
-    return std::make_shared<FrameFromPtr>(CodecOpus, (char *)data, bytes, dts, pts);
+    return ObjectPool::makeShared<FrameFromPtr>(CodecOpus, (char *)data, bytes, dts, pts);
 }
 
 } // namespace
@@ -48,6 +48,10 @@
 #include "Pusher/PusherProxy.h"
 #include "Rtp/RtpProcess.h"
 #include "Record/MP4Reader.h"
+#include "Record/MP4AsyncWriter.h"
+#include "Common/StreamProfiler.h"
+#include "Common/Metrics.h"
+#include "Common/ObjectPool.h"
 
 #if defined(ENABLE_RTPPROXY)
 #include "Rtp/RtpServer.h"
@@ -495,6 +499,92 @@ uint16_t openRtpServer(uint16_t local_port, const mediakit::MediaTuple &tuple, i
 
 #endif
 
+// 获取所有流的性能统计(json格式)
+static Value makeStreamProfileJson() {
+    Value ret(arrayValue);
+    StreamProfiler::for_each([&](const StreamProfiler &profiler) {
+        Value obj;
+        auto &tuple = profiler.getMediaTuple();
+        obj["vhost"] = tuple.vhost;
+        obj["app"] = tuple.app;
+        obj["stream"] = tuple.stream;
+        obj["frames"] = (Json::UInt64)profiler.getFrames();
+        obj["bytesIn"] = (Json::UInt64)profiler.getBytesIn();
+        obj["bytesOut"] = (Json::UInt64)profiler.getBytesOut();
+        obj["cpuNs"] = (Json::UInt64)profiler.getCpuNanoseconds();
+        obj["poolHits"] = (Json::UInt64)profiler.getPoolHits();
+        obj["poolMisses"] = (Json::UInt64)profiler.getPoolMisses();
+        for (int i = 0; i < StreamProfiler::kStageCount; ++i) {
+            auto stage = (StreamProfiler::Stage)i;
+            obj["stageNs"][StreamProfiler::getStageName(stage)] = (Json::UInt64)profiler.getStageNanoseconds(stage);
+        }
+        for (size_t i = 0; i < StreamProfiler::kLatencyBuckets; ++i) {
+            obj["latencyHistogram"][StreamProfiler::getLatencyBucketName(i)] = (Json::UInt64)profiler.getLatencyCount(i);
+        }
+        ret.append(obj);
+    });
+    return ret;
+}
+
+// prometheus标签值需要转义反斜杠、双引号与换行
+static string escapeLabelValue(const string &value) {
+    string ret;
+    ret.reserve(value.size());
+    for (auto ch : value) {
+        switch (ch) {
+            case '\\': ret += "\\\\"; break;
+            case '"': ret += "\\\""; break;
+            case '\n': ret += "\\n"; break;
+            default: ret += ch; break;
+        }
+    }
+    return ret;
+}
+
+// 获取所有流的性能统计(prometheus文本格式)
+static string makeStreamProfilePrometheus() {
+    static const double s_latency_le[StreamProfiler::kLatencyBuckets - 1] = { 0.00001, 0.00005, 0.0001, 0.0005, 0.001, 0.005, 0.01 };
+    _StrPrinter frames, bytes_in, bytes_out, cpu, pool_hits, pool_misses, stage_cpu, latency;
+    frames << "# TYPE zlm_stream_frames_total counter\n";
+    bytes_in << "# TYPE zlm_stream_bytes_in_total counter\n";
+    bytes_out << "# TYPE zlm_stream_bytes_out_total counter\n";
+    cpu << "# TYPE zlm_stream_cpu_seconds_total counter\n";
+    pool_hits << "# TYPE zlm_stream_pool_hits_total counter\n";
+    pool_misses << "# TYPE zlm_stream_pool_misses_total counter\n";
+    stage_cpu << "# TYPE zlm_stream_muxer_cpu_seconds_total counter\n";
+    latency << "# TYPE zlm_stream_frame_latency_seconds histogram\n";
+    StreamProfiler::for_each([&](const StreamProfiler &profiler) {
+        auto &tuple = profiler.getMediaTuple();
+        string labels = "vhost=\"" + escapeLabelValue(tuple.vhost) + "\",app=\"" + escapeLabelValue(tuple.app) + "\",stream=\"" + escapeLabelValue(tuple.stream) + "\"";
+        frames << "zlm_stream_frames_total{" << labels << "} " << profiler.getFrames() << "\n";
+        bytes_in << "zlm_stream_bytes_in_total{" << labels << "} " << profiler.getBytesIn() << "\n";
+        bytes_out << "zlm_stream_bytes_out_total{" << labels << "} " << profiler.getBytesOut() << "\n";
+        cpu << "zlm_stream_cpu_seconds_total{" << labels << "} " << profiler.getCpuNanoseconds() / 1e9 << "\n";
+        pool_hits << "zlm_stream_pool_hits_total{" << labels << "} " << profiler.getPoolHits() << "\n";
+        pool_misses << "zlm_stream_pool_misses_total{" << labels << "} " << profiler.getPoolMisses() << "\n";
+        for (int i = 0; i < StreamProfiler::kStageCount; ++i) {
+            auto stage = (StreamProfiler::Stage)i;
+            stage_cpu << "zlm_stream_muxer_cpu_seconds_total{" << labels << ",muxer=\"" << StreamProfiler::getStageName(stage) << "\"} "
+                      << profiler.getStageNanoseconds(stage) / 1e9 << "\n";
+        }
+        // prometheus直方图档位是累加的
+        uint64_t count = 0;
+        for (size_t i = 0; i < StreamProfiler::kLatencyBuckets; ++i) {
+            count += profiler.getLatencyCount(i);
+            latency << "zlm_stream_frame_latency_seconds_bucket{" << labels << ",le=\"";
+            if (i + 1 < StreamProfiler::kLatencyBuckets) {
+                latency << s_latency_le[i];
+            } else {
+                latency << "+Inf";
+            }
+            latency << "\"} " << count << "\n";
+        }
+        latency << "zlm_stream_frame_latency_seconds_sum{" << labels << "} " << profiler.getCpuNanoseconds() / 1e9 << "\n";
+        latency << "zlm_stream_frame_latency_seconds_count{" << labels << "} " << count << "\n";
+    });
+    return frames << bytes_in << bytes_out << cpu << pool_hits << pool_misses << stage_cpu << latency;
+}
+
 void getStatisticJson(const function<void(Value &val)> &cb) {
     auto obj = std::make_shared<Value>(objectValue);
     auto &val = *obj;
@@ -518,6 +608,27 @@ void getStatisticJson(const function<void(Value &val)> &cb) {
 
     val["RtpPacket"] = (Json::UInt64)(ObjectStatistic<RtpPacket>::count());
     val["RtmpPacket"] = (Json::UInt64)(ObjectStatistic<RtmpPacket>::count());
+    {
+        // 帧、rtp/rtmp包等对象池命中统计
+        auto stat = ObjectPool::getStatistic();
+        val["ObjectPool"]["hit"] = (Json::UInt64)stat.hit;
+        val["ObjectPool"]["miss"] = (Json::UInt64)stat.miss;
+    }
+#if defined(ENABLE_MP4) && !defined(_WIN32)
+    {
+        // mp4录制写盘队列与耗时统计
+        auto stat = MP4WriteThreadPool::Instance().getStatistic();
+        auto &writer = val["MP4Writer"];
+        writer["threads"] = (Json::UInt64)stat.threads;
+        writer["queueDepth"] = (Json::UInt64)stat.queue_depth;
+        writer["queueBytes"] = (Json::UInt64)stat.queue_bytes;
+        writer["droppedFrames"] = (Json::UInt64)stat.dropped_frames;
+        writer["writtenBytes"] = (Json::UInt64)stat.written_bytes;
+        for (size_t i = 0; i < MP4WriteThreadPool::kLatencyBuckets; ++i) {
+            writer["latencyHistogram"][MP4WriteThreadPool::getLatencyBucketName(i)] = (Json::UInt64)stat.latency_histogram[i];
+        }
+    }
+#endif
 #ifdef ENABLE_MEM_DEBUG
     auto bytes = getTotalMemUsage();
     val["totalMemUsage"] = (Json::UInt64) bytes;
@@ -1844,6 +1955,35 @@ void installWebApi() {
         });
     });
 
+    // 获取每个流的性能统计(需要开启general.enable_stream_profile)
+    // 测试url http://127.0.0.1/index/api/getStreamProfile?format=prometheus
+    api_regist("/index/api/getStreamProfile",[](API_ARGS_MAP_ASYNC){
+        CHECK_SECRET();
+        if (allArgs["format"] == "prometheus") {
+            headerOut["Content-Type"] = "text/plain; version=0.0.4";
+            invoker(200, headerOut, makeStreamProfilePrometheus());
+            return;
+        }
+        val["data"] = makeStreamProfileJson();
+        invoker(200, headerOut, val.toStyledString());
+    });
+
+    // prometheus指标拉取接口，只累加各线程计数器，开销与会话个数无关
+    // 测试url http://127.0.0.1/index/api/metrics
+    api_regist("/index/api/metrics",[](API_ARGS_MAP_ASYNC){
+        CHECK_SECRET();
+        _StrPrinter printer;
+        printer << Metrics::toPrometheus();
+        printer << "# TYPE zlm_media_sources gauge\n";
+        printer << "zlm_media_sources " << ObjectStatistic<MediaSource>::count() << "\n";
+        printer << "# TYPE zlm_muxers gauge\n";
+        printer << "zlm_muxers " << ObjectStatistic<MultiMediaSourceMuxer>::count() << "\n";
+        // 开启general.enable_stream_profile后附带每个流的性能统计
+        printer << makeStreamProfilePrometheus();
+        headerOut["Content-Type"] = "text/plain; version=0.0.4";
+        invoker(200, headerOut, printer);
+    });
+
 #ifdef ENABLE_WEBRTC
     class WebRtcArgsImp : public WebRtcArgs {
     public:
@@ -346,7 +346,7 @@ int start_main(int argc,char *argv[]) {
             }
             auto new_poller = SRT::SrtSession::queryPoller(buf);
             if (!new_poller) {
-                //握手第一阶段
+                //未找到对应的srt对象
                 return Socket::createSocket(poller, false);
             }
             return Socket::createSocket(new_poller, false);
@@ -73,4 +73,29 @@ void JemallocUtil::some_malloc_stats(const std::function<void(const char *, uint
     }
 #endif
 }
+
+uint64_t JemallocUtil::get_malloc_count() {
+#ifdef USE_JEMALLOC
+    // 刷新统计数据
+    uint64_t epoch = 1;
+    size_t len = sizeof(epoch);
+    mallctl("epoch", &epoch, &len, &epoch, len);
+
+    static const std::string prefix = "stats.arenas." + std::to_string(MALLCTL_ARENAS_ALL);
+    uint64_t ret = 0;
+    for (auto stat : { ".small.nrequests", ".large.nrequests" }) {
+        uint64_t value;
+        len = sizeof(value);
+        auto err = mallctl((prefix + stat).data(), &value, &len, nullptr, 0);
+        if (err != 0) {
+            ErrorL << "Failed reading " << prefix << stat << ": " << err;
+            continue;
+        }
+        ret += value;
+    }
+    return ret;
+#else
+    return 0;
+#endif
+}
 } // namespace mediakit
\ No newline at end of file
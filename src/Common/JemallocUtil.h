@@ -23,6 +23,8 @@ public:
     static void dump(const std::string &file_name);
     static std::string get_malloc_stats();
     static void some_malloc_stats(const std::function<void(const char *, uint64_t)> &fn);
+    // 累计malloc请求次数(所有arena的small与large请求之和)，未启用jemalloc时返回0
+    static uint64_t get_malloc_count();
 };
 } // namespace mediakit
 #endif // ZLMEDIAKIT_JEMALLOCUTIL_H
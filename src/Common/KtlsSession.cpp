@@ -0,0 +1,746 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "KtlsSession.h"
+#include "Metrics.h"
+#include "Util/logger.h"
+#include "Util/uv_errno.h"
+
+#if defined(ENABLE_OPENSSL) && (defined(__linux__) || defined(__linux))
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/hmac.h>
+#if defined(__has_include)
+#if __has_include(<linux/tls.h>)
+#include <linux/tls.h>
+#endif
+#endif
+// keylog回调与SSL_set_num_tickets需要openssl 1.1.1
+#if defined(TLS_TX) && defined(TLS_1_3_VERSION) && defined(TLS_CIPHER_AES_GCM_256) && OPENSSL_VERSION_NUMBER >= 0x10101000L
+#define ENABLE_KTLS 1
+#endif
+#endif
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#ifndef TLS_SET_RECORD_TYPE
+#define TLS_SET_RECORD_TYPE 1
+#endif
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+#if defined(ENABLE_KTLS)
+
+// 单个tls记录明文最大长度
+static constexpr size_t kMaxRecordSize = 16 * 1024;
+
+union KtlsCryptoInfo {
+    struct tls_crypto_info info;
+    struct tls12_crypto_info_aes_gcm_128 gcm128;
+    struct tls12_crypto_info_aes_gcm_256 gcm256;
+};
+
+static int getBoxIndex() {
+    static int s_index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return s_index;
+}
+
+static string getSSLError() {
+    string ret;
+    unsigned long err;
+    while ((err = ERR_get_error()) != 0) {
+        char buf[256];
+        ERR_error_string_n(err, buf, sizeof(buf));
+        if (!ret.empty()) {
+            ret += "; ";
+        }
+        ret += buf;
+    }
+    return ret;
+}
+
+static string hexToBin(const char *hex) {
+    string ret;
+    auto value = [](char c) -> int {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        return -1;
+    };
+    while (value(hex[0]) >= 0 && value(hex[1]) >= 0) {
+        ret.push_back((char)(value(hex[0]) << 4 | value(hex[1])));
+        hex += 2;
+    }
+    return ret;
+}
+
+static void onKeyLog(const SSL *ssl, const char *line) {
+    // 格式: SERVER_TRAFFIC_SECRET_0 <client_random> <secret>，均为16进制
+    static const char kLabel[] = "SERVER_TRAFFIC_SECRET_0 ";
+    if (strncmp(line, kLabel, sizeof(kLabel) - 1)) {
+        return;
+    }
+    auto box = (KtlsBox *)SSL_get_ex_data(ssl, getBoxIndex());
+    auto secret = strchr(line + sizeof(kLabel) - 1, ' ');
+    if (box && secret) {
+        box->setServerSecret(hexToBin(secret + 1));
+    }
+}
+
+static void onMessage(int write_p, int version, int content_type, const void *buf, size_t len, SSL *ssl, void *arg) {
+    if (content_type == SSL3_RT_ALERT || content_type == SSL3_RT_HANDSHAKE) {
+        ((KtlsBox *)arg)->onControlMessage(write_p, content_type, buf, len);
+    }
+}
+
+static shared_ptr<SSL_CTX> getKtlsCtx(const string &vhost);
+
+static int onServerName(SSL *ssl, int *ad, void *arg) {
+    auto vhost = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+    if (!vhost) {
+        // 未指定sni，使用默认证书
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+    auto ctx = getKtlsCtx(vhost);
+    if (ctx && ctx.get() != SSL_get_SSL_CTX(ssl)) {
+        SSL_set_SSL_CTX(ssl, ctx.get());
+    }
+    return SSL_TLSEXT_ERR_OK;
+}
+
+/**
+ * 复制toolkit::SSL_Initor中的SSL_CTX创建kTLS专用的SSL_CTX
+ * keylog回调只能设置在SSL_CTX上，这样不会影响其他tls会话
+ */
+static shared_ptr<SSL_CTX> makeKtlsCtx(SSL_CTX *src) {
+    shared_ptr<SSL_CTX> ret(SSL_CTX_new(TLS_server_method()), SSL_CTX_free);
+    if (!ret) {
+        return nullptr;
+    }
+    auto ctx = ret.get();
+    if (src) {
+        // 复制所有证书(比如同时配置了RSA与ECDSA证书)及其证书链
+        for (auto has_cert = SSL_CTX_set_current_cert(src, SSL_CERT_SET_FIRST); has_cert == 1;
+             has_cert = SSL_CTX_set_current_cert(src, SSL_CERT_SET_NEXT)) {
+            auto cert = SSL_CTX_get0_certificate(src);
+            auto key = SSL_CTX_get0_privatekey(src);
+            if (SSL_CTX_use_certificate(ctx, cert) != 1 || SSL_CTX_use_PrivateKey(ctx, key) != 1) {
+                WarnL << "copy certificate for ktls failed:" << getSSLError();
+                SSL_CTX_set_current_cert(src, SSL_CERT_SET_FIRST);
+                return nullptr;
+            }
+            STACK_OF(X509) *chain = nullptr;
+            if (SSL_CTX_get0_chain_certs(src, &chain) && chain) {
+                SSL_CTX_set1_chain(ctx, chain);
+            }
+        }
+        SSL_CTX_set_current_cert(src, SSL_CERT_SET_FIRST);
+
+        // 加密套件，tls1.3套件需要单独设置
+        string ciphers, suites;
+        auto cipher_list = SSL_CTX_get_ciphers(src);
+        for (int i = 0; cipher_list && i < sk_SSL_CIPHER_num(cipher_list); ++i) {
+            auto cipher = sk_SSL_CIPHER_value(cipher_list, i);
+            auto &str = strcmp(SSL_CIPHER_get_version(cipher), "TLSv1.3") ? ciphers : suites;
+            if (!str.empty()) {
+                str.push_back(':');
+            }
+            str.append(SSL_CIPHER_get_name(cipher));
+        }
+        if ((!ciphers.empty() && SSL_CTX_set_cipher_list(ctx, ciphers.data()) != 1)
+            || (!suites.empty() && SSL_CTX_set_ciphersuites(ctx, suites.data()) != 1)) {
+            WarnL << "copy cipher list for ktls failed:" << getSSLError();
+            return nullptr;
+        }
+
+        SSL_CTX_set_options(ctx, SSL_CTX_get_options(src));
+        SSL_CTX_set_min_proto_version(ctx, SSL_CTX_get_min_proto_version(src));
+        SSL_CTX_set_max_proto_version(ctx, SSL_CTX_get_max_proto_version(src));
+        SSL_CTX_set_security_level(ctx, SSL_CTX_get_security_level(src));
+
+        // 客户端证书校验
+        SSL_CTX_set_verify(ctx, SSL_CTX_get_verify_mode(src), SSL_CTX_get_verify_callback(src));
+        SSL_CTX_set_verify_depth(ctx, SSL_CTX_get_verify_depth(src));
+        auto store = SSL_CTX_get_cert_store(src);
+        if (store && X509_STORE_up_ref(store) == 1) {
+            SSL_CTX_set_cert_store(ctx, store);
+        }
+        auto ca_list = SSL_CTX_get_client_CA_list(src);
+        if (ca_list) {
+            SSL_CTX_set_client_CA_list(ctx, SSL_dup_CA_list(ca_list));
+        }
+    }
+    // 源SSL_CTX的session id context无法读取，kTLS会话的会话缓存是独立的，使用固定值(开启客户端证书校验时会话复用需要)
+    static const char kSessionIdContext[] = "ZLMediaKit-ktls";
+    SSL_CTX_set_session_id_context(ctx, (const uint8_t *)kSessionIdContext, sizeof(kSessionIdContext) - 1);
+    SSL_CTX_set_keylog_callback(ctx, onKeyLog);
+    SSL_CTX_set_tlsext_servername_callback(ctx, onServerName);
+    return ret;
+}
+
+// 获取虚拟主机对应的kTLS专用SSL_CTX，证书重新加载后重新复制
+static shared_ptr<SSL_CTX> getKtlsCtx(const string &vhost) {
+    auto src = SSL_Initor::Instance().getSSLCtx(vhost, true);
+    if (!src && !vhost.empty()) {
+        src = SSL_Initor::Instance().getSSLCtx("", true);
+    }
+
+    static mutex s_mtx;
+    static unordered_map<SSL_CTX *, pair<weak_ptr<SSL_CTX>, shared_ptr<SSL_CTX>>> s_ctxs;
+    lock_guard<mutex> lck(s_mtx);
+    auto it = s_ctxs.find(src.get());
+    if (it != s_ctxs.end() && it->second.first.lock() == src) {
+        return it->second.second;
+    }
+    for (auto it = s_ctxs.begin(); it != s_ctxs.end();) {
+        // 清理已经释放的SSL_CTX
+        if (it->first && it->second.first.expired()) {
+            it = s_ctxs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    auto ctx = makeKtlsCtx(src.get());
+    if (ctx) {
+        s_ctxs[src.get()] = make_pair(weak_ptr<SSL_CTX>(src), ctx);
+    }
+    return ctx;
+}
+
+// tls1.2 PRF(rfc5246 5)
+static void tls12Prf(const EVP_MD *md, const string &secret, const string &label_seed, uint8_t *out, size_t out_len) {
+    uint8_t a[EVP_MAX_MD_SIZE], block[EVP_MAX_MD_SIZE];
+    unsigned int a_len, block_len;
+    HMAC(md, secret.data(), (int)secret.size(), (const uint8_t *)label_seed.data(), label_seed.size(), a, &a_len);
+    for (size_t done = 0; done < out_len; done += block_len) {
+        string input((char *)a, a_len);
+        input.append(label_seed);
+        HMAC(md, secret.data(), (int)secret.size(), (const uint8_t *)input.data(), input.size(), block, &block_len);
+        memcpy(out + done, block, min<size_t>(block_len, out_len - done));
+        HMAC(md, secret.data(), (int)secret.size(), (const uint8_t *)input.data(), a_len, a, &a_len);
+    }
+}
+
+// tls1.3 HKDF-Expand-Label(rfc8446 7.1)，context为空
+static void hkdfExpandLabel(const EVP_MD *md, const string &secret, const string &label, uint8_t *out, size_t out_len) {
+    string info;
+    info.push_back((char)(out_len >> 8));
+    info.push_back((char)(out_len & 0xFF));
+    info.push_back((char)(6 + label.size()));
+    info.append("tls13 ");
+    info.append(label);
+    info.push_back(0);
+
+    uint8_t block[EVP_MAX_MD_SIZE];
+    unsigned int block_len = 0;
+    uint8_t counter = 0;
+    for (size_t done = 0; done < out_len; done += block_len) {
+        string input((char *)block, block_len);
+        input.append(info);
+        input.push_back((char)++counter);
+        HMAC(md, secret.data(), (int)secret.size(), (const uint8_t *)input.data(), input.size(), block, &block_len);
+        memcpy(out + done, block, min<size_t>(block_len, out_len - done));
+    }
+}
+
+static void setBE64(uint8_t *out, uint64_t val) {
+    for (int i = 7; i >= 0; --i) {
+        out[i] = val & 0xFF;
+        val >>= 8;
+    }
+}
+
+/**
+ * 推导服务器发送方向的kTLS参数
+ * @return 返回参数长度，0代表不支持
+ */
+static size_t getTxCryptoInfo(SSL *ssl, const string &server_secret, KtlsCryptoInfo &info) {
+    auto cipher = SSL_get_current_cipher(ssl);
+    if (!cipher) {
+        return 0;
+    }
+    size_t key_len;
+    switch (SSL_CIPHER_get_cipher_nid(cipher)) {
+        case NID_aes_128_gcm: key_len = 16; break;
+        case NID_aes_256_gcm: key_len = 32; break;
+        default: return 0;
+    }
+    auto md = SSL_CIPHER_get_handshake_digest(cipher);
+    if (!md) {
+        return 0;
+    }
+
+    // 隐式nonce为salt(4字节) + iv(8字节)
+    uint8_t key[32], salt[4], iv[8], rec_seq[8];
+    memset(&info, 0, sizeof(info));
+    switch (SSL_version(ssl)) {
+        case TLS1_3_VERSION: {
+            if (server_secret.empty()) {
+                return 0;
+            }
+            uint8_t nonce[12];
+            hkdfExpandLabel(md, server_secret, "key", key, key_len);
+            hkdfExpandLabel(md, server_secret, "iv", nonce, sizeof(nonce));
+            memcpy(salt, nonce, 4);
+            memcpy(iv, nonce + 4, 8);
+            // 未发送NewSessionTicket，应用数据从序号0开始
+            setBE64(rec_seq, 0);
+            info.info.version = TLS_1_3_VERSION;
+            break;
+        }
+        case TLS1_2_VERSION: {
+            string master(SSL_MAX_MASTER_KEY_LENGTH, '\0');
+            master.resize(SSL_SESSION_get_master_key(SSL_get_session(ssl), (uint8_t *)&master[0], master.size()));
+            string label_seed = "key expansion";
+            uint8_t random[SSL3_RANDOM_SIZE];
+            SSL_get_server_random(ssl, random, sizeof(random));
+            label_seed.append((char *)random, sizeof(random));
+            SSL_get_client_random(ssl, random, sizeof(random));
+            label_seed.append((char *)random, sizeof(random));
+            // key_block: client_write_key, server_write_key, client_write_IV, server_write_IV(aes-gcm无mac key)
+            uint8_t key_block[2 * 32 + 2 * 4];
+            tls12Prf(md, master, label_seed, key_block, 2 * key_len + 8);
+            memcpy(key, key_block + key_len, key_len);
+            memcpy(salt, key_block + 2 * key_len + 4, 4);
+            // 服务器Finished消息占用序号0；显式nonce只需不重复，直接采用记录序号
+            setBE64(rec_seq, 1);
+            memcpy(iv, rec_seq, 8);
+            info.info.version = TLS_1_2_VERSION;
+            break;
+        }
+        default: return 0;
+    }
+
+    if (key_len == 16) {
+        info.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+        memcpy(info.gcm128.key, key, key_len);
+        memcpy(info.gcm128.salt, salt, 4);
+        memcpy(info.gcm128.iv, iv, 8);
+        memcpy(info.gcm128.rec_seq, rec_seq, 8);
+        return sizeof(info.gcm128);
+    }
+    info.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+    memcpy(info.gcm256.key, key, key_len);
+    memcpy(info.gcm256.salt, salt, 4);
+    memcpy(info.gcm256.iv, iv, 8);
+    memcpy(info.gcm256.rec_seq, rec_seq, 8);
+    return sizeof(info.gcm256);
+}
+
+bool KtlsBox::isSupported() {
+    return true;
+}
+
+KtlsBox::KtlsBox(Socket::Ptr sock) {
+    _sock = std::move(sock);
+    // 通过kTLS专用SSL_CTX的keylog回调获取tls1.3流量密钥
+    auto ctx = getKtlsCtx("");
+    if (ctx) {
+        _ssl.reset(SSL_new(ctx.get()), SSL_free);
+    }
+    if (!_ssl) {
+        throw std::runtime_error("create ssl failed");
+    }
+    _read_bio = BIO_new(BIO_s_mem());
+    _write_bio = BIO_new(BIO_s_mem());
+    SSL_set_bio(_ssl.get(), _read_bio, _write_bio);
+    SSL_set_accept_state(_ssl.get());
+    SSL_set_ex_data(_ssl.get(), getBoxIndex(), this);
+    SSL_set_msg_callback(_ssl.get(), onMessage);
+    SSL_set_msg_callback_arg(_ssl.get(), this);
+    // tls1.3的NewSessionTicket在握手后发送，会占用发送序号且无法交给内核，所以不发送(客户端无法复用会话)
+    SSL_set_num_tickets(_ssl.get(), 0);
+#ifdef SSL_OP_NO_RENEGOTIATION
+    // 开启kTLS后无法重新协商
+    SSL_set_options(_ssl.get(), SSL_OP_NO_RENEGOTIATION);
+#endif
+}
+
+KtlsBox::~KtlsBox() {
+    // 会话关闭时发送close_notify；还有未发送的数据时不发送，避免对端在数据之前收到close_notify
+    if (_ktls && !_alert_sent && !(SSL_get_shutdown(_ssl.get()) & SSL_SENT_SHUTDOWN) && _control_records.empty() && _buffer_send.empty()
+        && !getSendQueueSize()) {
+        sendRecord(SSL3_RT_ALERT, "\x01\x00", 2);
+    }
+}
+
+void KtlsBox::onRecv(const Buffer::Ptr &buffer) {
+    if (!buffer->size()) {
+        return;
+    }
+    BIO_write(_read_bio, buffer->data(), (int)buffer->size());
+    flushReadBio();
+}
+
+void KtlsBox::onSend(Buffer::Ptr buffer) {
+    if (!buffer->size()) {
+        return;
+    }
+    if (_ktls) {
+        if (_alert_sent) {
+            // 连接即将关闭
+            return;
+        }
+        if (!_control_records.empty()) {
+            // 控制记录还未发送，明文排在其后
+            _buffer_send.emplace_back(std::move(buffer));
+            return;
+        }
+        // 内核加密，明文直接写入socket
+        _on_enc(buffer);
+        return;
+    }
+    if (!_handshake_done) {
+        _buffer_send.emplace_back(std::move(buffer));
+        return;
+    }
+    size_t offset = 0;
+    while (offset < buffer->size()) {
+        auto size = min(kMaxRecordSize, buffer->size() - offset);
+        auto ret = SSL_write(_ssl.get(), buffer->data() + offset, (int)size);
+        if (ret <= 0) {
+            throw std::runtime_error(StrPrinter << "ssl write failed:" << getSSLError());
+        }
+        offset += ret;
+    }
+    flushWriteBio();
+}
+
+void KtlsBox::flushWriteBio() {
+    if (_ktls) {
+        // 开启kTLS后openssl的发送密钥与序号已经与内核不一致，其密文无法使用，
+        // 需要发送的告警与KeyUpdate已经由消息回调记录，以明文控制记录交给内核加密发送
+        (void)BIO_reset(_write_bio);
+        if (!flushControlRecords()) {
+            throw SockException(Err_shutdown, "ktls key update failed");
+        }
+        return;
+    }
+    auto pending = BIO_ctrl_pending(_write_bio);
+    if (!pending) {
+        return;
+    }
+    auto buffer = BufferRaw::create();
+    buffer->setCapacity(pending + 1);
+    auto size = BIO_read(_write_bio, buffer->data(), (int)pending);
+    if (size <= 0) {
+        return;
+    }
+    buffer->setSize(size);
+    _on_enc(buffer);
+}
+
+void KtlsBox::onControlMessage(bool write, uint8_t type, const void *data, size_t size) {
+    if (!_ktls) {
+        return;
+    }
+    auto ptr = (const uint8_t *)data;
+    if (write && type == SSL3_RT_ALERT) {
+        _control_records.emplace_back(type, string((const char *)data, size));
+    } else if (!write && type == SSL3_RT_HANDSHAKE && size >= 5 && ptr[0] == SSL3_MT_KEY_UPDATE && ptr[4] == SSL_KEY_UPDATE_REQUESTED) {
+        // 对端请求更新密钥，openssl只在下次SSL_write时才回复KeyUpdate，开启kTLS后不再调用SSL_write，所以由我们回复
+        // KeyUpdate: msg_type(1) + length(3) + request_update(1)，update_not_requested
+        static const char kKeyUpdate[] = { SSL3_MT_KEY_UPDATE, 0x00, 0x00, 0x01, SSL_KEY_UPDATE_NOT_REQUESTED };
+        _control_records.emplace_back(type, string(kKeyUpdate, sizeof(kKeyUpdate)));
+    }
+}
+
+bool KtlsBox::flushControlRecords() {
+    while (!_control_records.empty()) {
+        if (getSendQueueSize()) {
+            // 会话发送队列中的明文先写入内核，之后再发送控制记录，避免告警或KeyUpdate插队
+            startRetryTimer();
+            return true;
+        }
+        auto &record = _control_records.front();
+        auto type = record.first;
+        auto sent = sendRecord(type, record.second.data() + _control_offset, record.second.size() - _control_offset);
+        if (sent < 0) {
+            WarnL << "send tls control record failed, type:" << (int)type << ", err:" << get_uv_errmsg();
+            if (type != SSL3_RT_ALERT) {
+                return false;
+            }
+            // 告警之后连接会关闭，尽力发送即可
+            sent = record.second.size() - _control_offset;
+        }
+        _control_offset += sent;
+        if (_control_offset < record.second.size()) {
+            // socket不可写或者部分写入，稍后继续发送剩余部分
+            startRetryTimer();
+            return true;
+        }
+        _control_offset = 0;
+        _control_records.pop_front();
+        if (type == SSL3_RT_ALERT) {
+            _alert_sent = true;
+            _control_records.clear();
+            _buffer_send.clear();
+            return true;
+        }
+        // 对端请求更新密钥(tls1.3 KeyUpdate)，以旧密钥发送KeyUpdate后更新内核发送密钥，之后写入的明文使用新密钥
+        if (!rekeyTx()) {
+            return false;
+        }
+    }
+    // 发送控制记录期间缓存的明文
+    auto buffer_send = std::move(_buffer_send);
+    _buffer_send.clear();
+    for (auto &buffer : buffer_send) {
+        _on_enc(buffer);
+    }
+    return true;
+}
+
+void KtlsBox::startRetryTimer() {
+    if (_retrying) {
+        return;
+    }
+    _retrying = true;
+    // 定时器由本对象持有，析构时取消，所以可以捕获this
+    _retry_timer = std::make_shared<Timer>(0.01f, [this]() {
+        if (!flushControlRecords()) {
+            _control_records.clear();
+            _retrying = false;
+            _sock->emitErr(SockException(Err_shutdown, "ktls key update failed"));
+            return false;
+        }
+        _retrying = !_control_records.empty();
+        return _retrying;
+    }, _sock->getPoller());
+}
+
+size_t KtlsBox::getSendQueueSize() {
+    return _sock->getSendBufferCount();
+}
+
+ssize_t KtlsBox::sendRaw(const char *data, size_t size) {
+    auto fd = _sock->rawFD();
+    if (fd < 0) {
+        return -1;
+    }
+    size_t sent = 0;
+    while (sent < size) {
+        auto ret = ::send(fd, data + sent, size - sent, MSG_NOSIGNAL);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            break;
+        }
+        sent += ret;
+    }
+    return sent;
+}
+
+bool KtlsBox::setTxCryptoInfo(const void *info, size_t size, bool rekey) {
+    auto fd = _sock->rawFD();
+    if (fd < 0) {
+        return false;
+    }
+    if (!rekey && setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) != 0) {
+        WarnL << "enable ktls failed(modprobe tls?):" << get_uv_errmsg();
+        return false;
+    }
+    if (setsockopt(fd, SOL_TLS, TLS_TX, info, size) != 0) {
+        if (rekey) {
+            WarnL << "update ktls tx key failed(kernel does not support tls1.3 tx rekey?):" << get_uv_errmsg();
+        } else {
+            WarnL << "set ktls tx key failed:" << get_uv_errmsg();
+        }
+        return false;
+    }
+    return true;
+}
+
+ssize_t KtlsBox::sendRecord(uint8_t type, const char *data, size_t size) {
+    auto fd = _sock->rawFD();
+    if (fd < 0) {
+        return -1;
+    }
+    char control[CMSG_SPACE(sizeof(type))];
+    memset(control, 0, sizeof(control));
+    struct iovec iov;
+    iov.iov_base = (void *)data;
+    iov.iov_len = size;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_TLS;
+    cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(type));
+    *CMSG_DATA(cmsg) = type;
+    while (true) {
+        auto ret = ::sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 0;
+        }
+        return ret;
+    }
+}
+
+bool KtlsBox::rekeyTx() {
+    auto cipher = SSL_get_current_cipher(_ssl.get());
+    auto md = cipher ? SSL_CIPHER_get_handshake_digest(cipher) : nullptr;
+    if (!md || _server_secret.empty()) {
+        return false;
+    }
+    // rfc8446 7.2: application_traffic_secret_N+1 = HKDF-Expand-Label(application_traffic_secret_N, "traffic upd", "", Hash.length)
+    string secret(_server_secret.size(), '\0');
+    hkdfExpandLabel(md, _server_secret, "traffic upd", (uint8_t *)&secret[0], secret.size());
+    _server_secret = std::move(secret);
+
+    // 新密钥的记录序号从0开始
+    KtlsCryptoInfo info;
+    auto info_len = getTxCryptoInfo(_ssl.get(), _server_secret, info);
+    return info_len && setTxCryptoInfo(&info, info_len, true);
+}
+
+void KtlsBox::flushReadBio() {
+    if (!_handshake_done) {
+        auto ret = SSL_do_handshake(_ssl.get());
+        if (ret != 1) {
+            auto err = SSL_get_error(_ssl.get(), ret);
+            flushWriteBio();
+            if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+                return;
+            }
+            throw std::runtime_error(StrPrinter << "tls handshake failed:" << getSSLError());
+        }
+        onHandshakeDone();
+    }
+
+    // 单个tls记录最大16KB
+    static thread_local char s_buf[kMaxRecordSize];
+    while (true) {
+        auto ret = SSL_read(_ssl.get(), s_buf, sizeof(s_buf));
+        if (ret <= 0) {
+            auto err = SSL_get_error(_ssl.get(), ret);
+            flushWriteBio();
+            if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+                return;
+            }
+            if (err == SSL_ERROR_ZERO_RETURN) {
+                // 回复close_notify
+                SSL_shutdown(_ssl.get());
+                flushWriteBio();
+                throw SockException(Err_shutdown, "tls close notify");
+            }
+            throw std::runtime_error(StrPrinter << "ssl read failed:" << getSSLError());
+        }
+        auto buffer = BufferRaw::create();
+        buffer->assign(s_buf, ret);
+        _on_dec(buffer);
+    }
+}
+
+void KtlsBox::onHandshakeDone() {
+    _handshake_done = true;
+    if (enableKtls()) {
+        Metrics::add(Metrics::kKtlsEnabled);
+    } else {
+        Metrics::add(Metrics::kKtlsFallback);
+        flushWriteBio();
+    }
+    // 发送握手完成前缓存的明文
+    auto buffer_send = std::move(_buffer_send);
+    for (auto &buffer : buffer_send) {
+        onSend(std::move(buffer));
+    }
+}
+
+bool KtlsBox::enableKtls() {
+    KtlsCryptoInfo info;
+    auto info_len = getTxCryptoInfo(_ssl.get(), _server_secret, info);
+    if (!info_len) {
+        DebugL << "ktls not supported, version:" << SSL_get_version(_ssl.get()) << ", cipher:" << SSL_get_cipher_name(_ssl.get());
+        return false;
+    }
+
+    // 握手的最后数据(比如tls1.2的ChangeCipherSpec与Finished)必须在开启kTLS前以密文写入socket，
+    // 所以直接写入socket；如果会话发送队列中还有数据，这些数据会在开启kTLS后才写入socket并被内核再次加密，只能回退
+    if (getSendQueueSize()) {
+        DebugL << "ktls disabled, socket send queue not empty";
+        return false;
+    }
+    string tail;
+    tail.resize(BIO_ctrl_pending(_write_bio));
+    if (!tail.empty()) {
+        tail.resize(BIO_read(_write_bio, &tail[0], (int)tail.size()));
+    }
+    auto sent = tail.empty() ? 0 : sendRaw(tail.data(), tail.size());
+    if (sent < (ssize_t)tail.size()) {
+        // 未能一次写入，剩余数据交给会话发送，回退到用户态加密
+        _on_enc(std::make_shared<BufferString>(tail.substr(max<ssize_t>(sent, 0))));
+        return false;
+    }
+    if (!setTxCryptoInfo(&info, info_len, false)) {
+        return false;
+    }
+    _ktls = true;
+    return true;
+}
+
+#else
+
+bool KtlsBox::isSupported() {
+    return false;
+}
+
+KtlsBox::KtlsBox(Socket::Ptr sock) {
+    _sock = std::move(sock);
+    throw std::runtime_error("ktls not supported");
+}
+
+KtlsBox::~KtlsBox() = default;
+void KtlsBox::onRecv(const Buffer::Ptr &buffer) {}
+void KtlsBox::onSend(Buffer::Ptr buffer) {}
+void KtlsBox::onControlMessage(bool write, uint8_t type, const void *data, size_t size) {}
+void KtlsBox::flushWriteBio() {}
+void KtlsBox::flushReadBio() {}
+void KtlsBox::onHandshakeDone() {}
+bool KtlsBox::enableKtls() { return false; }
+bool KtlsBox::flushControlRecords() { return false; }
+void KtlsBox::startRetryTimer() {}
+bool KtlsBox::rekeyTx() { return false; }
+size_t KtlsBox::getSendQueueSize() { return 0; }
+ssize_t KtlsBox::sendRaw(const char *data, size_t size) { return -1; }
+bool KtlsBox::setTxCryptoInfo(const void *info, size_t size, bool rekey) { return false; }
+ssize_t KtlsBox::sendRecord(uint8_t type, const char *data, size_t size) { return -1; }
+
+#endif // defined(ENABLE_KTLS)
+
+} // namespace mediakit
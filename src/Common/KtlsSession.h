@@ -0,0 +1,210 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_KTLSSESSION_H
+#define ZLMEDIAKIT_KTLSSESSION_H
+
+#include <list>
+#include <memory>
+#include <string>
+#include <functional>
+#include "Common/config.h"
+#include "Network/Session.h"
+#include "Poller/Timer.h"
+#include "Util/SSLBox.h"
+
+typedef struct ssl_st SSL;
+typedef struct bio_st BIO;
+
+namespace mediakit {
+
+/**
+ * 支持内核tls(kTLS)发送加密的tls服务器端
+ * 握手与接收方向解密由openssl在用户态完成，握手完成后推导出发送方向密钥并交给内核(setsockopt TLS_TX)，
+ * 之后发送的明文直接写入socket，由内核(或支持tls offload的网卡)加密，省去用户态加密与拷贝；
+ * 开启后openssl产生的告警与KeyUpdate以控制记录交给内核发送，控制记录排在会话发送队列中已有的明文之后，
+ * socket不可写时定时重试；对端请求更新密钥时同步更新内核发送密钥；
+ * 仅支持linux下的AES-GCM加密套件(tls1.2/tls1.3)，不支持时回退到用户态加密，功能与toolkit::SSL_Box一致
+ * 为了获取tls1.3流量密钥，kTLS会话使用独立的SSL_CTX，复制toolkit::SSL_Initor中各虚拟主机的所有证书与证书链、
+ * 加密套件、协议版本、选项、安全级别与客户端证书校验设置；
+ * openssl无法读取SSL_CTX上的alpn选择回调、ecdh曲线列表与session id context，所以kTLS会话不协商alpn、使用openssl默认曲线，
+ * session id context使用独立的固定值(toolkit::SSL_Initor创建的SSL_CTX也未设置alpn与曲线)
+ */
+class KtlsBox {
+public:
+    using onData = std::function<void(const toolkit::Buffer::Ptr &)>;
+
+    /**
+     * @param sock 会话socket，握手完成后在其fd上开启kTLS
+     */
+    KtlsBox(toolkit::Socket::Ptr sock);
+    virtual ~KtlsBox();
+
+    KtlsBox(const KtlsBox &) = delete;
+    KtlsBox &operator=(const KtlsBox &) = delete;
+
+    /**
+     * 当前平台与编译选项是否支持kTLS(linux且开启openssl)
+     */
+    static bool isSupported();
+
+    /**
+     * 设置需要由会话写入socket的数据回调，用户态加密时为密文，开启kTLS后为明文
+     */
+    void setOnEncData(onData cb) { _on_enc = std::move(cb); }
+
+    /**
+     * 设置解密后的明文回调
+     */
+    void setOnDecData(onData cb) { _on_dec = std::move(cb); }
+
+    /**
+     * 收到密文
+     */
+    void onRecv(const toolkit::Buffer::Ptr &buffer);
+
+    /**
+     * 发送明文，握手完成前先缓存
+     */
+    void onSend(toolkit::Buffer::Ptr buffer);
+
+    /**
+     * 发送方向是否已经由内核加密
+     */
+    bool isKtls() const { return _ktls; }
+
+    /**
+     * 供openssl keylog回调保存tls1.3服务器发送方向的流量密钥
+     */
+    void setServerSecret(std::string secret) { _server_secret = std::move(secret); }
+
+    /**
+     * 供openssl消息回调记录开启kTLS后需要交给内核发送的告警与KeyUpdate
+     * @param write 是否为openssl发送的消息，否则为收到的消息
+     * @param type 记录类型，SSL3_RT_ALERT或SSL3_RT_HANDSHAKE
+     */
+    void onControlMessage(bool write, uint8_t type, const void *data, size_t size);
+
+protected:
+    /**
+     * 获取会话socket发送队列中还未写入内核的Buffer个数
+     */
+    virtual size_t getSendQueueSize();
+
+    /**
+     * 开启kTLS前把握手的最后数据直接写入socket
+     * @return 写入的字节数，失败返回-1
+     */
+    virtual ssize_t sendRaw(const char *data, size_t size);
+
+    /**
+     * 设置内核发送方向的加密参数
+     * @param info tls12_crypto_info_aes_gcm_128或tls12_crypto_info_aes_gcm_256
+     * @param rekey 是否为更新密钥，否则为开启kTLS
+     */
+    virtual bool setTxCryptoInfo(const void *info, size_t size, bool rekey);
+
+    /**
+     * 以指定记录类型把控制记录交给内核加密发送
+     * @return 写入的字节数，socket不可写返回0，失败返回-1
+     */
+    virtual ssize_t sendRecord(uint8_t type, const char *data, size_t size);
+
+private:
+    void flushWriteBio();
+    void flushReadBio();
+    void onHandshakeDone();
+    bool enableKtls();
+    bool flushControlRecords();
+    void startRetryTimer();
+    bool rekeyTx();
+
+private:
+    toolkit::Socket::Ptr _sock;
+    bool _ktls = false;
+    bool _handshake_done = false;
+    // 已经发送告警，连接即将关闭，不再发送明文
+    bool _alert_sent = false;
+    bool _retrying = false;
+    std::shared_ptr<SSL> _ssl;
+    BIO *_read_bio = nullptr;
+    BIO *_write_bio = nullptr;
+    std::string _server_secret;
+    // 握手完成前，或者开启kTLS后控制记录发送完毕前缓存的明文
+    std::list<toolkit::Buffer::Ptr> _buffer_send;
+    // 开启kTLS后openssl需要发送的控制记录
+    std::list<std::pair<uint8_t, std::string>> _control_records;
+    // 第一个控制记录已经写入内核的字节数
+    size_t _control_offset = 0;
+    toolkit::Timer::Ptr _retry_timer;
+    onData _on_enc;
+    onData _on_dec;
+};
+
+/**
+ * 可选开启kTLS的tls会话，用法与toolkit::SessionWithSSL相同
+ * 未开启general.enable_ktls时直接使用toolkit::SSL_Box
+ */
+template <typename SessionType>
+class SessionWithKTLS : public SessionType {
+public:
+    template <typename... ArgsType>
+    SessionWithKTLS(ArgsType &&...args) : SessionType(std::forward<ArgsType>(args)...) {
+        GET_CONFIG(bool, enable_ktls, General::kEnableKtls);
+        if (!enable_ktls || !KtlsBox::isSupported()) {
+            _ssl_box.reset(new toolkit::SSL_Box(true));
+            _ssl_box->setOnEncData([&](const toolkit::Buffer::Ptr &buf) { public_send(buf); });
+            _ssl_box->setOnDecData([&](const toolkit::Buffer::Ptr &buf) { public_onRecv(buf); });
+            return;
+        }
+        _ktls_box.reset(new KtlsBox(this->getSock()));
+        _ktls_box->setOnEncData([&](const toolkit::Buffer::Ptr &buf) { public_send(buf); });
+        _ktls_box->setOnDecData([&](const toolkit::Buffer::Ptr &buf) { public_onRecv(buf); });
+    }
+
+    ~SessionWithKTLS() override {
+        if (_ssl_box) {
+            _ssl_box->flush();
+        }
+    }
+
+    void onRecv(const toolkit::Buffer::Ptr &buf) override {
+        if (_ssl_box) {
+            _ssl_box->onRecv(buf);
+        } else {
+            _ktls_box->onRecv(buf);
+        }
+    }
+
+    // 添加public_onRecv和public_send函数是解决较低版本gcc一个lambda中访问protected或private方法导致的编译错误
+    inline void public_onRecv(const toolkit::Buffer::Ptr &buf) { SessionType::onRecv(buf); }
+    inline void public_send(const toolkit::Buffer::Ptr &buf) { SessionType::send(buf); }
+
+    bool overSsl() const override { return true; }
+
+protected:
+    ssize_t send(toolkit::Buffer::Ptr buf) override {
+        auto size = buf->size();
+        if (_ssl_box) {
+            _ssl_box->onSend(std::move(buf));
+        } else {
+            _ktls_box->onSend(std::move(buf));
+        }
+        return size;
+    }
+
+private:
+    std::unique_ptr<toolkit::SSL_Box> _ssl_box;
+    std::unique_ptr<KtlsBox> _ktls_box;
+};
+
+} // namespace mediakit
+
+#endif // ZLMEDIAKIT_KTLSSESSION_H
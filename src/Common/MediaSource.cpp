@@ -28,12 +28,66 @@ namespace toolkit {
 
 namespace mediakit {
 
-static recursive_mutex s_media_source_mtx;
 using StreamMap = unordered_map<string/*strema_id*/, weak_ptr<MediaSource> >;
 using AppStreamMap = unordered_map<string/*app*/, StreamMap>;
 using VhostAppStreamMap = unordered_map<string/*vhost*/, AppStreamMap>;
 using SchemaVhostAppStreamMap = unordered_map<string/*schema*/, VhostAppStreamMap>;
-static SchemaVhostAppStreamMap s_media_source_map;
+
+/**
+ * 媒体源注册表
+ * 按vhost/app/stream的hash值分片(同一条流的不同schema在同一分片)，每个分片采用写时复制：
+ * 注册/注销时只锁住本分片并替换其快照，查找与遍历只需原子的获取分片快照，
+ * 这样播放请求、hook回调、getMediaList等操作不会被注册/注销期间的拷贝与回调阻塞
+ *
+ * 注意：项目基于C++11，没有std::atomic<std::shared_ptr>，shared_ptr的atomic_load/atomic_store
+ * 在libstdc++/libc++中由全局的小互斥锁池实现，所以获取快照并非wait-free，只是临界区极短(一次引用计数增减)；
+ * 注册/注销时会拷贝整个分片(约为全部流的1/kShardCount)，适用于读远多于写的场景
+ */
+class MediaSourceRegistry {
+public:
+    using MapPtr = std::shared_ptr<const SchemaVhostAppStreamMap>;
+    static constexpr size_t kShardCount = 64;
+
+    static size_t shardIndex(const string &vhost, const string &app, const string &stream) {
+        std::hash<string> hasher;
+        auto ret = hasher(vhost);
+        ret = ret * 31 + hasher(app);
+        ret = ret * 31 + hasher(stream);
+        return ret % kShardCount;
+    }
+
+    /**
+     * 获取分片快照，快照只读，可在任意线程访问
+     */
+    MapPtr snapshot(size_t index) const {
+        return std::atomic_load(&_shards[index].map);
+    }
+
+    /**
+     * 修改分片，多个写者之间通过分片互斥锁串行化
+     * @param func 修改拷贝后的分片，返回false时放弃修改
+     */
+    bool update(size_t index, const function<bool(SchemaVhostAppStreamMap &map)> &func) {
+        auto &shard = _shards[index];
+        lock_guard<mutex> lck(shard.mtx);
+        auto copy = std::make_shared<SchemaVhostAppStreamMap>(*shard.map);
+        if (!func(*copy)) {
+            return false;
+        }
+        std::atomic_store(&shard.map, MapPtr(std::move(copy)));
+        return true;
+    }
+
+private:
+    struct Shard {
+        mutex mtx;
+        MapPtr map = std::make_shared<SchemaVhostAppStreamMap>();
+    };
+    Shard _shards[kShardCount];
+};
+
+constexpr size_t MediaSourceRegistry::kShardCount;
+static MediaSourceRegistry s_media_source_registry;
 
 string getOriginTypeString(MediaOriginType type){
 #define SWITCH_CASE(type) case MediaOriginType::type : return #type
@@ -333,9 +387,16 @@ void MediaSource::for_each_media(const function<void(const Ptr &src)> &cb,
                                  const string &app,
                                  const string &stream) {
     deque<Ptr> src_list;
-    {
-        lock_guard<recursive_mutex> lock(s_media_source_mtx);
-        for_each_media_l(s_media_source_map, src_list, schema, vhost, app, stream);
+    if (!vhost.empty() && !app.empty() && !stream.empty()) {
+        // 精确查找，只需要访问一个分片
+        auto map = s_media_source_registry.snapshot(MediaSourceRegistry::shardIndex(vhost, app, stream));
+        for_each_media_l(*map, src_list, schema, vhost, app, stream);
+    } else {
+        // 遍历所有分片的快照，期间不阻塞注册与注销
+        for (size_t i = 0; i < MediaSourceRegistry::kShardCount; ++i) {
+            auto map = s_media_source_registry.snapshot(i);
+            for_each_media_l(*map, src_list, schema, vhost, app, stream);
+        }
     }
     for (auto &src : src_list) {
         cb(src);
@@ -465,7 +526,37 @@ MediaSource::Ptr MediaSource::find(const string &vhost, const string &app, const
     return MediaSource::find(HLS_FMP4_SCHEMA, vhost, app, stream_id, from_mp4);
 }
 
-void MediaSource::emitEvent(bool regist){
+static thread_local bool s_parallel_mux_thread = false;
+
+void MediaSource::setParallelMuxThread() {
+    s_parallel_mux_thread = true;
+}
+
+void MediaSource::emitEvent(bool regist) {
+    if (s_parallel_mux_thread) {
+        EventPoller::Ptr poller;
+        try {
+            poller = getOwnerPoller();
+        } catch (...) {
+            // 未设置监听者或监听者未实现getOwnerPoller，在当前线程触发
+        }
+        MediaSource::Ptr strong_self;
+        try {
+            strong_self = shared_from_this();
+        } catch (std::exception &) {
+            // 析构中注销，不能阻塞等待其他线程，只能在当前线程触发；
+            // 之前投递的事件持有强引用，此时必然已经触发，所以注销事件不会先于注册事件到达
+        }
+        if (poller && strong_self && !poller->isCurrentThread()) {
+            // 并行复用时媒体源在复用线程注册注销，事件切回归属线程触发，与串行复用时保持一致
+            poller->async([strong_self, regist]() { strong_self->emitEvent_l(regist); }, false);
+            return;
+        }
+    }
+    emitEvent_l(regist);
+}
+
+void MediaSource::emitEvent_l(bool regist){
     auto listener = _listener.lock();
     if (listener) {
         //触发回调
@@ -477,21 +568,23 @@ void MediaSource::emitEvent(bool regist){
 }
 
 void MediaSource::regist() {
-    {
-        //减小互斥锁临界区
-        lock_guard<recursive_mutex> lock(s_media_source_mtx);
-        auto &ref = s_media_source_map[_schema][_tuple.vhost][_tuple.app][_tuple.stream];
+    auto index = MediaSourceRegistry::shardIndex(_tuple.vhost, _tuple.app, _tuple.stream);
+    auto changed = s_media_source_registry.update(index, [&](SchemaVhostAppStreamMap &map) {
+        auto &ref = map[_schema][_tuple.vhost][_tuple.app][_tuple.stream];
         auto src = ref.lock();
         if (src) {
             if (src.get() == this) {
-                return;
+                return false;
             }
             //增加判断, 防止当前流已注册时再次注册
             throw std::invalid_argument("media source already existed:" + getUrl());
         }
         ref = shared_from_this();
+        return true;
+    });
+    if (changed) {
+        emitEvent(true);
     }
-    emitEvent(true);
 }
 
 template<typename MAP, typename First, typename ...KeyTypes>
@@ -520,11 +613,11 @@ static bool erase_media_source(bool &hit, const MediaSource *thiz, MAP &map, con
 //反注册该源
 bool MediaSource::unregist() {
     bool ret = false;
-    {
-        //减小互斥锁临界区
-        lock_guard<recursive_mutex> lock(s_media_source_mtx);
-        erase_media_source(ret, this, s_media_source_map, _schema, _tuple.vhost, _tuple.app, _tuple.stream);
-    }
+    auto index = MediaSourceRegistry::shardIndex(_tuple.vhost, _tuple.app, _tuple.stream);
+    s_media_source_registry.update(index, [&](SchemaVhostAppStreamMap &map) {
+        erase_media_source(ret, this, map, _schema, _tuple.vhost, _tuple.app, _tuple.stream);
+        return ret;
+    });
 
     if (ret) {
         emitEvent(false);
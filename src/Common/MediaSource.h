@@ -11,6 +11,7 @@
 #ifndef ZLMEDIAKIT_MEDIASOURCE_H
 #define ZLMEDIAKIT_MEDIASOURCE_H
 
+#include <mutex>
 #include <string>
 #include <atomic>
 #include <memory>
@@ -316,6 +317,41 @@ public:
 
 bool equalMediaTuple(const MediaTuple& a, const MediaTuple& b);
 
+/**
+ * 线程安全的码率统计
+ * 并行复用时媒体源的数据在复用线程写入，码率在http api等线程读取；写入只做一次原子累加
+ */
+class AtomicBytesSpeed {
+public:
+    AtomicBytesSpeed &operator+=(size_t bytes) {
+        _bytes.fetch_add(bytes, std::memory_order_relaxed);
+        return *this;
+    }
+
+    /**
+     * 获取速度，单位bytes/s，与BytesSpeed一样最多每秒计算一次
+     */
+    int getSpeed() {
+        std::lock_guard<std::mutex> lck(_mtx);
+        auto elapsed = _ticker.elapsedTime();
+        if (elapsed < 1000) {
+            return _speed;
+        }
+        auto bytes = _bytes.load(std::memory_order_relaxed);
+        _speed = (int)((bytes - _last_bytes) * 1000 / elapsed);
+        _last_bytes = bytes;
+        _ticker.resetTime();
+        return _speed;
+    }
+
+private:
+    int _speed = 0;
+    uint64_t _last_bytes = 0;
+    std::atomic<uint64_t> _bytes { 0 };
+    std::mutex _mtx;
+    toolkit::Ticker _ticker;
+};
+
 /**
  * 媒体源，任何rtsp/rtmp的直播流都源自该对象
  */
@@ -430,6 +466,13 @@ public:
     // 从mp4文件生成MediaSource
     static MediaSource::Ptr createFromMP4(const std::string &schema, const std::string &vhost, const std::string &app, const std::string &stream, const std::string &file_path = "", bool check_app = true);
 
+    /**
+     * 标记当前线程为并行复用线程
+     * 只有在该类线程中注册注销媒体源时，媒体事件(onRegist与kBroadcastMediaChanged)才异步切回归属线程触发，
+     * 其他线程中与串行复用时一样同步触发
+     */
+    static void setParallelMuxThread();
+
 protected:
     //媒体注册
     void regist();
@@ -437,11 +480,12 @@ protected:
 private:
     // 媒体注销
     bool unregist();
-    // 触发媒体事件
+    // 触发媒体事件，在并行复用线程中注册注销时异步切换到归属线程触发
     void emitEvent(bool regist);
+    void emitEvent_l(bool regist);
 
 protected:
-    toolkit::BytesSpeed _speed[TrackMax];
+    AtomicBytesSpeed _speed[TrackMax];
     MediaTuple _tuple;
 
 private:
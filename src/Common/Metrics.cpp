@@ -0,0 +1,183 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "Metrics.h"
+#include "Util/util.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+constexpr size_t Metrics::kHlsSegmentBuckets;
+
+// 计数器在线程计数块中的下标
+enum {
+    kSessionIndex = 0,
+    kBytesInIndex = kSessionIndex + Metrics::kProtocolCount,
+    kBytesOutIndex = kBytesInIndex + Metrics::kProtocolCount,
+    kSendBatchIndex = kBytesOutIndex + Metrics::kProtocolCount,
+    kSendIovecIndex = kSendBatchIndex + Metrics::kProtocolCount,
+    kSendBufferIndex = kSendIovecIndex + Metrics::kProtocolCount,
+    kCounterIndex = kSendBufferIndex + Metrics::kProtocolCount,
+    kHlsBucketIndex = kCounterIndex + Metrics::kCounterCount,
+    kHlsSumIndex = kHlsBucketIndex + Metrics::kHlsSegmentBuckets,
+    kValueCount
+};
+
+// hls切片生成耗时直方图档位上限，单位纳秒
+static const uint64_t s_hls_limit_ns[Metrics::kHlsSegmentBuckets - 1] = { 1000000, 5000000, 10000000, 50000000, 100000000, 500000000 };
+static const char *s_hls_limit_le[Metrics::kHlsSegmentBuckets] = { "0.001", "0.005", "0.01", "0.05", "0.1", "0.5", "+Inf" };
+static const char *s_protocol_name[Metrics::kProtocolCount] = { "rtsp", "rtmp", "http", "webrtc", "srt", "rtp" };
+
+class ThreadCounters {
+public:
+    ThreadCounters() {
+        for (auto &val : _values) {
+            val = 0;
+        }
+    }
+
+    void add(size_t index, int64_t count) {
+        // 只有本线程会写入，不需要原子加，原子变量只是为了拉取指标线程读取安全
+        auto &val = _values[index];
+        val.store(val.load(memory_order_relaxed) + count, memory_order_relaxed);
+    }
+
+    int64_t get(size_t index) const { return _values[index].load(memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> _values[kValueCount];
+};
+
+static mutex s_mtx;
+static vector<ThreadCounters *> s_counters;
+
+static ThreadCounters &getThreadCounters() {
+    // 线程退出后计数块不释放，保证counter类型指标单调递增(线程个数有限，不会无限增长)
+    static thread_local ThreadCounters *s_local = []() {
+        auto ret = new ThreadCounters;
+        lock_guard<mutex> lck(s_mtx);
+        s_counters.emplace_back(ret);
+        return ret;
+    }();
+    return *s_local;
+}
+
+static int64_t sumCounters(size_t index) {
+    int64_t ret = 0;
+    for (auto counters : s_counters) {
+        ret += counters->get(index);
+    }
+    return ret;
+}
+
+Metrics::SessionCounter::SessionCounter(Protocol protocol) {
+    _protocol = protocol;
+    getThreadCounters().add(kSessionIndex + protocol, 1);
+}
+
+Metrics::SessionCounter::~SessionCounter() {
+    // 会话可能在其他线程析构，各线程计数累加后仍然正确
+    getThreadCounters().add(kSessionIndex + _protocol, -1);
+}
+
+void Metrics::addBytesIn(Protocol protocol, size_t bytes) {
+    getThreadCounters().add(kBytesInIndex + protocol, bytes);
+}
+
+void Metrics::addBytesOut(Protocol protocol, size_t bytes) {
+    getThreadCounters().add(kBytesOutIndex + protocol, bytes);
+}
+
+void Metrics::onSendBatch(Protocol protocol, size_t iovecs, size_t buffers) {
+    auto &counters = getThreadCounters();
+    counters.add(kSendBatchIndex + protocol, 1);
+    counters.add(kSendIovecIndex + protocol, iovecs);
+    counters.add(kSendBufferIndex + protocol, buffers);
+}
+
+void Metrics::add(Counter counter, uint64_t count) {
+    getThreadCounters().add(kCounterIndex + counter, count);
+}
+
+void Metrics::onHlsSegment(uint64_t ns) {
+    size_t bucket = 0;
+    while (bucket < kHlsSegmentBuckets - 1 && ns >= s_hls_limit_ns[bucket]) {
+        ++bucket;
+    }
+    auto &counters = getThreadCounters();
+    counters.add(kHlsBucketIndex + bucket, 1);
+    counters.add(kHlsSumIndex, ns);
+}
+
+string Metrics::toPrometheus() {
+    lock_guard<mutex> lck(s_mtx);
+    _StrPrinter printer;
+    printer << "# TYPE zlm_sessions gauge\n";
+    for (int i = 0; i < kProtocolCount; ++i) {
+        printer << "zlm_sessions{protocol=\"" << s_protocol_name[i] << "\"} " << sumCounters(kSessionIndex + i) << "\n";
+    }
+    printer << "# TYPE zlm_bytes_received_total counter\n";
+    for (int i = 0; i < kProtocolCount; ++i) {
+        printer << "zlm_bytes_received_total{protocol=\"" << s_protocol_name[i] << "\"} " << sumCounters(kBytesInIndex + i) << "\n";
+    }
+    printer << "# TYPE zlm_bytes_sent_total counter\n";
+    for (int i = 0; i < kProtocolCount; ++i) {
+        printer << "zlm_bytes_sent_total{protocol=\"" << s_protocol_name[i] << "\"} " << sumCounters(kBytesOutIndex + i) << "\n";
+    }
+    // 合并写批次数，iovecs与batches之比即每批的平均iovec个数(socket不可写时实际系统调用次数会不同)
+    printer << "# TYPE zlm_send_batches_total counter\n";
+    for (int i = 0; i < kProtocolCount; ++i) {
+        printer << "zlm_send_batches_total{protocol=\"" << s_protocol_name[i] << "\"} " << sumCounters(kSendBatchIndex + i) << "\n";
+    }
+    printer << "# TYPE zlm_send_iovecs_total counter\n";
+    for (int i = 0; i < kProtocolCount; ++i) {
+        printer << "zlm_send_iovecs_total{protocol=\"" << s_protocol_name[i] << "\"} " << sumCounters(kSendIovecIndex + i) << "\n";
+    }
+    printer << "# TYPE zlm_send_buffers_total counter\n";
+    for (int i = 0; i < kProtocolCount; ++i) {
+        printer << "zlm_send_buffers_total{protocol=\"" << s_protocol_name[i] << "\"} " << sumCounters(kSendBufferIndex + i) << "\n";
+    }
+
+    auto counter = [&](const char *name, Counter index) {
+        printer << "# TYPE " << name << " counter\n";
+        printer << name << " " << sumCounters(kCounterIndex + index) << "\n";
+    };
+    counter("zlm_rtp_packets_lost_total", kRtpPacketLost);
+    printer << "# TYPE zlm_webrtc_nack_total counter\n";
+    printer << "zlm_webrtc_nack_total{direction=\"sent\"} " << sumCounters(kCounterIndex + kRtcNackSent) << "\n";
+    printer << "zlm_webrtc_nack_total{direction=\"received\"} " << sumCounters(kCounterIndex + kRtcNackRecv) << "\n";
+    printer << "# TYPE zlm_webrtc_rtx_packets_total counter\n";
+    printer << "zlm_webrtc_rtx_packets_total{direction=\"sent\"} " << sumCounters(kCounterIndex + kRtcRtxSent) << "\n";
+    printer << "zlm_webrtc_rtx_packets_total{direction=\"received\"} " << sumCounters(kCounterIndex + kRtcRtxRecv) << "\n";
+    counter("zlm_srt_nak_sent_total", kSrtNakSent);
+    counter("zlm_srt_retransmit_packets_total", kSrtRetransmit);
+    counter("zlm_srt_drop_requests_total", kSrtDropReq);
+    printer << "# TYPE zlm_ktls_sessions_total counter\n";
+    printer << "zlm_ktls_sessions_total{result=\"enabled\"} " << sumCounters(kCounterIndex + kKtlsEnabled) << "\n";
+    printer << "zlm_ktls_sessions_total{result=\"fallback\"} " << sumCounters(kCounterIndex + kKtlsFallback) << "\n";
+
+    // prometheus直方图档位是累加的
+    printer << "# TYPE zlm_hls_segment_seconds histogram\n";
+    int64_t count = 0;
+    for (size_t i = 0; i < kHlsSegmentBuckets; ++i) {
+        count += sumCounters(kHlsBucketIndex + i);
+        printer << "zlm_hls_segment_seconds_bucket{le=\"" << s_hls_limit_le[i] << "\"} " << count << "\n";
+    }
+    printer << "zlm_hls_segment_seconds_sum " << sumCounters(kHlsSumIndex) / 1e9 << "\n";
+    printer << "zlm_hls_segment_seconds_count " << count << "\n";
+    return std::move(printer);
+}
+
+} // namespace mediakit
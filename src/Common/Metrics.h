@@ -0,0 +1,102 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_METRICS_H
+#define ZLMEDIAKIT_METRICS_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace mediakit {
+
+/**
+ * 全局运行指标(prometheus)
+ * 每个线程拥有独立的计数器，热路径上只写本线程计数器，无锁无竞争；
+ * 拉取指标时才把所有线程的计数器累加起来，拉取开销只与线程数相关，与会话个数无关
+ */
+class Metrics {
+public:
+    enum Protocol { kRtsp = 0, kRtmp, kHttp, kWebRtc, kSrt, kRtp, kProtocolCount };
+
+    enum Counter {
+        // rtcp rr统计的rtp丢包数(rtsp/rtp代理/webrtc推流)
+        kRtpPacketLost = 0,
+        // webrtc发送与接收的nack包数
+        kRtcNackSent,
+        kRtcNackRecv,
+        // webrtc发送与接收的rtx重传包数
+        kRtcRtxSent,
+        kRtcRtxRecv,
+        // srt发送的nak包数、重传包数、发送的丢弃请求数
+        kSrtNakSent,
+        kSrtRetransmit,
+        kSrtDropReq,
+        // tls握手完成后开启kTLS成功与回退到用户态加密的会话数
+        kKtlsEnabled,
+        kKtlsFallback,
+        kCounterCount
+    };
+
+    // hls切片生成耗时直方图档位个数
+    static constexpr size_t kHlsSegmentBuckets = 7;
+
+    /**
+     * 会话对象个数统计，作为会话类的成员变量使用
+     */
+    class SessionCounter {
+    public:
+        SessionCounter(Protocol protocol);
+        ~SessionCounter();
+
+        SessionCounter(const SessionCounter &) = delete;
+        SessionCounter &operator=(const SessionCounter &) = delete;
+
+    private:
+        Protocol _protocol;
+    };
+
+    /**
+     * 增加某协议接收字节数
+     */
+    static void addBytesIn(Protocol protocol, size_t bytes);
+
+    /**
+     * 增加某协议发送字节数
+     */
+    static void addBytesOut(Protocol protocol, size_t bytes);
+
+    /**
+     * 记录一批tcp合并写数据被放入socket发送队列并flush
+     * socket不可写或者部分发送时，实际的writev/sendmsg次数可能与批次数不同
+     * @param iovecs 本批的iovec个数
+     * @param buffers 合并前的Buffer个数
+     */
+    static void onSendBatch(Protocol protocol, size_t iovecs, size_t buffers);
+
+    /**
+     * 增加计数
+     */
+    static void add(Counter counter, uint64_t count = 1);
+
+    /**
+     * 记录一次hls切片生成(flush切片与m3u8)耗时
+     * @param ns 耗时，单位纳秒
+     */
+    static void onHlsSegment(uint64_t ns);
+
+    /**
+     * 累加所有线程的计数器，生成prometheus文本格式指标
+     */
+    static std::string toPrometheus();
+};
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_METRICS_H
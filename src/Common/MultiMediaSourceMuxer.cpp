@@ -9,6 +9,10 @@
 */
 
 #include <math.h>
+#include <thread>
+#include <algorithm>
+#include <cstdint>
+#include <condition_variable>
 #include "Common/config.h"
 #include "MultiMediaSourceMuxer.h"
 
@@ -117,6 +121,135 @@ private:
     std::list<std::pair<uint64_t, Frame::Ptr>> _cache;
 };
 
+// 并行复用线程池，每个线程按投递顺序执行复用任务
+// 复用器一旦分配到某个线程就归该线程所有，帧与状态变更(重置track、切换hls共享)都投递到该线程执行
+class MuxerWorkerPool {
+public:
+    // 单个复用线程最多排队的帧个数，复用线程跟不上时丢帧，防止内存无限增长
+    static constexpr size_t kMaxQueueSize = 4096;
+
+    static MuxerWorkerPool &Instance() {
+        static MuxerWorkerPool s_instance;
+        return s_instance;
+    }
+
+    ~MuxerWorkerPool() {
+        for (auto &worker : _workers) {
+            {
+                std::lock_guard<std::mutex> lck(worker->mtx);
+                worker->exit = true;
+            }
+            worker->cond.notify_one();
+        }
+        for (auto &worker : _workers) {
+            worker->thread.join();
+        }
+    }
+
+    /**
+     * 为复用器分配线程
+     */
+    size_t getWorker() { return _next++ % _workers.size(); }
+
+    /**
+     * 投递任务
+     * @param force 状态变更类任务不能丢弃，不受队列上限限制
+     * @return 队列已满时返回false，任务被丢弃
+     */
+    bool async(size_t index, std::function<void()> task, bool force = false) {
+        auto &worker = *_workers[index];
+        {
+            std::lock_guard<std::mutex> lck(worker.mtx);
+            if (!force && worker.tasks.size() >= kMaxQueueSize) {
+                return false;
+            }
+            worker.tasks.emplace_back(std::move(task));
+        }
+        worker.cond.notify_one();
+        return true;
+    }
+
+private:
+    struct Worker {
+        bool exit = false;
+        std::mutex mtx;
+        std::condition_variable cond;
+        std::deque<std::function<void()>> tasks;
+        std::thread thread;
+    };
+
+    MuxerWorkerPool() {
+        GET_CONFIG(uint32_t, threads, General::kParallelMuxThreads);
+        for (size_t i = 0; i < std::max<uint32_t>(threads, 1); ++i) {
+            _workers.emplace_back(new Worker);
+            auto worker = _workers.back().get();
+            worker->thread = std::thread([worker, i]() { run(*worker, i); });
+        }
+        InfoL << "parallel mux threads: " << _workers.size();
+    }
+
+    static void run(Worker &worker, size_t index) {
+        setThreadName(("mux worker " + to_string(index)).data());
+        MediaSource::setParallelMuxThread();
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lck(worker.mtx);
+                worker.cond.wait(lck, [&]() { return worker.exit || !worker.tasks.empty(); });
+                if (worker.tasks.empty()) {
+                    // 退出前执行完所有任务
+                    return;
+                }
+                task = std::move(worker.tasks.front());
+                worker.tasks.pop_front();
+            }
+            try {
+                task();
+            } catch (std::exception &ex) {
+                WarnL << "Exception occurred when mux frame: " << ex.what();
+            }
+        }
+    }
+
+private:
+    std::atomic<size_t> _next { 0 };
+    std::vector<std::unique_ptr<Worker>> _workers;
+};
+
+constexpr size_t MuxerWorkerPool::kMaxQueueSize;
+
+// 复用线程中排队的任务持有复用器的引用，复用器的最后一个引用可能在复用线程释放；
+// 在已投递的任务之后把引用移交给归属线程释放，确保媒体源注销等析构操作在归属线程执行
+static void releaseInPoller(const EventPoller::Ptr &poller, size_t worker, MediaSinkInterface::Ptr muxer) {
+    auto holder = std::make_shared<MediaSinkInterface::Ptr>(std::move(muxer));
+    MuxerWorkerPool::Instance().async(worker, [poller, holder]() {
+        // 已投递的帧处理完毕后，回到归属线程释放复用器(注销媒体源等)
+        if (poller) {
+            poller->async([holder]() { holder->reset(); }, false);
+        } else {
+            holder->reset();
+        }
+    }, true);
+}
+
+// 复用线程中复用器抛异常(例如媒体源注册失败)时，与串行复用时一样关闭该流，切回归属线程处理
+static void closeOnMuxerError(const std::weak_ptr<MultiMediaSourceMuxer> &weak_self, const std::string &err) {
+    auto strong_self = weak_self.lock();
+    if (!strong_self) {
+        return;
+    }
+    WarnL << "Exception occurred when mux frame, close the stream: " << strong_self->shortUrl() << ", " << err;
+    try {
+        strong_self->getOwnerPoller(MediaSource::NullMediaSource())->async([weak_self]() {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->close(MediaSource::NullMediaSource());
+            }
+        }, false);
+    } catch (std::exception &ex) {
+        WarnL << ex.what();
+    }
+}
+
 static std::shared_ptr<MediaSinkInterface> makeRecorder(MediaSource &sender, const vector<Track::Ptr> &tracks, Recorder::type type, const ProtocolOption &option){
     auto recorder = Recorder::createRecorder(type, sender.getMediaTuple(), option);
     for (auto &track : tracks) {
@@ -179,6 +312,13 @@ void MultiMediaSourceMuxer::forEachRtpSender(const std::function<void(const std:
     }
 }
 
+MultiMediaSourceMuxer::~MultiMediaSourceMuxer() {
+    // 并行复用时复用器可能还有帧在复用线程排队，在归属线程释放
+    for (auto &pr : _parallel_muxers) {
+        releaseInPoller(_parallel_poller, pr.worker, std::move(pr.muxer));
+    }
+}
+
 MultiMediaSourceMuxer::MultiMediaSourceMuxer(const MediaTuple& tuple, float dur_sec, const ProtocolOption &option): _tuple(tuple) {
     if (!option.stream_replace.empty()) {
         // 支持在on_publish hook中替换stream_id
@@ -188,6 +328,11 @@ MultiMediaSourceMuxer::MultiMediaSourceMuxer(const MediaTuple& tuple, float dur_
     _create_in_poller = _poller->isCurrentThread();
     _option = option;
     _dur_sec = dur_sec;
+    _profiler = StreamProfiler::create(_tuple);
+    GET_CONFIG(uint32_t, parallel_mux_threads, General::kParallelMuxThreads);
+    _parallel_mux = parallel_mux_threads > 0;
+    GET_CONFIG(bool, share_ts, General::kShareTsMuxer);
+    _share_ts = share_ts;
     setMaxTrackCount(option.max_track);
 
     if (option.enable_rtmp) {
@@ -211,6 +356,7 @@ MultiMediaSourceMuxer::MultiMediaSourceMuxer(const MediaTuple& tuple, float dur_
     if (option.enable_fmp4) {
         _fmp4 = dynamic_pointer_cast<FMP4MediaSourceMuxer>(Recorder::createRecorder(Recorder::type_fmp4, _tuple, option));
     }
+    updateTsShare(_ts);
 
     //音频相关设置
     enableAudio(option.enable_audio);
@@ -287,6 +433,10 @@ bool MultiMediaSourceMuxer::setupRecord(MediaSource &sender, Recorder::type type
             //开启关闭mp4录制，触发观看人数变化相关事件
             onReaderChanged(sender, totalReaderCount());
         }
+        if (!_parallel_muxers.empty()) {
+            //录制开启或关闭后，更新并行复用的复用器列表
+            updateParallelMuxers();
+        }
     });
     switch (type) {
         case Recorder::type_hls : {
@@ -299,9 +449,11 @@ bool MultiMediaSourceMuxer::setupRecord(MediaSource &sender, Recorder::type type
                     hls->setListener(shared_from_this());
                 }
                 _hls = hls;
+                updateTsShare(_ts);
             } else if (!start && _hls) {
                 //停止录制
                 _hls = nullptr;
+                updateTsShare(_ts);
             }
             return true;
         }
@@ -352,8 +504,10 @@ bool MultiMediaSourceMuxer::setupRecord(MediaSource &sender, Recorder::type type
                     ts->setListener(shared_from_this());
                 }
                 _ts = ts;
+                updateTsShare(_ts);
             } else if (!start && _ts) {
-                _ts = nullptr;
+                auto ts = std::move(_ts);
+                updateTsShare(ts);
             }
             return true;
         }
@@ -478,27 +632,32 @@ bool MultiMediaSourceMuxer::onTrackReady(const Track::Ptr &track) {
     }
 
     bool ret = false;
-    if (_rtmp) {
-        ret = _rtmp->addTrack(track) ? true : ret;
-    }
-    if (_rtsp) {
-        ret = _rtsp->addTrack(track) ? true : ret;
-    }
-    if (_ts) {
-        ret = _ts->addTrack(track) ? true : ret;
-    }
-    if (_fmp4) {
-        ret = _fmp4->addTrack(track) ? true : ret;
-    }
-    if (_hls) {
-        ret = _hls->addTrack(track) ? true : ret;
-    }
-    if (_hls_fmp4) {
-        ret = _hls_fmp4->addTrack(track) ? true : ret;
-    }
-    if (_mp4) {
-        ret = _mp4->addTrack(track) ? true : ret;
-    }
+    std::weak_ptr<MultiMediaSourceMuxer> weak_self = shared_from_this();
+    auto add_track = [&](const MediaSinkInterface::Ptr &muxer) {
+        if (!muxer) {
+            return;
+        }
+        auto task = [muxer, track, weak_self]() {
+            try {
+                muxer->addTrack(track);
+            } catch (std::exception &ex) {
+                closeOnMuxerError(weak_self, ex.what());
+            }
+        };
+        if (postToMuxerThread(muxer, std::move(task))) {
+            // resetTracks后重新添加track，此时复用器归复用线程所有，只能异步添加，不能阻塞归属线程等待排队的帧
+            ret = true;
+            return;
+        }
+        ret = muxer->addTrack(track) ? true : ret;
+    };
+    add_track(_rtmp);
+    add_track(_rtsp);
+    add_track(_ts);
+    add_track(_fmp4);
+    add_track(_hls);
+    add_track(_hls_fmp4);
+    add_track(_mp4);
     return ret;
 }
 
@@ -516,26 +675,20 @@ void MultiMediaSourceMuxer::onAllTrackReady() {
 
     setMediaListener(getDelegate());
 
-    if (_rtmp) {
-        _rtmp->addTrackCompleted();
-    }
-    if (_rtsp) {
-        _rtsp->addTrackCompleted();
-    }
-    if (_ts) {
-        _ts->addTrackCompleted();
-    }
-    if (_mp4) {
-        _mp4->addTrackCompleted();
-    }
-    if (_fmp4) {
-        _fmp4->addTrackCompleted();
-    }
-    if (_hls) {
-        _hls->addTrackCompleted();
-    }
-    if (_hls_fmp4) {
-        _hls_fmp4->addTrackCompleted();
+    auto add_track_completed = [&](const MediaSinkInterface::Ptr &muxer) {
+        if (muxer && !postToMuxerThread(muxer, [muxer]() { muxer->addTrackCompleted(); })) {
+            muxer->addTrackCompleted();
+        }
+    };
+    add_track_completed(_rtmp);
+    add_track_completed(_rtsp);
+    add_track_completed(_ts);
+    add_track_completed(_mp4);
+    add_track_completed(_fmp4);
+    add_track_completed(_hls);
+    add_track_completed(_hls_fmp4);
+    if (_parallel_mux) {
+        updateParallelMuxers();
     }
 
     auto listener = _track_listener.lock();
@@ -577,37 +730,105 @@ void MultiMediaSourceMuxer::createGopCacheIfNeed() {
     });
 }
 
-void MultiMediaSourceMuxer::resetTracks() {
-    MediaSink::resetTracks();
-
-    if (_rtmp) {
-        _rtmp->resetTracks();
+const MultiMediaSourceMuxer::ParallelMuxer *MultiMediaSourceMuxer::findParallelMuxer(const MediaSinkInterface::Ptr &muxer) const {
+    if (!muxer) {
+        return nullptr;
     }
-    if (_rtsp) {
-        _rtsp->resetTracks();
+    for (auto &pr : _parallel_muxers) {
+        if (pr.muxer == muxer) {
+            return &pr;
+        }
     }
-    if (_ts) {
-        _ts->resetTracks();
+    return nullptr;
+}
+
+bool MultiMediaSourceMuxer::postToMuxerThread(const MediaSinkInterface::Ptr &muxer, std::function<void()> task) {
+    auto pr = findParallelMuxer(muxer);
+    if (!pr) {
+        return false;
     }
-    if (_fmp4) {
-        _fmp4->resetTracks();
+    // 排在已经投递的帧之后执行，保证顺序且不阻塞归属线程
+    MuxerWorkerPool::Instance().async(pr->worker, std::move(task), true);
+    return true;
+}
+
+void MultiMediaSourceMuxer::updateParallelMuxers() {
+    auto &pool = MuxerWorkerPool::Instance();
+    if (!_parallel_poller) {
+        _parallel_poller = getOwnerPoller(MediaSource::NullMediaSource());
     }
-    if (_hls_fmp4) {
-        _hls_fmp4->resetTracks();
+    decltype(_parallel_muxers) muxers;
+    auto add = [&](const MediaSinkInterface::Ptr &muxer, size_t worker, StreamProfiler::Stage stage) {
+        if (!muxer) {
+            return;
+        }
+        if (auto pr = findParallelMuxer(muxer)) {
+            // 已经存在的复用器不能切换线程，否则无法保证帧的顺序
+            muxers.emplace_back(*pr);
+            return;
+        }
+        muxers.emplace_back(ParallelMuxer { muxer, worker == SIZE_MAX ? pool.getWorker() : worker, false, stage });
+    };
+    // hls与http-ts共享时由ts所在线程输出hls数据，所以两者固定在同一线程，切换共享状态时hls数据不会乱序或并发
+    auto ts_worker = SIZE_MAX;
+    if (auto pr = findParallelMuxer(_ts)) {
+        ts_worker = pr->worker;
+    } else if (auto pr = findParallelMuxer(_hls)) {
+        ts_worker = pr->worker;
+    } else if (_ts || _hls) {
+        ts_worker = pool.getWorker();
+    }
+    add(_rtmp, SIZE_MAX, StreamProfiler::kRtmp);
+    add(_rtsp, SIZE_MAX, StreamProfiler::kRtsp);
+    add(_ts, ts_worker, StreamProfiler::kTs);
+    add(_hls, ts_worker, StreamProfiler::kHls);
+    add(_hls_fmp4, SIZE_MAX, StreamProfiler::kHlsFmp4);
+    add(_mp4, SIZE_MAX, StreamProfiler::kMp4);
+    add(_fmp4, SIZE_MAX, StreamProfiler::kFmp4);
+    // 停止录制等原因被移除的复用器在归属线程释放
+    for (auto &pr : _parallel_muxers) {
+        auto it = std::find_if(muxers.begin(), muxers.end(), [&](const ParallelMuxer &item) { return item.muxer == pr.muxer; });
+        if (it == muxers.end()) {
+            releaseInPoller(_parallel_poller, pr.worker, std::move(pr.muxer));
+        }
     }
-    if (_hls) {
-        _hls->resetTracks();
+    _parallel_muxers = std::move(muxers);
+}
+
+void MultiMediaSourceMuxer::updateTsShare(const TSMediaSourceMuxer::Ptr &ts) {
+    if (!ts) {
+        return;
     }
-    if (_mp4) {
-        _mp4->resetTracks();
+    HlsRecorder::Ptr hls = ts == _ts && isHlsShared() ? _hls : nullptr;
+    // 并行复用时，ts与hls可能正在复用线程中处理已经投递的帧，切换操作(包括强制hls切片)也投递到该线程执行
+    if (!postToMuxerThread(ts, [ts, hls]() { ts->setHlsRecorder(hls); })) {
+        ts->setHlsRecorder(hls);
     }
 }
 
+void MultiMediaSourceMuxer::resetTracks() {
+    MediaSink::resetTracks();
+
+    auto reset = [&](const MediaSinkInterface::Ptr &muxer) {
+        // 并行复用时，重置操作排在已投递的帧之后在复用线程执行
+        if (muxer && !postToMuxerThread(muxer, [muxer]() { muxer->resetTracks(); })) {
+            muxer->resetTracks();
+        }
+    };
+    reset(_rtmp);
+    reset(_rtsp);
+    reset(_ts);
+    reset(_fmp4);
+    reset(_hls_fmp4);
+    reset(_hls);
+    reset(_mp4);
+}
+
 bool MultiMediaSourceMuxer::onTrackFrame(const Frame::Ptr &frame_in) {
     auto frame = frame_in;
     if (_option.modify_stamp != ProtocolOption::kModifyStampOff) {
         // 时间戳不采用原始的绝对时间戳
-        frame = std::make_shared<FrameStamp>(frame, _stamps[frame->getIndex()], _option.modify_stamp);
+        frame = ObjectPool::makeShared<FrameStamp>(frame, _stamps[frame->getIndex()], _option.modify_stamp);
     }
     return _paced_sender ? _paced_sender->inputFrame(frame) : onTrackFrame_l(frame);
 }
@@ -615,29 +836,80 @@ bool MultiMediaSourceMuxer::onTrackFrame(const Frame::Ptr &frame_in) {
 bool MultiMediaSourceMuxer::onTrackFrame_l(const Frame::Ptr &frame_in) {
     auto frame = frame_in;
     bool ret = false;
-    if (_rtmp) {
-        ret = _rtmp->inputFrame(frame) ? true : ret;
-    }
-    if (_rtsp) {
-        ret = _rtsp->inputFrame(frame) ? true : ret;
-    }
-    if (_ts) {
-        ret = _ts->inputFrame(frame) ? true : ret;
-    }
+    StreamProfiler::Timer timer(_profiler.get(), frame->size());
+    if (!_parallel_muxers.empty()) {
+        // 并行复用，帧会在复用线程中被异步处理，所以需要可缓存的帧；
+        // 同一复用器的帧总是投递到同一线程，保证各协议内帧的顺序以及合并写逻辑不变
+        frame = Frame::getCacheAbleFrame(frame);
+        auto &pool = MuxerWorkerPool::Instance();
+        // 丢帧后需要从关键帧处恢复，纯音频时任意帧都可恢复
+        auto key_pos = !haveVideo() || (frame->getTrackType() == TrackVideo && (frame->keyFrame() || frame->configFrame()));
+        auto hls_shared = isHlsShared();
+        std::weak_ptr<MultiMediaSourceMuxer> weak_self = shared_from_this();
+        for (auto &pr : _parallel_muxers) {
+            if (hls_shared && pr.muxer == _hls) {
+                // 与http-ts共享时，hls数据由_ts输出
+                continue;
+            }
+            if (pr.wait_key && !key_pos) {
+                continue;
+            }
+            auto muxer = pr.muxer;
+            auto stage = pr.stage;
+            auto profiler = _profiler;
+            auto task = [muxer, frame, stage, profiler, weak_self]() {
+                // 各协议复用器耗时在复用线程统计
+                StreamProfiler::StageTimer timer(profiler.get(), stage);
+                try {
+                    muxer->inputFrame(frame);
+                } catch (std::exception &ex) {
+                    closeOnMuxerError(weak_self, ex.what());
+                }
+            };
+            if (pool.async(pr.worker, std::move(task))) {
+                pr.wait_key = false;
+            } else if (!pr.wait_key) {
+                WarnL << "Parallel mux worker " << pr.worker << " is overloaded, drop frames until next key frame: " << shortUrl();
+                pr.wait_key = true;
+            }
+        }
+        // 帧在复用线程异步处理，根据复用器是否开启判断帧是否被消费
+        ret = (_rtmp && _rtmp->isEnabled()) || (_rtsp && _rtsp->isEnabled()) || (_ts && _ts->isEnabled()) ||
+              (_hls && !hls_shared && _hls->isEnabled()) || (_hls_fmp4 && _hls_fmp4->isEnabled()) || _mp4 ||
+              (_fmp4 && _fmp4->isEnabled());
+    } else {
+        if (_rtmp) {
+            ret = _rtmp->inputFrame(frame) ? true : ret;
+            timer.stage(StreamProfiler::kRtmp);
+        }
+        if (_rtsp) {
+            ret = _rtsp->inputFrame(frame) ? true : ret;
+            timer.stage(StreamProfiler::kRtsp);
+        }
+        if (_ts) {
+            ret = _ts->inputFrame(frame) ? true : ret;
+            timer.stage(StreamProfiler::kTs);
+        }
 
-    if (_hls) {
-        ret = _hls->inputFrame(frame) ? true : ret;
-    }
+        if (_hls && !isHlsShared()) {
+            // 与http-ts共享时，hls数据由_ts输出
+            ret = _hls->inputFrame(frame) ? true : ret;
+            timer.stage(StreamProfiler::kHls);
+        }
 
-    if (_hls_fmp4) {
-        ret = _hls_fmp4->inputFrame(frame) ? true : ret;
-    }
+        if (_hls_fmp4) {
+            ret = _hls_fmp4->inputFrame(frame) ? true : ret;
+            timer.stage(StreamProfiler::kHlsFmp4);
+        }
 
-    if (_mp4) {
-        ret = _mp4->inputFrame(frame) ? true : ret;
-    }
-    if (_fmp4) {
-        ret = _fmp4->inputFrame(frame) ? true : ret;
+        if (_mp4) {
+            ret = _mp4->inputFrame(frame) ? true : ret;
+            timer.stage(StreamProfiler::kMp4);
+        }
+        if (_fmp4) {
+            ret = _fmp4->inputFrame(frame) ? true : ret;
+            timer.stage(StreamProfiler::kFmp4);
+        }
     }
     if (_ring) {
         // 此场景由于直接转发，可能存在切换线程引起的数据被缓存在管道，所以需要CacheAbleFrame
@@ -653,6 +925,7 @@ bool MultiMediaSourceMuxer::onTrackFrame_l(const Frame::Ptr &frame_in) {
             // 没有视频时，设置is_key为true，目的是关闭gop缓存
             _ring->write(frame, !haveVideo());
         }
+        timer.stage(StreamProfiler::kRing);
     }
     return ret;
 }
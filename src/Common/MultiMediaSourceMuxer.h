@@ -14,6 +14,7 @@
 #include "Common/Stamp.h"
 #include "Common/MediaSource.h"
 #include "Common/MediaSink.h"
+#include "Common/StreamProfiler.h"
 #include "Record/Recorder.h"
 #include "Rtp/RtpSender.h"
 #include "Record/HlsRecorder.h"
@@ -37,6 +38,7 @@ public:
     };
 
     MultiMediaSourceMuxer(const MediaTuple& tuple, float dur_sec = 0.0,const ProtocolOption &option = ProtocolOption());
+    ~MultiMediaSourceMuxer() override;
 
     /**
      * 设置事件监听器
@@ -135,6 +137,11 @@ public:
 
     void forEachRtpSender(const std::function<void(const std::string &ssrc)> &cb) const;
 
+    /**
+     * 获取本流性能统计对象，未开启统计时返回nullptr
+     */
+    const StreamProfiler::Ptr &getProfiler() const { return _profiler; }
+
 protected:
     /////////////////////////////////MediaSink override/////////////////////////////////
 
@@ -158,12 +165,32 @@ protected:
     bool onTrackFrame_l(const Frame::Ptr &frame);
 
 private:
+    // 并行复用的复用器
+    struct ParallelMuxer {
+        MediaSinkInterface::Ptr muxer;
+        // 所在复用线程
+        size_t worker;
+        // 复用线程过载丢帧后，需要等待关键帧再恢复投递
+        bool wait_key;
+        // 性能统计中对应的复用器
+        StreamProfiler::Stage stage;
+    };
+
     void createGopCacheIfNeed();
+    void updateParallelMuxers();
+    const ParallelMuxer *findParallelMuxer(const MediaSinkInterface::Ptr &muxer) const;
+    // 复用器在复用线程上时投递任务并返回true，否则返回false，由调用者在本线程执行
+    bool postToMuxerThread(const MediaSinkInterface::Ptr &muxer, std::function<void()> task);
+    void updateTsShare(const TSMediaSourceMuxer::Ptr &ts);
+    // hls是否直接使用http-ts的复用结果
+    bool isHlsShared() const { return _share_ts && _ts && _hls; }
 
 private:
     bool _is_enable = false;
     bool _create_in_poller = false;
     bool _video_key_pos = false;
+    bool _parallel_mux = false;
+    bool _share_ts = false;
     float _dur_sec;
     std::shared_ptr<class FramePacedSender> _paced_sender;
     MediaTuple _tuple;
@@ -181,6 +208,11 @@ private:
     HlsFMP4Recorder::Ptr _hls_fmp4;
     toolkit::EventPoller::Ptr _poller;
     RingType::Ptr _ring;
+    StreamProfiler::Ptr _profiler;
+    // 并行复用时各协议复用器及其所在的复用线程
+    std::vector<ParallelMuxer> _parallel_muxers;
+    // 并行复用时的归属线程，复用器在该线程释放
+    toolkit::EventPoller::Ptr _parallel_poller;
 
     //对象个数统计
     toolkit::ObjectStatistic<MultiMediaSourceMuxer> _statistic;
@@ -0,0 +1,150 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <new>
+#include "ObjectPool.h"
+
+using namespace std;
+
+namespace mediakit {
+
+// 内存块按16字节分档，最大缓存512字节的内存块，更大的内存块直接向系统申请
+static constexpr size_t kBlockAlign = 16;
+static constexpr size_t kBlockClasses = 32;
+// 每个线程每档最多缓存的字节数
+static constexpr size_t kMaxCacheBytes = 256 * 1024;
+
+struct FreeBlock {
+    FreeBlock *next;
+};
+
+// POD类型，线程退出时不会析构，保证其他thread_local对象析构时仍然可以安全访问
+struct ThreadCache {
+    FreeBlock *head[kBlockClasses];
+    size_t count[kBlockClasses];
+    bool registered;
+    bool closed;
+};
+
+static thread_local ThreadCache s_cache;
+
+// 线程退出时释放缓存的内存块，之后释放的内存块不再缓存
+class ThreadCacheCleaner {
+public:
+    ~ThreadCacheCleaner() {
+        for (size_t i = 0; i < kBlockClasses; ++i) {
+            while (s_cache.head[i]) {
+                auto block = s_cache.head[i];
+                s_cache.head[i] = block->next;
+                ::operator delete(block);
+            }
+            s_cache.count[i] = 0;
+        }
+        s_cache.closed = true;
+    }
+};
+
+class ThreadStatistic {
+public:
+    void add(bool hit) {
+        // 只有本线程会写入，不需要原子加，原子变量只是为了统计线程读取安全
+        auto &val = hit ? _hit : _miss;
+        val.store(val.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    }
+
+    ObjectPool::Statistic get() const {
+        ObjectPool::Statistic ret;
+        ret.hit = _hit.load(memory_order_relaxed);
+        ret.miss = _miss.load(memory_order_relaxed);
+        return ret;
+    }
+
+private:
+    std::atomic<uint64_t> _hit { 0 };
+    std::atomic<uint64_t> _miss { 0 };
+};
+
+static mutex s_mtx;
+static vector<ThreadStatistic *> s_statistics;
+
+static ThreadStatistic &getLocalStatistic() {
+    // 线程退出后统计块不释放，保证计数单调递增(线程个数有限，不会无限增长)
+    static thread_local ThreadStatistic *s_local = []() {
+        auto ret = new ThreadStatistic;
+        lock_guard<mutex> lck(s_mtx);
+        s_statistics.emplace_back(ret);
+        return ret;
+    }();
+    return *s_local;
+}
+
+static inline size_t getBlockClass(size_t size) {
+    // size为0时下溢为很大的值，按不缓存处理
+    return (size + kBlockAlign - 1) / kBlockAlign - 1;
+}
+
+void *ObjectPool::allocate(size_t size) {
+    auto index = getBlockClass(size);
+    if (index >= kBlockClasses) {
+        getLocalStatistic().add(false);
+        return ::operator new(size);
+    }
+    auto block = s_cache.head[index];
+    if (block) {
+        s_cache.head[index] = block->next;
+        --s_cache.count[index];
+        getLocalStatistic().add(true);
+        return block;
+    }
+    getLocalStatistic().add(false);
+    // 按档位大小申请，保证可以被其他同档对象复用
+    return ::operator new((index + 1) * kBlockAlign);
+}
+
+void ObjectPool::deallocate(void *ptr, size_t size) {
+    auto index = getBlockClass(size);
+    if (index >= kBlockClasses || s_cache.closed || s_cache.count[index] >= kMaxCacheBytes / ((index + 1) * kBlockAlign)) {
+        ::operator delete(ptr);
+        return;
+    }
+    if (!s_cache.registered) {
+        s_cache.registered = true;
+        static thread_local ThreadCacheCleaner s_cleaner;
+        (void)s_cleaner;
+    }
+    auto block = (FreeBlock *)ptr;
+    block->next = s_cache.head[index];
+    s_cache.head[index] = block;
+    ++s_cache.count[index];
+}
+
+void ObjectPool::onObtain(bool hit) {
+    getLocalStatistic().add(hit);
+}
+
+ObjectPool::Statistic ObjectPool::getThreadStatistic() {
+    return getLocalStatistic().get();
+}
+
+ObjectPool::Statistic ObjectPool::getStatistic() {
+    Statistic ret;
+    lock_guard<mutex> lck(s_mtx);
+    for (auto statistic : s_statistics) {
+        auto val = statistic->get();
+        ret.hit += val.hit;
+        ret.miss += val.miss;
+    }
+    return ret;
+}
+
+} // namespace mediakit
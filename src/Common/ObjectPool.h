@@ -0,0 +1,156 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_OBJECTPOOL_H
+#define ZLMEDIAKIT_OBJECTPOOL_H
+
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+namespace mediakit {
+
+/**
+ * 线程本地定长内存块缓存
+ * 帧、rtp/rtmp包等对象生命周期很短，稳定转发时每帧都要new/delete多次；
+ * 内存块按16字节分档，释放后放回释放线程的空闲链表，下次在该线程申请同档内存时直接复用；
+ * 获取与回收都只访问本线程数据，无锁；每个线程每档缓存有上限，超过后直接释放
+ */
+class ObjectPool {
+public:
+    struct Statistic {
+        // 命中本线程缓存次数
+        uint64_t hit = 0;
+        // 未命中缓存，向系统申请内存次数
+        uint64_t miss = 0;
+    };
+
+    static void *allocate(size_t size);
+    static void deallocate(void *ptr, size_t size);
+
+    /**
+     * 通过allocate_shared创建对象，对象与shared_ptr控制块在同一个内存块中，并且该内存块在线程内复用
+     */
+    template <typename C, typename... ARGS>
+    static std::shared_ptr<C> makeShared(ARGS &&...args);
+
+    /**
+     * 记录一次对象获取是否命中缓存，供RecyclePool使用
+     */
+    static void onObtain(bool hit);
+
+    /**
+     * 获取本线程的命中统计，可以用于统计某段代码(比如处理一帧)向系统申请内存的次数
+     */
+    static Statistic getThreadStatistic();
+
+    /**
+     * 获取所有线程的命中统计之和
+     */
+    static Statistic getStatistic();
+};
+
+/**
+ * 基于ObjectPool的stl分配器
+ */
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    PoolAllocator() = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &) {}
+
+    T *allocate(size_t n) { return (T *)ObjectPool::allocate(n * sizeof(T)); }
+    void deallocate(T *ptr, size_t n) { ObjectPool::deallocate(ptr, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U> &) const { return false; }
+};
+
+template <typename C, typename... ARGS>
+std::shared_ptr<C> ObjectPool::makeShared(ARGS &&...args) {
+    return std::allocate_shared<C>(PoolAllocator<C>(), std::forward<ARGS>(args)...);
+}
+
+/**
+ * 线程本地对象回收池
+ * 跟ObjectPool不同的是，回收的是整个对象(不析构)，对象内部缓存(比如rtp包内存、帧数据)得以保留，下次获取时无需重新申请；
+ * 跟toolkit::ResourcePool不同的是，对象在哪个线程释放就回收到哪个线程，获取与回收都无锁；
+ * 复用的对象状态由调用者负责重置
+ */
+template <typename C, size_t kMaxCount = 64>
+class RecyclePool {
+public:
+    // 对象释放时判断是否回收，比如内部缓存太大时不回收，防止占用过多内存
+    using RecycleAble = bool (*)(C *obj);
+
+    static std::shared_ptr<C> obtain(RecycleAble recycle_able = nullptr) {
+        auto &cache = getCache();
+        C *obj;
+        if (cache.count) {
+            obj = cache.objs[--cache.count];
+            ObjectPool::onObtain(true);
+        } else {
+            obj = new C();
+            ObjectPool::onObtain(false);
+        }
+        return std::shared_ptr<C>(obj, Deleter { recycle_able }, PoolAllocator<C>());
+    }
+
+private:
+    // POD类型，线程退出时不会析构，保证其他thread_local对象析构时仍然可以安全访问
+    struct Cache {
+        C *objs[kMaxCount];
+        size_t count;
+        bool registered;
+        bool closed;
+    };
+
+    // 线程退出时释放缓存的对象，之后释放的对象不再回收
+    struct Cleaner {
+        ~Cleaner() {
+            auto &cache = getCache();
+            while (cache.count) {
+                delete cache.objs[--cache.count];
+            }
+            cache.closed = true;
+        }
+    };
+
+    struct Deleter {
+        RecycleAble recycle_able;
+
+        void operator()(C *obj) const {
+            auto &cache = getCache();
+            if (cache.closed || cache.count == kMaxCount || (recycle_able && !recycle_able(obj))) {
+                delete obj;
+                return;
+            }
+            if (!cache.registered) {
+                cache.registered = true;
+                static thread_local Cleaner s_cleaner;
+                (void)s_cleaner;
+            }
+            cache.objs[cache.count++] = obj;
+        }
+    };
+
+    static Cache &getCache() {
+        static thread_local Cache s_cache;
+        return s_cache;
+    }
+};
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_OBJECTPOOL_H
@@ -0,0 +1,33 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "PollerHash.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+EventPoller::Ptr getPollerByHash(uint32_t key) {
+    static auto s_pollers = []() {
+        vector<EventPoller::Ptr> ret;
+        EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr &executor) {
+            ret.emplace_back(static_pointer_cast<EventPoller>(executor));
+        });
+        return ret;
+    }();
+    if (s_pollers.empty()) {
+        return nullptr;
+    }
+    // 乘以黄金分割常数打散后取乘积的高32位再取模；低位只由key的低位决定，poller个数为2的幂时步进的key会落到同一个poller
+    return s_pollers[(uint32_t)(((uint64_t)key * 2654435761U) >> 32) % s_pollers.size()];
+}
+
+} // namespace mediakit
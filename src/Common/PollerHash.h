@@ -0,0 +1,28 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_POLLERHASH_H
+#define ZLMEDIAKIT_POLLERHASH_H
+
+#include <cstdint>
+#include "Poller/EventPoller.h"
+
+namespace mediakit {
+
+/**
+ * 按key把会话固定分配到EventPollerPool中的某个poller线程，同一个key总是得到同一个poller
+ * key(ssrc、srt socket id等)通常是连续分配的，内部会先打散再取模
+ * @param key 会话标识
+ * @return poller，线程池为空时返回nullptr
+ */
+toolkit::EventPoller::Ptr getPollerByHash(uint32_t key);
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_POLLERHASH_H
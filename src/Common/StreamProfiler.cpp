@@ -0,0 +1,157 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <unordered_set>
+#include "StreamProfiler.h"
+#include "MultiMediaSourceMuxer.h"
+#include "ObjectPool.h"
+#include "Common/config.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+constexpr size_t StreamProfiler::kLatencyBuckets;
+constexpr size_t StreamProfiler::kBytesOutSlots;
+
+// 耗时直方图档位上限，单位纳秒
+static const uint64_t s_latency_limit[StreamProfiler::kLatencyBuckets - 1] = { 10000, 50000, 100000, 500000, 1000000, 5000000, 10000000 };
+
+static uint64_t nowNanoseconds() {
+    // steady_clock在linux下通过vdso获取，开销很小
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static mutex s_mtx;
+static unordered_set<StreamProfiler *> s_profilers;
+
+static size_t getThreadSlot() {
+    // 每个线程首次使用时分配一个分片序号，poller线程个数固定，一般不会重复
+    static atomic<size_t> s_next_slot { 0 };
+    static thread_local size_t s_slot = s_next_slot++;
+    return s_slot;
+}
+
+StreamProfiler::Timer::Timer(StreamProfiler *profiler, size_t bytes) {
+    _profiler = profiler;
+    _bytes = bytes;
+    if (_profiler) {
+        auto pool = ObjectPool::getThreadStatistic();
+        _pool_hit = pool.hit;
+        _pool_miss = pool.miss;
+        _start = _last = nowNanoseconds();
+    }
+}
+
+StreamProfiler::Timer::~Timer() {
+    if (!_profiler) {
+        return;
+    }
+    auto ns = nowNanoseconds() - _start;
+    size_t bucket = 0;
+    while (bucket < kLatencyBuckets - 1 && ns >= s_latency_limit[bucket]) {
+        ++bucket;
+    }
+    ++_profiler->_latency_histogram[bucket];
+    ++_profiler->_frames;
+    _profiler->_bytes_in += _bytes;
+    _profiler->_cpu_ns += ns;
+    auto pool = ObjectPool::getThreadStatistic();
+    _profiler->_pool_hit += pool.hit - _pool_hit;
+    _profiler->_pool_miss += pool.miss - _pool_miss;
+}
+
+void StreamProfiler::Timer::stage(Stage stage) {
+    if (!_profiler) {
+        return;
+    }
+    auto now = nowNanoseconds();
+    _profiler->_stage_ns[stage] += now - _last;
+    _last = now;
+}
+
+StreamProfiler::StageTimer::StageTimer(StreamProfiler *profiler, Stage stage) {
+    _profiler = profiler;
+    _stage = stage;
+    if (_profiler) {
+        _start = nowNanoseconds();
+    }
+}
+
+StreamProfiler::StageTimer::~StageTimer() {
+    if (_profiler) {
+        _profiler->_stage_ns[_stage] += nowNanoseconds() - _start;
+    }
+}
+
+StreamProfiler::Ptr StreamProfiler::create(const MediaTuple &tuple) {
+    GET_CONFIG(bool, enable, General::kEnableStreamProfile);
+    if (!enable) {
+        return nullptr;
+    }
+    Ptr ret(new StreamProfiler(tuple));
+    lock_guard<mutex> lck(s_mtx);
+    s_profilers.emplace(ret.get());
+    return ret;
+}
+
+StreamProfiler::Ptr StreamProfiler::get(MediaSource &src) {
+    auto muxer = src.getMuxer();
+    return muxer ? muxer->getProfiler() : nullptr;
+}
+
+void StreamProfiler::for_each(const function<void(const StreamProfiler &profiler)> &cb) {
+    lock_guard<mutex> lck(s_mtx);
+    for (auto profiler : s_profilers) {
+        cb(*profiler);
+    }
+}
+
+const char *StreamProfiler::getLatencyBucketName(size_t index) {
+    static const char *s_names[kLatencyBuckets] = { "<10us", "<50us", "<100us", "<500us", "<1ms", "<5ms", "<10ms", ">=10ms" };
+    return index < kLatencyBuckets ? s_names[index] : "";
+}
+
+const char *StreamProfiler::getStageName(Stage stage) {
+    static const char *s_names[kStageCount] = { "rtmp", "rtsp", "ts", "hls", "hls.fmp4", "mp4", "fmp4", "ring" };
+    return stage < kStageCount ? s_names[stage] : "";
+}
+
+void StreamProfiler::addBytesOut(size_t bytes) {
+    _bytes_out[getThreadSlot() % kBytesOutSlots].bytes.fetch_add(bytes, memory_order_relaxed);
+}
+
+uint64_t StreamProfiler::getBytesOut() const {
+    uint64_t ret = 0;
+    for (auto &slot : _bytes_out) {
+        ret += slot.bytes.load(memory_order_relaxed);
+    }
+    return ret;
+}
+
+StreamProfiler::StreamProfiler(const MediaTuple &tuple) : _tuple(tuple) {
+    for (auto &ns : _stage_ns) {
+        ns = 0;
+    }
+    for (auto &count : _latency_histogram) {
+        count = 0;
+    }
+}
+
+StreamProfiler::~StreamProfiler() {
+    lock_guard<mutex> lck(s_mtx);
+    s_profilers.erase(this);
+}
+
+} // namespace mediakit
@@ -0,0 +1,147 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_STREAMPROFILER_H
+#define ZLMEDIAKIT_STREAMPROFILER_H
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <functional>
+#include "Common/MediaSource.h"
+
+namespace mediakit {
+
+/**
+ * 单个流的性能统计
+ * 统计该流在MultiMediaSourceMuxer中处理每帧的耗时(总耗时与各协议复用器耗时)、输入字节数、
+ * 播放器发送字节数、每帧处理耗时直方图以及对象池命中情况，用于定位线程负载过高时是哪个流导致的
+ * 所有计数都是原子变量，由流所在线程写入，由http api线程读取；
+ * 并行复用时各协议复用器耗时由复用线程写入，总耗时只包含流所在线程投递帧的耗时；
+ * 播放器发送字节数由各播放器所在poller线程写入，按线程分片累加，读取时再求和
+ */
+class StreamProfiler {
+public:
+    using Ptr = std::shared_ptr<StreamProfiler>;
+
+    // 各协议复用器
+    enum Stage { kRtmp = 0, kRtsp, kTs, kHls, kHlsFmp4, kMp4, kFmp4, kRing, kStageCount };
+
+    // 每帧处理耗时直方图档位个数
+    static constexpr size_t kLatencyBuckets = 8;
+
+    /**
+     * 计时器，在MultiMediaSourceMuxer处理帧时栈上构造
+     * profiler为空时不做任何事
+     */
+    class Timer {
+    public:
+        Timer(StreamProfiler *profiler, size_t bytes);
+        ~Timer();
+
+        /**
+         * 记录上个计时点至今某个复用器的耗时
+         */
+        void stage(Stage stage);
+
+    private:
+        size_t _bytes;
+        uint64_t _pool_hit = 0;
+        uint64_t _pool_miss = 0;
+        uint64_t _start = 0;
+        uint64_t _last = 0;
+        StreamProfiler *_profiler;
+    };
+
+    /**
+     * 单个复用器的计时器，并行复用时在复用线程处理帧时栈上构造
+     * profiler为空时不做任何事
+     */
+    class StageTimer {
+    public:
+        StageTimer(StreamProfiler *profiler, Stage stage);
+        ~StageTimer();
+
+    private:
+        Stage _stage;
+        uint64_t _start = 0;
+        StreamProfiler *_profiler;
+    };
+
+    /**
+     * 创建并注册统计对象，未开启统计时返回nullptr
+     */
+    static Ptr create(const MediaTuple &tuple);
+
+    /**
+     * 获取媒体源所属流的统计对象，未开启统计时返回nullptr
+     */
+    static Ptr get(MediaSource &src);
+
+    /**
+     * 遍历所有流的统计对象
+     */
+    static void for_each(const std::function<void(const StreamProfiler &profiler)> &cb);
+
+    /**
+     * 获取耗时直方图档位名称
+     */
+    static const char *getLatencyBucketName(size_t index);
+
+    /**
+     * 获取复用器名称
+     */
+    static const char *getStageName(Stage stage);
+
+    ~StreamProfiler();
+
+    /**
+     * 增加播放器发送字节数，只写本线程对应的分片
+     */
+    void addBytesOut(size_t bytes);
+
+    const MediaTuple &getMediaTuple() const { return _tuple; }
+    uint64_t getFrames() const { return _frames; }
+    uint64_t getBytesIn() const { return _bytes_in; }
+    uint64_t getBytesOut() const;
+    uint64_t getCpuNanoseconds() const { return _cpu_ns; }
+    uint64_t getStageNanoseconds(Stage stage) const { return _stage_ns[stage]; }
+    uint64_t getLatencyCount(size_t index) const { return _latency_histogram[index]; }
+    // 处理帧时命中对象池(帧、rtp/rtmp包等)的次数与向系统申请内存的次数
+    uint64_t getPoolHits() const { return _pool_hit; }
+    uint64_t getPoolMisses() const { return _pool_miss; }
+
+private:
+    StreamProfiler(const MediaTuple &tuple);
+
+private:
+    // 发送字节数分片个数，线程数超过该值时多个线程共享分片(仍然正确，只是存在争用)
+    static constexpr size_t kBytesOutSlots = 32;
+
+    // 每个分片独占一个缓存行，防止多个线程累加时伪共享
+    struct BytesOutSlot {
+        std::atomic<uint64_t> bytes { 0 };
+        char pad[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    MediaTuple _tuple;
+    std::atomic<uint64_t> _frames { 0 };
+    std::atomic<uint64_t> _bytes_in { 0 };
+    std::atomic<uint64_t> _cpu_ns { 0 };
+    std::atomic<uint64_t> _pool_hit { 0 };
+    std::atomic<uint64_t> _pool_miss { 0 };
+    std::array<std::atomic<uint64_t>, kStageCount> _stage_ns;
+    std::array<std::atomic<uint64_t>, kLatencyBuckets> _latency_histogram;
+    std::array<BytesOutSlot, kBytesOutSlots> _bytes_out;
+};
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_STREAMPROFILER_H
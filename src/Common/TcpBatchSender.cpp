@@ -0,0 +1,73 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "TcpBatchSender.h"
+#include "ObjectPool.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+constexpr size_t TcpBatchSender::kMaxIovecs;
+constexpr size_t TcpBatchSender::kCopySize;
+
+TcpBatchSender::TcpBatchSender(SocketHelper *session, Metrics::Protocol protocol) {
+    _session = session;
+    _protocol = protocol;
+}
+
+void TcpBatchSender::input(Buffer::Ptr buf) {
+    if (!buf || !buf->size()) {
+        return;
+    }
+    auto copy = buf->size() <= kCopySize;
+    if ((!copy || !_tail) && _iovecs.size() >= kMaxIovecs) {
+        // 需要新的iovec但已达到上限，先发送本批，大Buffer不拷贝
+        flush();
+    }
+    ++_buffers;
+    if (!copy) {
+        _tail = nullptr;
+        _iovecs.emplace_back(std::move(buf));
+        return;
+    }
+    if (!_tail) {
+        _tail = ObjectPool::makeShared<BufferLikeString>();
+        _iovecs.emplace_back(_tail);
+    }
+    _tail->append(buf->data(), buf->size());
+}
+
+void TcpBatchSender::flush() {
+    if (_iovecs.empty()) {
+        return;
+    }
+    Metrics::onSendBatch(_protocol, _iovecs.size(), _buffers);
+
+    // 先放入socket发送队列，最后再一次性flush，socket可写时整批数据通过一次writev/sendmsg发送
+    _session->setSendFlushFlag(false);
+    for (auto &buf : _iovecs) {
+        _session->send(std::move(buf));
+    }
+    _iovecs.clear();
+    _tail = nullptr;
+    _buffers = 0;
+    _session->flushAll();
+    // 恢复调用者设置的flush标志
+    _session->setSendFlushFlag(_flush_flag);
+}
+
+void TcpBatchSender::setSendFlushFlag(bool try_flush) {
+    _flush_flag = try_flush;
+    _session->setSendFlushFlag(try_flush);
+}
+
+} // namespace mediakit
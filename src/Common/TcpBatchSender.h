@@ -0,0 +1,76 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_TCPBATCHSENDER_H
+#define ZLMEDIAKIT_TCPBATCHSENDER_H
+
+#include <vector>
+#include "Metrics.h"
+#include "Network/Socket.h"
+
+namespace mediakit {
+
+/**
+ * tcp会话合并写发送队列
+ * 缓存一次合并写(比如一组rtp/rtmp/flv/ts包)的所有Buffer，刷新时一次性放入socket发送队列后再flush，
+ * 这样socket可以尽量用一次writev/sendmsg发送整批数据(socket不可写或者部分发送时剩余数据仍由socket发送队列续发，
+ * 实际系统调用次数可能多于刷新次数)；
+ * rtsp interleaved头、rtcp、websocket帧头等小Buffer会被拷贝合并到相邻的连续内存中，
+ * 每批的iovec个数有上限(保证不超过IOV_MAX)，达到上限时先发送本批，再开始新的一批
+ */
+class TcpBatchSender {
+public:
+    // 单次刷新最多的iovec个数(linux IOV_MAX为1024)
+    static constexpr size_t kMaxIovecs = 256;
+    // 不超过该长度的Buffer拷贝合并，不单独占用iovec
+    static constexpr size_t kCopySize = 256;
+
+    /**
+     * @param session 发送数据的会话，刷新时通过其send接口发送，以便会话统计发送字节数
+     * @param protocol 统计合并写指标时所属的协议
+     */
+    TcpBatchSender(toolkit::SocketHelper *session, Metrics::Protocol protocol);
+    ~TcpBatchSender() = default;
+
+    /**
+     * 缓存一个Buffer
+     */
+    void input(toolkit::Buffer::Ptr buf);
+
+    /**
+     * 发送所有缓存的Buffer
+     */
+    void flush();
+
+    /**
+     * 获取缓存的iovec个数
+     */
+    size_t size() const { return _iovecs.size(); }
+
+    /**
+     * 设置会话的flush标志，刷新时会临时关闭该标志，刷新后恢复为此处设置的值
+     * SocketHelper不提供该标志的获取接口，使用本对象的会话需通过此接口而不是直接调用会话的setSendFlushFlag
+     */
+    void setSendFlushFlag(bool try_flush);
+
+private:
+    // 调用者设置的flush标志，SocketHelper默认为true
+    bool _flush_flag = true;
+    size_t _buffers = 0;
+    Metrics::Protocol _protocol;
+    toolkit::SocketHelper *_session;
+    // 最后一个iovec是拷贝合并用的连续内存时有效
+    std::shared_ptr<toolkit::BufferLikeString> _tail;
+    std::vector<toolkit::Buffer::Ptr> _iovecs;
+};
+
+} // namespace mediakit
+
+#endif // ZLMEDIAKIT_TCPBATCHSENDER_H
@@ -0,0 +1,210 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <vector>
+#include <cstring>
+#include "UdpBatchReceiver.h"
+#include "Util/uv_errno.h"
+
+#if defined(__linux__) || defined(__linux)
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#define ENABLE_UDP_BATCH_RECV 1
+#endif
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+#if defined(ENABLE_UDP_BATCH_RECV)
+// 单次recvmmsg最多读取的数据报个数
+static constexpr size_t kBatchSize = 32;
+// 每个读缓存的大小，开启GRO时内核合并后的数据报最大为64KB
+static constexpr size_t kSlotSize = 64 * 1024;
+// 保存GRO分片大小的控制消息长度
+static const size_t kControlSize = CMSG_SPACE(sizeof(int));
+
+/**
+ * 线程级读缓存池
+ * 同一个poller线程上的所有接收器共用，读缓存被用户持有时才会重新分配
+ */
+class UdpRecvArena {
+public:
+    UdpRecvArena() {
+        _buffers.resize(kBatchSize);
+        _iovs.resize(kBatchSize);
+        _addrs.resize(kBatchSize);
+        _msgs.resize(kBatchSize);
+        _control.resize(kBatchSize * kControlSize);
+    }
+
+    static UdpRecvArena &Instance() {
+        static thread_local UdpRecvArena s_arena;
+        return s_arena;
+    }
+
+    struct mmsghdr *prepare(bool gro) {
+        for (size_t i = 0; i < kBatchSize; ++i) {
+            auto &buffer = _buffers[i];
+            if (!buffer || buffer.use_count() > 1) {
+                // 上次的数据被用户持有，重新分配
+                buffer = BufferRaw::create();
+                buffer->setCapacity(kSlotSize);
+            }
+            _iovs[i].iov_base = buffer->data();
+            _iovs[i].iov_len = kSlotSize;
+
+            auto &hdr = _msgs[i].msg_hdr;
+            memset(&_msgs[i], 0, sizeof(_msgs[i]));
+            hdr.msg_name = &_addrs[i];
+            hdr.msg_namelen = sizeof(_addrs[i]);
+            hdr.msg_iov = &_iovs[i];
+            hdr.msg_iovlen = 1;
+            if (gro) {
+                hdr.msg_control = &_control[i * kControlSize];
+                hdr.msg_controllen = kControlSize;
+            }
+        }
+        return _msgs.data();
+    }
+
+    BufferRaw::Ptr &buffer(size_t index) { return _buffers[index]; }
+    struct mmsghdr &msg(size_t index) { return _msgs[index]; }
+
+private:
+    std::vector<BufferRaw::Ptr> _buffers;
+    std::vector<struct iovec> _iovs;
+    std::vector<struct sockaddr_storage> _addrs;
+    std::vector<struct mmsghdr> _msgs;
+    std::vector<char> _control;
+};
+
+// 获取GRO合并前单个数据报的大小，0表示未合并
+static int getGroSegmentSize(struct msghdr &hdr) {
+    for (auto cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+            int ret = 0;
+            memcpy(&ret, CMSG_DATA(cmsg), sizeof(ret));
+            return ret;
+        }
+    }
+    return 0;
+}
+#endif
+
+UdpBatchReceiver::Ptr UdpBatchReceiver::attach(const Socket::Ptr &sock, onReadCB cb, bool enable_gro) {
+#if defined(ENABLE_UDP_BATCH_RECV)
+    if (!sock || sock->rawFD() < 0) {
+        return nullptr;
+    }
+    // 复制一个fd用于批量接收，原socket停止接收但仍可正常发送
+    auto fd = dup(sock->rawFD());
+    if (fd < 0) {
+        WarnL << "dup udp socket failed: " << get_uv_errmsg(true);
+        return nullptr;
+    }
+
+    Ptr ret(new UdpBatchReceiver);
+    ret->_fd = fd;
+    ret->_cb = std::move(cb);
+    ret->_sock = sock;
+    ret->_poller = sock->getPoller();
+    if (enable_gro) {
+        int on = 1;
+        ret->_gro = setsockopt(fd, SOL_UDP, UDP_GRO, &on, sizeof(on)) == 0;
+        if (!ret->_gro) {
+            WarnL << "enable udp gro failed: " << get_uv_errmsg(true);
+        }
+    }
+
+    weak_ptr<UdpBatchReceiver> weak_self = ret;
+    auto result = ret->_poller->addEvent(fd, EventPoller::Event_Read | EventPoller::Event_Error, [weak_self](int event) {
+        if (auto strong_self = weak_self.lock()) {
+            strong_self->onRead();
+        }
+    });
+    if (result == -1) {
+        WarnL << "add udp batch receive event failed: " << get_uv_errmsg(true);
+        close(fd);
+        ret->_fd = -1;
+        return nullptr;
+    }
+    sock->enableRecv(false);
+    return ret;
+#else
+    return nullptr;
+#endif
+}
+
+UdpBatchReceiver::~UdpBatchReceiver() {
+#if defined(ENABLE_UDP_BATCH_RECV)
+    if (_fd < 0) {
+        return;
+    }
+    auto fd = _fd;
+    _poller->delEvent(fd, [fd](bool) { close(fd); });
+    if (auto sock = _sock.lock()) {
+        sock->enableRecv(true);
+    }
+#endif
+}
+
+void UdpBatchReceiver::onRead() {
+#if defined(ENABLE_UDP_BATCH_RECV)
+    auto &arena = UdpRecvArena::Instance();
+    while (true) {
+        auto msgs = arena.prepare(_gro);
+        auto count = recvmmsg(_fd, msgs, kBatchSize, 0, nullptr);
+        if (count <= 0) {
+            if (count == -1 && errno == EINTR) {
+                continue;
+            }
+            // EAGAIN，数据已经读完
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            auto &msg = arena.msg(i);
+            auto &buffer = arena.buffer(i);
+            auto addr = (struct sockaddr *)msg.msg_hdr.msg_name;
+            auto addr_len = (int)msg.msg_hdr.msg_namelen;
+            size_t size = msg.msg_len;
+            buffer->setSize(size);
+
+            size_t segment = _gro ? getGroSegmentSize(msg.msg_hdr) : 0;
+            if (!segment || segment >= size) {
+                _cb(buffer, addr, addr_len);
+                continue;
+            }
+            // 切分GRO合并的数据报
+            for (size_t offset = 0; offset < size; offset += segment) {
+                auto len = (std::min)(segment, size - offset);
+                _cb(std::make_shared<BufferOffset<Buffer::Ptr> >(buffer, offset, len), addr, addr_len);
+            }
+        }
+
+        if ((size_t)count < kBatchSize) {
+            // socket接收缓存已经读空
+            break;
+        }
+    }
+#endif
+}
+
+} // namespace mediakit
@@ -0,0 +1,56 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_UDPBATCHRECEIVER_H
+#define ZLMEDIAKIT_UDPBATCHRECEIVER_H
+
+#include <memory>
+#include <functional>
+#include "Network/Socket.h"
+
+namespace mediakit {
+
+/**
+ * udp批量接收器
+ * 接管udp socket的读事件，每次可读事件通过recvmmsg一次性读取多个数据报(读缓存为线程级共享内存池)，
+ * 并可开启UDP GRO，让内核把同一对端的多个等长数据报合并后一次性交给用户态，由本对象再切分
+ * socket本身仍然可以正常用于发送、获取本地/对端地址等
+ */
+class UdpBatchReceiver : public std::enable_shared_from_this<UdpBatchReceiver> {
+public:
+    using Ptr = std::shared_ptr<UdpBatchReceiver>;
+    using onReadCB = std::function<void(const toolkit::Buffer::Ptr &buf, struct sockaddr *addr, int addr_len)>;
+
+    ~UdpBatchReceiver();
+
+    /**
+     * 接管udp socket的读事件
+     * @param sock 已经绑定端口的udp socket，接管后其setOnRead回调不再触发
+     * @param cb 数据回调，与Socket::setOnRead回调相同
+     * @param enable_gro 是否尝试开启UDP GRO
+     * @return 非linux平台或接管失败时返回nullptr，此时应该继续使用Socket::setOnRead
+     */
+    static Ptr attach(const toolkit::Socket::Ptr &sock, onReadCB cb, bool enable_gro);
+
+private:
+    UdpBatchReceiver() = default;
+    void onRead();
+
+private:
+    int _fd = -1;
+    bool _gro = false;
+    onReadCB _cb;
+    std::weak_ptr<toolkit::Socket> _sock;
+    toolkit::EventPoller::Ptr _poller;
+};
+
+} // namespace mediakit
+
+#endif // ZLMEDIAKIT_UDPBATCHRECEIVER_H
@@ -0,0 +1,174 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "UdpBatchSender.h"
+#include "Common/config.h"
+#include "Network/sockutil.h"
+
+#if defined(__linux__) || defined(__linux)
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#define ENABLE_UDP_BATCH_SEND 1
+#endif
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+// 内核限制单个GSO数据报最多64个分片
+static constexpr size_t kMaxGsoSegments = 64;
+// 单个GSO数据报最大长度(不能超过udp数据报最大长度)
+static constexpr size_t kMaxGsoBytes = 65000;
+// 单次sendmmsg最多发送的数据报个数
+static constexpr size_t kMaxBatchMessages = 256;
+
+void UdpBatchSender::setSocket(const Socket::Ptr &sock) {
+    if (_sock == sock) {
+        return;
+    }
+    flush();
+    _sock = sock;
+    // 不同socket可能绑定不同网卡，重新尝试GSO
+    _gso_supported = true;
+}
+
+void UdpBatchSender::input(Buffer::Ptr buf) {
+    _cache.emplace_back(std::move(buf));
+}
+
+void UdpBatchSender::flush() {
+    if (_cache.empty()) {
+        return;
+    }
+    if (!_sock) {
+        _cache.clear();
+        return;
+    }
+
+    size_t sent = 0;
+#if defined(ENABLE_UDP_BATCH_SEND)
+    GET_CONFIG(bool, batch_send, General::kUdpBatchSend);
+    // socket发送缓存中还有数据(比如之前遇到EAGAIN)时，直接写fd会导致乱序，此时只能通过socket的发送缓存发送
+    if (batch_send && !_sock->isSocketBusy() && !_sock->getSendBufferCount()) {
+        sent = sendBatch();
+    }
+#endif
+
+    if (sent < _cache.size()) {
+        // 批量发送失败或未开启，剩余的包通过socket的发送缓存发送
+        for (auto i = sent; i < _cache.size(); ++i) {
+            _sock->send(std::move(_cache[i]), nullptr, 0, false);
+        }
+        _sock->flushAll();
+    }
+    _cache.clear();
+}
+
+size_t UdpBatchSender::sendBatch() {
+#if defined(ENABLE_UDP_BATCH_SEND)
+    auto fd = _sock->rawFD();
+    auto peer_ip = _sock->get_peer_ip();
+    auto peer_port = _sock->get_peer_port();
+    if (fd < 0 || peer_ip.empty() || !peer_port) {
+        return 0;
+    }
+    auto peer_addr = SockUtil::make_sockaddr(peer_ip.data(), peer_port);
+    socklen_t peer_len = peer_addr.ss_family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+
+    // 把连续等长的包划分为一个GSO数据报，更短的包只能作为GSO数据报的最后一个分片
+    auto use_gso = _gso_supported;
+    auto packets = _cache.size();
+    _iovs.resize(packets);
+    _msg_packets.clear();
+    _msg_segment.clear();
+    for (size_t i = 0; i < packets;) {
+        auto segment = _cache[i]->size();
+        size_t count = 1;
+        auto bytes = segment;
+        while (use_gso && i + count < packets && count < kMaxGsoSegments) {
+            auto size = _cache[i + count]->size();
+            if (size > segment || bytes + size > kMaxGsoBytes) {
+                break;
+            }
+            bytes += size;
+            ++count;
+            if (size < segment) {
+                break;
+            }
+        }
+        for (size_t j = i; j < i + count; ++j) {
+            _iovs[j].iov_base = _cache[j]->data();
+            _iovs[j].iov_len = _cache[j]->size();
+        }
+        _msg_packets.emplace_back(count);
+        _msg_segment.emplace_back(count > 1 ? (uint16_t)segment : 0);
+        i += count;
+    }
+
+    auto messages = _msg_packets.size();
+    const size_t kControlSize = CMSG_SPACE(sizeof(uint16_t));
+    _msgs.resize(messages);
+    _control.assign(messages * kControlSize, 0);
+    size_t iov_index = 0;
+    for (size_t i = 0; i < messages; ++i) {
+        auto &hdr = _msgs[i].msg_hdr;
+        memset(&_msgs[i], 0, sizeof(_msgs[i]));
+        hdr.msg_name = &peer_addr;
+        hdr.msg_namelen = peer_len;
+        hdr.msg_iov = &_iovs[iov_index];
+        hdr.msg_iovlen = _msg_packets[i];
+        iov_index += _msg_packets[i];
+        if (!_msg_segment[i]) {
+            continue;
+        }
+        hdr.msg_control = &_control[i * kControlSize];
+        hdr.msg_controllen = kControlSize;
+        auto cmsg = CMSG_FIRSTHDR(&hdr);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        memcpy(CMSG_DATA(cmsg), &_msg_segment[i], sizeof(uint16_t));
+    }
+
+    size_t sent_messages = 0, sent_packets = 0;
+    while (sent_messages < messages) {
+        auto count = (std::min)(kMaxBatchMessages, messages - sent_messages);
+        int ret;
+        do {
+            ret = sendmmsg(fd, &_msgs[sent_messages], count, 0);
+        } while (ret == -1 && errno == EINTR);
+
+        if (ret <= 0) {
+            if (_msg_segment[sent_messages] && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT)) {
+                // 内核或网卡不支持GSO(或硬件校验和卸载)，关闭本socket的GSO，剩余的包回退到普通发送方式
+                _gso_supported = false;
+                WarnL << "udp gso is not supported by " << _sock->get_local_ip() << ", disable it: " << get_uv_errmsg(true);
+            }
+            break;
+        }
+        for (auto i = sent_messages; i < sent_messages + ret; ++i) {
+            sent_packets += _msg_packets[i];
+        }
+        sent_messages += ret;
+    }
+    return sent_packets;
+#else
+    return 0;
+#endif
+}
+
+} // namespace mediakit
@@ -0,0 +1,74 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_UDPBATCHSENDER_H
+#define ZLMEDIAKIT_UDPBATCHSENDER_H
+
+#include <vector>
+#include "Network/Socket.h"
+
+#if defined(__linux__) || defined(__linux)
+#include <sys/socket.h>
+#endif
+
+namespace mediakit {
+
+/**
+ * udp批量发送器
+ * 缓存一次合并写的所有udp包，刷新时通过一次sendmmsg系统调用发送出去，
+ * 并且连续等长的包(最后一个可以更短)会通过UDP GSO合并成一个大数据报，由内核(或网卡)负责切分
+ * 非linux平台、未开启general.udp_batch_send、socket发送缓存不为空或者发送失败时回退到Socket::send；
+ * 注意批量发送绕过了Socket::send，所以toolkit Socket内部的发送速率统计不包含这部分数据，
+ * 调用者需要自行统计发送字节数(比如会话的_bytes_usage与Metrics)
+ */
+class UdpBatchSender {
+public:
+    UdpBatchSender() = default;
+    ~UdpBatchSender() = default;
+
+    /**
+     * 设置发送socket，切换socket前会先发送旧socket的缓存
+     */
+    void setSocket(const toolkit::Socket::Ptr &sock);
+
+    /**
+     * 缓存一个udp包
+     */
+    void input(toolkit::Buffer::Ptr buf);
+
+    /**
+     * 发送所有缓存的udp包，目标地址为socket绑定的对端地址
+     */
+    void flush();
+
+private:
+    /**
+     * 通过sendmmsg批量发送
+     * @return 已经发送成功的包个数，剩余的包回退到Socket::send
+     */
+    size_t sendBatch();
+
+private:
+    // 当前socket是否支持GSO，不支持时只关闭该socket的GSO
+    bool _gso_supported = true;
+    toolkit::Socket::Ptr _sock;
+    std::vector<toolkit::Buffer::Ptr> _cache;
+#if defined(__linux__) || defined(__linux)
+    std::vector<struct iovec> _iovs;
+    std::vector<struct mmsghdr> _msgs;
+    std::vector<size_t> _msg_packets;
+    std::vector<uint16_t> _msg_segment;
+    std::vector<char> _control;
+#endif
+};
+
+} // namespace mediakit
+
+#endif // ZLMEDIAKIT_UDPBATCHSENDER_H
@@ -84,6 +84,12 @@ const string kWaitTrackReadyMS = GENERAL_FIELD "wait_track_ready_ms";
 const string kWaitAddTrackMS = GENERAL_FIELD "wait_add_track_ms";
 const string kUnreadyFrameCache = GENERAL_FIELD "unready_frame_cache";
 const string kBroadcastPlayerCountChanged = GENERAL_FIELD "broadcast_player_count_changed";
+const string kUdpBatchSend = GENERAL_FIELD "udp_batch_send";
+const string kEnableStreamProfile = GENERAL_FIELD "enable_stream_profile";
+const string kParallelMuxThreads = GENERAL_FIELD "parallel_mux_threads";
+const string kEnableKtls = GENERAL_FIELD "enable_ktls";
+const string kTsFastMux = GENERAL_FIELD "ts_fast_mux";
+const string kShareTsMuxer = GENERAL_FIELD "share_ts_muxer";
 
 static onceToken token([]() {
     mINI::Instance()[kFlowThreshold] = 1024;
@@ -99,6 +105,12 @@ static onceToken token([]() {
     mINI::Instance()[kWaitAddTrackMS] = 3000;
     mINI::Instance()[kUnreadyFrameCache] = 100;
     mINI::Instance()[kBroadcastPlayerCountChanged] = 0;
+    mINI::Instance()[kUdpBatchSend] = 0;
+    mINI::Instance()[kEnableStreamProfile] = 0;
+    mINI::Instance()[kParallelMuxThreads] = 0;
+    mINI::Instance()[kEnableKtls] = 0;
+    mINI::Instance()[kTsFastMux] = 0;
+    mINI::Instance()[kShareTsMuxer] = 0;
 });
 
 } // namespace General
@@ -295,6 +307,10 @@ const string kFileBufSize = RECORD_FIELD "fileBufSize";
 const string kFastStart = RECORD_FIELD "fastStart";
 const string kFileRepeat = RECORD_FIELD "fileRepeat";
 const string kEnableFmp4 = RECORD_FIELD "enableFmp4";
+const string kAsyncWriteThreads = RECORD_FIELD "asyncWriteThreads";
+const string kAsyncBlockKB = RECORD_FIELD "asyncBlockKB";
+const string kAsyncQueueMB = RECORD_FIELD "asyncQueueMB";
+const string kDirectIO = RECORD_FIELD "directIO";
 
 static onceToken token([]() {
     mINI::Instance()[kAppName] = "record";
@@ -303,6 +319,10 @@ static onceToken token([]() {
     mINI::Instance()[kFastStart] = false;
     mINI::Instance()[kFileRepeat] = false;
     mINI::Instance()[kEnableFmp4] = false;
+    mINI::Instance()[kAsyncWriteThreads] = 0;
+    mINI::Instance()[kAsyncBlockKB] = 1024;
+    mINI::Instance()[kAsyncQueueMB] = 256;
+    mINI::Instance()[kDirectIO] = false;
 });
 } // namespace Record
 
@@ -318,6 +338,11 @@ const string kFileBufSize = HLS_FIELD "fileBufSize";
 const string kBroadcastRecordTs = HLS_FIELD "broadcastRecordTs";
 const string kDeleteDelaySec = HLS_FIELD "deleteDelaySec";
 const string kFastRegister = HLS_FIELD "fastRegister";
+const string kMemoryStore = HLS_FIELD "memoryStore";
+const string kMemoryStoreMaxMB = HLS_FIELD "memoryStoreMaxMB";
+const string kMemoryStoreVhostMaxMB = HLS_FIELD "memoryStoreVhostMaxMB";
+const string kLowLatency = HLS_FIELD "lowLatency";
+const string kPartDuration = HLS_FIELD "partDur";
 
 static onceToken token([]() {
     mINI::Instance()[kSegmentDuration] = 2;
@@ -329,6 +354,11 @@ static onceToken token([]() {
     mINI::Instance()[kBroadcastRecordTs] = false;
     mINI::Instance()[kDeleteDelaySec] = 10;
     mINI::Instance()[kFastRegister] = false;
+    mINI::Instance()[kMemoryStore] = false;
+    mINI::Instance()[kMemoryStoreMaxMB] = 1024;
+    mINI::Instance()[kMemoryStoreVhostMaxMB] = 0;
+    mINI::Instance()[kLowLatency] = false;
+    mINI::Instance()[kPartDuration] = 0.5;
 });
 } // namespace Hls
 
@@ -345,6 +375,8 @@ const string kOpusPT = RTP_PROXY_FIELD "opus_pt";
 const string kGopCache = RTP_PROXY_FIELD "gop_cache";
 const string kRtpG711DurMs = RTP_PROXY_FIELD "rtp_g711_dur_ms";
 const string kUdpRecvSocketBuffer = RTP_PROXY_FIELD "udp_recv_socket_buffer";
+const string kUdpBatchRecv = RTP_PROXY_FIELD "udp_batch_recv";
+const string kPSFastDemux = RTP_PROXY_FIELD "ps_fast_demux";
 
 static onceToken token([]() {
     mINI::Instance()[kDumpDir] = "";
@@ -357,6 +389,8 @@ static onceToken token([]() {
     mINI::Instance()[kGopCache] = 1;
     mINI::Instance()[kRtpG711DurMs] = 100;
     mINI::Instance()[kUdpRecvSocketBuffer] = 4 * 1024 * 1024;
+    mINI::Instance()[kUdpBatchRecv] = 0;
+    mINI::Instance()[kPSFastDemux] = 0;
 });
 } // namespace RtpProxy
 
@@ -202,6 +202,26 @@ extern const std::string kWaitAddTrackMS;
 extern const std::string kUnreadyFrameCache;
 // 是否启用观看人数变化事件广播，置1则启用，置0则关闭
 extern const std::string kBroadcastPlayerCountChanged;
+// udp合并写时是否通过sendmmsg批量发送(linux下有效)，并在内核支持时使用UDP GSO，
+// 可以大幅减少rtsp(udp)、rtp代理、webrtc、srt等udp发送的系统调用次数
+extern const std::string kUdpBatchSend;
+// 是否开启每个流的性能统计(每帧复用耗时、输入输出字节数、耗时直方图)，
+// 开启后可以通过getStreamProfile接口定位占用cpu较高的流
+extern const std::string kEnableStreamProfile;
+// 并行复用线程个数，置0关闭
+// 开启后各协议复用器(rtmp/rtsp/ts/hls/mp4/fmp4)分别在独立的复用线程中生成数据，
+// 同一复用器的帧总是在同一线程按顺序处理，适用于少量高码率流(比如4K HEVC)占满单核的场景
+// 复用线程在第一个开启并行复用的流创建时启动，修改线程个数需要重启
+extern const std::string kParallelMuxThreads;
+// https/rtmps/rtsps是否开启内核tls(kTLS)发送加密，仅linux且编译时开启openssl有效
+// 开启后tls握手仍然由openssl完成，握手完成后把发送方向的对称密钥交给内核，之后明文直接写入socket由内核(或网卡)加密；
+// 仅支持AES-GCM加密套件，内核不支持(需加载tls模块)或者协商结果不支持时自动回退到用户态加密，修改后对新连接生效
+extern const std::string kEnableKtls;
+// 是否开启快速ts复用，开启后H264/H265 + AAC/G711的ts(http-ts、hls、rtp ts)不再经过mpeg_muxer，
+// 而是使用预先生成的PAT/PMT与pes/ts头直接写入整数个ts包大小的缓存；其他编码格式自动使用mpeg_muxer
+extern const std::string kTsFastMux;
+// 同时开启http-ts与hls(mpegts)时，是否共享同一份ts复用结果，开启后每帧只复用一次ts
+extern const std::string kShareTsMuxer;
 } // namespace General
 
 namespace Protocol {
@@ -363,6 +383,14 @@ extern const std::string kFastStart;
 extern const std::string kFileRepeat;
 // mp4录制文件是否采用fmp4格式
 extern const std::string kEnableFmp4;
+// mp4录制专用写盘线程数，0则在流所在线程同步写盘
+extern const std::string kAsyncWriteThreads;
+// mp4录制写盘合并块大小，单位KB
+extern const std::string kAsyncBlockKB;
+// mp4录制写盘队列上限，单位MB，超过后按帧丢弃录制数据
+extern const std::string kAsyncQueueMB;
+// mp4录制异步写盘时是否使用O_DIRECT绕过page cache(仅linux有效)
+extern const std::string kDirectIO;
 } // namespace Record
 
 ////////////HLS相关配置///////////
@@ -385,6 +413,16 @@ extern const std::string kBroadcastRecordTs;
 extern const std::string kDeleteDelaySec;
 // 如果设置为1，则第一个切片长度强制设置为1个GOP
 extern const std::string kFastRegister;
+// 如果设置为1，则hls直播(segNum不为0且segKeep为0时)的m3u8与切片只保存在内存中，不再读写磁盘
+extern const std::string kMemoryStore;
+// hls内存存储总内存上限，单位MB，超过后淘汰最早的切片，0则不限制
+extern const std::string kMemoryStoreMaxMB;
+// hls内存存储单个vhost内存上限，单位MB，超过后淘汰该vhost最早的切片，0则不限制
+extern const std::string kMemoryStoreVhostMaxMB;
+// 是否开启LL-HLS(部分切片、阻塞式m3u8请求)，仅对fmp4 hls直播有效
+extern const std::string kLowLatency;
+// LL-HLS部分切片时长，单位秒
+extern const std::string kPartDuration;
 } // namespace Hls
 
 ////////////Rtp代理相关配置///////////
@@ -411,6 +449,10 @@ extern const std::string kGopCache;
 extern const std::string kRtpG711DurMs;
 // udp recv socket buffer size
 extern const std::string kUdpRecvSocketBuffer;
+// 单端口单流模式下是否使用recvmmsg批量接收udp rtp(并尝试开启UDP GRO)，仅linux有效
+extern const std::string kUdpBatchRecv;
+// 是否对常见的单节目H264/H265 + G711/AAC ps流启用快速解析，遇到不支持的格式时自动回退到通用ps解析器
+extern const std::string kPSFastDemux;
 } // namespace RtpProxy
 
 /**
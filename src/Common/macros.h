@@ -12,8 +12,12 @@
 #define ZLMEDIAKIT_MACROS_H
 
 #include "Util/logger.h"
+#include <cstdint>
 #include <iostream>
 #include <sstream>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 #if defined(__MACH__)
 #include <arpa/inet.h>
 #include <machine/endian.h>
@@ -89,6 +93,33 @@ public:
 
 extern const char kServerName[];
 
+/**
+ * 获取64位整数末尾0的个数(即最低位1的位置)，用于位图查找，调用方确保value不为0
+ */
+inline size_t countTrailingZero(uint64_t value) {
+#if defined(_MSC_VER)
+    unsigned long ret;
+#if defined(_M_X64) || defined(_M_ARM64)
+    _BitScanForward64(&ret, value);
+#else
+    if (!_BitScanForward(&ret, (uint32_t)value)) {
+        _BitScanForward(&ret, (uint32_t)(value >> 32));
+        ret += 32;
+    }
+#endif
+    return ret;
+#elif defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(value);
+#else
+    size_t ret = 0;
+    while (!(value & 1)) {
+        value >>= 1;
+        ++ret;
+    }
+    return ret;
+#endif
+}
+
 template <typename... ARGS>
 void Assert_ThrowCpp(int failed, const char *exp, const char *func, const char *file, int line, ARGS &&...args) {
     if (failed) {
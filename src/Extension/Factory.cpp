@@ -198,7 +198,7 @@ Frame::Ptr Factory::getFrameFromPtr(CodecId codec, const char *data, size_t byte
     auto it = s_plugins.find(codec);
     if (it == s_plugins.end()) {
         // 创建不支持codec的frame
-        return std::make_shared<FrameFromPtr>(codec, (char *)data, bytes, dts, pts);
+        return ObjectPool::makeShared<FrameFromPtr>(codec, (char *)data, bytes, dts, pts);
     }
     return it->second->getFrameFromPtr(data, bytes, dts, pts);
 }
@@ -208,7 +208,7 @@ Frame::Ptr Factory::getFrameFromBuffer(CodecId codec, Buffer::Ptr data, uint64_t
     if(!frame){
         return nullptr;
     }
-    return std::make_shared<FrameCacheAble>(frame, false, std::move(data));
+    return ObjectPool::makeShared<FrameCacheAble>(frame, false, std::move(data));
 }
 
 }//namespace mediakit
@@ -35,7 +35,7 @@ Frame::Ptr Frame::getCacheAbleFrame(const Frame::Ptr &frame){
     if(frame->cacheAble()){
         return frame;
     }
-    return std::make_shared<FrameCacheAble>(frame);
+    return ObjectPool::makeShared<FrameCacheAble>(frame);
 }
 
 FrameStamp::FrameStamp(Frame::Ptr frame, Stamp &stamp, int modify_stamp)
@@ -265,7 +265,7 @@ bool FrameMerger::inputFrame(const Frame::Ptr &frame, onOutput cb, BufferLikeStr
                     have_key_frame = true;
                 }
             });
-            merged_frame = std::make_shared<BufferOffset<BufferLikeString> >(buffer ? merged : std::move(merged));
+            merged_frame = ObjectPool::makeShared<BufferOffset<BufferLikeString> >(buffer ? merged : std::move(merged));
         }
         cb(back->dts(), back->pts(), merged_frame, have_key_frame);
         _frame_cache.clear();
@@ -17,6 +17,7 @@
 #include "Util/List.h"
 #include "Util/TimeTicker.h"
 #include "Common/Stamp.h"
+#include "Common/ObjectPool.h"
 #include "Network/Buffer.h"
 
 namespace mediakit {
@@ -215,22 +216,22 @@ class FrameImp : public Frame {
 public:
     using Ptr = std::shared_ptr<FrameImp>;
 
+    // 帧数据内存(容量而非数据长度)不超过该大小时，帧对象释放后回收复用(保留数据内存)，防止线程回收池占用过多内存
+    static constexpr size_t kMaxRecycleSize = 16 * 1024;
+
     template <typename C = FrameImp>
     static std::shared_ptr<C> create() {
-#if 0
-        static ResourcePool<C> packet_pool;
-        static onceToken token([]() {
-            packet_pool.setSize(1024);
-        });
-        auto ret = packet_pool.obtain2();
+        // 新建对象的编码类型，H264Frame等子类在构造函数中指定
+        static const CodecId s_codec_id = C()._codec_id;
+        auto ret = RecyclePool<C>::obtain([](C *frame) { return frame->_buffer.capacity() <= kMaxRecycleSize; });
+        // 回收复用的对象需重置全部成员，防止残留上次使用时的状态
+        ret->_codec_id = s_codec_id;
         ret->_buffer.clear();
         ret->_prefix_size = 0;
         ret->_dts = 0;
         ret->_pts = 0;
+        ret->setIndex(-1);
         return ret;
-#else
-        return std::shared_ptr<C>(new C());
-#endif
     }
 
     char *data() const override { return (char *)_buffer.data(); }
@@ -254,7 +255,8 @@ private:
     toolkit::ObjectStatistic<FrameImp> _statistic;
 
 protected:
-    friend class toolkit::ResourcePool_l<FrameImp>;
+    template <typename C, size_t kMaxCount>
+    friend class RecyclePool;
     FrameImp() = default;
 };
 
@@ -379,7 +381,7 @@ public:
             _ptr = frame->data();
             _buffer = std::move(buf);
         } else {
-            auto buffer = std::make_shared<toolkit::BufferLikeString>();
+            auto buffer = ObjectPool::makeShared<toolkit::BufferLikeString>();
             buffer->assign(frame->data(), frame->size());
             _ptr = buffer->data();
             _buffer = std::move(buffer);
@@ -0,0 +1,150 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <cstdint>
+#include "NalScanner.h"
+#include "Common/macros.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NAL_SCAN_SSE2
+#include <emmintrin.h>
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define NAL_SCAN_AVX2
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define NAL_SCAN_NEON
+#include <arm_neon.h>
+#endif
+
+namespace mediakit {
+
+using FindFunc = const char *(*)(const char *ptr, const char *end);
+
+const char *findNalStartCodeScalar(const char *ptr, const char *end) {
+    auto p = (const uint8_t *)ptr;
+    auto e = (const uint8_t *)end;
+    while (p + 2 < e) {
+        // 根据第3个字节跳跃查找，大部分情况下每次可以跳过3个字节
+        if (p[2] > 1) {
+            p += 3;
+        } else if (p[1]) {
+            p += 2;
+        } else if (p[0] || p[2] != 1) {
+            ++p;
+        } else {
+            return (const char *)p;
+        }
+    }
+    return nullptr;
+}
+
+#if defined(NAL_SCAN_SSE2)
+static const char *findNalStartCodeSSE2(const char *ptr, const char *end) {
+    auto p = (const uint8_t *)ptr;
+    auto e = (const uint8_t *)end;
+    const auto zero = _mm_setzero_si128();
+    const auto one = _mm_set1_epi8(1);
+    // 每次比较16个位置，需要多读2个字节
+    while (p + 18 <= e) {
+        auto v0 = _mm_loadu_si128((const __m128i *)p);
+        auto v1 = _mm_loadu_si128((const __m128i *)(p + 1));
+        auto v2 = _mm_loadu_si128((const __m128i *)(p + 2));
+        auto hit = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(v0, zero), _mm_cmpeq_epi8(v1, zero)), _mm_cmpeq_epi8(v2, one));
+        auto mask = (uint32_t)_mm_movemask_epi8(hit);
+        if (mask) {
+            return (const char *)p + countTrailingZero(mask);
+        }
+        p += 16;
+    }
+    return findNalStartCodeScalar((const char *)p, end);
+}
+#endif
+
+#if defined(NAL_SCAN_AVX2)
+__attribute__((target("avx2"))) static const char *findNalStartCodeAVX2(const char *ptr, const char *end) {
+    auto p = (const uint8_t *)ptr;
+    auto e = (const uint8_t *)end;
+    const auto zero = _mm256_setzero_si256();
+    const auto one = _mm256_set1_epi8(1);
+    // 每次比较32个位置，需要多读2个字节
+    while (p + 34 <= e) {
+        auto v0 = _mm256_loadu_si256((const __m256i *)p);
+        auto v1 = _mm256_loadu_si256((const __m256i *)(p + 1));
+        auto v2 = _mm256_loadu_si256((const __m256i *)(p + 2));
+        auto hit = _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(v0, zero), _mm256_cmpeq_epi8(v1, zero)), _mm256_cmpeq_epi8(v2, one));
+        auto mask = (uint32_t)_mm256_movemask_epi8(hit);
+        if (mask) {
+            return (const char *)p + countTrailingZero(mask);
+        }
+        p += 32;
+    }
+    return findNalStartCodeSSE2((const char *)p, end);
+}
+#endif
+
+#if defined(NAL_SCAN_NEON)
+static const char *findNalStartCodeNEON(const char *ptr, const char *end) {
+    auto p = (const uint8_t *)ptr;
+    auto e = (const uint8_t *)end;
+    const auto zero = vdupq_n_u8(0);
+    const auto one = vdupq_n_u8(1);
+    while (p + 18 <= e) {
+        auto v0 = vld1q_u8(p);
+        auto v1 = vld1q_u8(p + 1);
+        auto v2 = vld1q_u8(p + 2);
+        auto hit = vandq_u8(vandq_u8(vceqq_u8(v0, zero), vceqq_u8(v1, zero)), vceqq_u8(v2, one));
+        // neon没有movemask，每个字节压缩为4个bit
+        auto mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+        if (mask) {
+            return (const char *)p + (countTrailingZero(mask) >> 2);
+        }
+        p += 16;
+    }
+    return findNalStartCodeScalar((const char *)p, end);
+}
+#endif
+
+struct NalScanner {
+    FindFunc func;
+    const char *name;
+};
+
+static NalScanner makeScanner() {
+#if defined(NAL_SCAN_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return { findNalStartCodeAVX2, "avx2" };
+    }
+#endif
+#if defined(NAL_SCAN_SSE2)
+    return { findNalStartCodeSSE2, "sse2" };
+#elif defined(NAL_SCAN_NEON)
+    return { findNalStartCodeNEON, "neon" };
+#else
+    return { findNalStartCodeScalar, "scalar" };
+#endif
+}
+
+static const NalScanner &getScanner() {
+    // 只在第一次调用时检测cpu特性
+    static NalScanner s_scanner = makeScanner();
+    return s_scanner;
+}
+
+const char *findNalStartCode(const char *ptr, const char *end) {
+    return getScanner().func(ptr, end);
+}
+
+const char *getNalStartCodeScanner() {
+    return getScanner().name;
+}
+
+} // namespace mediakit
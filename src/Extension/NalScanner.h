@@ -0,0 +1,36 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_NALSCANNER_H
+#define ZLMEDIAKIT_NALSCANNER_H
+
+namespace mediakit {
+
+/**
+ * 查找h264/h265 annexb起始码(00 00 01)
+ * 运行时根据cpu自动选择avx2/sse2/neon实现，不支持时采用标量实现
+ * @param ptr 开始查找位置
+ * @param end 数据结束位置
+ * @return 起始码00 00 01的位置，未找到返回nullptr；调用者需自行判断其前面是否还有一个0(4字节起始码)
+ */
+const char *findNalStartCode(const char *ptr, const char *end);
+
+/**
+ * 标量实现的起始码查找，用于simd实现的对比测试
+ */
+const char *findNalStartCodeScalar(const char *ptr, const char *end);
+
+/**
+ * 获取当前使用的起始码查找实现名称(avx2/sse2/neon/scalar)
+ */
+const char *getNalStartCodeScanner();
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_NALSCANNER_H
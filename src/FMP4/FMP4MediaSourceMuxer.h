@@ -11,6 +11,7 @@
 #ifndef ZLMEDIAKIT_FMP4MEDIASOURCEMUXER_H
 #define ZLMEDIAKIT_FMP4MEDIASOURCEMUXER_H
 
+#include <atomic>
 #include "FMP4MediaSource.h"
 #include "Record/MP4Muxer.h"
 
@@ -52,8 +53,7 @@ public:
     }
 
     bool inputFrame(const Frame::Ptr &frame) override {
-        if (_clear_cache && _option.fmp4_demand) {
-            _clear_cache = false;
+        if (_option.fmp4_demand && _clear_cache.exchange(false)) {
             _media_src->clearCache();
         }
         if (_enabled || !_option.fmp4_demand) {
@@ -64,7 +64,7 @@ public:
 
     bool isEnabled() {
         //缓存尚未清空时，还允许触发inputFrame函数，以便及时清空缓存
-        return _option.fmp4_demand ? (_clear_cache ? true : _enabled) : true;
+        return _option.fmp4_demand ? (_clear_cache || _enabled) : true;
     }
 
     void addTrackCompleted() override {
@@ -83,8 +83,10 @@ protected:
     }
 
 private:
-    bool _enabled = true;
-    bool _clear_cache = false;
+    // 并行复用时onReaderChanged(归属线程)与inputFrame(复用线程)不在同一线程，
+    // 所以使用原子变量；_clear_cache通过exchange保证缓存只在复用线程清空一次
+    std::atomic<bool> _enabled { true };
+    std::atomic<bool> _clear_cache { false };
     ProtocolOption _option;
     FMP4MediaSource::Ptr _media_src;
 };
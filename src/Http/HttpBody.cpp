@@ -367,6 +367,11 @@ HttpBufferBody::HttpBufferBody(Buffer::Ptr buffer) {
     _buffer = std::move(buffer);
 }
 
+void HttpBufferBody::setRange(uint64_t offset, uint64_t max_size) {
+    CHECK(_buffer && (int64_t)offset <= remainSize() && (int64_t)(max_size + offset) <= remainSize());
+    _buffer = std::make_shared<BufferOffset<Buffer::Ptr> >(std::move(_buffer), offset, max_size);
+}
+
 int64_t HttpBufferBody::remainSize() {
     return _buffer ? _buffer->size() : 0;
 }
@@ -90,6 +90,13 @@ public:
     using Ptr = std::shared_ptr<HttpBufferBody>;
     HttpBufferBody(toolkit::Buffer::Ptr buffer);
 
+    /**
+     * 设置读取范围
+     * @param offset 相对Buffer头的偏移量
+     * @param max_size 最大读取字节数
+     */
+    void setRange(uint64_t offset, uint64_t max_size);
+
     int64_t remainSize() override;
     toolkit::Buffer::Ptr readData(size_t size) override;
 
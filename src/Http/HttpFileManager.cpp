@@ -14,6 +14,8 @@
 #include "Common/config.h"
 #include "Common/strCoding.h"
 #include "Record/HlsMediaSource.h"
+#include "Record/HlsMaker.h"
+#include "Record/HlsSegmentStore.h"
 #include "HttpConst.h"
 #include "HttpSession.h"
 #include "HttpFileManager.h"
@@ -162,6 +164,30 @@ static std::string fileName(const string &dir, const string &path) {
     return ret;
 }
 
+/**
+ * 根据Range请求头设置回复范围，并添加Content-Range回复头
+ * @return http状态码，分节下载时为206
+ */
+template <typename Body>
+static int setBodyRange(const StrCaseMap &requestHeader, StrCaseMap &httpHeader, Body &body) {
+    auto &strRange = const_cast<StrCaseMap &>(requestHeader)["Range"];
+    if (strRange.empty()) {
+        return 200;
+    }
+    //分节下载
+    auto iRangeStart = atoll(findSubString(strRange.data(), "bytes=", "-").data());
+    auto iRangeEnd = atoll(findSubString(strRange.data(), "-", nullptr).data());
+    auto totalSize = body.remainSize();
+    if (iRangeEnd == 0) {
+        iRangeEnd = totalSize - 1;
+    }
+    //设置读取范围
+    body.setRange(iRangeStart, iRangeEnd - iRangeStart + 1);
+    //分节下载返回Content-Range头
+    httpHeader.emplace("Content-Range", StrPrinter << "bytes " << iRangeStart << "-" << iRangeEnd << "/" << totalSize << endl);
+    return 206;
+}
+
 static string searchIndexFile(const string &dir) {
     std::string ret;
     static set<std::string, StrCaseCompare> indexSet = { "index.html", "index.htm" };
@@ -457,8 +483,12 @@ static string pathCat(const string &a, const string &b){
  */
 static void accessFile(Session &sender, const Parser &parser, const MediaInfo &media_info, const string &file_path, const HttpFileManager::invoker &cb) {
     bool is_hls = end_with(file_path, kHlsSuffix) || end_with(file_path, kHlsFMP4Suffix);
-    if (!is_hls && !File::fileExist(file_path)) {
-        //文件不存在且不是hls,那么直接返回404
+    uint64_t part_msn = 0;
+    uint32_t part_index = 0;
+    // LL-HLS部分切片可能尚未生成(预加载提示)
+    bool is_part = !is_hls && HlsMaker::parsePartName(file_path, part_msn, part_index);
+    if (!is_hls && !is_part && !File::fileExist(file_path) && !HlsSegmentStore::Instance().get(file_path)) {
+        //文件不存在(磁盘与hls内存存储中都不存在)且不是hls,那么直接返回404
         sendNotFound(cb);
         return;
     }
@@ -475,7 +505,7 @@ static void accessFile(Session &sender, const Parser &parser, const MediaInfo &m
 
     weak_ptr<Session> weakSession = static_pointer_cast<Session>(sender.shared_from_this());
     //判断是否有权限访问该文件
-    canAccessPath(sender, parser, media_info, false, [cb, file_path, parser, is_hls, media_info, weakSession](const string &err_msg, const HttpServerCookie::Ptr &cookie) {
+    canAccessPath(sender, parser, media_info, false, [cb, file_path, parser, is_hls, is_part, part_msn, part_index, media_info, weakSession](const string &err_msg, const HttpServerCookie::Ptr &cookie) {
         auto strongSession = weakSession.lock();
         if (!strongSession) {
             // http客户端已经断开，不需要回复
@@ -515,9 +545,35 @@ static void accessFile(Session &sender, const Parser &parser, const MediaInfo &m
                     break;
                 }
             }
+            if (file_content.empty()) {
+                if (auto buffer = HlsSegmentStore::Instance().get(file_path)) {
+                    // hls直播文件只保存在内存中，直接回复
+                    GET_CONFIG(string, charSet, Http::kCharSet);
+                    httpHeader.emplace("Content-Type", HttpConst::getHttpContentType(file_path.data()) + "; charset=" + charSet);
+                    auto body = std::make_shared<HttpBufferBody>(std::move(buffer));
+                    auto code = setBodyRange(parser.getHeader(), httpHeader, *body);
+                    invoker(code, httpHeader, body);
+                    return;
+                }
+            }
             invoker.responseFile(parser.getHeader(), httpHeader, file_content.empty() ? file_path : file_content, !is_hls && !is_forbid_cache, file_content.empty());
         };
 
+        if (is_part && cookie && !HlsSegmentStore::Instance().get(file_path)) {
+            auto &attach = cookie->getAttach<HttpCookieAttachment>();
+            auto src = attach._hls_data ? attach._hls_data->getMediaSource() : nullptr;
+            if (src) {
+                // LL-HLS预加载提示的部分切片尚未生成，等待其生成后再回复
+                auto waiting = src->getIndexFile(part_msn, part_index, [response_file, cookie, cb, file_path, parser](const string &) {
+                    response_file(cookie, cb, file_path, parser);
+                });
+                if (!waiting) {
+                    response_file(cookie, cb, file_path, parser);
+                }
+                return;
+            }
+        }
+
         if (!is_hls || !cookie) {
             //不是hls或访问m3u8文件不带cookie, 直接回复文件或404
             response_file(cookie, cb, file_path, parser);
@@ -530,6 +586,25 @@ static void accessFile(Session &sender, const Parser &parser, const MediaInfo &m
         auto &attach = cookie->getAttach<HttpCookieAttachment>();
         auto src = attach._hls_data->getMediaSource();
         if (src) {
+            auto &args = parser.getUrlArgs();
+            auto msn_it = args.find("_HLS_msn");
+            auto part_it = args.find("_HLS_part");
+            if (msn_it == args.end() && part_it != args.end()) {
+                // 协议要求携带_HLS_part时必须同时携带_HLS_msn
+                cb(400, "text/html", StrCaseMap(), std::make_shared<HttpStringBody>("Bad Request"));
+                return;
+            }
+            if (msn_it != args.end()) {
+                // LL-HLS阻塞式请求，等待指定的部分切片生成后再回复m3u8
+                auto part = part_it == args.end() ? -1 : atoi(part_it->second.data());
+                auto waiting = src->getIndexFile(strtoull(msn_it->second.data(), nullptr, 10), part, [response_file, cookie, cb, file_path, parser](const string &file) {
+                    response_file(cookie, cb, file_path, parser, file);
+                });
+                if (!waiting) {
+                    cb(400, "text/html", StrCaseMap(), std::make_shared<HttpStringBody>("Bad Request"));
+                }
+                return;
+            }
             // 直接从内存获取m3u8索引文件(而不是从文件系统)
             response_file(cookie, cb, file_path, parser, src->getIndexFile());
             return;
@@ -719,23 +794,7 @@ void HttpResponseInvokerImp::responseFile(const StrCaseMap &requestHeader,
     // 尝试添加Content-Type
     httpHeader.emplace("Content-Type", HttpConst::getHttpContentType(file.data()) + "; charset=" + charSet);
 
-    auto &strRange = const_cast<StrCaseMap &>(requestHeader)["Range"];
-    int code = 200;
-    if (!strRange.empty()) {
-        //分节下载
-        code = 206;
-        auto iRangeStart = atoll(findSubString(strRange.data(), "bytes=", "-").data());
-        auto iRangeEnd = atoll(findSubString(strRange.data(), "-", nullptr).data());
-        auto fileSize = fileBody->remainSize();
-        if (iRangeEnd == 0) {
-            iRangeEnd = fileSize - 1;
-        }
-        //设置文件范围
-        fileBody->setRange(iRangeStart, iRangeEnd - iRangeStart + 1);
-        //分节下载返回Content-Range头
-        httpHeader.emplace("Content-Range", StrPrinter << "bytes " << iRangeStart << "-" << iRangeEnd << "/" << fileSize << endl);
-    }
-
+    auto code = setBodyRange(requestHeader, httpHeader, *fileBody);
     //回复文件
     (*this)(code, httpHeader, fileBody);
 }
@@ -13,6 +13,7 @@
 #include <algorithm>
 #include "Common/config.h"
 #include "Common/strCoding.h"
+#include "Common/StreamProfiler.h"
 #include "HttpSession.h"
 #include "HttpConst.h"
 #include "Util/base64.h"
@@ -147,6 +148,7 @@ void HttpSession::onRecvContent(const char *data, size_t len) {
 
 void HttpSession::onRecv(const Buffer::Ptr &pBuf) {
     _ticker.resetTime();
+    Metrics::addBytesIn(Metrics::kHttp, pBuf->size());
     input(pBuf->data(), pBuf->size());
 }
 
@@ -355,15 +357,23 @@ bool HttpSession::checkLiveStreamFMP4(const function<void()> &cb) {
             }
             strong_self->shutdown(SockException(Err_shutdown, "fmp4 ring buffer detached"));
         });
-        _fmp4_reader->setReadCB([weak_self](const FMP4MediaSource::RingDataType &fmp4_list) {
+        auto profiler = StreamProfiler::get(*src);
+        _fmp4_reader->setReadCB([weak_self, profiler](const FMP4MediaSource::RingDataType &fmp4_list) {
             auto strong_self = weak_self.lock();
             if (!strong_self) {
                 // 本对象已经销毁
                 return;
             }
             size_t i = 0;
+            size_t bytes = 0;
             auto size = fmp4_list->size();
-            fmp4_list->for_each([&](const FMP4Packet::Ptr &ts) { strong_self->onWrite(ts, ++i == size); });
+            fmp4_list->for_each([&](const FMP4Packet::Ptr &ts) {
+                bytes += ts->size();
+                strong_self->onWrite(ts, ++i == size);
+            });
+            if (profiler) {
+                profiler->addBytesOut(bytes);
+            }
         });
     });
 }
@@ -399,15 +409,23 @@ bool HttpSession::checkLiveStreamTS(const function<void()> &cb) {
             }
             strong_self->shutdown(SockException(Err_shutdown, "ts ring buffer detached"));
         });
-        _ts_reader->setReadCB([weak_self](const TSMediaSource::RingDataType &ts_list) {
+        auto profiler = StreamProfiler::get(*src);
+        _ts_reader->setReadCB([weak_self, profiler](const TSMediaSource::RingDataType &ts_list) {
             auto strong_self = weak_self.lock();
             if (!strong_self) {
                 // 本对象已经销毁
                 return;
             }
             size_t i = 0;
+            size_t bytes = 0;
             auto size = ts_list->size();
-            ts_list->for_each([&](const TSPacket::Ptr &ts) { strong_self->onWrite(ts, ++i == size); });
+            ts_list->for_each([&](const TSPacket::Ptr &ts) {
+                bytes += ts->size();
+                strong_self->onWrite(ts, ++i == size);
+            });
+            if (profiler) {
+                profiler->addBytesOut(bytes);
+            }
         });
     });
 }
@@ -443,7 +461,7 @@ bool HttpSession::checkLiveStreamFlv(const function<void()> &cb) {
             }
         }
 
-        start(getPoller(), rtmp_src, start_pts);
+        start(getPoller(), rtmp_src, start_pts, _live_over_websocket);
     });
 }
 
@@ -746,28 +764,46 @@ void HttpSession::setSocketFlags() {
 }
 
 void HttpSession::onWrite(const Buffer::Ptr &buffer, bool flush) {
-    if (flush) {
-        // 需要flush那么一次刷新缓存
-        HttpSession::setSendFlushFlag(true);
-    }
-
     _ticker.resetTime();
     if (!_live_over_websocket) {
         _total_bytes_usage += buffer->size();
-        send(buffer);
+        _tcp_batch_sender.input(buffer);
     } else {
         WebSocketHeader header;
         header._fin = true;
         header._reserved = 0;
         header._opcode = WebSocketHeader::BINARY;
         header._mask_flag = false;
-        WebSocketSplitter::encode(header, buffer);
+        // 服务器下发的数据不加掩码，帧头与负载分别放入发送队列即可
+        auto frame = std::make_shared<BufferLikeString>();
+        WebSocketSplitter::encodeHeader(header, buffer->size(), *frame);
+        _total_bytes_usage += frame->size() + buffer->size();
+        _tcp_batch_sender.input(std::move(frame));
+        _tcp_batch_sender.input(buffer);
     }
 
     if (flush) {
-        // 本次刷新缓存后，下次不用刷新缓存
-        HttpSession::setSendFlushFlag(false);
+        // 一组数据写入完毕，一次性flush
+        _tcp_batch_sender.flush();
+    }
+}
+
+void HttpSession::onWriteFlvTags(const RtmpMediaSource::RingDataType &pkts) {
+    if (!_live_over_websocket) {
+        FlvMuxer::onWriteFlvTags(pkts);
+        return;
     }
+    // websocket帧头也已经包含在共享缓存中，直接发送
+    _ticker.resetTime();
+    auto buffer = getFlvTagBuffer(pkts);
+    _total_bytes_usage += buffer->size();
+    _tcp_batch_sender.input(std::move(buffer));
+    _tcp_batch_sender.flush();
+}
+
+ssize_t HttpSession::send(Buffer::Ptr pkt) {
+    Metrics::addBytesOut(Metrics::kHttp, pkt->size());
+    return Session::send(std::move(pkt));
 }
 
 void HttpSession::onWebSocketEncodeData(Buffer::Ptr buffer) {
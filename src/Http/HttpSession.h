@@ -20,6 +20,9 @@
 #include "HttpFileManager.h"
 #include "TS/TSMediaSource.h"
 #include "FMP4/FMP4MediaSource.h"
+#include "Common/Metrics.h"
+#include "Common/TcpBatchSender.h"
+#include "Common/KtlsSession.h"
 
 namespace mediakit {
 
@@ -50,6 +53,7 @@ public:
 protected:
     //FlvMuxer override
     void onWrite(const toolkit::Buffer::Ptr &data, bool flush) override ;
+    void onWriteFlvTags(const RtmpMediaSource::RingDataType &pkts) override;
     void onDetach() override;
     std::shared_ptr<FlvMuxer> getSharedPtr() override;
 
@@ -100,6 +104,9 @@ protected:
     //重载获取客户端ip
     std::string get_peer_ip() override;
 
+    //重载send函数统计发送字节数
+    ssize_t send(toolkit::Buffer::Ptr pkt) override;
+
 private:
     void onHttpRequest_GET();
     void onHttpRequest_POST();
@@ -135,6 +142,8 @@ private:
     size_t _max_req_size = 0;
     //消耗的总流量
     uint64_t _total_bytes_usage = 0;
+    //直播合并写发送队列
+    TcpBatchSender _tcp_batch_sender { this, Metrics::kHttp };
     // http请求中的 Origin字段
     std::string _origin;
     Parser _parser;
@@ -143,9 +152,11 @@ private:
     FMP4MediaSource::RingType::RingReader::Ptr _fmp4_reader;
     //处理content数据的callback
     std::function<bool (const char *data,size_t len) > _on_recv_body;
+    //会话个数统计
+    Metrics::SessionCounter _metrics { Metrics::kHttp };
 };
 
-using HttpsSession = toolkit::SessionWithSSL<HttpSession>;
+using HttpsSession = SessionWithKTLS<HttpSession>;
 
 } /* namespace mediakit */
 
@@ -151,8 +151,23 @@ void WebSocketSplitter::onPayloadData(uint8_t *data, size_t len) {
 }
 
 void WebSocketSplitter::encode(const WebSocketHeader &header,const Buffer::Ptr &buffer) {
-    string ret;
     uint64_t len = buffer ? buffer->size() : 0;
+    auto ret = std::make_shared<BufferLikeString>();
+    encodeHeader(header, len, *ret);
+    onWebSocketEncodeData(std::move(ret));
+
+    if(len > 0){
+        if(header._mask_flag && header._mask.size() >= 4){
+            uint8_t *ptr = (uint8_t*)buffer->data();
+            for(size_t i = 0; i < len ; ++i,++ptr){
+                *(ptr) ^= header._mask[i % 4];
+            }
+        }
+        onWebSocketEncodeData(buffer);
+    }
+}
+
+void WebSocketSplitter::encodeHeader(const WebSocketHeader &header, uint64_t len, BufferLikeString &ret) {
     uint8_t byte = header._fin << 7 | ((header._reserved & 0x07) << 4) | (header._opcode & 0x0F) ;
     ret.push_back(byte);
 
@@ -180,19 +195,6 @@ void WebSocketSplitter::encode(const WebSocketHeader &header,const Buffer::Ptr &
     if(mask_flag){
         ret.append((char *)header._mask.data(),4);
     }
-
-    onWebSocketEncodeData(std::make_shared<BufferString>(std::move(ret)));
-
-    if(len > 0){
-        if(mask_flag){
-            uint8_t *ptr = (uint8_t*)buffer->data();
-            for(size_t i = 0; i < len ; ++i,++ptr){
-                *(ptr) ^= header._mask[i % 4];
-            }
-        }
-        onWebSocketEncodeData(buffer);
-    }
-
 }
 
 
@@ -99,6 +99,15 @@ public:
      */
     void encode(const WebSocketHeader &header,const toolkit::Buffer::Ptr &buffer);
 
+    /**
+     * 生成数据包头，不触发回调
+     * 服务器下发的数据包不加掩码，所以相同负载的数据包头可以在多个连接间共享
+     * @param header 数据头
+     * @param len 负载数据长度
+     * @param out 数据包头追加至此
+     */
+    static void encodeHeader(const WebSocketHeader &header, uint64_t len, toolkit::BufferLikeString &out);
+
 protected:
     /**
      * 收到一个webSocket数据包包头，后续将继续触发onWebSocketDecodePayload回调
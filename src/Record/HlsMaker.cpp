@@ -8,9 +8,11 @@
  * may be found in the AUTHORS file in the root of the source tree.
  */
 
+#include <chrono>
 #include <iomanip>
 #include "HlsMaker.h"
 #include "Common/config.h"
+#include "Common/Metrics.h"
 
 using namespace std;
 
@@ -22,6 +24,12 @@ HlsMaker::HlsMaker(bool is_fmp4, float seg_duration, uint32_t seg_number, bool s
     _seg_number = seg_number;
     _seg_duration = seg_duration;
     _seg_keep = seg_keep;
+
+    GET_CONFIG(bool, lowLatency, Hls::kLowLatency);
+    GET_CONFIG(float, partDuration, Hls::kPartDuration);
+    // LL-HLS只支持fmp4直播
+    _low_latency = lowLatency && is_fmp4 && seg_number && partDuration > 0;
+    _part_duration = partDuration;
 }
 
 void HlsMaker::makeIndexFile(bool include_delay, bool eof) {
@@ -40,17 +48,19 @@ void HlsMaker::makeIndexFile(bool include_delay, bool eof) {
             maxSegmentDuration = dur;
         }
     }
+    // LL-HLS时切片尚未完成也会生成m3u8，此时正在生成的切片不计入
+    auto file_index = _last_file_name.empty() ? _file_index : _file_index - 1;
     uint64_t index_seq;
     if (_seg_number) {
         if (include_delay) {
-            if (_file_index > _seg_number + segDelay) {
-                index_seq = _file_index - _seg_number - segDelay;
+            if (file_index > _seg_number + segDelay) {
+                index_seq = file_index - _seg_number - segDelay;
             } else {
                 index_seq = 0LL;
             }
         } else {
-            if (_file_index > _seg_number) {
-                index_seq = _file_index - _seg_number;
+            if (file_index > _seg_number) {
+                index_seq = file_index - _seg_number;
             } else {
                 index_seq = 0LL;
             }
@@ -59,25 +69,66 @@ void HlsMaker::makeIndexFile(bool include_delay, bool eof) {
         index_seq = 0LL;
     }
 
+    // 延时m3u8不输出LL-HLS信息
+    bool low_latency = _low_latency && !include_delay;
+    if (low_latency && !maxSegmentDuration) {
+        // 第一个切片尚未生成完毕
+        maxSegmentDuration = _seg_duration * 1000;
+    }
+
     string index_str;
     index_str.reserve(2048);
     index_str += "#EXTM3U\n";
-    index_str += (_is_fmp4 ? "#EXT-X-VERSION:7\n" : "#EXT-X-VERSION:4\n");
+    index_str += (low_latency ? "#EXT-X-VERSION:9\n" : (_is_fmp4 ? "#EXT-X-VERSION:7\n" : "#EXT-X-VERSION:4\n"));
     if (_seg_number == 0) {
         index_str += "#EXT-X-PLAYLIST-TYPE:EVENT\n";
     } else {
         index_str += "#EXT-X-ALLOW-CACHE:NO\n";
     }
     index_str += "#EXT-X-TARGETDURATION:" + std::to_string((maxSegmentDuration + 999) / 1000) + "\n";
-    index_str += "#EXT-X-MEDIA-SEQUENCE:" + std::to_string(index_seq) + "\n";
+
+    stringstream ss;
+    if (low_latency) {
+        ss << std::fixed << std::setprecision(3);
+        // 播放器应该至少距离直播点3个部分切片时长
+        // 协议要求PART-TARGET在整个直播过程中保持不变，所以固定使用配置时长
+        ss << "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=" << _part_duration * 3 << "\n";
+        ss << "#EXT-X-PART-INF:PART-TARGET=" << _part_duration << "\n";
+    }
+    ss << "#EXT-X-MEDIA-SEQUENCE:" << index_seq << "\n";
     if (_is_fmp4) {
-        index_str += "#EXT-X-MAP:URI=\"init.mp4\"\n";
+        ss << "#EXT-X-MAP:URI=\"init.mp4\"\n";
     }
 
-    stringstream ss;
+    auto write_parts = [&](uint64_t msn) {
+        for (auto &pr : _part_list) {
+            if (pr.first != msn) {
+                continue;
+            }
+            for (auto &part : pr.second) {
+                ss << "#EXT-X-PART:DURATION=" << part.duration / 1000.0 << ",URI=\"" << part.uri << "\"" << (part.independent ? ",INDEPENDENT=YES" : "") << "\n";
+            }
+            break;
+        }
+    };
+
+    auto msn = index_seq;
     for (auto &tp : temp) {
+        if (low_latency) {
+            write_parts(msn++);
+        }
         ss << "#EXTINF:" << std::setprecision(3) << std::get<0>(tp) / 1000.0 << ",\n" << std::get<1>(tp) << "\n";
     }
+    if (low_latency && !eof) {
+        if (!_part_complete) {
+            // 正在生成的切片的部分切片
+            write_parts(_part_msn);
+        }
+        // 下一个部分切片的预加载提示
+        auto next_msn = _part_complete ? _part_msn + 1 : _part_msn;
+        auto next_part = _part_complete ? 0 : _part_index + 1;
+        ss << "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"" << getPartUri(next_msn, next_part) << "\"\n";
+    }
     index_str += ss.str();
 
     if (eof) {
@@ -106,6 +157,9 @@ void HlsMaker::inputData(const char *data, size_t len, uint64_t timestamp, bool
         }
         if (!_last_file_name.empty()) {
             // 存在切片才写入ts数据
+            if (_low_latency) {
+                inputPart(data, len, timestamp, is_idr_fast_packet);
+            }
             onWriteSegment(data, len);
             _last_timestamp = timestamp;
         }
@@ -148,6 +202,62 @@ void HlsMaker::addNewSegment(uint64_t stamp) {
     _last_file_name = onOpenSegment(_file_index++);
     //记录本次切片的起始时间戳
     _last_seg_timestamp = _last_timestamp ? _last_timestamp : stamp;
+
+    if (_low_latency) {
+        _part_msn = _file_index - 1;
+        _part_index = -1;
+        _part_complete = false;
+        _part_list.emplace_back(_part_msn, std::vector<PartInfo>());
+        // m3u8中只有最近几个切片需要列出部分切片
+        while (_part_list.size() > 4) {
+            onDelPart(_part_list.front().first);
+            _part_list.pop_front();
+        }
+    }
+}
+
+void HlsMaker::inputPart(const char *data, size_t len, uint64_t timestamp, bool is_idr_fast_packet) {
+    if (timestamp < _part_start_timestamp) {
+        // 时间戳回退了，部分切片时长重新计时
+        _part_start_timestamp = timestamp;
+    }
+    if (timestamp > _part_last_timestamp) {
+        // 记录输入间隔，用于预估本次数据的时长
+        _part_input_interval = timestamp - _part_last_timestamp;
+    }
+    _part_last_timestamp = timestamp;
+
+    auto duration = timestamp - _part_start_timestamp;
+    // 协议要求部分切片时长不得超过PART-TARGET，所以在追加本次数据会超时前切分
+    if (!_part_data.empty() && duration > 0 && duration + _part_input_interval > _part_duration * 1000) {
+        // 部分切片时长足够了，输出并更新m3u8
+        flushPart(duration);
+        makeIndexFile(false);
+    }
+    if (_part_data.empty()) {
+        _part_start_timestamp = timestamp;
+        _part_independent = is_idr_fast_packet;
+    }
+    _part_data.append(data, len);
+}
+
+void HlsMaker::flushPart(uint64_t duration) {
+    if (_part_list.empty() || _part_data.empty()) {
+        return;
+    }
+    auto &parts = _part_list.back().second;
+    auto index = (uint32_t)parts.size();
+    if (!onWritePart(_part_msn, index, _part_data.data(), _part_data.size())) {
+        WarnL << "LL-HLS is not supported";
+        _low_latency = false;
+        _part_data.clear();
+        return;
+    }
+    // 输入间隔抖动时部分切片仍可能略超配置时长，声明时长不得超过PART-TARGET
+    duration = MIN(duration, (uint64_t)(_part_duration * 1000));
+    parts.emplace_back(PartInfo { (int)duration, _part_independent, getPartUri(_part_msn, index) });
+    _part_index = index;
+    _part_data.clear();
 }
 
 void HlsMaker::flushLastSegment(bool eof){
@@ -156,6 +266,7 @@ void HlsMaker::flushLastSegment(bool eof){
         //不存在上个切片
         return;
     }
+    auto start = std::chrono::steady_clock::now();
     //文件创建到最后一次数据写入的时间即为切片长度
     auto seg_dur = _last_timestamp - _last_seg_timestamp;
     if (seg_dur <= 0) {
@@ -163,6 +274,12 @@ void HlsMaker::flushLastSegment(bool eof){
     }
     _seg_dur_list.emplace_back(seg_dur, std::move(_last_file_name));
     delOldSegment();
+    if (_low_latency) {
+        // 输出本切片最后一个部分切片
+        auto part_dur = _last_timestamp - _part_start_timestamp;
+        flushPart(part_dur > 0 ? part_dur : 100);
+        _part_complete = true;
+    }
     //先flush ts切片，否则可能存在ts文件未写入完毕就被访问的情况
     onFlushLastSegment(seg_dur);
     //然后写m3u8文件
@@ -171,6 +288,7 @@ void HlsMaker::flushLastSegment(bool eof){
     if (segDelay) {
         makeIndexFile(true, eof);
     }
+    Metrics::onHlsSegment(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
 }
 
 bool HlsMaker::isLive() const {
@@ -185,12 +303,52 @@ bool HlsMaker::isFmp4() const {
     return _is_fmp4;
 }
 
+bool HlsMaker::isLowLatency() const {
+    return _low_latency;
+}
+
+void HlsMaker::getPartProgress(uint64_t &msn, int &part, bool &complete) const {
+    msn = _part_msn;
+    part = _part_index;
+    complete = _part_complete;
+}
+
+string HlsMaker::getPartName(uint64_t msn, uint32_t part) {
+    return "part/" + std::to_string(msn) + "." + std::to_string(part) + ".m4s";
+}
+
+bool HlsMaker::parsePartName(const string &path, uint64_t &msn, uint32_t &part) {
+    static const string kPartDir = "/part/";
+    static const string kPartSuffix = ".m4s";
+    auto pos = path.rfind(kPartDir);
+    if (pos == string::npos || path.size() <= pos + kPartDir.size() + kPartSuffix.size()
+        || path.compare(path.size() - kPartSuffix.size(), kPartSuffix.size(), kPartSuffix)) {
+        return false;
+    }
+    auto name = path.substr(pos + kPartDir.size(), path.size() - pos - kPartDir.size() - kPartSuffix.size());
+    auto dot = name.find('.');
+    if (dot == string::npos || !dot || dot + 1 == name.size()
+        || name.find_first_not_of("0123456789.") != string::npos || name.find('.', dot + 1) != string::npos) {
+        return false;
+    }
+    msn = std::stoull(name.substr(0, dot));
+    part = (uint32_t)std::stoul(name.substr(dot + 1));
+    return true;
+}
+
 void HlsMaker::clear() {
     _file_index = 0;
     _last_timestamp = 0;
     _last_seg_timestamp = 0;
     _seg_dur_list.clear();
     _last_file_name.clear();
+    _part_data.clear();
+    _part_list.clear();
+    _part_last_timestamp = 0;
+    _part_input_interval = 0;
+    _part_msn = 0;
+    _part_index = -1;
+    _part_complete = false;
 }
 
 }//namespace mediakit
@@ -14,6 +14,7 @@
 #include <string>
 #include <deque>
 #include <tuple>
+#include <vector>
 #include <cstdint>
 
 namespace mediakit {
@@ -65,6 +66,17 @@ public:
      */
     void clear();
 
+    /**
+     * 获取LL-HLS部分切片相对m3u8所在目录的文件名
+     */
+    static std::string getPartName(uint64_t msn, uint32_t part);
+
+    /**
+     * 根据文件路径解析LL-HLS部分切片序号
+     * @return 不是部分切片时返回false
+     */
+    static bool parsePartName(const std::string &path, uint64_t &msn, uint32_t &part);
+
 protected:
     /**
      * 创建ts切片文件回调
@@ -104,12 +116,46 @@ protected:
      */
     virtual void onFlushLastSegment(uint64_t duration_ms) {};
 
+    /**
+     * 写LL-HLS部分切片(EXT-X-PART)回调
+     * @param msn 所属切片的序号(media sequence number)
+     * @param part 部分切片在所属切片中的序号
+     * @param data 部分切片内容
+     * @param len 部分切片长度
+     * @return 返回false代表不支持LL-HLS
+     */
+    virtual bool onWritePart(uint64_t msn, uint32_t part, const char *data, size_t len) { return false; }
+
+    /**
+     * 获取LL-HLS部分切片在m3u8中的uri
+     */
+    virtual std::string getPartUri(uint64_t msn, uint32_t part) const { return getPartName(msn, part); }
+
+    /**
+     * 删除LL-HLS部分切片回调
+     * @param msn 删除该序号切片(含)之前的所有部分切片
+     */
+    virtual void onDelPart(uint64_t msn) {}
+
     /**
      * 关闭上个ts切片并且写入m3u8索引
      * @param eof HLS直播是否已结束
      */
     void flushLastSegment(bool eof);
 
+    /**
+     * 是否开启了LL-HLS
+     */
+    bool isLowLatency() const;
+
+    /**
+     * 获取LL-HLS最新生成的部分切片，用于阻塞式m3u8请求
+     * @param msn 最新部分切片所属切片序号
+     * @param part 最新部分切片序号，-1代表该切片尚无部分切片
+     * @param complete 该切片是否已经完整
+     */
+    void getPartProgress(uint64_t &msn, int &part, bool &complete) const;
+
 private:
     /**
      * 生成m3u8文件
@@ -128,7 +174,24 @@ private:
      */
     void addNewSegment(uint64_t timestamp);
 
+    /**
+     * 输入LL-HLS部分切片数据
+     */
+    void inputPart(const char *data, size_t len, uint64_t timestamp, bool is_idr_fast_packet);
+
+    /**
+     * 生成一个部分切片
+     * @param duration 部分切片时长，单位毫秒
+     */
+    void flushPart(uint64_t duration);
+
 private:
+    struct PartInfo {
+        int duration;
+        bool independent;
+        std::string uri;
+    };
+
     bool _is_fmp4 = false;
     float _seg_duration = 0;
     uint32_t _seg_number = 0;
@@ -138,6 +201,21 @@ private:
     uint64_t _file_index = 0;
     std::string _last_file_name;
     std::deque<std::tuple<int,std::string> > _seg_dur_list;
+
+    // 以下为LL-HLS相关
+    bool _low_latency = false;
+    float _part_duration = 0;
+    bool _part_independent = false;
+    uint64_t _part_start_timestamp = 0;
+    uint64_t _part_last_timestamp = 0;
+    uint64_t _part_input_interval = 0;
+    std::string _part_data;
+    // 最近几个切片(含正在生成的切片)的部分切片列表
+    std::deque<std::pair<uint64_t/*msn*/, std::vector<PartInfo> > > _part_list;
+    // 最新部分切片的进度
+    uint64_t _part_msn = 0;
+    int _part_index = -1;
+    bool _part_complete = false;
 };
 
 }//namespace mediakit
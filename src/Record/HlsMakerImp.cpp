@@ -11,6 +11,7 @@
 #include <ctime>
 #include <sys/stat.h>
 #include "HlsMakerImp.h"
+#include "HlsSegmentStore.h"
 #include "Util/util.h"
 #include "Util/uv_errno.h"
 #include "Util/File.h"
@@ -39,6 +40,9 @@ HlsMakerImp::HlsMakerImp(bool is_fmp4, const string &m3u8_file, const string &pa
     _buf_size = bufSize;
     _file_buf.reset(new char[bufSize], [](char *ptr) { delete[] ptr; });
     _info.folder = _path_prefix;
+    GET_CONFIG(bool, memory_store, Hls::kMemoryStore);
+    // 只有直播且不保留切片时才可以只保存在内存中
+    _in_memory = memory_store && isLive() && !isKeep();
 }
 
 HlsMakerImp::~HlsMakerImp() {
@@ -54,7 +58,13 @@ void HlsMakerImp::clearCache() {
     clearCache(true, false);
 }
 
-static void clearHls(const std::list<std::string> &files) {
+static void clearHls(const std::list<std::string> &files, bool in_memory) {
+    if (in_memory) {
+        for (auto &file : files) {
+            HlsSegmentStore::Instance().remove(file);
+        }
+        return;
+    }
     for (auto &file : files) {
         File::delete_file(file);
     }
@@ -78,14 +88,21 @@ void HlsMakerImp::clearCache(bool immediately, bool eof) {
         for (auto &pr : _segment_file_paths) {
             lst.emplace_back(std::move(pr.second));
         }
+        std::list<std::string> part_lst;
+        for (auto &pr : _part_file_paths) {
+            part_lst.splice(part_lst.end(), pr.second);
+        }
 
         // hls直播才删除文件
         GET_CONFIG(uint32_t, delay, Hls::kDeleteDelaySec);
         if (!delay || immediately) {
-            clearHls(lst);
+            clearHls(lst, _in_memory);
+            clearHls(part_lst, true);
         } else {
-            _poller->doDelayTask(delay * 1000, [lst]() {
-                clearHls(lst);
+            auto in_memory = _in_memory;
+            _poller->doDelayTask(delay * 1000, [lst, part_lst, in_memory]() {
+                clearHls(lst, in_memory);
+                clearHls(part_lst, true);
                 return 0;
             });
         }
@@ -93,7 +110,9 @@ void HlsMakerImp::clearCache(bool immediately, bool eof) {
 
     clear();
     _file = nullptr;
+    _segment = nullptr;
     _segment_file_paths.clear();
+    _part_file_paths.clear();
 }
 
 string HlsMakerImp::onOpenSegment(uint64_t index) {
@@ -108,7 +127,11 @@ string HlsMakerImp::onOpenSegment(uint64_t index) {
             _segment_file_paths.emplace(index, segment_path);
         }
     }
-    _file = makeFile(segment_path, true);
+    if (_in_memory) {
+        _segment = std::make_shared<BufferLikeString>();
+    } else {
+        _file = makeFile(segment_path, true);
+    }
 
     // 保存本切片的元数据
     _info.start_time = ::time(NULL);
@@ -116,7 +139,7 @@ string HlsMakerImp::onOpenSegment(uint64_t index) {
     _info.file_path = segment_path;
     _info.url = _info.app + "/" + _info.stream + "/" + segment_name;
 
-    if (!_file) {
+    if (!_file && !_segment) {
         WarnL << "Create file failed," << segment_path << " " << get_uv_errmsg();
     }
     if (_params.empty()) {
@@ -130,12 +153,21 @@ void HlsMakerImp::onDelSegment(uint64_t index) {
     if (it == _segment_file_paths.end()) {
         return;
     }
-    File::delete_file(it->second.data(), true);
+    if (_in_memory) {
+        HlsSegmentStore::Instance().remove(it->second);
+    } else {
+        File::delete_file(it->second.data(), true);
+    }
     _segment_file_paths.erase(it);
 }
 
 void HlsMakerImp::onWriteInitSegment(const char *data, size_t len) {
     string init_seg_path = _path_prefix + "/init.mp4";
+    if (_in_memory) {
+        HlsSegmentStore::Instance().write(_info.vhost, init_seg_path, std::make_shared<BufferString>(string(data, len)), false);
+        _path_init = std::move(init_seg_path);
+        return;
+    }
     _file = makeFile(init_seg_path);
 
     if (_file) {
@@ -151,6 +183,9 @@ void HlsMakerImp::onWriteSegment(const char *data, size_t len) {
     if (_file) {
         fwrite(data, len, 1, _file.get());
     }
+    if (_segment) {
+        _segment->append(data, len);
+    }
     if (_media_src) {
         _media_src->onSegmentSize(len);
     }
@@ -158,12 +193,19 @@ void HlsMakerImp::onWriteSegment(const char *data, size_t len) {
 
 void HlsMakerImp::onWriteHls(const std::string &data, bool include_delay) {
     auto path = include_delay ? _path_hls_delay : _path_hls;
+    if (_in_memory) {
+        HlsSegmentStore::Instance().write(_info.vhost, path, std::make_shared<BufferString>(data), false);
+        if (_media_src && !include_delay) {
+            setIndexFile(data);
+        }
+        return;
+    }
     auto hls = makeFile(path);
     if (hls) {
         fwrite(data.data(), data.size(), 1, hls.get());
         hls.reset();
         if (_media_src && !include_delay) {
-            _media_src->setIndexFile(data);
+            setIndexFile(data);
         }
     } else {
         WarnL << "Create hls file failed," << path << " " << get_uv_errmsg();
@@ -173,15 +215,45 @@ void HlsMakerImp::onWriteHls(const std::string &data, bool include_delay) {
 void HlsMakerImp::onFlushLastSegment(uint64_t duration_ms) {
     // 关闭并flush文件到磁盘
     _file = nullptr;
+    size_t memory_size = 0;
+    if (_segment) {
+        // 切片写入完毕，开放访问
+        memory_size = _segment->size();
+        HlsSegmentStore::Instance().write(_info.vhost, _info.file_path, std::move(_segment), true);
+        _segment = nullptr;
+    }
 
     GET_CONFIG(bool, broadcastRecordTs, Hls::kBroadcastRecordTs);
     if (broadcastRecordTs) {
         _info.time_len = duration_ms / 1000.0f;
-        _info.file_size = File::fileSize(_info.file_path.data());
+        _info.file_size = _in_memory ? memory_size : File::fileSize(_info.file_path.data());
         NOTICE_EMIT(BroadcastRecordTsArgs, Broadcast::kBroadcastRecordTs, _info);
     }
 }
 
+bool HlsMakerImp::onWritePart(uint64_t msn, uint32_t part, const char *data, size_t len) {
+    auto path = _path_prefix + "/" + getPartName(msn, part);
+    HlsSegmentStore::Instance().write(_info.vhost, path, std::make_shared<BufferString>(string(data, len)), false);
+    _part_file_paths[msn].emplace_back(std::move(path));
+    return true;
+}
+
+void HlsMakerImp::onDelPart(uint64_t msn) {
+    while (!_part_file_paths.empty() && _part_file_paths.begin()->first <= msn) {
+        for (auto &path : _part_file_paths.begin()->second) {
+            HlsSegmentStore::Instance().remove(path);
+        }
+        _part_file_paths.erase(_part_file_paths.begin());
+    }
+}
+
+string HlsMakerImp::getPartUri(uint64_t msn, uint32_t part) const {
+    if (_params.empty()) {
+        return getPartName(msn, part);
+    }
+    return getPartName(msn, part) + "?" + _params;
+}
+
 std::shared_ptr<FILE> HlsMakerImp::makeFile(const string &file, bool setbuf) {
     auto file_buf = _file_buf;
     auto ret = shared_ptr<FILE>(File::create_file(file.data(), "wb"), [file_buf](FILE *fp) {
@@ -195,6 +267,18 @@ std::shared_ptr<FILE> HlsMakerImp::makeFile(const string &file, bool setbuf) {
     return ret;
 }
 
+void HlsMakerImp::setIndexFile(const string &data) {
+    if (!isLowLatency()) {
+        _media_src->setIndexFile(data);
+        return;
+    }
+    uint64_t msn;
+    int part;
+    bool complete;
+    getPartProgress(msn, part, complete);
+    _media_src->setIndexFile(data, msn, part, complete);
+}
+
 void HlsMakerImp::setMediaSource(const MediaTuple& tuple) {
     static_cast<MediaTuple &>(_info) = tuple;
     _media_src = std::make_shared<HlsMediaSource>(isFmp4() ? HLS_FMP4_SCHEMA : HLS_SCHEMA, _info);
@@ -48,12 +48,18 @@ protected:
     void onWriteSegment(const char *data, size_t len) override;
     void onWriteHls(const std::string &data, bool include_delay) override;
     void onFlushLastSegment(uint64_t duration_ms) override;
+    bool onWritePart(uint64_t msn, uint32_t part, const char *data, size_t len) override;
+    void onDelPart(uint64_t msn) override;
+    std::string getPartUri(uint64_t msn, uint32_t part) const override;
 
 private:
     std::shared_ptr<FILE> makeFile(const std::string &file,bool setbuf = false);
     void clearCache(bool immediately, bool eof);
+    void setIndexFile(const std::string &data);
 
 private:
+    // hls直播文件是否只保存在内存中
+    bool _in_memory = false;
     int _buf_size;
     std::string _params;
     std::string _path_hls;
@@ -62,10 +68,14 @@ private:
     std::string _path_prefix;
     RecordInfo _info;
     std::shared_ptr<FILE> _file;
+    // 内存模式下正在写入的切片
+    std::shared_ptr<toolkit::BufferLikeString> _segment;
     std::shared_ptr<char> _file_buf;
     HlsMediaSource::Ptr _media_src;
     toolkit::EventPoller::Ptr _poller;
     std::map<uint64_t/*index*/,std::string/*file_path*/> _segment_file_paths;
+    // LL-HLS部分切片只保存在内存中
+    std::map<uint64_t/*msn*/, std::list<std::string>/*file_path*/> _part_file_paths;
 };
 
 }//namespace mediakit
@@ -90,25 +90,140 @@ void HlsMediaSource::setIndexFile(std::string index_file)
         regist();
     }
 
-    //赋值m3u8索引文件内容
-    std::lock_guard<std::mutex> lck(_mtx_index);
-    _index_file = std::move(index_file);
+    std::string file;
+    List<std::function<void(const std::string &)>> cbs;
+    {
+        //赋值m3u8索引文件内容
+        std::lock_guard<std::mutex> lck(_mtx_index);
+        _index_file = std::move(index_file);
+        file = _index_file;
+        if (!_index_file.empty()) {
+            cbs.swap(_list_cb);
+        } else {
+            // hls已经清空，不再等待部分切片
+            _low_latency = false;
+            for (auto &waiter : _part_waiters) {
+                cbs.emplace_back(std::move(waiter.cb));
+            }
+            _part_waiters.clear();
+        }
+    }
+    // 回调可能触发网络发送，不能在锁内执行
+    cbs.for_each([&](const std::function<void(const std::string &)> &cb) { cb(file); });
+}
 
-    if (!_index_file.empty()) {
-        _list_cb.for_each([&](const std::function<void(const std::string& str)>& cb) { cb(_index_file); });
-        _list_cb.clear();
+void HlsMediaSource::setIndexFile(std::string index_file, uint64_t msn, int part, bool complete) {
+    setIndexFile(std::move(index_file));
+
+    std::string file;
+    List<std::function<void(const std::string &)>> cbs;
+    {
+        std::lock_guard<std::mutex> lck(_mtx_index);
+        _low_latency = true;
+        _part_msn = msn;
+        _part_index = part;
+        _part_complete = complete;
+        file = _index_file;
+        popReadyWaiters(cbs);
     }
+    cbs.for_each([&](const std::function<void(const std::string &)> &cb) { cb(file); });
+}
+
+void HlsMediaSource::popReadyWaiters(List<std::function<void(const std::string &)>> &cbs) {
+    // 协议建议阻塞请求最多等待3倍切片时长，超时后回复当前m3u8，防止推流卡顿时请求堆积
+    GET_CONFIG(float, segDuration, Hls::kSegmentDuration);
+    auto timeout_ms = (uint64_t)(segDuration * 3 * 1000);
+    for (auto it = _part_waiters.begin(); it != _part_waiters.end();) {
+        if (isPartReady(it->msn, it->part) || it->ticker.createdTime() > timeout_ms) {
+            cbs.emplace_back(std::move(it->cb));
+            it = _part_waiters.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void HlsMediaSource::startWaiterTimer() {
+    if (_waiter_timer) {
+        return;
+    }
+    std::weak_ptr<HlsMediaSource> weak_self = std::static_pointer_cast<HlsMediaSource>(shared_from_this());
+    _waiter_timer = std::make_shared<Timer>(0.5f, [weak_self]() {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return false;
+        }
+        std::string file;
+        List<std::function<void(const std::string &)>> cbs;
+        bool again = true;
+        {
+            std::lock_guard<std::mutex> lck(strong_self->_mtx_index);
+            file = strong_self->_index_file;
+            strong_self->popReadyWaiters(cbs);
+            if (strong_self->_part_waiters.empty()) {
+                // 没有等待者了，停止定时器，下次有等待者时再开启
+                strong_self->_waiter_timer = nullptr;
+                again = false;
+            }
+        }
+        cbs.for_each([&](const std::function<void(const std::string &)> &cb) { cb(file); });
+        return again;
+    }, EventPollerPool::Instance().getPoller());
+}
+
+bool HlsMediaSource::isPartReady(uint64_t msn, int part) const {
+    if (msn != _part_msn) {
+        return msn < _part_msn;
+    }
+    return _part_complete || (part >= 0 && part <= _part_index);
 }
 
 void HlsMediaSource::getIndexFile(std::function<void(const std::string& str)> cb)
 {
-    std::lock_guard<std::mutex> lck(_mtx_index);
-    if (!_index_file.empty()) {
-        cb(_index_file);
-        return;
+    std::string file;
+    {
+        std::lock_guard<std::mutex> lck(_mtx_index);
+        if (_index_file.empty()) {
+            //等待生成m3u8文件
+            _list_cb.emplace_back(std::move(cb));
+            return;
+        }
+        file = _index_file;
+    }
+    cb(file);
+}
+
+bool HlsMediaSource::getIndexFile(uint64_t msn, int part, std::function<void(const std::string &str)> cb) {
+    std::string file;
+    List<std::function<void(const std::string &)>> cbs;
+    bool ready = true;
+    {
+        std::lock_guard<std::mutex> lck(_mtx_index);
+        if (_index_file.empty()) {
+            _list_cb.emplace_back(std::move(cb));
+            return true;
+        }
+        file = _index_file;
+        if (_low_latency) {
+            if (msn > _part_msn + 2) {
+                // 协议规定请求超前两个切片以上时应该回复400
+                return false;
+            }
+            if (!isPartReady(msn, part)) {
+                ready = false;
+                _part_waiters.emplace_back(PartWaiter { msn, part, std::move(cb) });
+                startWaiterTimer();
+            }
+            // 顺带回复已就绪或超时的等待者
+            popReadyWaiters(cbs);
+        }
+        // 非LL-HLS忽略阻塞参数
+    }
+    if (ready) {
+        cbs.emplace_back(std::move(cb));
     }
-    //等待生成m3u8文件
-    _list_cb.emplace_back(std::move(cb));
+    cbs.for_each([&](const std::function<void(const std::string &)> &cb) { cb(file); });
+    return true;
 }
 
 } // namespace mediakit
@@ -14,6 +14,7 @@
 #include "Common/MediaSource.h"
 #include "Util/TimeTicker.h"
 #include "Util/RingBuffer.h"
+#include "Poller/Timer.h"
 #include <atomic>
 
 namespace mediakit {
@@ -42,11 +43,27 @@ public:
      */
     void setIndexFile(std::string index_file);
 
+    /**
+     * 设置LL-HLS m3u8索引文件内容，并唤醒等待该部分切片的阻塞式请求
+     * @param msn 最新部分切片所属切片序号
+     * @param part 最新部分切片序号，-1代表该切片尚无部分切片
+     * @param complete 该切片是否已经完整
+     */
+    void setIndexFile(std::string index_file, uint64_t msn, int part, bool complete);
+
     /**
      * 异步获取m3u8文件
      */
     void getIndexFile(std::function<void(const std::string &str)> cb);
 
+    /**
+     * LL-HLS阻塞式获取m3u8文件(_HLS_msn/_HLS_part)，直到指定的部分切片生成后才回调
+     * @param msn 切片序号
+     * @param part 部分切片序号，-1代表等待整个切片完成
+     * @return 请求的切片超前太多时返回false，此时应该回复400
+     */
+    bool getIndexFile(uint64_t msn, int part, std::function<void(const std::string &str)> cb);
+
     /**
      * 同步获取m3u8文件
      */
@@ -63,10 +80,32 @@ public:
     }
 
 private:
+    bool isPartReady(uint64_t msn, int part) const;
+    // 取出已就绪或等待超时的阻塞请求，需在_mtx_index锁内调用
+    void popReadyWaiters(toolkit::List<std::function<void(const std::string &)>> &cbs);
+    // 定时回复等待超时的阻塞请求，防止推流中断后请求一直得不到回复，需在_mtx_index锁内调用
+    void startWaiterTimer();
+
+private:
+    struct PartWaiter {
+        uint64_t msn;
+        int part;
+        std::function<void(const std::string &)> cb;
+        toolkit::Ticker ticker;
+    };
+
     RingType::Ptr _ring;
     std::string _index_file;
     mutable std::mutex _mtx_index;
     toolkit::List<std::function<void(const std::string &)>> _list_cb;
+
+    // LL-HLS最新部分切片进度
+    bool _low_latency = false;
+    bool _part_complete = false;
+    int _part_index = -1;
+    uint64_t _part_msn = 0;
+    std::list<PartWaiter> _part_waiters;
+    std::shared_ptr<toolkit::Timer> _waiter_timer;
 };
 
 class HlsCookieData {
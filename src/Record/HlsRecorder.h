@@ -11,6 +11,7 @@
 #ifndef HLSRECORDER_H
 #define HLSRECORDER_H
 
+#include <atomic>
 #include "HlsMakerImp.h"
 #include "MPEG.h"
 #include "MP4Muxer.h"
@@ -55,13 +56,7 @@ public:
     }
 
     bool inputFrame(const Frame::Ptr &frame) override {
-        if (_clear_cache && _option.hls_demand) {
-            _clear_cache = false;
-            //清空旧的m3u8索引文件于ts切片
-            _hls->clearCache();
-            _hls->getMediaSource()->setIndexFile("");
-        }
-        if (_enabled || !_option.hls_demand) {
+        if (checkEnabled()) {
             return Muxer::inputFrame(frame);
         }
         return false;
@@ -69,12 +64,26 @@ public:
 
     bool isEnabled() {
         //缓存尚未清空时，还允许触发inputFrame函数，以便及时清空缓存
-        return _option.hls_demand ? (_clear_cache ? true : _enabled) : true;
+        return _option.hls_demand ? (_clear_cache || _enabled) : true;
+    }
+
+protected:
+    /**
+     * 按需生成hls时，无人观看后清空缓存，并判断是否需要生成hls
+     */
+    bool checkEnabled() {
+        if (_option.hls_demand && _clear_cache.exchange(false)) {
+            //清空旧的m3u8索引文件于ts切片
+            _hls->clearCache();
+            _hls->getMediaSource()->setIndexFile("");
+        }
+        return _enabled || !_option.hls_demand;
     }
 
 protected:
-    bool _enabled = true;
-    bool _clear_cache = false;
+    // onReaderChanged在归属线程调用，checkEnabled在复用线程(并行复用或与http-ts共享时)调用，所以使用原子变量
+    std::atomic<bool> _enabled { true };
+    std::atomic<bool> _clear_cache { false };
     ProtocolOption _option;
     std::shared_ptr<HlsMakerImp> _hls;
 };
@@ -92,6 +101,16 @@ public:
         }
     }
 
+    /**
+     * 输入http-ts复用好的ts数据，与http-ts共享同一份ts复用结果时，不再通过inputFrame单独复用
+     * @param buffer ts数据，nullptr代表重置track
+     */
+    void inputTS(const std::shared_ptr<toolkit::Buffer> &buffer, uint64_t timestamp, bool key_pos) {
+        if (!buffer || checkEnabled()) {
+            onWrite(buffer, timestamp, key_pos);
+        }
+    }
+
 private:
     void onWrite(std::shared_ptr<toolkit::Buffer> buffer, uint64_t timestamp, bool key_pos) override {
         if (!buffer) {
@@ -0,0 +1,107 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "HlsSegmentStore.h"
+#include "Common/config.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+HlsSegmentStore &HlsSegmentStore::Instance() {
+    static HlsSegmentStore s_instance;
+    return s_instance;
+}
+
+void HlsSegmentStore::write(const string &vhost, const string &path, Buffer::Ptr data, bool evictable) {
+    lock_guard<mutex> lck(_mtx);
+    auto it = _files.find(path);
+    if (it != _files.end()) {
+        removeItem(it);
+    }
+    auto &item = _files[path];
+    item.vhost = vhost;
+    item.evictable = evictable;
+    item.data = std::move(data);
+    if (evictable) {
+        item.order = _order.emplace(_order.end(), path);
+    }
+    auto bytes = item.data ? item.data->size() : 0;
+    _total_bytes += bytes;
+    _vhost_bytes[vhost] += bytes;
+    evict(vhost);
+}
+
+void HlsSegmentStore::remove(const string &path) {
+    lock_guard<mutex> lck(_mtx);
+    auto it = _files.find(path);
+    if (it != _files.end()) {
+        removeItem(it);
+    }
+}
+
+Buffer::Ptr HlsSegmentStore::get(const string &path) const {
+    lock_guard<mutex> lck(_mtx);
+    auto it = _files.find(path);
+    return it == _files.end() ? nullptr : it->second.data;
+}
+
+size_t HlsSegmentStore::totalBytes() const {
+    lock_guard<mutex> lck(_mtx);
+    return _total_bytes;
+}
+
+void HlsSegmentStore::removeItem(unordered_map<string, Item>::iterator it) {
+    auto &item = it->second;
+    auto bytes = item.data ? item.data->size() : 0;
+    _total_bytes -= bytes;
+    auto vhost_it = _vhost_bytes.find(item.vhost);
+    if (vhost_it != _vhost_bytes.end()) {
+        vhost_it->second -= bytes;
+        if (!vhost_it->second) {
+            _vhost_bytes.erase(vhost_it);
+        }
+    }
+    if (item.evictable) {
+        _order.erase(item.order);
+    }
+    _files.erase(it);
+}
+
+void HlsSegmentStore::evict(const string &vhost) {
+    GET_CONFIG(size_t, max_mb, Hls::kMemoryStoreMaxMB);
+    GET_CONFIG(size_t, vhost_max_mb, Hls::kMemoryStoreVhostMaxMB);
+
+    // 超过总内存上限，淘汰最早的切片
+    while (max_mb && _total_bytes > max_mb * 1024 * 1024 && !_order.empty()) {
+        WarnL << "hls memory store is full, evict segment: " << _order.front();
+        removeItem(_files.find(_order.front()));
+    }
+
+    // 超过该vhost内存上限，淘汰该vhost最早的切片
+    if (!vhost_max_mb) {
+        return;
+    }
+    auto it = _order.begin();
+    while (it != _order.end()) {
+        auto vhost_it = _vhost_bytes.find(vhost);
+        if (vhost_it == _vhost_bytes.end() || vhost_it->second <= vhost_max_mb * 1024 * 1024) {
+            break;
+        }
+        auto file_it = _files.find(*it++);
+        if (file_it->second.vhost == vhost) {
+            WarnL << "hls memory store of vhost " << vhost << " is full, evict segment: " << file_it->first;
+            removeItem(file_it);
+        }
+    }
+}
+
+} // namespace mediakit
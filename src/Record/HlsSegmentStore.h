@@ -0,0 +1,79 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_HLSSEGMENTSTORE_H
+#define ZLMEDIAKIT_HLSSEGMENTSTORE_H
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "Network/Buffer.h"
+
+namespace mediakit {
+
+/**
+ * hls直播内存文件存储
+ * 以文件绝对路径为key保存m3u8、init.mp4以及ts/fmp4切片，http服务器优先从这里回复hls文件，
+ * 这样hls直播(不保留切片时)不再需要读写磁盘
+ * 切片按写入顺序淘汰，同时受总内存与单个vhost内存上限约束，m3u8与init.mp4不参与淘汰
+ */
+class HlsSegmentStore {
+public:
+    static HlsSegmentStore &Instance();
+
+    /**
+     * 写入或覆盖文件
+     * @param vhost 所属虚拟主机，用于按vhost统计内存
+     * @param path 文件绝对路径
+     * @param data 文件内容
+     * @param evictable 内存超限时是否可以被淘汰(切片为true)
+     */
+    void write(const std::string &vhost, const std::string &path, toolkit::Buffer::Ptr data, bool evictable);
+
+    /**
+     * 删除文件
+     */
+    void remove(const std::string &path);
+
+    /**
+     * 获取文件内容，不存在时返回nullptr
+     */
+    toolkit::Buffer::Ptr get(const std::string &path) const;
+
+    /**
+     * 获取已占用的总内存
+     */
+    size_t totalBytes() const;
+
+private:
+    HlsSegmentStore() = default;
+
+    struct Item {
+        std::string vhost;
+        toolkit::Buffer::Ptr data;
+        bool evictable = false;
+        std::list<std::string>::iterator order;
+    };
+
+    void removeItem(std::unordered_map<std::string, Item>::iterator it);
+    void evict(const std::string &vhost);
+
+private:
+    mutable std::mutex _mtx;
+    size_t _total_bytes = 0;
+    // 可淘汰切片的写入顺序
+    std::list<std::string> _order;
+    std::unordered_map<std::string, Item> _files;
+    std::unordered_map<std::string, size_t> _vhost_bytes;
+};
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_HLSSEGMENTSTORE_H
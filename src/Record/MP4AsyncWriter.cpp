@@ -0,0 +1,386 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#if defined(ENABLE_MP4) && !defined(_WIN32)
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cstdlib>
+#include "MP4AsyncWriter.h"
+#include "Util/File.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/TimeTicker.h"
+#include "Common/config.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+// O_DIRECT要求内存地址、文件偏移量与写入长度按该大小对齐
+static constexpr size_t kDirectAlign = 4096;
+
+constexpr size_t MP4WriteThreadPool::kLatencyBuckets;
+
+MP4WriteThreadPool &MP4WriteThreadPool::Instance() {
+    static MP4WriteThreadPool s_instance;
+    return s_instance;
+}
+
+MP4WriteThreadPool::MP4WriteThreadPool() {
+    GET_CONFIG(uint32_t, threads, Record::kAsyncWriteThreads);
+    GET_CONFIG(uint32_t, queue_mb, Record::kAsyncQueueMB);
+    _max_queue_bytes = (size_t)queue_mb * 1024 * 1024;
+    for (auto &count : _latency_histogram) {
+        count = 0;
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        _workers.emplace_back(new Worker);
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        _threads.emplace_back([this, i]() { run(i); });
+    }
+}
+
+MP4WriteThreadPool::~MP4WriteThreadPool() {
+    {
+        lock_guard<mutex> lck(_mtx);
+        _exit = true;
+        for (auto &worker : _workers) {
+            worker->cond.notify_all();
+        }
+    }
+    for (auto &thread : _threads) {
+        thread.join();
+    }
+}
+
+size_t MP4WriteThreadPool::allocThread(const string &file) {
+    return std::hash<string>()(file) % _threads.size();
+}
+
+void MP4WriteThreadPool::async(size_t index, size_t bytes, function<void()> task) {
+    lock_guard<mutex> lck(_mtx);
+    _queue_bytes += bytes;
+    ++_queue_depth;
+    auto &worker = _workers[index % _workers.size()];
+    worker->tasks.emplace_back(Task { bytes, std::move(task) });
+    worker->cond.notify_one();
+}
+
+bool MP4WriteThreadPool::overloaded() const {
+    return _max_queue_bytes && _queue_bytes >= _max_queue_bytes;
+}
+
+void MP4WriteThreadPool::run(size_t index) {
+    setThreadName(("mp4 writer " + to_string(index)).data());
+    auto &worker = _workers[index];
+    while (true) {
+        Task task;
+        {
+            unique_lock<mutex> lck(_mtx);
+            worker->cond.wait(lck, [&]() { return _exit || !worker->tasks.empty(); });
+            if (worker->tasks.empty()) {
+                // 退出
+                break;
+            }
+            task = std::move(worker->tasks.front());
+            worker->tasks.pop_front();
+        }
+
+        Ticker ticker;
+        try {
+            task.task();
+        } catch (std::exception &ex) {
+            WarnL << "Write mp4 file failed: " << ex.what();
+        }
+        auto ms = ticker.elapsedTime();
+        static const uint64_t kBucketLimit[kLatencyBuckets - 1] = { 1, 5, 20, 100, 500 };
+        size_t bucket = 0;
+        while (bucket < kLatencyBuckets - 1 && ms >= kBucketLimit[bucket]) {
+            ++bucket;
+        }
+        ++_latency_histogram[bucket];
+        _written_bytes += task.bytes;
+
+        lock_guard<mutex> lck(_mtx);
+        _queue_bytes -= task.bytes;
+        --_queue_depth;
+    }
+}
+
+MP4WriteThreadPool::Statistic MP4WriteThreadPool::getStatistic() const {
+    Statistic ret;
+    ret.threads = _threads.size();
+    ret.written_bytes = _written_bytes;
+    for (size_t i = 0; i < kLatencyBuckets; ++i) {
+        ret.latency_histogram[i] = _latency_histogram[i];
+    }
+    lock_guard<mutex> lck(_mtx);
+    ret.queue_depth = _queue_depth;
+    ret.queue_bytes = _queue_bytes;
+    ret.dropped_frames = _dropped_frames;
+    return ret;
+}
+
+const char *MP4WriteThreadPool::getLatencyBucketName(size_t index) {
+    static const char *s_names[kLatencyBuckets] = { "<1ms", "<5ms", "<20ms", "<100ms", "<500ms", ">=500ms" };
+    return index < kLatencyBuckets ? s_names[index] : "";
+}
+
+/////////////////////////////////////////////////////MP4FileAsyncDisk/////////////////////////////////////////////////////////
+
+// 写满全部数据，返回0或errno
+static int writeAll(int fd, const char *data, size_t bytes, uint64_t offset) {
+    while (bytes) {
+        auto ret = pwrite(fd, data, bytes, offset);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        data += ret;
+        bytes -= ret;
+        offset += ret;
+    }
+    return 0;
+}
+
+// 关闭文件，写盘失败的文件不完整，清空后由录制模块当作过小文件删除
+static void closeFd(int fd, int direct_fd, int error, const function<void()> &on_closed) {
+    if (error) {
+        WarnL << "MP4 file is incomplete, discard it: " << strerror(error);
+        if (ftruncate(fd, 0) == -1) {
+            WarnL << "Truncate mp4 file failed: " << strerror(errno);
+        }
+    }
+    if (direct_fd != -1) {
+        close(direct_fd);
+    }
+    close(fd);
+    if (on_closed) {
+        on_closed();
+    }
+}
+
+MP4FileAsyncDisk::~MP4FileAsyncDisk() {
+    closeFile();
+}
+
+void MP4FileAsyncDisk::openFile(const char *file) {
+    closeFile();
+    // 确保目录存在；同名旧文件可能还有数据在io线程排队，不能在此截断
+    auto fp = File::create_file(file, "ab");
+    if (!fp) {
+        throw std::runtime_error(string("打开文件失败:") + file);
+    }
+    fclose(fp);
+
+    _fd = open(file, O_RDWR);
+    if (_fd == -1) {
+        throw std::runtime_error(string("打开文件失败:") + file);
+    }
+    GET_CONFIG(bool, direct_io, Record::kDirectIO);
+#if defined(O_DIRECT)
+    if (direct_io) {
+        // 对齐的整块数据通过O_DIRECT绕过page cache写盘，其他数据(如mp4头的回写)仍然走普通fd
+        _direct_fd = open(file, O_WRONLY | O_DIRECT);
+        if (_direct_fd == -1) {
+            WarnL << "Open file with O_DIRECT failed: " << file << ", " << strerror(errno);
+        }
+    }
+#else
+    (void)direct_io;
+#endif
+
+    GET_CONFIG(uint32_t, block_kb, Record::kAsyncBlockKB);
+    _block_size = (std::max)((size_t)block_kb * 1024, kDirectAlign);
+    // 保证整块数据对齐
+    _block_size = (_block_size + kDirectAlign - 1) / kDirectAlign * kDirectAlign;
+    _thread = MP4WriteThreadPool::Instance().allocThread(file);
+    _state = std::make_shared<State>();
+    _offset = 0;
+    _block_offset = 0;
+    _block_used = 0;
+    allocBlock();
+
+    // 在io线程截断文件，此时同名旧文件排队中的数据已经写完并关闭
+    auto fd = _fd;
+    auto state = _state;
+    MP4WriteThreadPool::Instance().async(_thread, 0, [fd, state]() {
+        if (ftruncate(fd, 0) == -1 && !state->error) {
+            state->error = errno;
+        }
+    });
+}
+
+void MP4FileAsyncDisk::setOnClosed(function<void()> cb) {
+    _on_closed = std::move(cb);
+}
+
+void MP4FileAsyncDisk::closeFile() {
+    if (_fd == -1) {
+        return;
+    }
+    auto fd = _fd;
+    auto direct_fd = _direct_fd;
+    auto state = _state;
+    auto on_closed = std::move(_on_closed);
+    _fd = -1;
+    _direct_fd = -1;
+    _on_closed = nullptr;
+    if (_io_thread) {
+        // 在io线程销毁(mp4 writer释放了最后一个引用)，之前的数据都已写完
+        closeFd(fd, direct_fd, state->error, on_closed);
+    } else {
+        submitBlock(fd, direct_fd);
+        MP4WriteThreadPool::Instance().async(_thread, 0, [fd, direct_fd, state, on_closed]() {
+            closeFd(fd, direct_fd, state->error, on_closed);
+        });
+    }
+    _block = nullptr;
+}
+
+MP4FileIO::Writer MP4FileAsyncDisk::createWriter(int flags, bool is_fmp4) {
+    auto writer = MP4FileIO::createWriter(flags, is_fmp4);
+    auto self = std::static_pointer_cast<MP4FileAsyncDisk>(shared_from_this());
+    auto ptr = writer.get();
+    return Writer(ptr, [writer, self](mp4_writer_t *) mutable {
+        // mp4_writer_destroy会写mp4头，faststart时还会回读并重写整个文件，交给io线程执行，
+        // 同一文件的任务按顺序执行，此时之前提交的数据块都已写完
+        auto strong_writer = std::move(writer);
+        auto strong_self = std::move(self);
+        strong_self->submit();
+        auto thread = strong_self->_thread;
+        MP4WriteThreadPool::Instance().async(thread, 0, [strong_writer, strong_self]() mutable {
+            strong_self->_io_thread = true;
+            strong_writer = nullptr;
+            strong_self = nullptr;
+        });
+    });
+}
+
+void MP4FileAsyncDisk::allocBlock() {
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, kDirectAlign, _block_size)) {
+        throw std::bad_alloc();
+    }
+    _block.reset((char *)ptr, [](char *ptr) { free(ptr); });
+}
+
+void MP4FileAsyncDisk::submit() {
+    if (_fd == -1 || !_block_used) {
+        return;
+    }
+    submitBlock(_fd, _direct_fd);
+    allocBlock();
+}
+
+void MP4FileAsyncDisk::submitBlock(int fd, int direct_fd) {
+    if (!_block_used) {
+        return;
+    }
+    auto block = std::move(_block);
+    auto size = _block_used;
+    auto offset = _block_offset;
+    // 整块且对齐的数据才可以使用O_DIRECT
+    auto direct = direct_fd != -1 && offset % kDirectAlign == 0 && size % kDirectAlign == 0 ? direct_fd : -1;
+    auto state = _state;
+    MP4WriteThreadPool::Instance().async(_thread, size, [block, size, offset, fd, direct, state]() {
+        if (state->error) {
+            // 文件已经不完整，不再写盘
+            return;
+        }
+        auto err = direct != -1 ? writeAll(direct, block.get(), size, offset) : EINVAL;
+        if (err) {
+            err = writeAll(fd, block.get(), size, offset);
+        }
+        if (err) {
+            state->error = err;
+        }
+    });
+    _block_used = 0;
+    _block_offset = _offset;
+}
+
+uint64_t MP4FileAsyncDisk::onTell() {
+    return _offset;
+}
+
+int MP4FileAsyncDisk::onSeek(uint64_t offset) {
+    _offset = offset;
+    return 0;
+}
+
+int MP4FileAsyncDisk::onRead(void *data, size_t bytes) {
+    if (!_io_thread) {
+        // 只有销毁mp4 writer(faststart)时需要回读，此时在io线程且之前的数据都已写完
+        WarnL << "MP4 file can only be read back in the writer thread";
+        return -1;
+    }
+    char *ptr = (char *)data;
+    while (bytes) {
+        auto ret = pread(_fd, ptr, bytes, _offset);
+        if (ret <= 0) {
+            if (ret < 0 && errno == EINTR) {
+                continue;
+            }
+            return ret ? errno : -1 /*EOF*/;
+        }
+        ptr += ret;
+        bytes -= ret;
+        _offset += ret;
+        _block_offset = _offset;
+    }
+    return 0;
+}
+
+int MP4FileAsyncDisk::onWrite(const void *data, size_t bytes) {
+    if (_state->error) {
+        // 之前的异步写盘已经失败
+        return _state->error;
+    }
+    if (_io_thread) {
+        // 在io线程写mp4头，直接写盘
+        auto err = writeAll(_fd, (const char *)data, bytes, _offset);
+        if (err) {
+            _state->error = err;
+            return err;
+        }
+        _offset += bytes;
+        _block_offset = _offset;
+        return 0;
+    }
+    if (_offset != _block_offset + _block_used) {
+        // 非连续写(seek过)，先提交之前的数据
+        submit();
+        _block_offset = _offset;
+    }
+    auto ptr = (const char *)data;
+    while (bytes) {
+        auto len = (std::min)(bytes, _block_size - _block_used);
+        memcpy(_block.get() + _block_used, ptr, len);
+        _block_used += len;
+        _offset += len;
+        ptr += len;
+        bytes -= len;
+        if (_block_used == _block_size) {
+            submit();
+        }
+    }
+    return 0;
+}
+
+} // namespace mediakit
+
+#endif // defined(ENABLE_MP4) && !defined(_WIN32)
@@ -0,0 +1,189 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_MP4ASYNCWRITER_H
+#define ZLMEDIAKIT_MP4ASYNCWRITER_H
+
+#if defined(ENABLE_MP4) && !defined(_WIN32)
+
+#include <array>
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+#include "MP4.h"
+
+namespace mediakit {
+
+/**
+ * mp4录制专用的磁盘io线程池
+ * 录制数据通过有界队列交给io线程写盘，磁盘缓慢时不会阻塞流所在的poller线程
+ * 同一个文件的写任务总是在同一个io线程上按顺序执行
+ */
+class MP4WriteThreadPool {
+public:
+    // 写耗时直方图分档上限，单位毫秒，最后一档为超过500ms
+    static constexpr size_t kLatencyBuckets = 6;
+
+    struct Statistic {
+        // io线程个数
+        size_t threads = 0;
+        // 排队中的写任务个数
+        size_t queue_depth = 0;
+        // 排队中的数据字节数
+        size_t queue_bytes = 0;
+        // 队列满导致被丢弃的录制帧数
+        uint64_t dropped_frames = 0;
+        // 累计写盘字节数
+        uint64_t written_bytes = 0;
+        // 写耗时直方图，分别为<1ms、<5ms、<20ms、<100ms、<500ms、>=500ms
+        std::array<uint64_t, kLatencyBuckets> latency_histogram;
+    };
+
+    static MP4WriteThreadPool &Instance();
+    ~MP4WriteThreadPool();
+
+    /**
+     * 是否开启了异步写盘
+     */
+    bool enabled() const { return !_threads.empty(); }
+
+    /**
+     * 为新文件分配io线程，同一路径总是分配到同一线程，确保旧文件关闭先于同名新文件写入
+     * @param file 文件路径
+     */
+    size_t allocThread(const std::string &file);
+
+    /**
+     * 提交写任务，不会阻塞调用线程
+     * 队列上限由调用者通过overloaded()按帧控制，已经生成的数据总是入队，保证文件完整
+     * @param index io线程索引
+     * @param bytes 本次写入的数据量
+     * @param task 写任务
+     */
+    void async(size_t index, size_t bytes, std::function<void()> task);
+
+    /**
+     * 队列中数据是否超过上限，超过时录制应该丢帧
+     */
+    bool overloaded() const;
+
+    /**
+     * 统计因队列满被丢弃的录制帧
+     */
+    void onDropFrame() { ++_dropped_frames; }
+
+    /**
+     * 获取队列深度与写耗时统计
+     */
+    Statistic getStatistic() const;
+
+    /**
+     * 获取写耗时直方图各档名称
+     */
+    static const char *getLatencyBucketName(size_t index);
+
+private:
+    MP4WriteThreadPool();
+    void run(size_t index);
+
+private:
+    struct Task {
+        size_t bytes;
+        std::function<void()> task;
+    };
+
+    struct Worker {
+        std::deque<Task> tasks;
+        std::condition_variable cond;
+    };
+
+    bool _exit = false;
+    size_t _max_queue_bytes = 0;
+    size_t _queue_depth = 0;
+    std::atomic<size_t> _queue_bytes { 0 };
+    std::atomic<uint64_t> _dropped_frames { 0 };
+    std::atomic<uint64_t> _written_bytes { 0 };
+    std::array<std::atomic<uint64_t>, kLatencyBuckets> _latency_histogram;
+    mutable std::mutex _mtx;
+    std::vector<std::unique_ptr<Worker> > _workers;
+    std::vector<std::thread> _threads;
+};
+
+/**
+ * 异步写盘的mp4文件
+ * 写入的数据先合并成大块(开启O_DIRECT时为对齐的内存块)，再交给MP4WriteThreadPool用pwrite写盘
+ * seek与tell只修改逻辑偏移量；写mp4头(faststart时还需回读重写整个文件)与关闭文件都在io线程执行，
+ * 调用线程从不等待磁盘
+ */
+class MP4FileAsyncDisk : public MP4FileIO {
+public:
+    using Ptr = std::shared_ptr<MP4FileAsyncDisk>;
+
+    ~MP4FileAsyncDisk() override;
+
+    /**
+     * 打开磁盘文件，失败时抛异常
+     * @param file 文件路径
+     */
+    void openFile(const char *file);
+
+    /**
+     * 提交剩余数据并在io线程关闭文件，不等待
+     */
+    void closeFile();
+
+    /**
+     * 设置文件在io线程写完并关闭后的回调
+     */
+    void setOnClosed(std::function<void()> cb);
+
+    /**
+     * 创建mp4 writer，其销毁(写mp4头与faststart)在io线程执行
+     */
+    Writer createWriter(int flags, bool is_fmp4 = false) override;
+
+protected:
+    uint64_t onTell() override;
+    int onSeek(uint64_t offset) override;
+    int onRead(void *data, size_t bytes) override;
+    int onWrite(const void *data, size_t bytes) override;
+
+private:
+    void submit();
+    void submitBlock(int fd, int direct_fd);
+    void allocBlock();
+
+private:
+    struct State {
+        std::atomic<int> error { 0 };
+    };
+
+    // 是否在io线程同步读写(销毁mp4 writer时)
+    bool _io_thread = false;
+    int _fd = -1;
+    int _direct_fd = -1;
+    size_t _thread = 0;
+    size_t _block_size = 0;
+    size_t _block_used = 0;
+    uint64_t _offset = 0;
+    uint64_t _block_offset = 0;
+    std::shared_ptr<char> _block;
+    std::shared_ptr<State> _state;
+    std::function<void()> _on_closed;
+};
+
+} // namespace mediakit
+
+#endif // defined(ENABLE_MP4) && !defined(_WIN32)
+#endif // ZLMEDIAKIT_MP4ASYNCWRITER_H
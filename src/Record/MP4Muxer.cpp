@@ -11,6 +11,7 @@
 #if defined(ENABLE_MP4)
 
 #include "MP4Muxer.h"
+#include "MP4AsyncWriter.h"
 #include "Common/config.h"
 
 using namespace std;
@@ -25,8 +26,20 @@ MP4Muxer::~MP4Muxer() {
 void MP4Muxer::openMP4(const string &file) {
     closeMP4();
     _file_name = file;
-    _mp4_file = std::make_shared<MP4FileDisk>();
-    _mp4_file->openFile(_file_name.data(), "wb+");
+#if !defined(_WIN32)
+    if (MP4WriteThreadPool::Instance().enabled()) {
+        // 交给录制专用io线程写盘，防止磁盘缓慢时阻塞poller线程
+        auto mp4_file = std::make_shared<MP4FileAsyncDisk>();
+        mp4_file->openFile(_file_name.data());
+        _mp4_file = std::move(mp4_file);
+        _async_write = true;
+        return;
+    }
+#endif
+    _async_write = false;
+    auto mp4_file = std::make_shared<MP4FileDisk>();
+    mp4_file->openFile(_file_name.data(), "wb+");
+    _mp4_file = std::move(mp4_file);
 }
 
 MP4FileIO::Writer MP4Muxer::createWriter() {
@@ -35,9 +48,44 @@ MP4FileIO::Writer MP4Muxer::createWriter() {
     return _mp4_file->createWriter(mp4FastStart ? MOV_FLAG_FASTSTART : 0, recordEnableFmp4);
 }
 
-void MP4Muxer::closeMP4() {
+void MP4Muxer::closeMP4(const std::function<void()> &on_closed) {
+    auto cb = on_closed;
+#if !defined(_WIN32)
+    if (auto async_file = std::dynamic_pointer_cast<MP4FileAsyncDisk>(_mp4_file)) {
+        // 文件在io线程写完mp4头并关闭后回调
+        async_file->setOnClosed(std::move(cb));
+        cb = nullptr;
+    }
+#endif
     MP4MuxerInterface::resetTracks();
     _mp4_file = nullptr;
+    _drop_frame = false;
+    if (cb) {
+        cb();
+    }
+}
+
+bool MP4Muxer::inputFrame(const Frame::Ptr &frame) {
+#if !defined(_WIN32)
+    if (_async_write) {
+        auto &pool = MP4WriteThreadPool::Instance();
+        auto overloaded = pool.overloaded();
+        if (overloaded || _drop_frame) {
+            // 磁盘跟不上时按帧丢弃而不是放弃整个文件；有视频时一直丢到下一个关键帧，保证文件仍然可以解码
+            auto resume = !haveVideo() || frame->configFrame() || (frame->getTrackType() == TrackVideo && frame->keyFrame());
+            if (overloaded || !resume) {
+                if (!_drop_frame) {
+                    WarnL << "MP4 write queue is full, drop frames: " << _file_name;
+                }
+                _drop_frame = true;
+                pool.onDropFrame();
+                return false;
+            }
+            _drop_frame = false;
+        }
+    }
+#endif
+    return MP4MuxerInterface::inputFrame(frame);
 }
 
 void MP4Muxer::resetTracks() {
@@ -104,15 +104,25 @@ public:
 
     /**
      * 手动关闭文件(对象析构时会自动关闭)
+     * @param on_closed 文件写完并关闭后的回调，异步写盘时在录制io线程触发，否则在本函数内触发
      */
-    void closeMP4();
+    void closeMP4(const std::function<void()> &on_closed = nullptr);
+
+    /**
+     * 输入帧，异步写盘队列满时按帧丢弃
+     */
+    bool inputFrame(const Frame::Ptr &frame) override;
 
 protected:
     MP4FileIO::Writer createWriter() override;
 
 private:
+    // 是否异步写盘
+    bool _async_write = false;
+    // 是否正在因写盘队列满而丢帧
+    bool _drop_frame = false;
     std::string _file_name;
-    MP4FileDisk::Ptr _mp4_file;
+    MP4FileIO::Ptr _mp4_file;
 };
 
 class MP4MuxerMemory : public MP4MuxerInterface{
@@ -79,22 +79,26 @@ void MP4Recorder::asyncClose() {
         info.time_len = muxer->getDuration() / 1000.0f;
         // 关闭mp4可能非常耗时，所以要放在后台线程执行
         TraceL << "Closing tmp mp4 file: " << full_path_tmp;
-        muxer->closeMP4();
-        TraceL << "Closed tmp mp4 file: " << full_path_tmp;
-        if (!full_path_tmp.empty()) {
-            // 获取文件大小
-            info.file_size = File::fileSize(full_path_tmp);
-            if (info.file_size < 1024) {
-                // 录像文件太小，删除之
-                File::delete_file(full_path_tmp);
-                return;
-            }
-            // 临时文件名改成正式文件名，防止mp4未完成时被访问
-            rename(full_path_tmp.data(), full_path.data());
-        }
-        TraceL << "Emit mp4 record event: " << full_path;
-        //触发mp4录制切片生成事件
-        NOTICE_EMIT(BroadcastRecordMP4Args, Broadcast::kBroadcastRecordMP4, info);
+        // 异步写盘时文件在录制io线程写完并关闭后才回调，再切回后台线程处理，不占用io线程
+        muxer->closeMP4([full_path_tmp, full_path, info]() {
+            WorkThreadPool::Instance().getExecutor()->async([full_path_tmp, full_path, info]() mutable {
+                TraceL << "Closed tmp mp4 file: " << full_path_tmp;
+                if (!full_path_tmp.empty()) {
+                    // 获取文件大小
+                    info.file_size = File::fileSize(full_path_tmp);
+                    if (info.file_size < 1024) {
+                        // 录像文件太小，删除之
+                        File::delete_file(full_path_tmp);
+                        return;
+                    }
+                    // 临时文件名改成正式文件名，防止mp4未完成时被访问
+                    rename(full_path_tmp.data(), full_path.data());
+                }
+                TraceL << "Emit mp4 record event: " << full_path;
+                //触发mp4录制切片生成事件
+                NOTICE_EMIT(BroadcastRecordMP4Args, Broadcast::kBroadcastRecordMP4, info);
+            });
+        });
     });
 }
 
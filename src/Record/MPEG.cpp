@@ -9,17 +9,94 @@
  */
 
 #include <assert.h>
+#include <algorithm>
+#include <vector>
 #include "MPEG.h"
 
 #if defined(ENABLE_HLS) || defined(ENABLE_RTPPROXY)
 
 #include "mpeg-ts.h"
 #include "mpeg-muxer.h"
+#include "Common/config.h"
 
 using namespace toolkit;
 
 namespace mediakit {
 
+static constexpr size_t kTSPacketSize = 188;
+static constexpr size_t kTSPayloadSize = kTSPacketSize - 4;
+static constexpr uint16_t kPMTPid = 0x1000;
+static constexpr uint16_t kFirstPid = 0x100;
+// PAT/PMT最长发送间隔(400ms)，与mpeg_ts_write保持一致
+static constexpr int64_t kPSIPeriod = 400 * 90;
+
+static bool isFastCodec(CodecId codec) {
+    switch (codec) {
+        case CodecH264:
+        case CodecH265:
+        case CodecAAC:
+        case CodecG711A:
+        case CodecG711U: return true;
+        default: return false;
+    }
+}
+
+static uint32_t mpegCrc32(const uint8_t *data, size_t len) {
+    static auto s_table = []() {
+        std::vector<uint32_t> table(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i << 24;
+            for (int j = 0; j < 8; ++j) {
+                crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+            }
+            table[i] = crc;
+        }
+        return table;
+    }();
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; ++i) {
+        crc = (crc << 8) ^ s_table[((crc >> 24) ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+
+static void writeSection(uint8_t *packet, uint16_t pid, const uint8_t *section, size_t len) {
+    packet[0] = 0x47;
+    packet[1] = 0x40 | ((pid >> 8) & 0x1F);
+    packet[2] = pid & 0xFF;
+    packet[3] = 0x10;
+    // pointer_field
+    packet[4] = 0;
+    memcpy(packet + 5, section, len);
+    auto crc = mpegCrc32(section, len);
+    packet[5 + len] = crc >> 24;
+    packet[6 + len] = (crc >> 16) & 0xFF;
+    packet[7 + len] = (crc >> 8) & 0xFF;
+    packet[8 + len] = crc & 0xFF;
+}
+
+static void writePESTimestamp(uint8_t *ptr, uint8_t prefix, int64_t ts) {
+    ptr[0] = (prefix << 4) | (((ts >> 30) & 0x07) << 1) | 0x01;
+    ptr[1] = (ts >> 22) & 0xFF;
+    ptr[2] = ((ts >> 14) & 0xFE) | 0x01;
+    ptr[3] = (ts >> 7) & 0xFF;
+    ptr[4] = ((ts << 1) & 0xFE) | 0x01;
+}
+
+// 视频帧是否以AUD开头，没有的话需要与mpeg_ts_write一样插入AUD
+static bool startWithAUD(CodecId codec, const char *data, size_t size) {
+    auto ptr = (const uint8_t *)data;
+    size_t pos;
+    if (size > 4 && !ptr[0] && !ptr[1] && ptr[2] == 1) {
+        pos = 3;
+    } else if (size > 5 && !ptr[0] && !ptr[1] && !ptr[2] && ptr[3] == 1) {
+        pos = 4;
+    } else {
+        return false;
+    }
+    return codec == CodecH264 ? (ptr[pos] & 0x1F) == 9 : ((ptr[pos] >> 1) & 0x3F) == 35;
+}
+
 MpegMuxer::MpegMuxer(bool is_ps) {
     _is_ps = is_ps;
     createContext();
@@ -40,7 +117,17 @@ bool MpegMuxer::addTrack(const Track::Ptr &track) {
     if (track->getTrackType() == TrackVideo) {
         _have_video = true;
     }
-    _tracks[track->getIndex()].track_id = mpeg_muxer_add_stream((::mpeg_muxer_t *)_context, mpeg_id, nullptr, 0);
+    auto &ref = _tracks[track->getIndex()];
+    ref.track_id = mpeg_muxer_add_stream((::mpeg_muxer_t *)_context, mpeg_id, nullptr, 0);
+    ref.codec = track->getCodecId();
+    ref.pid = kFirstPid + _tracks.size() - 1;
+    ref.stream_type = mpeg_id;
+    ref.stream_id = track->getTrackType() == TrackVideo ? 0xE0 : 0xC0;
+    if (!isFastCodec(ref.codec)) {
+        _fast = false;
+    }
+    // 轨道变化，重新生成PAT/PMT
+    _psi.clear();
     return true;
 }
 
@@ -60,8 +147,7 @@ bool MpegMuxer::inputFrame(const Frame::Ptr &frame) {
                 // 取视频时间戳为TS的时间戳
                 _timestamp = dts;
                 _max_cache_size = 512 + 1.2 * buffer->size();
-                mpeg_muxer_input((::mpeg_muxer_t *)_context, track.track_id, have_idr ? 0x0001 : 0, pts * 90LL, dts * 90LL, buffer->data(), buffer->size());
-                flushCache();
+                input_l(track, have_idr, pts, dts, buffer->data(), buffer->size());
             });
         }
 
@@ -80,13 +166,197 @@ bool MpegMuxer::inputFrame(const Frame::Ptr &frame) {
                 _timestamp = frame->dts();
             }
             _max_cache_size = 512 + 1.2 * frame->size();
-            mpeg_muxer_input((::mpeg_muxer_t *)_context, track.track_id, frame->keyFrame() ? 0x0001 : 0, frame->pts() * 90LL, frame->dts() * 90LL, frame->data(), frame->size());
-            flushCache();
+            input_l(track, frame->keyFrame(), frame->pts(), frame->dts(), frame->data(), frame->size());
             return true;
         }
     }
 }
 
+void MpegMuxer::input_l(MP4Track &track, bool key, uint64_t pts, uint64_t dts, const char *data, size_t size) {
+    if (_fast) {
+        inputFast(track, key, pts * 90LL, dts * 90LL, data, size);
+    } else {
+        mpeg_muxer_input((::mpeg_muxer_t *)_context, track.track_id, key ? 0x0001 : 0, pts * 90LL, dts * 90LL, data, size);
+    }
+    flushCache();
+}
+
+void MpegMuxer::makePSI() {
+    std::vector<const MP4Track *> tracks;
+    for (auto &pr : _tracks) {
+        tracks.emplace_back(&pr.second);
+    }
+    std::sort(tracks.begin(), tracks.end(), [](const MP4Track *a, const MP4Track *b) { return a->pid < b->pid; });
+    // 有视频时以视频为PCR，否则以第一个音频为PCR
+    _pcr_pid = tracks.empty() ? 0x1FFF : tracks[0]->pid;
+    for (auto track : tracks) {
+        if (track->stream_id == 0xE0) {
+            _pcr_pid = track->pid;
+            break;
+        }
+    }
+
+    _psi.assign(kTSPacketSize * 2, (char)0xFF);
+    uint8_t section[kTSPayloadSize];
+
+    // PAT，只有一个节目
+    section[0] = 0x00;
+    section[1] = 0xB0;
+    section[2] = 13;
+    section[3] = 0x00;
+    section[4] = 0x01;
+    section[5] = 0xC1;
+    section[6] = 0x00;
+    section[7] = 0x00;
+    section[8] = 0x00;
+    section[9] = 0x01;
+    section[10] = 0xE0 | (kPMTPid >> 8);
+    section[11] = kPMTPid & 0xFF;
+    writeSection((uint8_t *)&_psi[0], 0, section, 12);
+
+    // PMT
+    size_t section_len = 9 + 5 * tracks.size() + 4;
+    section[0] = 0x02;
+    section[1] = 0xB0 | ((section_len >> 8) & 0x0F);
+    section[2] = section_len & 0xFF;
+    section[3] = 0x00;
+    section[4] = 0x01;
+    section[5] = 0xC1;
+    section[6] = 0x00;
+    section[7] = 0x00;
+    section[8] = 0xE0 | (_pcr_pid >> 8);
+    section[9] = _pcr_pid & 0xFF;
+    section[10] = 0xF0;
+    section[11] = 0x00;
+    auto ptr = section + 12;
+    for (auto track : tracks) {
+        ptr[0] = track->stream_type;
+        ptr[1] = 0xE0 | (track->pid >> 8);
+        ptr[2] = track->pid & 0xFF;
+        ptr[3] = 0xF0;
+        ptr[4] = 0x00;
+        ptr += 5;
+    }
+    writeSection((uint8_t *)&_psi[kTSPacketSize], kPMTPid, section, ptr - section);
+}
+
+void MpegMuxer::inputFast(MP4Track &track, bool key, int64_t pts, int64_t dts, const char *data, size_t size) {
+    if (_psi.empty()) {
+        makePSI();
+    }
+    bool is_video = track.stream_id == 0xE0;
+    // 与mpeg_ts_write一致，第一帧、视频关键帧前以及每隔400ms插入PAT/PMT
+    bool write_psi = !_psi_written || (is_video && key) || dts < _psi_dts || dts - _psi_dts >= kPSIPeriod;
+
+    const char *aud = nullptr;
+    size_t aud_size = 0;
+    if (is_video && !startWithAUD(track.codec, data, size)) {
+        aud = track.codec == CodecH264 ? "\x00\x00\x00\x01\x09\xF0" : "\x00\x00\x00\x01\x46\x01\x50";
+        aud_size = track.codec == CodecH264 ? 6 : 7;
+    }
+
+    // pes头，pts与dts相同时只写pts
+    uint8_t pes[19];
+    bool with_dts = pts != dts;
+    size_t pes_size = with_dts ? 19 : 14;
+    size_t pes_len = pes_size - 6 + aud_size + size;
+    pes[0] = 0x00;
+    pes[1] = 0x00;
+    pes[2] = 0x01;
+    pes[3] = track.stream_id;
+    // 视频帧超过65535字节时PES_packet_length置0
+    pes[4] = pes_len > 0xFFFF ? 0 : (pes_len >> 8);
+    pes[5] = pes_len > 0xFFFF ? 0 : (pes_len & 0xFF);
+    pes[6] = 0x80;
+    pes[7] = with_dts ? 0xC0 : 0x80;
+    pes[8] = pes_size - 9;
+    writePESTimestamp(pes + 9, with_dts ? 0x03 : 0x02, pts);
+    if (with_dts) {
+        writePESTimestamp(pes + 14, 0x01, dts);
+    }
+
+    // 第一个ts包的adaptation field：PCR与random_access_indicator
+    bool pcr = track.pid == _pcr_pid;
+    bool random_access = is_video && key;
+    size_t first_af = pcr ? 8 : (random_access ? 2 : 0);
+    size_t payload = pes_size + aud_size + size;
+    size_t first_payload = kTSPayloadSize - first_af;
+    size_t count = 1 + (payload > first_payload ? (payload - first_payload + kTSPayloadSize - 1) / kTSPayloadSize : 0);
+    size_t psi_size = write_psi ? _psi.size() : 0;
+    size_t total = psi_size + count * kTSPacketSize;
+
+    // 整帧的ts包一次性写入连续缓存，不经过mpeg_muxer的alloc/write回调
+    _current_buffer = _buffer_pool.obtain2();
+    _current_buffer->setCapacity(total);
+    _current_buffer->setSize(total);
+    auto out = (uint8_t *)_current_buffer->data();
+    if (write_psi) {
+        memcpy(out, _psi.data(), psi_size);
+        out[3] = 0x10 | (_pat_cc++ & 0x0F);
+        out[kTSPacketSize + 3] = 0x10 | (_pmt_cc++ & 0x0F);
+        out += psi_size;
+        _psi_written = true;
+        _psi_dts = dts;
+    }
+
+    const uint8_t *src[3] = { pes, (const uint8_t *)aud, (const uint8_t *)data };
+    size_t src_len[3] = { pes_size, aud_size, size };
+    size_t src_index = 0;
+    auto copy = [&](uint8_t *dst, size_t len) {
+        while (len) {
+            if (!src_len[src_index]) {
+                ++src_index;
+                continue;
+            }
+            auto n = MIN(len, src_len[src_index]);
+            memcpy(dst, src[src_index], n);
+            dst += n;
+            src[src_index] += n;
+            src_len[src_index] -= n;
+            len -= n;
+        }
+    };
+
+    for (size_t i = 0; i < count; ++i, out += kTSPacketSize) {
+        bool start = i == 0;
+        size_t af = start ? first_af : 0;
+        size_t n = MIN(payload, kTSPayloadSize - af);
+        // 最后一个ts包负载不足时，通过adaptation field填充
+        af = kTSPayloadSize - n;
+        out[0] = 0x47;
+        out[1] = (start ? 0x40 : 0x00) | ((track.pid >> 8) & 0x1F);
+        out[2] = track.pid & 0xFF;
+        out[3] = (af ? 0x30 : 0x10) | (track.cc++ & 0x0F);
+        auto ptr = out + 4;
+        if (af) {
+            ptr[0] = af - 1;
+            if (af > 1) {
+                size_t pos = 2;
+                ptr[1] = 0x00;
+                if (start && random_access) {
+                    ptr[1] |= 0x40;
+                }
+                if (start && pcr) {
+                    // 以dts为PCR，program_clock_reference_extension为0
+                    auto base = dts & 0x1FFFFFFFFLL;
+                    ptr[1] |= 0x10;
+                    ptr[2] = (base >> 25) & 0xFF;
+                    ptr[3] = (base >> 17) & 0xFF;
+                    ptr[4] = (base >> 9) & 0xFF;
+                    ptr[5] = (base >> 1) & 0xFF;
+                    ptr[6] = ((base & 0x01) << 7) | 0x7E;
+                    ptr[7] = 0x00;
+                    pos = 8;
+                }
+                memset(ptr + pos, 0xFF, af - pos);
+            }
+            ptr += af;
+        }
+        copy(ptr, n);
+        payload -= n;
+    }
+}
+
 void MpegMuxer::resetTracks() {
     _have_video = false;
     //通知片段中断
@@ -96,6 +366,11 @@ void MpegMuxer::resetTracks() {
 }
 
 void MpegMuxer::createContext() {
+    GET_CONFIG(bool, fast_mux, General::kTsFastMux);
+    _fast = !_is_ps && fast_mux;
+    _psi_written = false;
+    _psi.clear();
+
     static mpeg_muxer_func_t func = {
             /*alloc*/
             [](void *param, size_t bytes) {
@@ -15,6 +15,7 @@
 
 #include <cstdio>
 #include <cstdint>
+#include <string>
 #include <unordered_map>
 #include "Extension/Frame.h"
 #include "Extension/Track.h"
@@ -58,13 +59,32 @@ protected:
     virtual void onWrite(std::shared_ptr<toolkit::Buffer> buffer, uint64_t timestamp, bool key_pos) = 0;
 
 private:
+    struct MP4Track;
+
     void createContext();
     void releaseContext();
     void onWrite_l(const void *packet, size_t bytes);
     void flushCache();
+    void input_l(MP4Track &track, bool key, uint64_t pts, uint64_t dts, const char *data, size_t size);
+
+    /**
+     * 快速生成H264/H265 + AAC/G711的ts流，不经过mpeg_muxer
+     * PAT/PMT预先生成，pes头与ts头直接写入按整数个ts包大小申请的缓存，负载只拷贝一次
+     */
+    void inputFast(MP4Track &track, bool key, int64_t pts, int64_t dts, const char *data, size_t size);
+    void makePSI();
 
 private:
     bool _is_ps = false;
+    // 是否使用快速ts复用，遇到不支持的编码格式后切换为mpeg_muxer
+    bool _fast = false;
+    bool _psi_written = false;
+    uint8_t _pat_cc = 0;
+    uint8_t _pmt_cc = 0;
+    uint16_t _pcr_pid = 0;
+    int64_t _psi_dts = 0;
+    // 预先生成的PAT、PMT两个ts包，输出时只修改continuity_counter
+    std::string _psi;
     bool _have_video = false;
     bool _key_pos = false;
     uint32_t _max_cache_size = 0;
@@ -79,6 +99,12 @@ private:
     struct MP4Track {
         int track_id = -1;
         FrameMergerImp merger;
+        // 以下为快速ts复用所用
+        CodecId codec = CodecInvalid;
+        uint16_t pid = 0;
+        uint8_t stream_type = 0;
+        uint8_t stream_id = 0;
+        uint8_t cc = 0;
     };
     std::unordered_map<int, MP4Track> _tracks;
     toolkit::BufferRaw::Ptr _current_buffer;
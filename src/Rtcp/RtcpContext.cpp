@@ -10,6 +10,7 @@
 
 #include "RtcpContext.h"
 #include "Util/logger.h"
+#include "Common/Metrics.h"
 using namespace toolkit;
 
 namespace mediakit {
@@ -235,6 +236,10 @@ size_t RtcpContextForRecv::getLostInterval() {
     auto lost = getLost();
     auto ret = lost - _last_lost;
     _last_lost = lost;
+    if ((ssize_t)ret > 0) {
+        // 重复包可能导致丢包数变小，此时不统计
+        Metrics::add(Metrics::kRtpPacketLost, ret);
+    }
     return ret;
 }
 
@@ -11,6 +11,7 @@
 #include "FlvMuxer.h"
 #include "Util/File.h"
 #include "Rtmp/utils.h"
+#include "Common/StreamProfiler.h"
 #include "Http/HttpSession.h"
 
 #define FILE_BUF_SIZE (64 * 1024)
@@ -24,17 +25,17 @@ FlvMuxer::FlvMuxer(){
     _packet_pool.setSize(64);
 }
 
-void FlvMuxer::start(const EventPoller::Ptr &poller, const RtmpMediaSource::Ptr &media, uint32_t start_pts) {
+void FlvMuxer::start(const EventPoller::Ptr &poller, const RtmpMediaSource::Ptr &media, uint32_t start_pts, bool websocket) {
     if (!media) {
         throw std::runtime_error("RtmpMediaSource 无效");
     }
     if (!poller->isCurrentThread()) {
         weak_ptr<FlvMuxer> weak_self = getSharedPtr();
         //延时两秒启动录制，目的是为了等待config帧收集完毕
-        poller->doDelayTask(2000, [weak_self, poller, media, start_pts]() {
+        poller->doDelayTask(2000, [weak_self, poller, media, start_pts, websocket]() {
             auto strong_self = weak_self.lock();
             if (strong_self) {
-                strong_self->start(poller, media, start_pts);
+                strong_self->start(poller, media, start_pts, websocket);
             }
             return 0;
         });
@@ -45,6 +46,9 @@ void FlvMuxer::start(const EventPoller::Ptr &poller, const RtmpMediaSource::Ptr
 
     std::weak_ptr<FlvMuxer> weak_self = getSharedPtr();
     media->pause(false);
+    _websocket = websocket;
+    _media_src = media;
+    _shared_reader_ref = media->addSharedReader(websocket ? RtmpMediaSource::kSharedWsFlv : RtmpMediaSource::kSharedFlv);
     _ring_reader = media->getRing()->attach(poller);
     _ring_reader->setGetInfoCB([weak_self]() {
         Any ret;
@@ -60,26 +64,52 @@ void FlvMuxer::start(const EventPoller::Ptr &poller, const RtmpMediaSource::Ptr
     });
 
     bool check = start_pts > 0;
-    _ring_reader->setReadCB([weak_self, start_pts, check](const RtmpMediaSource::RingDataType &pkt) mutable {
+    auto profiler = StreamProfiler::get(*media);
+    _ring_reader->setReadCB([weak_self, start_pts, check, profiler](const RtmpMediaSource::RingDataType &pkt) mutable {
         auto strong_self = weak_self.lock();
         if (!strong_self) {
             return;
         }
 
-        size_t i = 0;
-        auto size = pkt->size();
-        pkt->for_each([&](const RtmpPacket::Ptr &rtmp) {
-            if (check) {
-                if (rtmp->time_stamp < start_pts) {
-                    return;
+        if (check) {
+            // 还未到达起始时间戳，逐个过滤rtmp包
+            size_t i = 0;
+            auto size = pkt->size();
+            pkt->for_each([&](const RtmpPacket::Ptr &rtmp) {
+                if (check) {
+                    if (rtmp->time_stamp < start_pts) {
+                        ++i;
+                        return;
+                    }
+                    check = false;
                 }
-                check = false;
-            }
-            strong_self->onWriteRtmp(rtmp, ++i == size);
-        });
+                if (profiler) {
+                    profiler->addBytesOut(rtmp->size());
+                }
+                strong_self->onWriteRtmp(rtmp, ++i == size);
+            });
+            return;
+        }
+
+        if (profiler) {
+            size_t bytes = 0;
+            pkt->for_each([&](const RtmpPacket::Ptr &rtmp) { bytes += rtmp->size(); });
+            profiler->addBytesOut(bytes);
+        }
+        // flv tag不随播放器变化，所有播放器共享同一份序列化后的数据
+        strong_self->onWriteFlvTags(pkt);
     });
 }
 
+void FlvMuxer::onWriteFlvTags(const RtmpMediaSource::RingDataType &pkts) {
+    onWrite(getFlvTagBuffer(pkts), true);
+}
+
+Buffer::Ptr FlvMuxer::getFlvTagBuffer(const RtmpMediaSource::RingDataType &pkts) {
+    auto src = _media_src.lock();
+    return src ? src->getFlvTagBuffer(pkts, _websocket) : pkts->getFlvTagBuffer(_websocket);
+}
+
 BufferRaw::Ptr FlvMuxer::obtainBuffer() {
     return _packet_pool.obtain2();
 }
@@ -153,6 +183,7 @@ void FlvMuxer::onWriteRtmp(const RtmpPacket::Ptr &pkt, bool flush) {
 void FlvMuxer::stop() {
     if (_ring_reader) {
         _ring_reader.reset();
+        _shared_reader_ref = nullptr;
         onDetach();
     }
 }
@@ -26,8 +26,22 @@ public:
     void stop();
 
 protected:
-    void start(const toolkit::EventPoller::Ptr &poller, const RtmpMediaSource::Ptr &media, uint32_t start_pts = 0);
+    /**
+     * 开始输出flv
+     * @param websocket 是否以ws-flv方式输出，决定共享的flv tag缓存是否携带websocket帧头
+     */
+    void start(const toolkit::EventPoller::Ptr &poller, const RtmpMediaSource::Ptr &media, uint32_t start_pts = 0, bool websocket = false);
     virtual void onWrite(const toolkit::Buffer::Ptr &data, bool flush) = 0;
+
+    /**
+     * 输出一组rtmp包对应的flv tag，默认通过onWrite输出媒体源共享的flv tag缓存
+     */
+    virtual void onWriteFlvTags(const RtmpMediaSource::RingDataType &pkts);
+
+    /**
+     * 获取一组rtmp包对应的媒体源共享flv tag缓存
+     */
+    toolkit::Buffer::Ptr getFlvTagBuffer(const RtmpMediaSource::RingDataType &pkts);
     virtual void onDetach() = 0;
     virtual std::shared_ptr<FlvMuxer> getSharedPtr() = 0;
 
@@ -41,6 +55,10 @@ private:
 
 private:
     toolkit::ResourcePool<toolkit::BufferRaw> _packet_pool;
+    bool _websocket = false;
+    std::weak_ptr<RtmpMediaSource> _media_src;
+    // 共享flv tag缓存的播放器登记，析构时注销
+    std::shared_ptr<void> _shared_reader_ref;
     RtmpMediaSource::RingType::RingReader::Ptr _ring_reader;
 };
 
@@ -132,17 +132,10 @@ void Metadata::addTrack(AMFValue &metadata, const Track::Ptr &track) {
 }
 
 RtmpPacket::Ptr RtmpPacket::create() {
-#if 0
-    static ResourcePool<RtmpPacket> packet_pool;
-    static onceToken token([]() {
-        packet_pool.setSize(1024);
-    });
-    auto ret = packet_pool.obtain2();
+    // rtmp包在释放线程回收复用，保留其内存；视频关键帧等大包不回收，防止线程回收池占用过多内存
+    auto ret = RecyclePool<RtmpPacket>::obtain([](RtmpPacket *pkt) { return pkt->buffer.capacity() <= FrameImp::kMaxRecycleSize; });
     ret->clear();
     return ret;
-#else
-    return Ptr(new RtmpPacket);
-#endif
 }
 
 void RtmpPacket::clear() {
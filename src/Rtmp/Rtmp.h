@@ -17,6 +17,7 @@
 #include "amf.h"
 #include "Network/Buffer.h"
 #include "Extension/Track.h"
+#include "Common/ObjectPool.h"
 
 #define DEFAULT_CHUNK_LEN	128
 #define HANDSHAKE_PLAINTEXT	0x03
@@ -200,6 +201,8 @@ public:
 
 private:
     friend class toolkit::ResourcePool_l<RtmpPacket>;
+    template <typename C, size_t kMaxCount>
+    friend class RecyclePool;
     RtmpPacket(){
         clear();
     }
@@ -15,6 +15,8 @@
 #include <memory>
 #include <string>
 #include <functional>
+#include <deque>
+#include <vector>
 #include <unordered_map>
 #include "amf.h"
 #include "Rtmp.h"
@@ -22,10 +24,53 @@
 #include "Common/PacketCache.h"
 #include "Util/RingBuffer.h"
 
+// rtmp环形缓冲(gop缓存)最大长度
+// 注意：除原始rtmp包外，gop缓存中的每组rtmp包还会挂载各类播放器共享的序列化数据(rtmp chunk流、flv tag、ws-flv帧)，
+// 每种类型的播放器存在时各多占用约一份gop缓存大小的内存，该类型播放器全部离开后释放
 #define RTMP_GOP_SIZE 512
 
 namespace mediakit {
 
+/**
+ * 合并写后的一组rtmp包
+ * 该对象由RtmpMediaSource生成后在环形缓冲中被所有播放器共享，
+ * rtmp播放器可以直接发送按其chunk size分块好的chunk流，而不必每个播放器每个rtmp包都重新分块
+ */
+class RtmpPacketList : public toolkit::List<RtmpPacket::Ptr> {
+public:
+    using Ptr = std::shared_ptr<RtmpPacketList>;
+
+    /**
+     * 获取本组rtmp包按chunk size分块后的连续内存(chunk id、stream index、时间戳都取自rtmp包本身)
+     * 每种chunk size只在第一次被访问时生成，之后所有播放器(不分线程)共享同一份数据
+     * @param created 返回本次调用是否新生成了数据
+     */
+    toolkit::Buffer::Ptr getChunkBuffer(size_t chunk_size, bool *created = nullptr) const;
+
+    /**
+     * 获取本组rtmp包序列化为flv tag(包含PreviousTagSize)后的连续内存，供http-flv/ws-flv播放器共享
+     * @param websocket 是否在头部加上websocket二进制帧头，服务器下发的帧不加掩码，所以ws-flv播放器之间也可以共享
+     * @param created 返回本次调用是否新生成了数据
+     */
+    toolkit::Buffer::Ptr getFlvTagBuffer(bool websocket, bool *created = nullptr) const;
+
+    /**
+     * 释放已生成的chunk流
+     */
+    void releaseChunkBuffers() const;
+
+    /**
+     * 释放已生成的flv tag数据
+     */
+    void releaseFlvTagBuffer(bool websocket) const;
+
+private:
+    mutable std::mutex _mtx;
+    mutable toolkit::Buffer::Ptr _flv_buffers[2];
+    // 一般所有播放器的chunk size都相同，所以通常只有一份
+    mutable std::vector<std::pair<size_t, toolkit::Buffer::Ptr> > _chunk_buffers;
+};
+
 /**
  * rtmp媒体源的数据抽象
  * rtmp有关键的三要素，分别是metadata、config帧，普通帧
@@ -33,10 +78,10 @@ namespace mediakit {
  * 只要生成了这三要素，那么要实现rtmp推流、rtmp服务器就很简单了
  * rtmp推拉流协议中，先传递metadata，然后传递config帧，然后一直传递普通帧
  */
-class RtmpMediaSource : public MediaSource, public toolkit::RingDelegate<RtmpPacket::Ptr>, private PacketCache<RtmpPacket>{
+class RtmpMediaSource : public MediaSource, public toolkit::RingDelegate<RtmpPacket::Ptr>, private PacketCache<RtmpPacket, FlushPolicy, RtmpPacketList>{
 public:
     using Ptr = std::shared_ptr<RtmpMediaSource>;
-    using RingDataType = std::shared_ptr<toolkit::List<RtmpPacket::Ptr> >;
+    using RingDataType = RtmpPacketList::Ptr;
     using RingType = toolkit::RingBuffer<RingDataType>;
 
     /**
@@ -76,6 +121,32 @@ public:
         return _ring ? _ring->readerCount() : 0;
     }
 
+    /**
+     * 播放器共享的序列化数据类型
+     */
+    enum SharedBufferType {
+        kSharedChunk = 0, // rtmp chunk流
+        kSharedFlv, // http-flv tag
+        kSharedWsFlv, // ws-flv帧
+        kSharedMax
+    };
+
+    /**
+     * 登记一个使用某类共享序列化数据的播放器，返回值析构时注销
+     * 该类播放器全部注销后释放gop缓存中已生成的该类数据，避免没有播放器时gop缓存仍然占用多份内存
+     */
+    std::shared_ptr<void> addSharedReader(SharedBufferType type);
+
+    /**
+     * 获取一组rtmp包的共享chunk流，并记录下来以便没有rtmp播放器时释放
+     */
+    toolkit::Buffer::Ptr getChunkBuffer(const RingDataType &pkt, size_t chunk_size);
+
+    /**
+     * 获取一组rtmp包的共享flv tag数据，并记录下来以便没有http-flv/ws-flv播放器时释放
+     */
+    toolkit::Buffer::Ptr getFlvTagBuffer(const RingDataType &pkt, bool websocket);
+
     /**
      * 获取metadata
      */
@@ -115,7 +186,7 @@ public:
     uint32_t getTimeStamp(TrackType trackType) override;
 
     void clearCache() override{
-        PacketCache<RtmpPacket>::clearCache();
+        PacketCache<RtmpPacket, FlushPolicy, RtmpPacketList>::clearCache();
         _ring->clearCache();
     }
 
@@ -133,16 +204,24 @@ private:
     * @param rtmp_list rtmp包列表
     * @param key_pos 是否包含关键帧
     */
-    void onFlush(std::shared_ptr<toolkit::List<RtmpPacket::Ptr> > rtmp_list, bool key_pos) override {
+    void onFlush(RtmpPacketList::Ptr rtmp_list, bool key_pos) override {
         //如果不存在视频，那么就没有存在GOP缓存的意义，所以is_key一直为true确保一直清空GOP缓存
         _ring->write(std::move(rtmp_list), _have_video ? key_pos : true);
     }
 
+    void addSharedList(SharedBufferType type, const RingDataType &pkt);
+    void releaseSharedBuffers(SharedBufferType type);
+
 private:
-    bool _have_video = false;
-    bool _have_audio = false;
+    // 并行复用时在复用线程写入，在其他线程读取
+    std::atomic<bool> _have_video { false };
+    std::atomic<bool> _have_audio { false };
     int _ring_size;
-    uint32_t _track_stamps[TrackMax] = {0};
+    std::atomic<uint32_t> _track_stamps[TrackMax] {};
+    std::atomic<int> _shared_readers[kSharedMax] {};
+    std::mutex _shared_lists_mtx;
+    // 已经生成共享数据的rtmp包组，rtmp包组被环形缓冲释放后自动失效
+    std::deque<std::weak_ptr<RtmpPacketList>> _shared_lists[kSharedMax];
     AMFValue _metadata;
     RingType::Ptr _ring;
 
@@ -1,8 +1,143 @@
 ﻿#include "RtmpDemuxer.h"
 #include "RtmpMediaSourceImp.h"
+#include "RtmpProtocol.h"
+#include "Rtmp/utils.h"
+#include "Http/WebSocketSplitter.h"
+
+using namespace toolkit;
 
 namespace mediakit {
 
+Buffer::Ptr RtmpPacketList::getChunkBuffer(size_t chunk_size, bool *created) const {
+    std::lock_guard<std::mutex> lck(_mtx);
+    for (auto &pr : _chunk_buffers) {
+        if (pr.first == chunk_size) {
+            if (created) {
+                *created = false;
+            }
+            return pr.second;
+        }
+    }
+    if (created) {
+        *created = true;
+    }
+    size_t total = 0;
+    for_each([&](const RtmpPacket::Ptr &pkt) { total += RtmpProtocol::getChunkStreamSize(pkt->size(), pkt->time_stamp, chunk_size); });
+    auto buffer = ObjectPool::makeShared<BufferLikeString>();
+    buffer->reserve(total);
+    for_each([&](const RtmpPacket::Ptr &pkt) {
+        RtmpProtocol::packChunkStream(*buffer, pkt->type_id, pkt->stream_index, pkt->data(), pkt->size(), pkt->time_stamp, pkt->chunk_id, chunk_size);
+    });
+    _chunk_buffers.emplace_back(chunk_size, buffer);
+    return buffer;
+}
+
+Buffer::Ptr RtmpPacketList::getFlvTagBuffer(bool websocket, bool *created) const {
+    std::lock_guard<std::mutex> lck(_mtx);
+    auto &ret = _flv_buffers[websocket];
+    if (created) {
+        *created = !ret;
+    }
+    if (ret) {
+        return ret;
+    }
+    size_t flv_size = 0;
+    for_each([&](const RtmpPacket::Ptr &pkt) { flv_size += sizeof(RtmpTagHeader) + pkt->size() + 4; });
+    auto buffer = ObjectPool::makeShared<BufferLikeString>();
+    buffer->reserve(flv_size + 16);
+    if (websocket) {
+        WebSocketHeader header;
+        header._fin = true;
+        header._reserved = 0;
+        header._opcode = WebSocketHeader::BINARY;
+        header._mask_flag = false;
+        WebSocketSplitter::encodeHeader(header, flv_size, *buffer);
+    }
+    for_each([&](const RtmpPacket::Ptr &pkt) {
+        RtmpTagHeader header;
+        header.type = pkt->type_id;
+        set_be24(header.data_size, (uint32_t)pkt->size());
+        header.timestamp_ex = (pkt->time_stamp >> 24) & 0xff;
+        set_be24(header.timestamp, pkt->time_stamp & 0xFFFFFF);
+        buffer->append((char *)&header, sizeof(header));
+        buffer->append(pkt->data(), pkt->size());
+        // PreviousTagSize
+        uint32_t size = htonl((uint32_t)(pkt->size() + sizeof(header)));
+        buffer->append((char *)&size, 4);
+    });
+    ret = std::move(buffer);
+    return ret;
+}
+
+void RtmpPacketList::releaseChunkBuffers() const {
+    std::lock_guard<std::mutex> lck(_mtx);
+    _chunk_buffers.clear();
+}
+
+void RtmpPacketList::releaseFlvTagBuffer(bool websocket) const {
+    std::lock_guard<std::mutex> lck(_mtx);
+    _flv_buffers[websocket] = nullptr;
+}
+
+std::shared_ptr<void> RtmpMediaSource::addSharedReader(SharedBufferType type) {
+    ++_shared_readers[type];
+    std::weak_ptr<RtmpMediaSource> weak_self = std::static_pointer_cast<RtmpMediaSource>(shared_from_this());
+    return std::shared_ptr<void>(nullptr, [weak_self, type](void *) {
+        auto strong_self = weak_self.lock();
+        if (strong_self && --strong_self->_shared_readers[type] == 0) {
+            // 该类播放器全部离开，释放gop缓存中对应的序列化数据
+            strong_self->releaseSharedBuffers(type);
+        }
+    });
+}
+
+Buffer::Ptr RtmpMediaSource::getChunkBuffer(const RingDataType &pkt, size_t chunk_size) {
+    bool created = false;
+    auto ret = pkt->getChunkBuffer(chunk_size, &created);
+    if (created) {
+        addSharedList(kSharedChunk, pkt);
+    }
+    return ret;
+}
+
+Buffer::Ptr RtmpMediaSource::getFlvTagBuffer(const RingDataType &pkt, bool websocket) {
+    bool created = false;
+    auto ret = pkt->getFlvTagBuffer(websocket, &created);
+    if (created) {
+        addSharedList(websocket ? kSharedWsFlv : kSharedFlv, pkt);
+    }
+    return ret;
+}
+
+void RtmpMediaSource::addSharedList(SharedBufferType type, const RingDataType &pkt) {
+    std::lock_guard<std::mutex> lck(_shared_lists_mtx);
+    auto &lists = _shared_lists[type];
+    // rtmp包组基本按写入顺序被环形缓冲释放，从头部清理已失效的记录
+    while (!lists.empty() && lists.front().expired()) {
+        lists.pop_front();
+    }
+    lists.emplace_back(pkt);
+}
+
+void RtmpMediaSource::releaseSharedBuffers(SharedBufferType type) {
+    std::deque<std::weak_ptr<RtmpPacketList>> lists;
+    {
+        std::lock_guard<std::mutex> lck(_shared_lists_mtx);
+        lists.swap(_shared_lists[type]);
+    }
+    for (auto &weak_list : lists) {
+        auto list = weak_list.lock();
+        if (!list) {
+            continue;
+        }
+        if (type == kSharedChunk) {
+            list->releaseChunkBuffers();
+        } else {
+            list->releaseFlvTagBuffer(type == kSharedWsFlv);
+        }
+    }
+}
+
 uint32_t RtmpMediaSource::getTimeStamp(TrackType trackType) {
     assert(trackType >= TrackInvalid && trackType < TrackMax);
     if (trackType != TrackInvalid) {
@@ -82,7 +217,7 @@ void RtmpMediaSource::onWrite(RtmpPacket::Ptr pkt, bool /*= true*/) {
     }
     bool key = pkt->isVideoKeyFrame();
     auto stamp = pkt->time_stamp;
-    PacketCache<RtmpPacket>::inputPacket(stamp, is_video, std::move(pkt), key);
+    PacketCache<RtmpPacket, FlushPolicy, RtmpPacketList>::inputPacket(stamp, is_video, std::move(pkt), key);
 }
 
 RtmpMediaSourceImp::RtmpMediaSourceImp(const MediaTuple &tuple, int ringSize)
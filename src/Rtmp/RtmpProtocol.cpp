@@ -270,6 +270,62 @@ void RtmpProtocol::sendRtmp(uint8_t type, uint32_t stream_index, const Buffer::P
     }
 }
 
+size_t RtmpProtocol::getChunkStreamSize(size_t size, uint32_t stamp, size_t chunk_size) {
+    size_t ext_stamp = stamp >= 0xFFFFFF ? 4 : 0;
+    size_t chunks = (size + chunk_size - 1) / chunk_size;
+    // 首个chunk为完整rtmp头，后续chunk为1个字节的fmt3头，每个chunk都带扩展时间戳
+    return sizeof(RtmpHeader) + (chunks ? chunks - 1 : 0) + chunks * ext_stamp + size;
+}
+
+void RtmpProtocol::packChunkStream(BufferLikeString &out, uint8_t type, uint32_t stream_index, const char *data, size_t size,
+                                   uint32_t stamp, int chunk_id, size_t chunk_size) {
+    if (chunk_id < 2 || chunk_id > 63) {
+        auto strErr = StrPrinter << "不支持发送该类型的块流 ID:" << chunk_id << endl;
+        throw std::runtime_error(strErr);
+    }
+    //是否有扩展时间戳
+    bool ext_stamp = stamp >= 0xFFFFFF;
+    char ext_stamp_buf[4];
+    set_be32(ext_stamp_buf, stamp);
+
+    //rtmp头
+    RtmpHeader header;
+    header.fmt = 0;
+    header.chunk_id = chunk_id;
+    header.type_id = type;
+    set_be24(header.time_stamp, ext_stamp ? 0xFFFFFF : stamp);
+    set_be24(header.body_size, (uint32_t)size);
+    set_le32(header.stream_index, stream_index);
+    out.append((char *)&header, sizeof(header));
+
+    //一个字节的flag，标明是什么chunkId
+    RtmpHeader flags;
+    flags.fmt = 3;
+    flags.chunk_id = chunk_id;
+
+    size_t offset = 0;
+    while (offset < size) {
+        if (offset) {
+            out.append((char *)&flags, 1);
+        }
+        if (ext_stamp) {
+            out.append(ext_stamp_buf, 4);
+        }
+        size_t chunk = min(chunk_size, size - offset);
+        out.append(data + offset, chunk);
+        offset += chunk;
+    }
+}
+
+void RtmpProtocol::sendChunkStream(Buffer::Ptr buffer) {
+    _bytes_sent += buffer->size();
+    onSendRawData(std::move(buffer));
+    if (_windows_size > 0 && _bytes_sent - _bytes_sent_last >= _windows_size) {
+        _bytes_sent_last = _bytes_sent;
+        sendAcknowledgement(_bytes_sent);
+    }
+}
+
 void RtmpProtocol::onParseRtmp(const char *data, size_t size) {
     input(data, size);
 }
@@ -31,6 +31,18 @@ public:
     //作为客户端发送c0c1，等待s0s1s2并且回调
     void startClientSession(const std::function<void()> &cb, bool complex = true);
 
+    /**
+     * 计算rtmp消息分块后的chunk流大小
+     */
+    static size_t getChunkStreamSize(size_t size, uint32_t stamp, size_t chunk_size);
+
+    /**
+     * 把rtmp消息分块为chunk流(首个chunk采用fmt0头，后续chunk采用fmt3头)，追加至out尾部
+     * 分块结果只取决于参数，不依赖连接状态，所以可以被多个连接共享
+     */
+    static void packChunkStream(toolkit::BufferLikeString &out, uint8_t type, uint32_t stream_index, const char *data, size_t size,
+                                uint32_t stamp, int chunk_id, size_t chunk_size);
+
 protected:
     virtual void onSendRawData(toolkit::Buffer::Ptr buffer) = 0;
     virtual void onRtmpChunk(RtmpPacket::Ptr chunk_data) = 0;
@@ -62,6 +74,11 @@ protected:
     void sendRtmp(uint8_t type, uint32_t stream_index, const std::string &buffer, uint32_t stamp, int chunk_id);
     void sendRtmp(uint8_t type, uint32_t stream_index, const toolkit::Buffer::Ptr &buffer, uint32_t stamp, int chunk_id);
     toolkit::BufferRaw::Ptr obtainBuffer(const void *data = nullptr, size_t len = 0);
+    /**
+     * 发送已经按本连接chunk size分块好的chunk流(由packChunkStream生成)
+     */
+    void sendChunkStream(toolkit::Buffer::Ptr buffer);
+    size_t getChunkSizeOut() const { return _chunk_size_out; }
 
 private:
     void handle_C1_simple(const char *data);
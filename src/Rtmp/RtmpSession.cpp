@@ -10,6 +10,7 @@
 
 #include "RtmpSession.h"
 #include "Common/config.h"
+#include "Common/StreamProfiler.h"
 #include "Util/onceToken.h"
 
 using namespace std;
@@ -67,6 +68,7 @@ void RtmpSession::onManager() {
 void RtmpSession::onRecv(const Buffer::Ptr &buf) {
     _ticker.resetTime();
     _total_bytes += buf->size();
+    Metrics::addBytesIn(Metrics::kRtmp, buf->size());
     onParseRtmp(buf->data(), buf->size());
 }
 
@@ -263,6 +265,8 @@ void RtmpSession::sendPlayResponse(const string &err, const RtmpMediaSource::Ptr
         return;
     }
 
+    // 以下控制消息、metadata与config帧都很小，合并成一次flush
+    _batch_send = true;
     // onStatus(NetStream.Play.Start)
 
     sendStatus({ "level", "status",
@@ -300,29 +304,38 @@ void RtmpSession::sendPlayResponse(const string &err, const RtmpMediaSource::Ptr
     src->getConfigFrame([&](const RtmpPacket::Ptr &pkt) {
         onSendMedia(pkt);
     });
+    _batch_send = false;
+    _tcp_batch_sender.flush();
 
     src->pause(false);
     _ring_reader = src->getRing()->attach(getPoller());
+    _shared_reader_ref = src->addSharedReader(RtmpMediaSource::kSharedChunk);
     weak_ptr<RtmpSession> weak_self = static_pointer_cast<RtmpSession>(shared_from_this());
     _ring_reader->setGetInfoCB([weak_self]() {
         Any ret;
         ret.set(static_pointer_cast<SockInfo>(weak_self.lock()));
         return ret;
     });
-    _ring_reader->setReadCB([weak_self](const RtmpMediaSource::RingDataType &pkt) {
+    auto profiler = StreamProfiler::get(*src);
+    weak_ptr<RtmpMediaSource> weak_src = src;
+    _ring_reader->setReadCB([weak_self, weak_src, profiler](const RtmpMediaSource::RingDataType &pkt) {
         auto strong_self = weak_self.lock();
         if (!strong_self) {
             return;
         }
-        size_t i = 0;
-        auto size = pkt->size();
-        strong_self->setSendFlushFlag(false);
-        pkt->for_each([&](const RtmpPacket::Ptr &rtmp){
-            if(++i == size){
-                strong_self->setSendFlushFlag(true);
-            }
-            strong_self->onSendMedia(rtmp);
-        });
+        if (profiler) {
+            size_t bytes = 0;
+            pkt->for_each([&](const RtmpPacket::Ptr &rtmp) { bytes += rtmp->size(); });
+            profiler->addBytesOut(bytes);
+        }
+        // 直接发送所有播放器共享的chunk流，每组rtmp包每个播放器只发送一个Buffer，无需逐包分块
+        // 可能触发的确认消息与chunk流一起flush
+        auto strong_src = weak_src.lock();
+        auto chunk_size = strong_self->getChunkSizeOut();
+        strong_self->_batch_send = true;
+        strong_self->sendChunkStream(strong_src ? strong_src->getChunkBuffer(pkt, chunk_size) : pkt->getChunkBuffer(chunk_size));
+        strong_self->_batch_send = false;
+        strong_self->_tcp_batch_sender.flush();
     });
     _ring_reader->setDetachCB([weak_self]() {
         auto strong_self = weak_self.lock();
@@ -19,6 +19,9 @@
 #include "RtmpMediaSourceImp.h"
 #include "Util/TimeTicker.h"
 #include "Network/Session.h"
+#include "Common/Metrics.h"
+#include "Common/TcpBatchSender.h"
+#include "Common/KtlsSession.h"
 
 namespace mediakit {
 
@@ -54,6 +57,11 @@ private:
     void onSendMedia(const RtmpPacket::Ptr &pkt);
     void onSendRawData(toolkit::Buffer::Ptr buffer) override{
         _total_bytes += buffer->size();
+        Metrics::addBytesOut(Metrics::kRtmp, buffer->size());
+        if (_batch_send) {
+            _tcp_batch_sender.input(std::move(buffer));
+            return;
+        }
         send(std::move(buffer));
     }
     void onRtmpChunk(RtmpPacket::Ptr chunk_data) override;
@@ -86,11 +94,15 @@ private:
 
 private:
     bool _set_meta_data = false;
+    //是否正在合并写，合并写期间输出的数据先放入发送队列
+    bool _batch_send = false;
     double _recv_req_id = 0;
     //断连续推延时
     uint32_t _continue_push_ms = 0;
     //消耗的总流量
     uint64_t _total_bytes = 0;
+    //合并写发送队列
+    TcpBatchSender _tcp_batch_sender { this, Metrics::kRtmp };
     //数据接收超时计时器
     toolkit::Ticker _ticker;
     MediaInfo _media_info;
@@ -100,12 +112,16 @@ private:
     RtmpMediaSourceImp::Ptr _push_src;
     std::shared_ptr<void> _push_src_ownership;
     RtmpMediaSource::RingType::RingReader::Ptr _ring_reader;
+    // 共享chunk流的播放器登记，析构时注销
+    std::shared_ptr<void> _shared_reader_ref;
+    //会话个数统计
+    Metrics::SessionCounter _metrics { Metrics::kRtmp };
 };
 
 /**
  * 支持ssl加密的rtmp服务器
  */
-using RtmpSessionWithSSL = toolkit::SessionWithSSL<RtmpSession>;
+using RtmpSessionWithSSL = SessionWithKTLS<RtmpSession>;
 
 } /* namespace mediakit */
 #endif /* SRC_RTMP_RTMPSESSION_H_ */
@@ -10,8 +10,10 @@
 
 #if defined(ENABLE_RTPPROXY)
 
+#include <algorithm>
 #include "PSDecoder.h"
 #include "mpeg-ps.h"
+#include "Common/config.h"
 
 using namespace toolkit;
 
@@ -42,6 +44,9 @@ PSDecoder::PSDecoder() {
             }
     };
     ps_demuxer_set_notify((struct ps_demuxer_t *) _ps_demuxer, &notify, this);
+
+    GET_CONFIG(bool, fast_demux, RtpProxy::kPSFastDemux);
+    _fast = fast_demux;
 }
 
 PSDecoder::~PSDecoder() {
@@ -49,10 +54,293 @@ PSDecoder::~PSDecoder() {
 }
 
 ssize_t PSDecoder::input(const uint8_t *data, size_t bytes) {
+    if (_fast) {
+        if (inputFast(data, bytes)) {
+            return bytes;
+        }
+        // 不支持的格式，之后都交给通用ps_demuxer处理
+        _fast = false;
+        InfoL << "ps fast demux not supported, fallback to ps_demuxer: bytes=" << bytes
+              << ", hex=" << hexdump(data, MIN(bytes, 32));
+        if (!_remain.empty()) {
+            // 上次输入中未解析的数据已经与本次输入合并
+            std::string remain;
+            remain.swap(_remain);
+            HttpRequestSplitter::input(remain.data(), remain.size());
+            return bytes;
+        }
+    }
     HttpRequestSplitter::input(reinterpret_cast<const char *>(data), bytes);
     return bytes;
 }
 
+static inline int64_t readPESTimestamp(const uint8_t *ptr) {
+    return ((int64_t)(ptr[0] & 0x0E) << 29) | (ptr[1] << 22) | ((ptr[2] & 0xFE) << 14) | (ptr[3] << 7) | (ptr[4] >> 1);
+}
+
+static inline bool isVideoStreamType(uint8_t type) {
+    return type == PSI_STREAM_H264 || type == PSI_STREAM_H265;
+}
+
+bool PSDecoder::inputFast(const uint8_t *data, size_t bytes) {
+    auto buf = data;
+    auto len = bytes;
+    if (!_remain.empty()) {
+        // 与上次输入末尾不完整的包合并
+        _remain.append(reinterpret_cast<const char *>(data), bytes);
+        buf = reinterpret_cast<const uint8_t *>(_remain.data());
+        len = _remain.size();
+    }
+    // 第一遍只校验结构并记录pes负载位置，确认整个输入都支持后再回调，
+    // 这样失败时可以把未输出的数据交给通用ps_demuxer而不会重复输出
+    auto consumed = parseFast(buf, len);
+    if (consumed < 0) {
+        // 之前输入中已缓存的视频帧先输出，之后的数据交给通用ps_demuxer
+        flushVideo();
+        return false;
+    }
+
+    if (_psm_found) {
+        onPSM();
+    }
+
+    for (auto &seg : _segments) {
+        if (!seg.stream_id) {
+            // 数据不连续，丢弃不完整的视频帧
+            resetVideo();
+            continue;
+        }
+        auto type = _stream_type[seg.stream_id];
+        if (!type) {
+            // 尚未收到psm或psm中没有该流
+            continue;
+        }
+        auto video = isVideoStreamType(type);
+        if (!seg.have_pts) {
+            // 同一帧被拆分为多个pes时，后续pes可能没有时间戳
+            seg.pts = _last_pts[video];
+            seg.dts = _last_dts[video];
+        }
+        _last_pts[video] = seg.pts;
+        _last_dts[video] = seg.dts;
+        if (!video) {
+            if (_on_decode) {
+                _on_decode(seg.stream_id, type, 0, seg.pts, seg.dts, seg.data, seg.size);
+            }
+            continue;
+        }
+        if (_video_pending && (_video_stream_id != seg.stream_id || (seg.have_pts && (_video_pts != seg.pts || _video_dts != seg.dts)))) {
+            // 新的一帧
+            flushVideo();
+        }
+        if (!_video_pending) {
+            _video_pending = true;
+            _video_stream_id = seg.stream_id;
+            _video_pts = seg.pts;
+            _video_dts = seg.dts;
+        }
+        _video_segments.emplace_back(&seg);
+    }
+
+    // 输入边界不一定是帧边界(rtp按32KB合并、丢包或者一帧拆分为多个pes)，
+    // 帧只在下一个带不同时间戳的pes到达时输出；帧剩余部分可能在下次输入中，先拷贝已收到的负载
+    for (auto seg : _video_segments) {
+        _video_buf.append(reinterpret_cast<const char *>(seg->data), seg->size);
+    }
+    _video_segments.clear();
+
+    // 缓存不完整的包，pes负载指针已经不再使用
+    if (buf == data) {
+        _remain.assign(reinterpret_cast<const char *>(data) + consumed, len - consumed);
+    } else {
+        _remain.erase(0, consumed);
+    }
+    return true;
+}
+
+ssize_t PSDecoder::parseFast(const uint8_t *data, size_t bytes) {
+    static const uint8_t kPackStart[] = { 0x00, 0x00, 0x01, 0xBA };
+    _segments.clear();
+    _psm_found = false;
+    auto ptr = data;
+    auto end = data + bytes;
+    // 结构错误(一般是丢包)，插入不连续标记并跳到下一个pack header，找不到则丢弃剩余数据
+    auto resync = [&]() {
+        PESSegment seg;
+        seg.stream_id = 0;
+        seg.have_pts = false;
+        seg.pts = seg.dts = 0;
+        seg.data = nullptr;
+        seg.size = 0;
+        _segments.emplace_back(seg);
+        ptr = std::search(ptr + 1, end, kPackStart, kPackStart + sizeof(kPackStart));
+    };
+    while (end - ptr >= 4) {
+        if (ptr[0] != 0x00 || ptr[1] != 0x00 || ptr[2] != 0x01) {
+            resync();
+            continue;
+        }
+        auto stream_id = ptr[3];
+        if (stream_id == 0xBA) {
+            if (end - ptr < 14) {
+                break;
+            }
+            // pack header，只支持mpeg2
+            if ((ptr[4] & 0xC0) != 0x40) {
+                return -1;
+            }
+            size_t len = 14 + (ptr[13] & 0x07);
+            if ((size_t)(end - ptr) < len) {
+                break;
+            }
+            ptr += len;
+            continue;
+        }
+        if (stream_id == 0xB9) {
+            // program end
+            ptr += 4;
+            continue;
+        }
+        if (stream_id < 0xBB) {
+            resync();
+            continue;
+        }
+        if (end - ptr < 6) {
+            break;
+        }
+        size_t len = 6 + ((ptr[4] << 8) | ptr[5]);
+        if ((size_t)(end - ptr) < len) {
+            break;
+        }
+        if (stream_id == 0xBC) {
+            if (!parsePSM(ptr, len)) {
+                return -1;
+            }
+        } else if (stream_id >= 0xC0 && stream_id <= 0xEF) {
+            // 音视频pes，只支持mpeg2
+            if (len < 9 || (ptr[6] & 0xC0) != 0x80) {
+                return -1;
+            }
+            auto pts_dts_flags = ptr[7] >> 6;
+            size_t header_len = 9 + ptr[8];
+            if (header_len > len || pts_dts_flags == 0x01 || (pts_dts_flags & 0x02 && ptr[8] < (pts_dts_flags == 0x03 ? 10 : 5))) {
+                resync();
+                continue;
+            }
+            PESSegment seg;
+            seg.stream_id = stream_id;
+            seg.have_pts = pts_dts_flags & 0x02;
+            seg.pts = seg.have_pts ? readPESTimestamp(ptr + 9) : 0;
+            seg.dts = pts_dts_flags == 0x03 ? readPESTimestamp(ptr + 14) : seg.pts;
+            seg.data = ptr + header_len;
+            seg.size = len - header_len;
+            if (seg.size) {
+                _segments.emplace_back(seg);
+            }
+        }
+        // system header、私有数据(海康0xBD)、填充等直接跳过
+        ptr += len;
+    }
+    return ptr - data;
+}
+
+bool PSDecoder::parsePSM(const uint8_t *data, size_t bytes) {
+    // start code(4) + length(2) + flags(2) + ps_info_length(2) + ps_info + es_map_length(2) + es_map + crc32(4)
+    if (bytes < 16) {
+        return false;
+    }
+    auto end = data + bytes - 4;
+    auto ptr = data + 10 + ((data[8] << 8) | data[9]);
+    if (ptr + 2 > end) {
+        return false;
+    }
+    auto map_end = ptr + 2 + ((ptr[0] << 8) | ptr[1]);
+    if (map_end > end) {
+        return false;
+    }
+    ptr += 2;
+    memset(_psm_type, 0, sizeof(_psm_type));
+    while (ptr + 4 <= map_end) {
+        auto type = ptr[0];
+        auto stream_id = ptr[1];
+        ptr += 4 + ((ptr[2] << 8) | ptr[3]);
+        if (ptr > map_end) {
+            return false;
+        }
+        switch (type) {
+            case PSI_STREAM_H264:
+            case PSI_STREAM_H265:
+                if (stream_id < 0xE0 || stream_id > 0xEF) {
+                    return false;
+                }
+                break;
+            case PSI_STREAM_AAC:
+            case PSI_STREAM_AUDIO_G711A:
+            case PSI_STREAM_AUDIO_G711U:
+                if (stream_id < 0xC0 || stream_id > 0xDF) {
+                    return false;
+                }
+                break;
+            default:
+                // 其他编码格式交给通用ps_demuxer
+                return false;
+        }
+        _psm_type[stream_id] = type;
+    }
+    if (_psm_ready && memcmp(_psm_type, _stream_type, sizeof(_stream_type))) {
+        // 节目信息发生变化
+        return false;
+    }
+    _psm_found = true;
+    return true;
+}
+
+void PSDecoder::onPSM() {
+    if (_psm_ready) {
+        return;
+    }
+    _psm_ready = true;
+    memcpy(_stream_type, _psm_type, sizeof(_stream_type));
+    if (!_on_stream) {
+        return;
+    }
+    int last = -1;
+    for (int i = 0; i < 256; ++i) {
+        last = _stream_type[i] ? i : last;
+    }
+    for (int i = 0; i <= last; ++i) {
+        if (_stream_type[i]) {
+            _on_stream(i, _stream_type[i], nullptr, 0, i == last);
+        }
+    }
+}
+
+void PSDecoder::flushVideo() {
+    if (!_video_pending) {
+        return;
+    }
+    if (_on_decode) {
+        auto type = _stream_type[_video_stream_id];
+        if (_video_buf.empty() && _video_segments.size() == 1) {
+            // 整帧为本次输入中的单个pes包，直接回调输入数据
+            auto seg = _video_segments.front();
+            _on_decode(_video_stream_id, type, 0, _video_pts, _video_dts, seg->data, seg->size);
+        } else {
+            for (auto seg : _video_segments) {
+                _video_buf.append((const char *)seg->data, seg->size);
+            }
+            _on_decode(_video_stream_id, type, 0, _video_pts, _video_dts, _video_buf.data(), _video_buf.size());
+        }
+    }
+    resetVideo();
+}
+
+void PSDecoder::resetVideo() {
+    _video_pending = false;
+    _video_segments.clear();
+    _video_buf.clear();
+}
+
 const char *PSDecoder::onSearchPacketTail(const char *data, size_t len) {
     try {
         auto ret = ps_demuxer_input(static_cast<struct ps_demuxer_t *>(_ps_demuxer), reinterpret_cast<const uint8_t *>(data), len);
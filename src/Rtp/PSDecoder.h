@@ -13,6 +13,8 @@
 
 #if defined(ENABLE_RTPPROXY)
 #include <stdint.h>
+#include <string>
+#include <vector>
 #include "Decoder.h"
 #include "Http/HttpRequestSplitter.h"
 
@@ -32,8 +34,63 @@ private:
     const char *onSearchPacketTail(const char *data, size_t len) override;
     ssize_t onRecvHeader(const char *, size_t) override { return 0; };
 
+private:
+    // 一个pes包的负载，指向输入数据
+    struct PESSegment {
+        uint8_t stream_id;
+        bool have_pts;
+        int64_t pts;
+        int64_t dts;
+        const uint8_t *data;
+        size_t size;
+    };
+
+    /**
+     * 快速解析单节目H264/H265 + G711/AAC的ps流，输入可以在任意位置被拆分(rtp按32KB合并或者丢包)，
+     * 不完整的ps/pes包缓存到下次输入，结构错误时丢弃数据直到下一个pack header；
+     * 视频帧在下一个时间戳不同的pes到达时输出，与通用ps_demuxer一致，所以跨输入的帧需要拷贝一次；
+     * 只有视频帧为单个pes包且下一帧在同一次输入中时才直接回调输入数据指针
+     * @return false代表不是该快速解析器支持的格式，需要交给通用ps_demuxer处理
+     */
+    bool inputFast(const uint8_t *data, size_t bytes);
+    /**
+     * 校验完整的ps/pes包并记录pes负载位置，不回调
+     * @return 已解析的字节数，剩余的是不完整的包；-1代表格式不支持
+     */
+    ssize_t parseFast(const uint8_t *data, size_t bytes);
+    bool parsePSM(const uint8_t *data, size_t bytes);
+    void onPSM();
+    void flushVideo();
+    void resetVideo();
+
 private:
     void *_ps_demuxer = nullptr;
+
+    // 是否使用快速解析，遇到不支持的格式后永久切换为通用ps_demuxer
+    bool _fast = false;
+    // 已经回调过psm
+    bool _psm_ready = false;
+    // 各stream id对应的PSI_STREAM_*，0代表未知
+    uint8_t _stream_type[256] = { 0 };
+    // 本次输入中解析到的psm
+    bool _psm_found = false;
+    uint8_t _psm_type[256] = { 0 };
+    // 上次输入末尾不完整的ps/pes包
+    std::string _remain;
+    // 音频与视频分别记录上个pes的时间戳
+    int64_t _last_pts[2] = { 0, 0 };
+    int64_t _last_dts[2] = { 0, 0 };
+    // 当前未输出的视频帧
+    bool _video_pending = false;
+    uint8_t _video_stream_id = 0;
+    int64_t _video_pts = 0;
+    int64_t _video_dts = 0;
+    // 以下缓存复用，避免每帧分配内存
+    std::vector<PESSegment> _segments;
+    // 当前视频帧在本次输入中的pes负载
+    std::vector<const PESSegment *> _video_segments;
+    // 当前视频帧在之前输入中的pes负载(已拷贝)，以及多个pes合并输出
+    std::string _video_buf;
 };
 
 }//namespace mediakit
@@ -13,6 +13,7 @@
 #include "RtpProcess.h"
 #include "Util/File.h"
 #include "Common/config.h"
+#include "Common/Metrics.h"
 
 using namespace std;
 using namespace toolkit;
@@ -115,6 +116,7 @@ bool RtpProcess::inputRtp(bool is_udp, const Socket::Ptr &sock, const char *data
     }
 
     _total_bytes += len;
+    Metrics::addBytesIn(Metrics::kRtp, len);
     if (_save_file_rtp) {
         uint16_t size = (uint16_t)len;
         size = htons(size);
@@ -320,16 +320,23 @@ void RtpSender::onFlushRtpList(shared_ptr<List<Buffer::Ptr> > rtp_list) {
 
     size_t i = 0;
     auto size = rtp_list->size();
+    if (_args.is_udp) {
+        _udp_batch_sender.setSocket(_socket_rtp);
+    }
     rtp_list->for_each([&](Buffer::Ptr &packet) {
         if (_args.is_udp) {
-            onSendRtpUdp(packet, i == 0);
+            onSendRtpUdp(packet, i++ == 0);
             // udp模式，rtp over tcp前4个字节可以忽略
-            _socket_rtp->send(std::make_shared<BufferRtp>(std::move(packet), RtpPacket::kRtpTcpHeaderSize), nullptr, 0, ++i == size);
+            _udp_batch_sender.input(std::make_shared<BufferRtp>(std::move(packet), RtpPacket::kRtpTcpHeaderSize));
         } else {
             // tcp模式, rtp over tcp前2个字节可以忽略,只保留后续rtp长度的2个字节
             _socket_rtp->send(std::make_shared<BufferRtp>(std::move(packet), 2), nullptr, 0, ++i == size);
         }
     });
+    if (_args.is_udp) {
+        // 一次性发送本次合并写的所有rtp包
+        _udp_batch_sender.flush();
+    }
 }
 
 void RtpSender::onErr(const SockException &ex) {
@@ -16,6 +16,7 @@
 #include "Rtcp/RtcpContext.h"
 #include "Common/MediaSource.h"
 #include "Common/MediaSink.h"
+#include "Common/UdpBatchSender.h"
 
 namespace mediakit{
 
@@ -82,6 +83,7 @@ private:
     MediaSourceEvent::SendRtpArgs _args;
     toolkit::Socket::Ptr _socket_rtp;
     toolkit::Socket::Ptr _socket_rtcp;
+    UdpBatchSender _udp_batch_sender;
     toolkit::EventPoller::Ptr _poller;
     MediaSinkInterface::Ptr _interface;
     std::shared_ptr<RtcpContext> _rtcp_context;
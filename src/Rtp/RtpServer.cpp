@@ -13,7 +13,9 @@
 #include "RtpServer.h"
 #include "RtpProcess.h"
 #include "Rtcp/RtcpContext.h"
+#include "Rtsp/Rtsp.h"
 #include "Common/config.h"
+#include "Common/PollerHash.h"
 
 using namespace std;
 using namespace toolkit;
@@ -122,6 +124,24 @@ private:
     std::shared_ptr<struct sockaddr_storage> _rtcp_addr;
 };
 
+// 单端口多流模式下，根据ssrc选择固定的poller线程
+static EventPoller::Ptr getPollerByRtpOrRtcp(const Buffer::Ptr &buf) {
+    uint32_t ssrc = 0;
+    if (isRtp(buf->data(), buf->size())) {
+        if (!getSSRC(buf->data(), buf->size(), ssrc)) {
+            return nullptr;
+        }
+    } else if (isRtcp(buf->data(), buf->size()) && buf->size() >= 8) {
+        // rtcp发送者ssrc
+        memcpy(&ssrc, buf->data() + 4, 4);
+        ssrc = ntohl(ssrc);
+    } else {
+        return nullptr;
+    }
+    // 国标ssrc通常是十进制递增分配的
+    return getPollerByHash(ssrc);
+}
+
 void RtpServer::start(uint16_t local_port, const MediaTuple &tuple, TcpMode tcp_mode, const char *local_ip, bool re_use_port, uint32_t ssrc, int only_track, bool multiplex) {
     //创建udp服务器
     auto poller = EventPollerPool::Instance().getPoller();
@@ -156,7 +176,7 @@ void RtpServer::start(uint16_t local_port, const MediaTuple &tuple, TcpMode tcp_
         bool bind_peer_addr = false;
         auto ssrc_ptr = std::make_shared<uint32_t>(ssrc);
         _ssrc = ssrc_ptr;
-        rtp_socket->setOnRead([rtp_socket, helper, ssrc_ptr, bind_peer_addr](const Buffer::Ptr &buf, struct sockaddr *addr, int addr_len) mutable {
+        auto on_read = [rtp_socket, helper, ssrc_ptr, bind_peer_addr](const Buffer::Ptr &buf, struct sockaddr *addr, int addr_len) mutable {
             RtpHeader *header = (RtpHeader *)buf->data();
             auto rtp_ssrc = ntohl(header->ssrc);
             auto ssrc = *ssrc_ptr;
@@ -170,7 +190,15 @@ void RtpServer::start(uint16_t local_port, const MediaTuple &tuple, TcpMode tcp_
                 }
                 helper->onRecvRtp(rtp_socket, buf, addr);
             }
-        });
+        };
+        GET_CONFIG(bool, udp_batch_recv, RtpProxy::kUdpBatchRecv);
+        if (udp_batch_recv && tcp_mode != ACTIVE) {
+            // tcp主动模式下rtp_socket之后会用于tcp连接，不能接管
+            _udp_receiver = UdpBatchReceiver::attach(rtp_socket, on_read, true);
+        }
+        if (!_udp_receiver) {
+            rtp_socket->setOnRead(std::move(on_read));
+        }
     } else {
         //单端口多线程接收多个流，根据ssrc区分流
         udp_server = std::make_shared<UdpServer>();
@@ -178,6 +206,12 @@ void RtpServer::start(uint16_t local_port, const MediaTuple &tuple, TcpMode tcp_
         (*udp_server)[RtpSession::kUdpRecvBuffer] = udpRecvSocketBuffer;
         (*udp_server)[RtpSession::kVhost] = tuple.vhost;
         (*udp_server)[RtpSession::kApp] = tuple.app;
+        udp_server->setOnCreateSocket([](const EventPoller::Ptr &poller, const Buffer::Ptr &buf, struct sockaddr *, int) {
+            // 每个对端的udp socket、RtpSession与RtpProcess都在ssrc对应的poller线程运行，
+            // 解复用与转协议均匀分摊到所有线程，同一路流每次推流都在同一线程
+            auto new_poller = buf ? getPollerByRtpOrRtcp(buf) : nullptr;
+            return Socket::createSocket(new_poller ? new_poller : poller, false);
+        });
         udp_server->start<RtpSession>(local_port, local_ip);
         rtp_socket = nullptr;
     }
@@ -17,6 +17,7 @@
 #include "Network/TcpServer.h"
 #include "Network/UdpServer.h"
 #include "RtpSession.h"
+#include "Common/UdpBatchReceiver.h"
 
 namespace mediakit {
 
@@ -80,6 +81,8 @@ protected:
     std::shared_ptr<uint32_t> _ssrc;
     std::shared_ptr<RtcpHelper> _rtcp_helper;
     std::function<void()> _on_cleanup;
+    // 批量接收rtp_socket的数据
+    UdpBatchReceiver::Ptr _udp_receiver;
 
     int _only_track = 0;
     //用于tcp主动模式
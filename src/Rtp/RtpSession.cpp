@@ -14,6 +14,7 @@
 #include "Network/TcpServer.h"
 #include "Rtsp/Rtsp.h"
 #include "Rtsp/RtpReceiver.h"
+#include "Extension/NalScanner.h"
 #include "Common/config.h"
 
 using namespace std;
@@ -158,11 +159,15 @@ static const char *findSSRC(const char *data, ssize_t len, uint32_t ssrc) {
 }
 
 static const char *findPsHeaderFlag(const char *data, ssize_t len) {
-    for (ssize_t i = 2; i <= len - 4; ++i) {
-        auto ptr = (const uint8_t *)data + i;
+    if (len < 6) {
+        return nullptr;
+    }
+    // 最后一个字节留给stream id
+    auto end = data + len - 1;
+    for (auto ptr = findNalStartCode(data + 2, end); ptr; ptr = findNalStartCode(ptr + 1, end)) {
         // PsHeader 0x000001ba、PsSystemHeader0x000001bb（关键帧标识）
-        if (ptr[0] == (0x00) && ptr[1] == (0x00) && ptr[2] == (0x01) && ptr[3] == (0xbb)) {
-            return (const char *)ptr;
+        if ((uint8_t)ptr[3] == 0xbb) {
+            return ptr;
         }
     }
 
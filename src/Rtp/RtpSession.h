@@ -17,6 +17,7 @@
 #include "RtpSplitter.h"
 #include "RtpProcess.h"
 #include "Util/TimeTicker.h"
+#include "Common/Metrics.h"
 
 namespace mediakit{
 
@@ -59,6 +60,8 @@ private:
     MediaTuple _tuple;
     struct sockaddr_storage _addr;
     RtpProcess::Ptr _process;
+    //会话个数统计
+    Metrics::SessionCounter _metrics { Metrics::kRtp };
 };
 
 }//namespace mediakit
@@ -12,6 +12,7 @@
 #define ZLMEDIAKIT_RTPRECEIVER_H
 
 #include <map>
+#include <vector>
 #include <string>
 #include <memory>
 #include "Rtsp/Rtsp.h"
@@ -26,8 +27,10 @@ template<typename T, typename SEQ = uint16_t>
 class PacketSortor {
 public:
     static constexpr SEQ SEQ_MAX = (std::numeric_limits<SEQ>::max)();
-    using iterator = typename std::map<SEQ, T>::iterator;
+    // 连续收到该个数的回退包时，认为推流端重置了seq
+    static constexpr size_t kMaxOldCount = 16;
 
+    PacketSortor() { resize(); }
     virtual ~PacketSortor() = default;
 
     void setOnSort(std::function<void(SEQ seq, T packet)> cb) { _cb = std::move(cb); }
@@ -37,14 +40,15 @@ public:
      */
     void clear() {
         _started = false;
+        _old_count = 0;
         _ticker.resetTime();
-        _pkt_sort_cache_map.clear();
+        resize();
     }
 
     /**
      * 获取排序缓存长度
      */
-    size_t getJitterSize() const { return _pkt_sort_cache_map.size(); }
+    size_t getJitterSize() const { return _size; }
 
     /**
      * 输入并排序
@@ -61,104 +65,150 @@ public:
         auto next_seq = static_cast<SEQ>(_last_seq_out + 1);
         if (seq == next_seq) {
             // 收到下一个seq
+            _old_count = 0;
             output(seq, std::move(packet));
             // 清空连续包列表
             flushPacket();
             return;
         }
 
-        if (seq < next_seq && !mayLooped(next_seq, seq)) {
-            // 无回环风险, 过滤seq回退包
+        // 按回环计算该包相对next_seq的距离
+        auto offset = static_cast<SEQ>(seq - next_seq);
+        if (offset > SEQ_MAX >> 1) {
+            // seq回退包或重复包(已经输出过了)
+            if (++_old_count < kMaxOldCount) {
+                // 迟到的包，过滤之；单个回退很远的包(例如很久之前的重复包)也不能作为seq重置的依据
+                return;
+            }
+            // 连续收到大量回退包，认为推流端重置了seq，
+            // 输出所有缓存后从该包开始重新计数
+            WarnL << "rtp seq reset: " << next_seq << " -> " << seq;
+            flush();
+            _old_count = 0;
+            _last_seq_out = seq - 1;
+            output(seq, std::move(packet));
             return;
         }
-        _pkt_sort_cache_map.emplace(seq, std::move(packet));
+        _old_count = 0;
 
-        if (needForceFlush(seq)) {
-            forceFlush(next_seq);
+        while (offset > _max_distance && _size) {
+            // seq跳跃太大，强制输出最早的缓存，直到该包落入排序窗口
+            forceFlush();
+            offset = static_cast<SEQ>(seq - static_cast<SEQ>(_last_seq_out + 1));
+        }
+
+        if (offset == 0 || offset > _max_distance) {
+            // 缓存已清空但是seq仍然跳跃太大，可能是推流端重置了seq，那么从该包开始重新计数
+            output(seq, std::move(packet));
+            flushPacket();
+            return;
+        }
+
+        auto index = seq & _mask;
+        if (isOccupied(index)) {
+            // 重复包
+            return;
+        }
+        setOccupied(index, true);
+        _slots[index] = std::move(packet);
+        ++_size;
+
+        if (needForceFlush()) {
+            forceFlush();
         }
     }
 
+    /**
+     * 按顺序输出所有缓存的包
+     */
     void flush() {
-        if (!_pkt_sort_cache_map.empty()) {
-            forceFlush(static_cast<SEQ>(_last_seq_out + 1));
-            _pkt_sort_cache_map.clear();
+        while (_size) {
+            forceFlush();
         }
     }
 
     void setParams(size_t max_buffer_size, size_t max_buffer_ms, size_t max_distance) {
         _max_buffer_size = max_buffer_size;
         _max_buffer_ms = max_buffer_ms;
-        _max_distance = max_distance;
+        max_distance = (std::min<size_t>)(max_distance, SEQ_MAX >> 1);
+        if (max_distance != _max_distance) {
+            // 排序窗口大小改变，先输出缓存
+            flush();
+            _max_distance = max_distance;
+            resize();
+        }
     }
 
 private:
-    SEQ distance(SEQ seq) {
-        SEQ ret;
-        auto next_seq = static_cast<SEQ>(_last_seq_out + 1);
-        if (seq > next_seq) {
-            ret = seq - next_seq;
-        } else {
-            ret = next_seq - seq;
+    /**
+     * 根据最大seq跳跃距离分配2的n次方个槽位，这样可以直接使用seq & mask作为下标
+     */
+    void resize() {
+        size_t capacity = 64;
+        while (capacity <= _max_distance) {
+            capacity <<= 1;
         }
-        if (ret > SEQ_MAX >> 1) {
-            return SEQ_MAX - ret;
+        _mask = capacity - 1;
+        _size = 0;
+        _slots.clear();
+        _slots.resize(capacity);
+        _bitmap.assign(capacity / 64, 0);
+    }
+
+    bool isOccupied(size_t index) const { return (_bitmap[index >> 6] >> (index & 63)) & 1; }
+
+    void setOccupied(size_t index, bool flag) {
+        if (flag) {
+            _bitmap[index >> 6] |= uint64_t(1) << (index & 63);
+        } else {
+            _bitmap[index >> 6] &= ~(uint64_t(1) << (index & 63));
         }
-        return ret;
     }
 
-    bool needForceFlush(SEQ seq) {
-        return !_pkt_sort_cache_map.empty() && (_pkt_sort_cache_map.size() > _max_buffer_size ||
-               distance(seq) > _max_distance || _ticker.elapsedTime() > _max_buffer_ms);
+    bool needForceFlush() {
+        return _size && (_size > _max_buffer_size || _ticker.elapsedTime() > _max_buffer_ms);
     }
 
-    //外部调用代码确保_pkt_sort_cache_map不为空
-    void forceFlush(SEQ next_seq) {
-        // 寻找距离比next_seq大的最近的seq
-        auto it = _pkt_sort_cache_map.lower_bound(next_seq);
-        if (it == _pkt_sort_cache_map.end()) {
-            // 没有比next_seq更大的seq，应该是回环时丢包导致
-            it = _pkt_sort_cache_map.begin();
+    //外部调用代码确保缓存不为空
+    void forceFlush() {
+        // 通过位图寻找next_seq之后最近的seq
+        auto next_seq = static_cast<SEQ>(_last_seq_out + 1);
+        size_t start = next_seq & _mask;
+        size_t pos = start;
+        for (size_t scanned = 0; scanned <= _mask;) {
+            auto bits = _bitmap[pos >> 6] >> (pos & 63);
+            if (bits) {
+                pos += countTrailingZero(bits);
+                break;
+            }
+            auto step = 64 - (pos & 63);
+            scanned += step;
+            pos = (pos + step) & _mask;
         }
         // 丢包无法恢复，把这个包当做next_seq
-        popIterator(it);
+        popPacket(static_cast<SEQ>(next_seq + ((pos - start) & _mask)));
         // 清空连续包列表
         flushPacket();
-        // 删除距离next_seq太大的包
-        for (auto it = _pkt_sort_cache_map.begin(); it != _pkt_sort_cache_map.end();) {
-            if (distance(it->first) > _max_distance) {
-                it = _pkt_sort_cache_map.erase(it);
-            } else {
-                ++it;
-            }
-        }
     }
 
-    bool mayLooped(SEQ last_seq, SEQ now_seq) { return last_seq > SEQ_MAX - _max_distance || now_seq < _max_distance; }
-
     void flushPacket() {
-        if (_pkt_sort_cache_map.empty()) {
-            return;
-        }
-        auto next_seq = static_cast<SEQ>(_last_seq_out + 1);
-        auto it = _pkt_sort_cache_map.lower_bound(next_seq);
-        if (!mayLooped(next_seq, next_seq)) {
-            // 无回环风险, 清空 < next_seq的值
-            it = _pkt_sort_cache_map.erase(_pkt_sort_cache_map.begin(), it);
-        }
-
-        while (it != _pkt_sort_cache_map.end()) {
+        while (_size) {
             // 找到下一个包
-            if (it->first == static_cast<SEQ>(_last_seq_out + 1)) {
-                it = popIterator(it);
-                continue;
+            auto next_seq = static_cast<SEQ>(_last_seq_out + 1);
+            if (!isOccupied(next_seq & _mask)) {
+                break;
             }
-            break;
+            popPacket(next_seq);
         }
     }
 
-    iterator popIterator(iterator it) {
-        output(it->first, std::move(it->second));
-        return _pkt_sort_cache_map.erase(it);
+    void popPacket(SEQ seq) {
+        auto index = seq & _mask;
+        setOccupied(index, false);
+        --_size;
+        auto packet = std::move(_slots[index]);
+        _slots[index] = T();
+        output(seq, std::move(packet));
     }
 
     void output(SEQ seq, T packet) {
@@ -166,7 +216,7 @@ private:
         if (seq != next_seq) {
             WarnL << "packet dropped: " << next_seq << " -> " << static_cast<SEQ>(seq - 1)
                   << ", latest seq: " << _latest_seq
-                  << ", jitter buffer size: " << _pkt_sort_cache_map.size()
+                  << ", jitter buffer size: " << _size
                   << ", jitter buffer ms: " << _ticker.elapsedTime();
         }
         _last_seq_out = seq;
@@ -186,10 +236,18 @@ private:
     toolkit::Ticker _ticker;
     // 最近输入的seq
     SEQ _latest_seq = 0;
+    // 连续收到的回退包个数
+    size_t _old_count = 0;
     // 下次应该输出的SEQ
     SEQ _last_seq_out = 0;
-    // pkt排序缓存，根据seq排序
-    std::map<SEQ, T> _pkt_sort_cache_map;
+    // 已缓存的包个数
+    size_t _size = 0;
+    // 槽位个数减一，槽位个数为2的n次方
+    size_t _mask = 0;
+    // pkt排序缓存，下标为seq & _mask
+    std::vector<T> _slots;
+    // 槽位占用位图
+    std::vector<uint64_t> _bitmap;
     // 回调
     std::function<void(SEQ seq, T packet)> _cb;
 };
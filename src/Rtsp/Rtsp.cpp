@@ -638,17 +638,10 @@ size_t RtpPacket::getPayloadSize() const {
 }
 
 RtpPacket::Ptr RtpPacket::create() {
-#if 0
-    static ResourcePool<RtpPacket> packet_pool;
-    static onceToken token([]() {
-        packet_pool.setSize(1024);
-    });
-    auto ret = packet_pool.obtain2();
+    // rtp包在释放线程回收复用，保留其内存；一般rtp包不超过mtu，超大的包不回收
+    auto ret = RecyclePool<RtpPacket, 256>::obtain([](RtpPacket *pkt) { return pkt->getCapacity() <= 4 * 1024; });
     ret->setSize(0);
     return ret;
-#else
-    return Ptr(new RtpPacket);
-#endif
 }
 
 /**
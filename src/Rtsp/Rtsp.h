@@ -172,6 +172,8 @@ public:
 
 private:
     friend class toolkit::ResourcePool_l<RtpPacket>;
+    template <typename C, size_t kMaxCount>
+    friend class RecyclePool;
     RtpPacket() = default;
 
 private:
@@ -12,6 +12,8 @@
 #define SRC_RTSP_RTSPMEDIASOURCE_H_
 
 #include <mutex>
+#include <deque>
+#include <atomic>
 #include <string>
 #include <memory>
 #include <functional>
@@ -23,16 +25,49 @@
 
 namespace mediakit {
 
+/**
+ * 合并写后的一组rtp包
+ * 该对象由RtspMediaSource生成后在环形缓冲中被所有播放器共享，
+ * rtsp over tcp播放器可以直接发送其连续内存，而不必每个rtp包都拷贝一次智能指针
+ */
+class RtpPacketList : public toolkit::List<RtpPacket::Ptr> {
+public:
+    using Ptr = std::shared_ptr<RtpPacketList>;
+
+    /**
+     * 获取本组rtp包(包含4字节interleaved头)拼接后的连续内存
+     * 该内存只在第一次被访问时生成，之后所有播放器(不分线程)共享同一份数据，
+     * 这样每个播放器每次合并写只需要发送一个Buffer
+     * @param created 返回本次调用是否新生成了连续内存
+     */
+    toolkit::Buffer::Ptr getTcpBuffer(bool *created = nullptr) const;
+
+    /**
+     * 释放拼接后的连续内存，下次访问时重新生成
+     * 该内存与rtp包本身各占一份gop缓存，没有tcp播放器时应该释放
+     */
+    void releaseTcpBuffer() const;
+
+    /**
+     * 本组rtp包是否都属于同一个track
+     */
+    bool isSingleTrack(TrackType type) const;
+
+private:
+    mutable std::mutex _tcp_buffer_mtx;
+    mutable toolkit::Buffer::Ptr _tcp_buffer;
+};
+
 /**
  * rtsp媒体源的数据抽象
  * rtsp有关键的两要素，分别是sdp、rtp包
  * 只要生成了这两要素，那么要实现rtsp推流、rtsp服务器就很简单了
  * rtsp推拉流协议中，先传递sdp，然后再协商传输方式(tcp/udp/组播)，最后一直传递rtp
  */
-class RtspMediaSource : public MediaSource, public toolkit::RingDelegate<RtpPacket::Ptr>, private PacketCache<RtpPacket> {
+class RtspMediaSource : public MediaSource, public toolkit::RingDelegate<RtpPacket::Ptr>, private PacketCache<RtpPacket, FlushPolicy, RtpPacketList> {
 public:
     using Ptr = std::shared_ptr<RtspMediaSource>;
-    using RingDataType = std::shared_ptr<toolkit::List<RtpPacket::Ptr> >;
+    using RingDataType = RtpPacketList::Ptr;
     using RingType = toolkit::RingBuffer<RingDataType>;
 
     /**
@@ -78,6 +113,38 @@ public:
         return _ring ? _ring->readerCount() : 0;
     }
 
+    /**
+     * 登记一个rtsp over tcp播放器，返回值析构时注销
+     * 共享连续内存只在多个tcp播放器时使用，tcp播放器不足两个时释放所有已生成的连续内存，
+     * 避免gop缓存中的rtp包被拷贝两份
+     */
+    std::shared_ptr<void> addTcpReader();
+
+    /**
+     * 获取rtsp over tcp播放器个数
+     */
+    int tcpReaderCount() const {
+        return _tcp_readers;
+    }
+
+    /**
+     * 登记一个simulcast自适应播放器对该层的reader，返回值析构时注销
+     * 这些播放器同时保持原始流的reader，统计推流总观看人数时不应重复计算
+     */
+    std::shared_ptr<void> addSimulcastReader();
+
+    /**
+     * 获取simulcast自适应播放器对该层的reader个数
+     */
+    int simulcastReaderCount() const {
+        return _simulcast_readers;
+    }
+
+    /**
+     * 获取一组rtp包拼接后的连续内存，并记录下来以便没有tcp播放器时释放
+     */
+    toolkit::Buffer::Ptr getTcpBuffer(const RingDataType &pkt);
+
     /**
      * 获取该源的sdp
      */
@@ -136,7 +203,7 @@ public:
     void onWrite(RtpPacket::Ptr rtp, bool keyPos) override;
 
     void clearCache() override{
-        PacketCache<RtpPacket>::clearCache();
+        PacketCache<RtpPacket, FlushPolicy, RtpPacketList>::clearCache();
         _ring->clearCache();
     }
 
@@ -146,14 +213,21 @@ private:
      * @param rtp_list rtp包列表
      * @param key_pos 是否包含关键帧
      */
-    void onFlush(std::shared_ptr<toolkit::List<RtpPacket::Ptr> > rtp_list, bool key_pos) override {
+    void onFlush(RtpPacketList::Ptr rtp_list, bool key_pos) override {
         //如果不存在视频，那么就没有存在GOP缓存的意义，所以is_key一直为true确保一直清空GOP缓存
         _ring->write(std::move(rtp_list), _have_video ? key_pos : true);
     }
 
+    void releaseTcpBuffers();
+
 private:
     bool _have_video = false;
     int _ring_size;
+    std::atomic<int> _tcp_readers { 0 };
+    std::atomic<int> _simulcast_readers { 0 };
+    std::mutex _tcp_lists_mtx;
+    // 已经生成连续内存的rtp包组，rtp包组被环形缓冲释放后自动失效
+    std::deque<std::weak_ptr<RtpPacketList>> _tcp_lists;
     std::string _sdp;
     RingType::Ptr _ring;
     SdpTrack::Ptr _tracks[TrackMax];
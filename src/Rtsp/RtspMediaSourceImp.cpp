@@ -1,7 +1,101 @@
 ﻿#include "RtspMediaSourceImp.h"
 #include "RtspDemuxer.h"
 #include "Common/config.h"
+
+using namespace toolkit;
+
 namespace mediakit {
+
+Buffer::Ptr RtpPacketList::getTcpBuffer(bool *created) const {
+    std::lock_guard<std::mutex> lck(_tcp_buffer_mtx);
+    if (created) {
+        *created = !_tcp_buffer;
+    }
+    if (_tcp_buffer) {
+        return _tcp_buffer;
+    }
+    if (size() == 1) {
+        // 只有一个rtp包，无需拷贝
+        _tcp_buffer = front();
+        return _tcp_buffer;
+    }
+    size_t total = 0;
+    for_each([&](const RtpPacket::Ptr &rtp) { total += rtp->size(); });
+    auto buffer = BufferRaw::create();
+    buffer->setCapacity(total);
+    auto ptr = buffer->data();
+    for_each([&](const RtpPacket::Ptr &rtp) {
+        memcpy(ptr, rtp->data(), rtp->size());
+        ptr += rtp->size();
+    });
+    buffer->setSize(total);
+    _tcp_buffer = std::move(buffer);
+    return _tcp_buffer;
+}
+
+void RtpPacketList::releaseTcpBuffer() const {
+    std::lock_guard<std::mutex> lck(_tcp_buffer_mtx);
+    _tcp_buffer = nullptr;
+}
+
+bool RtpPacketList::isSingleTrack(TrackType type) const {
+    for (auto &rtp : *this) {
+        if (rtp->type != type) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<void> RtspMediaSource::addTcpReader() {
+    ++_tcp_readers;
+    std::weak_ptr<RtspMediaSource> weak_self = std::static_pointer_cast<RtspMediaSource>(shared_from_this());
+    return std::shared_ptr<void>(nullptr, [weak_self](void *) {
+        auto strong_self = weak_self.lock();
+        if (strong_self && --strong_self->_tcp_readers < 2) {
+            // 共享连续内存只在多个tcp播放器时使用
+            strong_self->releaseTcpBuffers();
+        }
+    });
+}
+
+std::shared_ptr<void> RtspMediaSource::addSimulcastReader() {
+    ++_simulcast_readers;
+    std::weak_ptr<RtspMediaSource> weak_self = std::static_pointer_cast<RtspMediaSource>(shared_from_this());
+    return std::shared_ptr<void>(nullptr, [weak_self](void *) {
+        if (auto strong_self = weak_self.lock()) {
+            --strong_self->_simulcast_readers;
+        }
+    });
+}
+
+Buffer::Ptr RtspMediaSource::getTcpBuffer(const RingDataType &pkt) {
+    bool created = false;
+    auto ret = pkt->getTcpBuffer(&created);
+    if (created && pkt->size() > 1) {
+        std::lock_guard<std::mutex> lck(_tcp_lists_mtx);
+        // rtp包组基本按写入顺序被环形缓冲释放，从头部清理已失效的记录
+        while (!_tcp_lists.empty() && _tcp_lists.front().expired()) {
+            _tcp_lists.pop_front();
+        }
+        _tcp_lists.emplace_back(pkt);
+    }
+    return ret;
+}
+
+void RtspMediaSource::releaseTcpBuffers() {
+    std::deque<std::weak_ptr<RtpPacketList>> lists;
+    {
+        std::lock_guard<std::mutex> lck(_tcp_lists_mtx);
+        lists.swap(_tcp_lists);
+    }
+    for (auto &weak_list : lists) {
+        if (auto list = weak_list.lock()) {
+            list->releaseTcpBuffer();
+        }
+    }
+}
+
 void RtspMediaSource::setSdp(const std::string &sdp) {
     SdpParser sdp_parser(sdp);
     _tracks[TrackVideo] = sdp_parser.getTrack(TrackVideo);
@@ -71,7 +165,7 @@ void RtspMediaSource::onWrite(RtpPacket::Ptr rtp, bool keyPos) {
         }
     }
     bool is_video = rtp->type == TrackVideo;
-    PacketCache<RtpPacket>::inputPacket(stamp, is_video, std::move(rtp), keyPos);
+    PacketCache<RtpPacket, FlushPolicy, RtpPacketList>::inputPacket(stamp, is_video, std::move(rtp), keyPos);
 }
 
 RtspMediaSourceImp::RtspMediaSourceImp(const MediaTuple& tuple, int ringSize): RtspMediaSource(tuple, ringSize)
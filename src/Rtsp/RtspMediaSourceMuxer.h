@@ -11,6 +11,7 @@
 #ifndef ZLMEDIAKIT_RTSPMEDIASOURCEMUXER_H
 #define ZLMEDIAKIT_RTSPMEDIASOURCEMUXER_H
 
+#include <atomic>
 #include "RtspMuxer.h"
 #include "Rtsp/RtspMediaSource.h"
 
@@ -64,8 +65,7 @@ public:
     }
 
     bool inputFrame(const Frame::Ptr &frame) override {
-        if (_clear_cache && _option.rtsp_demand) {
-            _clear_cache = false;
+        if (_option.rtsp_demand && _clear_cache.exchange(false)) {
             _media_src->clearCache();
         }
         if (_enabled || !_option.rtsp_demand) {
@@ -76,12 +76,14 @@ public:
 
     bool isEnabled() {
         //缓存尚未清空时，还允许触发inputFrame函数，以便及时清空缓存
-        return _option.rtsp_demand ? (_clear_cache ? true : _enabled) : true;
+        return _option.rtsp_demand ? (_clear_cache || _enabled) : true;
     }
 
 private:
-    bool _enabled = true;
-    bool _clear_cache = false;
+    // 并行复用时onReaderChanged(归属线程)与inputFrame(复用线程)不在同一线程，
+    // 所以使用原子变量；_clear_cache通过exchange保证缓存只在复用线程清空一次
+    std::atomic<bool> _enabled { true };
+    std::atomic<bool> _clear_cache { false };
     ProtocolOption _option;
     RtspMediaSource::Ptr _media_src;
 };
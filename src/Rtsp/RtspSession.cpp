@@ -11,6 +11,7 @@
 #include <atomic>
 #include <iomanip>
 #include "Common/config.h"
+#include "Common/StreamProfiler.h"
 #include "UDPServer.h"
 #include "RtspSession.h"
 #include "Util/MD5.h"
@@ -117,6 +118,7 @@ void RtspSession::onManager() {
 void RtspSession::onRecv(const Buffer::Ptr &buf) {
     _alive_ticker.resetTime();
     _bytes_usage += buf->size();
+    Metrics::addBytesIn(Metrics::kRtsp, buf->size());
     if (_on_recv) {
         //http poster的请求数据转发给http getter处理
         _on_recv(buf);
@@ -857,6 +859,9 @@ void RtspSession::handleReq_Play(const Parser &parser) {
     if (!_play_reader && _rtp_type != Rtsp::RTP_MULTICAST) {
         weak_ptr<RtspSession> weak_self = static_pointer_cast<RtspSession>(shared_from_this());
         _play_reader = play_src->getRing()->attach(getPoller(), use_gop);
+        if (_rtp_type == Rtsp::RTP_TCP) {
+            _tcp_reader_ref = play_src->addTcpReader();
+        }
         _play_reader->setGetInfoCB([weak_self]() {
             Any ret;
             ret.set(static_pointer_cast<SockInfo>(weak_self.lock()));
@@ -869,11 +874,23 @@ void RtspSession::handleReq_Play(const Parser &parser) {
             }
             strong_self->shutdown(SockException(Err_shutdown, "rtsp ring buffer detached"));
         });
-        _play_reader->setReadCB([weak_self](const RtspMediaSource::RingDataType &pack) {
+        auto profiler = StreamProfiler::get(*play_src);
+        _play_reader->setReadCB([weak_self, profiler](const RtspMediaSource::RingDataType &pack) {
             auto strong_self = weak_self.lock();
             if (!strong_self) {
                 return;
             }
+            if (profiler) {
+                // 只统计实际发送给该播放器的track
+                size_t bytes = 0;
+                auto track = strong_self->_target_play_track;
+                pack->for_each([&](const RtpPacket::Ptr &rtp) {
+                    if (track == TrackInvalid || track == rtp->type) {
+                        bytes += rtp->size();
+                    }
+                });
+                profiler->addBytesOut(bytes);
+            }
             strong_self->sendRtpPacket(pack);
         });
     }
@@ -1105,6 +1122,7 @@ ssize_t RtspSession::send(Buffer::Ptr pkt){
 //		DebugP(this) << pkt->data();
 //	}
     _bytes_usage += pkt->size();
+    Metrics::addBytesOut(Metrics::kRtsp, pkt->size());
     return Session::send(std::move(pkt));
 }
 
@@ -1187,6 +1205,7 @@ toolkit::EventPoller::Ptr RtspSession::getOwnerPoller(MediaSource &sender) {
 
 void RtspSession::onBeforeRtpSorted(const RtpPacket::Ptr &rtp, int track_index){
     updateRtcpContext(rtp);
+    _tcp_batch_sender.flush();
 }
 
 void RtspSession::updateRtcpContext(const RtpPacket::Ptr &rtp){
@@ -1208,8 +1227,8 @@ void RtspSession::updateRtcpContext(const RtpPacket::Ptr &rtp){
         static auto send_rtcp = [](RtspSession *thiz, int index, Buffer::Ptr ptr) {
             if (thiz->_rtp_type == Rtsp::RTP_TCP) {
                 auto &track = thiz->_sdp_track[index];
-                thiz->send(makeRtpOverTcpPrefix((uint16_t)(ptr->size()), track->_interleaved + 1));
-                thiz->send(std::move(ptr));
+                thiz->_tcp_batch_sender.input(makeRtpOverTcpPrefix((uint16_t)(ptr->size()), track->_interleaved + 1));
+                thiz->_tcp_batch_sender.input(std::move(ptr));
             } else {
                 thiz->_rtcp_socks[index]->send(std::move(ptr));
             }
@@ -1228,15 +1247,25 @@ void RtspSession::updateRtcpContext(const RtpPacket::Ptr &rtp){
 void RtspSession::sendRtpPacket(const RtspMediaSource::RingDataType &pkt) {
     switch (_rtp_type) {
         case Rtsp::RTP_TCP: {
-            setSendFlushFlag(false);
+            auto src = _play_src.lock();
+            if (src && src->tcpReaderCount() > 1 && (_target_play_track == TrackInvalid || pkt->isSingleTrack(_target_play_track))) {
+                // 多个播放器且本组rtp包全部需要发送，那么直接发送所有播放器共享的连续内存，
+                // 这样每个播放器每组rtp包只产生一次Buffer拷贝，而不是每个rtp包都一次；
+                // 只有一个播放器时拼接连续内存反而多一次内存拷贝，所以逐包发送
+                _tcp_batch_sender.input(src->getTcpBuffer(pkt));
+                // rtp放入发送缓存后再更新rtcp上下文，确保sender report不会早于其统计的rtp发送
+                pkt->for_each([&](const RtpPacket::Ptr &rtp) { updateRtcpContext(rtp); });
+                _tcp_batch_sender.flush();
+                break;
+            }
             pkt->for_each([&](const RtpPacket::Ptr &rtp) {
                 if (_target_play_track == TrackInvalid || _target_play_track == rtp->type) {
+                    _tcp_batch_sender.input(rtp);
                     updateRtcpContext(rtp);
-                    send(rtp);
                 }
             });
-            flushAll();
-            setSendFlushFlag(true);
+            // rtcp与rtp一起flush
+            _tcp_batch_sender.flush();
         }
             break;
         case Rtsp::RTP_UDP: {
@@ -1253,13 +1282,14 @@ void RtspSession::sendRtpPacket(const RtspMediaSource::RingDataType &pkt) {
                         return;
                     }
                     _bytes_usage += rtp->size() - RtpPacket::kRtpTcpHeaderSize;
-                    sock->send(std::make_shared<BufferRtp>(rtp, RtpPacket::kRtpTcpHeaderSize), nullptr, 0, false);
+                    Metrics::addBytesOut(Metrics::kRtsp, rtp->size() - RtpPacket::kRtpTcpHeaderSize);
+                    auto &sender = _rtp_batch_senders[rtp->type];
+                    sender.setSocket(sock);
+                    sender.input(std::make_shared<BufferRtp>(rtp, RtpPacket::kRtpTcpHeaderSize));
                 }
             });
-            for (auto &sock : rtp_socks) {
-                if (sock) {
-                    sock->flushAll();
-                }
+            for (auto &sender : _rtp_batch_senders) {
+                sender.flush();
             }
         }
             break;
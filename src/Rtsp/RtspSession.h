@@ -21,6 +21,10 @@
 #include "RtspMediaSource.h"
 #include "RtspMediaSourceImp.h"
 #include "RtpMultiCaster.h"
+#include "Common/UdpBatchSender.h"
+#include "Common/TcpBatchSender.h"
+#include "Common/KtlsSession.h"
+#include "Common/Metrics.h"
 
 namespace mediakit {
 
@@ -180,6 +184,8 @@ private:
     std::weak_ptr<RtspMediaSource> _play_src;
     //直播源读取器
     RtspMediaSource::RingType::RingReader::Ptr _play_reader;
+    // 登记为rtsp over tcp播放器，用于判断是否共享连续内存
+    std::shared_ptr<void> _tcp_reader_ref;
     //sdp里面有效的track,包含音频或视频
     std::vector<SdpTrack::Ptr> _sdp_track;
     //播放器setup指定的播放track,默认为TrackInvalid表示不指定即音视频都推
@@ -190,6 +196,10 @@ private:
     toolkit::Socket::Ptr _rtp_socks[2];
     //RTCP端口,trackid idx 为数组下标
     toolkit::Socket::Ptr _rtcp_socks[2];
+    //RTP批量发送器,TrackType为数组下标
+    UdpBatchSender _rtp_batch_senders[2];
+    //RTP over tcp合并写发送队列
+    TcpBatchSender _tcp_batch_sender { this, Metrics::kRtsp };
     //标记是否收到播放的udp打洞包,收到播放的udp打洞包后才能知道其外网udp端口号
     std::unordered_set<int> _udp_connected_flags;
     ////////RTSP over HTTP  ////////
@@ -202,12 +212,14 @@ private:
     toolkit::Ticker _rtcp_send_tickers[2];
     //统计rtp并发送rtcp
     std::vector<RtcpContext::Ptr> _rtcp_context;
+    //会话个数统计
+    Metrics::SessionCounter _metrics { Metrics::kRtsp };
 };
 
 /**
  * 支持ssl加密的rtsp服务器，可用于诸如亚马逊echo show这样的设备访问
  */
-using RtspSessionWithSSL = toolkit::SessionWithSSL<RtspSession>;
+using RtspSessionWithSSL = SessionWithKTLS<RtspSession>;
 
 } /* namespace mediakit */
 
@@ -11,8 +11,10 @@
 #ifndef ZLMEDIAKIT_TSMEDIASOURCEMUXER_H
 #define ZLMEDIAKIT_TSMEDIASOURCEMUXER_H
 
+#include <atomic>
 #include "TSMediaSource.h"
 #include "Record/MPEG.h"
+#include "Record/HlsRecorder.h"
 
 namespace mediakit {
 
@@ -52,11 +54,10 @@ public:
     }
 
     bool inputFrame(const Frame::Ptr &frame) override {
-        if (_clear_cache && _option.ts_demand) {
-            _clear_cache = false;
+        if (_option.ts_demand && _clear_cache.exchange(false)) {
             _media_src->clearCache();
         }
-        if (_enabled || !_option.ts_demand) {
+        if (_enabled || !_option.ts_demand || (_hls && _hls->isEnabled())) {
             return MpegMuxer::inputFrame(frame);
         }
         return false;
@@ -64,12 +65,34 @@ public:
 
     bool isEnabled() {
         //缓存尚未清空时，还允许触发inputFrame函数，以便及时清空缓存
-        return _option.ts_demand ? (_clear_cache ? true : _enabled) : true;
+        return (_option.ts_demand ? (_clear_cache || _enabled) : true) || (_hls && _hls->isEnabled());
+    }
+
+    /**
+     * 与hls共享ts复用结果，设置后hls不再单独复用，而是直接使用本对象生成的ts数据
+     * @param hls 置空则取消共享
+     */
+    void setHlsRecorder(HlsRecorder::Ptr hls) {
+        if (_hls == hls) {
+            return;
+        }
+        // 切换前后ts数据来源不同(连续计数器、PAT/PMT不连续)，强制hls结束当前切片，新切片从下个关键帧开始
+        if (_hls) {
+            _hls->inputTS(nullptr, 0, false);
+        }
+        if (hls) {
+            hls->inputTS(nullptr, 0, false);
+        }
+        _hls = std::move(hls);
     }
 
 protected:
     void onWrite(std::shared_ptr<toolkit::Buffer> buffer, uint64_t timestamp, bool key_pos) override {
-        if (!buffer) {
+        if (_hls) {
+            _hls->inputTS(buffer, timestamp, key_pos);
+        }
+        if (!buffer || (!_enabled && _option.ts_demand)) {
+            // 仅hls需要ts数据时，不写入http-ts
             return;
         }
         auto packet = std::make_shared<TSPacket>(std::move(buffer));
@@ -78,10 +101,13 @@ protected:
     }
 
 private:
-    bool _enabled = true;
-    bool _clear_cache = false;
+    // 并行复用时onReaderChanged(归属线程)与inputFrame(复用线程)不在同一线程，
+    // 所以使用原子变量；_clear_cache通过exchange保证缓存只在复用线程清空一次
+    std::atomic<bool> _enabled { true };
+    std::atomic<bool> _clear_cache { false };
     ProtocolOption _option;
     TSMediaSource::Ptr _media_src;
+    HlsRecorder::Ptr _hls;
 };
 
 }//namespace mediakit
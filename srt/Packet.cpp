@@ -432,6 +432,11 @@ uint32_t HandshakePacket::getSynCookie(uint8_t *buf, size_t len) {
     return loadUint32(ptr);
 }
 
+uint32_t HandshakePacket::getSrtSocketID(uint8_t *buf, size_t len) {
+    uint8_t *ptr = buf + HEADER_SIZE + 6 * 4;
+    return loadUint32(ptr);
+}
+
 void HandshakePacket::assignPeerIP(struct sockaddr_storage *addr) {
     memset(peer_ip_addr, 0, sizeof(peer_ip_addr) * sizeof(peer_ip_addr[0]));
     if (addr->ss_family == AF_INET) {
@@ -543,7 +548,7 @@ bool NAKPacket::storeToData() {
 
     uint8_t *ptr = (uint8_t *)_data->data() + HEADER_SIZE;
 
-    for (auto it : lost_list) {
+    for (auto &it : lost_list) {
         if (it.first + 1 == it.second) {
             storeUint32(ptr, it.first);
             ptr[0] = ptr[0] & 0x7f;
@@ -562,9 +567,9 @@ bool NAKPacket::storeToData() {
     return true;
 }
 
-size_t NAKPacket::getCIFSize(std::list<LostPair> &lost) {
+size_t NAKPacket::getCIFSize(const std::vector<LostPair> &lost) {
     size_t size = 0;
-    for (auto it : lost) {
+    for (auto &it : lost) {
         if (it.first + 1 == it.second) {
             size += 4;
         } else {
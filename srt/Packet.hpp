@@ -201,6 +201,7 @@ public:
     static bool isHandshakePacket(uint8_t *buf, size_t len);
     static uint32_t getHandshakeType(uint8_t *buf, size_t len);
     static uint32_t getSynCookie(uint8_t *buf, size_t len);
+    static uint32_t getSrtSocketID(uint8_t *buf, size_t len);
     static uint32_t
     generateSynCookie(struct sockaddr_storage *addr, TimePoint ts, uint32_t current_cookie = 0, int correction = 0);
     std::string dump();
@@ -288,8 +289,8 @@ public:
     bool loadFromData(uint8_t *buf, size_t len) override;
     bool storeToData() override;
 
-    std::list<LostPair> lost_list;
-    static size_t getCIFSize(std::list<LostPair> &lost);
+    std::vector<LostPair> lost_list;
+    static size_t getCIFSize(const std::vector<LostPair> &lost);
 };
 
 /*
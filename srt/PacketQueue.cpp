@@ -1,7 +1,10 @@
 ﻿#include "PacketQueue.hpp"
+#include "Common/macros.h"
 
 namespace SRT {
 
+using mediakit::countTrailingZero;
+
 static inline bool isSeqEdge(uint32_t seq, uint32_t cap) {
     if (seq > (MAX_SEQ - cap)) {
         return true;
@@ -39,246 +42,46 @@ static inline bool isTSCycle(uint32_t first, uint32_t second) {
     }
 }
 
-PacketQueue::PacketQueue(uint32_t max_size, uint32_t init_seq, uint32_t latency)
-    : _pkt_cap(max_size)
-    , _pkt_latency(latency)
-    , _pkt_expected_seq(init_seq) {}
-
-void PacketQueue::tryInsertPkt(DataPacket::Ptr pkt) {
-    if (_pkt_expected_seq <= pkt->packet_seq_number) {
-        auto diff = pkt->packet_seq_number - _pkt_expected_seq;
-        if (diff >= (MAX_SEQ >> 1)) {
-            TraceL << "drop packet too later for cycle "
-                   << "expected seq=" << _pkt_expected_seq << " pkt seq=" << pkt->packet_seq_number;
-            return;
-        } else {
-            _pkt_map.emplace(pkt->packet_seq_number, pkt);
-        }
-    } else {
-        auto diff = _pkt_expected_seq - pkt->packet_seq_number;
-        if (diff >= (MAX_SEQ >> 1)) {
-            _pkt_map.emplace(pkt->packet_seq_number, pkt);
-            TraceL << " cycle packet "
-                   << "expected seq=" << _pkt_expected_seq << " pkt seq=" << pkt->packet_seq_number;
-        } else {
-            // TraceL << "drop packet too later "<< "expected seq=" << _pkt_expected_seq << " pkt seq=" <<
-            // pkt->packet_seq_number;
-        }
-    }
-}
-
-bool PacketQueue::inputPacket(DataPacket::Ptr pkt, std::list<DataPacket::Ptr> &out) {
-    tryInsertPkt(pkt);
-    auto it = _pkt_map.find(_pkt_expected_seq);
-    while (it != _pkt_map.end()) {
-        out.push_back(it->second);
-        _pkt_map.erase(it);
-        _pkt_expected_seq = genExpectedSeq(_pkt_expected_seq + 1);
-        it = _pkt_map.find(_pkt_expected_seq);
-    }
-
-    while (_pkt_map.size() > _pkt_cap) {
-        // 防止回环
-        it = _pkt_map.find(_pkt_expected_seq);
-        if (it != _pkt_map.end()) {
-            out.push_back(it->second);
-            _pkt_map.erase(it);
-        }
-        _pkt_expected_seq = genExpectedSeq(_pkt_expected_seq + 1);
-    }
-
-    while (timeLatency() > _pkt_latency) {
-        it = _pkt_map.find(_pkt_expected_seq);
-        if (it != _pkt_map.end()) {
-            out.push_back(it->second);
-            _pkt_map.erase(it);
-        }
-        _pkt_expected_seq = genExpectedSeq(_pkt_expected_seq + 1);
-    }
-
-    return true;
-}
-
-bool PacketQueue::drop(uint32_t first, uint32_t last, std::list<DataPacket::Ptr> &out) {
-    uint32_t end = genExpectedSeq(last + 1);
-    decltype(_pkt_map.end()) it;
-    for (uint32_t i = _pkt_expected_seq; i < end;) {
-        it = _pkt_map.find(i);
-        if (it != _pkt_map.end()) {
-            out.push_back(it->second);
-            _pkt_map.erase(it);
-        }
-        i = genExpectedSeq(i + 1);
-    }
-    _pkt_expected_seq = end;
-    return true;
-}
-
-uint32_t PacketQueue::timeLatency() {
-    if (_pkt_map.empty()) {
-        return 0;
-    }
-
-    auto first = _pkt_map.begin()->second->timestamp;
-    auto last = _pkt_map.rbegin()->second->timestamp;
-    uint32_t dur;
-    if (last > first) {
-        dur = last - first;
-    } else {
-        dur = first - last;
-    }
-
-    if (dur > 0x80000000) {
-        dur = MAX_TS - dur;
-        WarnL << "cycle dur " << dur;
-    }
-
-    return dur;
-}
-
-std::list<PacketQueue::LostPair> PacketQueue::getLostSeq() {
-    std::list<PacketQueue::LostPair> re;
-    if (_pkt_map.empty()) {
-        return re;
-    }
-
-    if (getExpectedSize() == getSize()) {
-        return re;
-    }
-
-    uint32_t end = 0;
-    uint32_t first, last;
-
-    first = _pkt_map.begin()->second->packet_seq_number;
-    last = _pkt_map.rbegin()->second->packet_seq_number;
-    if ((last - first) > (MAX_SEQ >> 1)) {
-        TraceL << " cycle seq first " << first << " last " << last << " size " << _pkt_map.size();
-        end = first;
-    } else {
-        end = last;
-    }
-    PacketQueue::LostPair lost;
-    lost.first = 0;
-    lost.second = 0;
-
-    uint32_t i = _pkt_expected_seq;
-    bool finish = true;
-    for (i = _pkt_expected_seq; i <= end;) {
-        if (_pkt_map.find(i) == _pkt_map.end()) {
-            if (finish) {
-                finish = false;
-                lost.first = i;
-                lost.second = genExpectedSeq(i + 1);
-            } else {
-                lost.second = genExpectedSeq(i + 1);
-            }
-        } else {
-            if (!finish) {
-                finish = true;
-                re.push_back(lost);
-            }
-        }
-        i = genExpectedSeq(i + 1);
-    }
-
-    return re;
-}
-
-size_t PacketQueue::getSize() {
-    return _pkt_map.size();
-}
-
-size_t PacketQueue::getExpectedSize() {
-    if (_pkt_map.empty()) {
-        return 0;
-    }
-
-    uint32_t max = _pkt_map.rbegin()->first;
-    uint32_t min = _pkt_map.begin()->first;
-    if ((max - min) >= (MAX_SEQ >> 1)) {
-        TraceL << "cycle "
-               << "expected seq " << _pkt_expected_seq << " min " << min << " max " << max << " size "
-               << _pkt_map.size();
-        return MAX_SEQ - _pkt_expected_seq + min + 1;
-    } else {
-        return max - _pkt_expected_seq + 1;
-    }
-}
-
-size_t PacketQueue::getAvailableBufferSize() {
-    auto size = getExpectedSize();
-    if (_pkt_cap > size) {
-        return _pkt_cap - size;
-    }
-
-    if (_pkt_cap > _pkt_map.size()) {
-        return _pkt_cap - _pkt_map.size();
-    }
-    WarnL << " cap " << _pkt_cap << " expected size " << size << " map size " << _pkt_map.size();
-    return _pkt_cap;
-}
-
-uint32_t PacketQueue::getExpectedSeq() {
-    return _pkt_expected_seq;
-}
-
-std::string PacketQueue::dump() {
-    _StrPrinter printer;
-    if (_pkt_map.empty()) {
-        printer << " expected seq :" << _pkt_expected_seq;
-    } else {
-        printer << " expected seq :" << _pkt_expected_seq << " size:" << _pkt_map.size()
-                << " first:" << _pkt_map.begin()->second->packet_seq_number;
-        printer << " last:" << _pkt_map.rbegin()->second->packet_seq_number;
-        printer << " latency:" << timeLatency() / 1e3;
-    }
-    return std::move(printer);
-}
-
-//////////////////// PacketRecvQueue //////////////////////////////////
-
 PacketRecvQueue::PacketRecvQueue(uint32_t max_size, uint32_t init_seq, uint32_t latency, uint32_t flag)
     : _pkt_cap(max_size)
     , _pkt_latency(latency)
     , _pkt_expected_seq(init_seq)
     , _srt_flag(flag)
-    , _pkt_buf(max_size) {}
+    , _pkt_buf(max_size)
+    , _bitmap((max_size + 63) / 64) {}
 
 bool  PacketRecvQueue::TLPKTDrop(){
     return (_srt_flag&HSExtMessage::HS_EXT_MSG_TLPKTDROP) && (_srt_flag &HSExtMessage::HS_EXT_MSG_TSBPDRCV);
 }
-bool PacketRecvQueue::inputPacket(DataPacket::Ptr pkt, std::list<DataPacket::Ptr> &out) {
+
+void PacketRecvQueue::popFront(std::vector<DataPacket::Ptr> &out) {
+    if (testBit(_start)) {
+        out.emplace_back(std::move(_pkt_buf[_start]));
+        _pkt_buf[_start] = nullptr;
+        clearBit(_start);
+        _size--;
+    }
+    _start = (_start + 1) % _pkt_cap;
+    if (_span) {
+        _span--;
+    }
+    _pkt_expected_seq = genExpectedSeq(_pkt_expected_seq + 1);
+}
+
+bool PacketRecvQueue::inputPacket(DataPacket::Ptr pkt, std::vector<DataPacket::Ptr> &out) {
     // TraceL << dump() << " seq:" << pkt->packet_seq_number;
-    while (_size > 0 && _start == _end) {
-        if (_pkt_buf[_start]) {
-            out.push_back(_pkt_buf[_start]);
-            _size--;
-            _pkt_buf[_start] = nullptr;
-        }
-        _start = (_start + 1) % _pkt_cap;
-        _pkt_expected_seq = genExpectedSeq(_pkt_expected_seq + 1);
+    if (_span == _pkt_cap) {
+        // 缓存已满，腾出一个位置
+        popFront(out);
     }
 
-    tryInsertPkt(pkt);
+    tryInsertPkt(std::move(pkt));
 
-    DataPacket::Ptr it = _pkt_buf[_start];
-    while (it) {
-        out.push_back(it);
-        _size--;
-        _pkt_buf[_start] = nullptr;
-        _pkt_expected_seq = genExpectedSeq(_pkt_expected_seq + 1);
-        _start = (_start + 1) % _pkt_cap;
-        it = _pkt_buf[_start];
+    while (_size > 0 && testBit(_start)) {
+        popFront(out);
     }
     while (timeLatency() > _pkt_latency && TLPKTDrop()) {
-        it = _pkt_buf[_start];
-        if (it) {
-            _pkt_buf[_start] = nullptr;
-            out.push_back(it);
-            _size--;
-        }
-        _pkt_expected_seq = genExpectedSeq(_pkt_expected_seq + 1);
-        _start = (_start + 1) % _pkt_cap;
+        popFront(out);
     }
     return true;
 }
@@ -305,39 +108,39 @@ uint32_t PacketRecvQueue::timeLatency() {
 
     return dur;
 }
-std::list<PacketQueueInterface::LostPair> PacketRecvQueue::getLostSeq() {
-    std::list<PacketQueueInterface::LostPair> re;
-    if (_size <= 0) {
-        return re;
-    }
 
-    if (getExpectedSize() == getSize()) {
-        return re;
+void PacketRecvQueue::getLostSeq(std::vector<LostPair> &lost) {
+    lost.clear();
+    if (_size <= 0 || _span == _size) {
+        return;
     }
 
-    LostPair lost;
-    uint32_t steup = 0;
     bool finish = true;
-
-    for (uint32_t i = _start; i != _end;) {
-        if (!_pkt_buf[i]) {
-            if (finish) {
-                finish = false;
-                lost.first = _pkt_expected_seq + steup;
-                lost.second = genExpectedSeq(lost.first + 1);
+    uint32_t i = 0;
+    while (i < _span) {
+        auto pos = (_start + i) % _pkt_cap;
+        // 一次检查一个位图字，不跨越缓存末尾与span末尾
+        auto n = std::min(std::min<uint32_t>(64 - (pos & 63), _pkt_cap - pos), _span - i);
+        auto mask = n == 64 ? ~(uint64_t)0 : (((uint64_t)1 << n) - 1);
+        auto bits = (_bitmap[pos >> 6] >> (pos & 63)) & mask;
+        if (bits == mask && finish) {
+            // 这一组全部收到
+            i += n;
+            continue;
+        }
+        for (uint32_t j = 0; j < n; ++j, ++i) {
+            if (!((bits >> j) & 1)) {
+                if (finish) {
+                    finish = false;
+                    lost.emplace_back(genExpectedSeq(_pkt_expected_seq + i), genExpectedSeq(_pkt_expected_seq + i + 1));
+                } else {
+                    lost.back().second = genExpectedSeq(_pkt_expected_seq + i + 1);
+                }
             } else {
-                lost.second = genExpectedSeq(_pkt_expected_seq + steup + 1);
-            }
-        } else {
-            if (!finish) {
                 finish = true;
-                re.push_back(lost);
             }
         }
-        i = (i + 1) % _pkt_cap;
-        steup++;
     }
-    return re;
 }
 
 size_t PacketRecvQueue::getSize() {
@@ -347,24 +150,7 @@ size_t PacketRecvQueue::getExpectedSize() {
     if (_size <= 0) {
         return 0;
     }
-
-    uint32_t max, min;
-    auto first = _pkt_expected_seq;
-    auto last = getLast()->packet_seq_number;
-    if (last >= first) {
-        max = last;
-        min = first;
-    } else {
-        max = first;
-        min = last;
-    }
-    if ((max - min) >= (MAX_SEQ >> 1)) {
-        TraceL << "cycle "
-               << "expected seq " << _pkt_expected_seq << " min " << min << " max " << max << " size " << _size;
-        return MAX_SEQ - _pkt_expected_seq + min + 1;
-    } else {
-        return max - _pkt_expected_seq + 1;
-    }
+    return _span;
 }
 size_t PacketRecvQueue::getAvailableBufferSize() {
     auto size = getExpectedSize();
@@ -392,15 +178,15 @@ std::string PacketRecvQueue::dump() {
         printer << " last:" << getLast()->packet_seq_number;
         printer << " latency:" << timeLatency() / 1e3;
         printer << " start:" << _start;
-        printer << " end:" << _end;
+        printer << " span:" << _span;
     }
     return std::move(printer);
 }
-bool PacketRecvQueue::drop(uint32_t first, uint32_t last, std::list<DataPacket::Ptr> &out) {
+bool PacketRecvQueue::drop(uint32_t first, uint32_t last, std::vector<DataPacket::Ptr> &out) {
     uint32_t diff = 0;
     if (isSeqCycle(_pkt_expected_seq, last)) {
         if (last < _pkt_expected_seq) {
-            diff = MAX_SEQ - _pkt_expected_seq + last + 1;
+            diff = genExpectedSeq(last - _pkt_expected_seq) + 1;
         } else {
             WarnL << "drop first " << first << " last " << last << " expected " << _pkt_expected_seq;
             return false;
@@ -419,48 +205,21 @@ bool PacketRecvQueue::drop(uint32_t first, uint32_t last, std::list<DataPacket::
     }
 
     for (uint32_t i = 0; i < diff; i++) {
-        auto pos = (i + _start) % _pkt_cap;
-        if (_pkt_buf[pos]) {
-            out.push_back(_pkt_buf[pos]);
-            _pkt_buf[pos] = nullptr;
-            _size--;
-        }
-    }
-
-    _pkt_expected_seq = genExpectedSeq(last + 1);
-    _start = (diff + _start) % _pkt_cap;
-    if (_size <= 0) {
-        _end = _start;
-        WarnL;
+        popFront(out);
     }
     return true;
 }
 
 void PacketRecvQueue::insertToCycleBuf(DataPacket::Ptr pkt, uint32_t diff) {
     auto pos = (_start + diff) % _pkt_cap;
-
-    if (!_pkt_buf[pos]) {
-        _size++;
-    } else {
+    if (testBit(pos)) {
         // WarnL << "repate packet " << pkt->packet_seq_number;
         return;
     }
-    _pkt_buf[pos] = pkt;
-
-    if (_start <= _end && pos >= _end) {
-        _end = (pos + 1) % _pkt_cap;
-        return;
-    }
-
-    if (_start <= _end && pos < _start) {
-        _end = (pos + 1) % _pkt_cap;
-        return;
-    }
-
-    if (_start > _end && _end <= pos && _start > pos) {
-        _end = (pos + 1) % _pkt_cap;
-        return;
-    }
+    _pkt_buf[pos] = std::move(pkt);
+    setBit(pos);
+    _size++;
+    _span = std::max(_span, diff + 1);
 }
 void PacketRecvQueue::tryInsertPkt(DataPacket::Ptr pkt) {
     if (_pkt_expected_seq <= pkt->packet_seq_number) {
@@ -477,12 +236,13 @@ void PacketRecvQueue::tryInsertPkt(DataPacket::Ptr pkt) {
                 return;
             }
 
-            insertToCycleBuf(pkt, diff);
+            insertToCycleBuf(std::move(pkt), diff);
         }
     } else {
         auto diff = _pkt_expected_seq - pkt->packet_seq_number;
         if (diff >= (MAX_SEQ >> 1)) {
-            diff = MAX_SEQ - diff;
+            // 序号空间为2^31，回环后的距离
+            diff = genExpectedSeq(pkt->packet_seq_number - _pkt_expected_seq);
             if (diff >= _pkt_cap) {
                 WarnL << "too new "
                       << "expected seq=" << _pkt_expected_seq << " pkt seq=" << pkt->packet_seq_number << " cap "
@@ -490,10 +250,9 @@ void PacketRecvQueue::tryInsertPkt(DataPacket::Ptr pkt) {
                 return;
             }
 
-            insertToCycleBuf(pkt, diff);
-
             TraceL << " cycle packet "
                    << "expected seq=" << _pkt_expected_seq << " pkt seq=" << pkt->packet_seq_number;
+            insertToCycleBuf(std::move(pkt), diff);
         } else {
             // TraceL << "drop packet too later "
             //<< "expected seq=" << _pkt_expected_seq << " pkt seq=" << pkt->packet_seq_number;
@@ -505,33 +264,24 @@ DataPacket::Ptr PacketRecvQueue::getFirst() {
         return nullptr;
     }
 
+    // 按位图字查找第一个已收到的槽位
     uint32_t i = _start;
     while (1) {
-        if (_pkt_buf[i]) {
-            return _pkt_buf[i];
+        auto bits = _bitmap[i >> 6] >> (i & 63);
+        if (bits) {
+            return _pkt_buf[i + countTrailingZero(bits)];
+        }
+        i = (i | 63) + 1;
+        if (i >= _pkt_cap) {
+            i = 0;
         }
-        i = (i + 1) % _pkt_cap;
     }
 }
 DataPacket::Ptr PacketRecvQueue::getLast() {
     if (_size <= 0) {
         return nullptr;
     }
-    uint32_t steup = 1;
-    uint32_t i = (_end + _pkt_cap - steup) % _pkt_cap;
-    /*
-    while (1) {
-        if (_pkt_buf[i]) {
-            _end = (i + 1) % _pkt_cap;
-            return _pkt_buf[i];
-        }
-        i = (_end + _pkt_cap - steup) % _pkt_cap;
-        steup++;
-    }
-    */
-    if (!_pkt_buf[i]) {
-        WarnL << "start " << _start << " end" << _end << " size " << _size;
-    }
-    return _pkt_buf[i];
+    // span的最后一个槽位总是已收到的包
+    return _pkt_buf[(_start + _span - 1) % _pkt_cap];
 }
-} // namespace SRT
\ No newline at end of file
+} // namespace SRT
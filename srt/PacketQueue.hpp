@@ -2,8 +2,6 @@
 #define ZLMEDIAKIT_SRT_PACKET_QUEUE_H
 #include "Packet.hpp"
 #include <algorithm>
-#include <list>
-#include <map>
 #include <memory>
 #include <tuple>
 #include <utility>
@@ -18,10 +16,16 @@ public:
 
     PacketQueueInterface() = default;
     virtual ~PacketQueueInterface() = default;
-    virtual bool inputPacket(DataPacket::Ptr pkt, std::list<DataPacket::Ptr> &out) = 0;
+    /**
+     * 输入收到的数据包，按序可交付的包追加到out
+     */
+    virtual bool inputPacket(DataPacket::Ptr pkt, std::vector<DataPacket::Ptr> &out) = 0;
 
     virtual uint32_t timeLatency() = 0;
-    virtual std::list<LostPair> getLostSeq() = 0;
+    /**
+     * 获取丢包区间(左闭右开)，结果覆盖写入lost，调用方复用lost可以避免内存分配
+     */
+    virtual void getLostSeq(std::vector<LostPair> &lost) = 0;
 
     virtual size_t getSize() = 0;
     virtual size_t getExpectedSize() = 0;
@@ -29,48 +33,21 @@ public:
     virtual uint32_t getExpectedSeq() = 0;
 
     virtual std::string dump() = 0;
-    virtual bool drop(uint32_t first, uint32_t last, std::list<DataPacket::Ptr> &out) = 0;
-};
-// for recv
-class PacketQueue : public PacketQueueInterface {
-public:
-    using Ptr = std::shared_ptr<PacketQueue>;
-
-    PacketQueue(uint32_t max_size, uint32_t init_seq, uint32_t latency);
-    ~PacketQueue() = default;
-    bool inputPacket(DataPacket::Ptr pkt, std::list<DataPacket::Ptr> &out);
-
-    uint32_t timeLatency();
-    std::list<LostPair> getLostSeq();
-
-    size_t getSize();
-    size_t getExpectedSize();
-    size_t getAvailableBufferSize();
-    uint32_t getExpectedSeq();
-
-    std::string dump();
-    bool drop(uint32_t first, uint32_t last, std::list<DataPacket::Ptr> &out);
-
-private:
-    void tryInsertPkt(DataPacket::Ptr pkt);
-
-private:
-    uint32_t _pkt_cap;
-    uint32_t _pkt_latency;
-    uint32_t _pkt_expected_seq;
-    std::map<uint32_t, DataPacket::Ptr> _pkt_map;
+    virtual bool drop(uint32_t first, uint32_t last, std::vector<DataPacket::Ptr> &out) = 0;
 };
 
+// for recv
+// 以序号为下标的环形缓存，并用位图记录每个槽位是否已收到，查找丢包时可以按64个包一组跳过
 class PacketRecvQueue : public PacketQueueInterface {
 public:
     using Ptr = std::shared_ptr<PacketRecvQueue>;
 
     PacketRecvQueue(uint32_t max_size, uint32_t init_seq, uint32_t latency,uint32_t flag = 0xbf);
     ~PacketRecvQueue() = default;
-    bool inputPacket(DataPacket::Ptr pkt, std::list<DataPacket::Ptr> &out);
+    bool inputPacket(DataPacket::Ptr pkt, std::vector<DataPacket::Ptr> &out);
 
     uint32_t timeLatency();
-    std::list<LostPair> getLostSeq();
+    void getLostSeq(std::vector<LostPair> &lost);
 
     size_t getSize();
     size_t getExpectedSize();
@@ -78,15 +55,20 @@ public:
     uint32_t getExpectedSeq();
 
     std::string dump();
-    bool drop(uint32_t first, uint32_t last, std::list<DataPacket::Ptr> &out);
+    bool drop(uint32_t first, uint32_t last, std::vector<DataPacket::Ptr> &out);
 
 private:
     void tryInsertPkt(DataPacket::Ptr pkt);
     void insertToCycleBuf(DataPacket::Ptr pkt, uint32_t diff);
+    void popFront(std::vector<DataPacket::Ptr> &out);
     DataPacket::Ptr getFirst();
     DataPacket::Ptr getLast();
     bool TLPKTDrop();
 
+    bool testBit(uint32_t pos) const { return (_bitmap[pos >> 6] >> (pos & 63)) & 1; }
+    void setBit(uint32_t pos) { _bitmap[pos >> 6] |= (uint64_t)1 << (pos & 63); }
+    void clearBit(uint32_t pos) { _bitmap[pos >> 6] &= ~((uint64_t)1 << (pos & 63)); }
+
 private:
     uint32_t _pkt_cap;
     uint32_t _pkt_latency;
@@ -95,8 +77,12 @@ private:
     uint32_t _srt_flag;
 
     std::vector<DataPacket::Ptr> _pkt_buf;
+    // 槽位是否已收到包
+    std::vector<uint64_t> _bitmap;
+    // 期望序号所在槽位
     uint32_t _start = 0;
-    uint32_t _end = 0;
+    // 从期望序号到已收到的最大序号的槽位个数
+    uint32_t _span = 0;
     size_t _size = 0;
 };
 
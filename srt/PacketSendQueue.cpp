@@ -4,29 +4,46 @@ namespace SRT {
 
 PacketSendQueue::PacketSendQueue(uint32_t max_size, uint32_t latency,uint32_t flag)
     : _srt_flag(flag)
-    , _pkt_cap(max_size)
-    , _pkt_latency(latency) {}
+    , _pkt_cap(std::max<uint32_t>(max_size, 1))
+    , _pkt_latency(latency)
+    , _pkt_buf(_pkt_cap) {}
+
+void PacketSendQueue::popFront() {
+    _pkt_buf[_start] = nullptr;
+    _start = (_start + 1) % _pkt_cap;
+    _first_seq = genExpectedSeq(_first_seq + 1);
+    _size--;
+}
 
 bool PacketSendQueue::drop(uint32_t num) {
-    decltype(_pkt_cache.begin()) it;
-    for (it = _pkt_cache.begin(); it != _pkt_cache.end(); ++it) {
-        if ((*it)->packet_seq_number == num) {
-            break;
-        }
+    // 丢弃num之前的包
+    auto offset = genExpectedSeq(num - _first_seq);
+    if (offset >= _size) {
+        return true;
     }
-    if (it != _pkt_cache.end()) {
-        _pkt_cache.erase(_pkt_cache.begin(), it);
+    while (offset--) {
+        popFront();
     }
     return true;
 }
 
 bool PacketSendQueue::inputPacket(DataPacket::Ptr pkt) {
-    _pkt_cache.push_back(pkt);
-    while (_pkt_cache.size() > _pkt_cap) {
-        _pkt_cache.pop_front();
+    if (_size && genExpectedSeq(_first_seq + _size) != pkt->packet_seq_number) {
+        // 序号不连续(正常不会发生)，清空缓存重新开始
+        WarnL << "send seq not continuous, expected " << genExpectedSeq(_first_seq + _size) << " but " << pkt->packet_seq_number;
+        while (_size) {
+            popFront();
+        }
+    }
+    if (!_size) {
+        _first_seq = pkt->packet_seq_number;
+    }
+    if (_size == _pkt_cap) {
+        popFront();
     }
+    at(_size++) = std::move(pkt);
     while (timeLatency() > _pkt_latency && TLPKTDrop()) {
-        _pkt_cache.pop_front();
+        popFront();
     }
     return true;
 }
@@ -35,37 +52,29 @@ bool PacketSendQueue::TLPKTDrop(){
     return (_srt_flag&HSExtMessage::HS_EXT_MSG_TLPKTDROP) && (_srt_flag &HSExtMessage::HS_EXT_MSG_TSBPDSND);
 }
 
-std::list<DataPacket::Ptr> PacketSendQueue::findPacketBySeq(uint32_t start, uint32_t end) {
-    std::list<DataPacket::Ptr> re;
-    decltype(_pkt_cache.begin()) it;
-    for (it = _pkt_cache.begin(); it != _pkt_cache.end(); ++it) {
-        if ((*it)->packet_seq_number == start) {
-            break;
-        }
+void PacketSendQueue::findPacketBySeq(uint32_t start, uint32_t end, std::vector<DataPacket::Ptr> &out) {
+    out.clear();
+    auto first = genExpectedSeq(start - _first_seq);
+    if (first >= _size) {
+        return;
     }
-
-    if (start == end) {
-        if (it != _pkt_cache.end()) {
-            re.push_back(*it);
-        }
-        return re;
+    auto last = genExpectedSeq(end - _first_seq);
+    if (last < first || last >= _size) {
+        // end不在缓存中，发送到缓存末尾
+        last = _size - 1;
     }
-
-    for (; it != _pkt_cache.end(); ++it) {
-        re.push_back(*it);
-        if ((*it)->packet_seq_number == end) {
-            break;
-        }
+    out.reserve(last - first + 1);
+    for (auto i = first; i <= last; ++i) {
+        out.emplace_back(at(i));
     }
-    return re;
 }
 
 uint32_t PacketSendQueue::timeLatency() {
-    if (_pkt_cache.empty()) {
+    if (!_size) {
         return 0;
     }
-    auto first = _pkt_cache.front()->timestamp;
-    auto last = _pkt_cache.back()->timestamp;
+    auto first = at(0)->timestamp;
+    auto last = at(_size - 1)->timestamp;
     uint32_t dur;
 
     if (last > first) {
@@ -3,14 +3,14 @@
 
 #include "Packet.hpp"
 #include <algorithm>
-#include <list>
 #include <memory>
-#include <set>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 namespace SRT {
 
+// 发送缓存，序号连续的环形缓存，重传时按序号直接定位
 class PacketSendQueue {
 public:
     using Ptr = std::shared_ptr<PacketSendQueue>;
@@ -21,16 +21,26 @@ public:
 
     bool drop(uint32_t num);
     bool inputPacket(DataPacket::Ptr pkt);
-    std::list<DataPacket::Ptr> findPacketBySeq(uint32_t start, uint32_t end);
+    /**
+     * 查找[start, end]区间内的包，结果覆盖写入out
+     */
+    void findPacketBySeq(uint32_t start, uint32_t end, std::vector<DataPacket::Ptr> &out);
 
 private:
     uint32_t timeLatency();
     bool TLPKTDrop();
+    void popFront();
+    DataPacket::Ptr &at(uint32_t offset) { return _pkt_buf[(_start + offset) % _pkt_cap]; }
+
 private:
     uint32_t _srt_flag;
     uint32_t _pkt_cap;
     uint32_t _pkt_latency;
-    std::list<DataPacket::Ptr> _pkt_cache;
+    std::vector<DataPacket::Ptr> _pkt_buf;
+    uint32_t _start = 0;
+    uint32_t _size = 0;
+    // 缓存中第一个包的序号
+    uint32_t _first_seq = 0;
 };
 
 } // namespace SRT
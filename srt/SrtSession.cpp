@@ -3,6 +3,7 @@
 #include "SrtTransportImp.hpp"
 
 #include "Common/config.h"
+#include "Common/PollerHash.h"
 
 namespace SRT {
 using namespace mediakit;
@@ -23,13 +24,22 @@ void SrtSession::attachServer(const toolkit::Server &server) {
 extern SrtTransport::Ptr querySrtTransport(uint8_t *data, size_t size, const EventPoller::Ptr& poller);
 
 EventPoller::Ptr SrtSession::queryPoller(const Buffer::Ptr &buffer) {
-    auto transport = querySrtTransport((uint8_t *)buffer->data(), buffer->size(), nullptr);
+    auto data = (uint8_t *)buffer->data();
+    auto size = buffer->size();
+    if (HandshakePacket::isHandshakePacket(data, size)
+        && HandshakePacket::getHandshakeType(data, size) == HandshakePacket::HS_TYPE_INDUCTION) {
+        // 握手第一阶段，按对端socket id把SrtTransport固定分配到某个poller线程，
+        // 同一端口下的大量srt链接不会集中在同一个线程，后续握手与数据包都会找到该poller
+        return getPollerByHash(HandshakePacket::getSrtSocketID(data, size));
+    }
+    auto transport = querySrtTransport(data, size, nullptr);
     return transport ? transport->getPoller() : nullptr;
 }
 
 void SrtSession::onRecv(const Buffer::Ptr &buffer) {
     uint8_t *data = (uint8_t *)buffer->data();
     size_t size = buffer->size();
+    mediakit::Metrics::addBytesIn(mediakit::Metrics::kSrt, size);
 
     if (_find_transport) {
         //只允许寻找一次transport
@@ -3,6 +3,7 @@
 
 #include "Network/Session.h"
 #include "SrtTransport.hpp"
+#include "Common/Metrics.h"
 
 namespace SRT {
 
@@ -23,6 +24,8 @@ private:
     Ticker _ticker;
     struct sockaddr_storage _peer_addr;
     SrtTransport::Ptr _transport;
+    //会话个数统计
+    mediakit::Metrics::SessionCounter _metrics { mediakit::Metrics::kSrt };
 };
 
 } // namespace SRT
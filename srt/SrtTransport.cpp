@@ -7,6 +7,7 @@
 #include "Ack.hpp"
 #include "Packet.hpp"
 #include "SrtTransport.hpp"
+#include "Common/Metrics.h"
 
 namespace SRT {
 #define SRT_FIELD "srt."
@@ -375,14 +376,17 @@ void SrtTransport::handleNAK(uint8_t *buf, int len, struct sockaddr_storage *add
             flush = true;
         }
         empty = true;
-        auto re_list = _send_buf->findPacketBySeq(it.first, it.second - 1);
-        for (auto& pkt : re_list) {
+        _send_buf->findPacketBySeq(it.first, it.second - 1, _resend_pkts);
+        for (auto& pkt : _resend_pkts) {
             pkt->R = 1;
             pkt->storeToHeader();
             sendPacket(pkt, flush);
             empty = false;
         }
+        mediakit::Metrics::add(mediakit::Metrics::kSrtRetransmit, _resend_pkts.size());
+        _resend_pkts.clear();
         if (empty) {
+            mediakit::Metrics::add(mediakit::Metrics::kSrtDropReq);
             sendMsgDropReq(it.first, it.second - 1);
         }
     }
@@ -400,15 +404,14 @@ void SrtTransport::handleShutDown(uint8_t *buf, int len, struct sockaddr_storage
 void SrtTransport::handleDropReq(uint8_t *buf, int len, struct sockaddr_storage *addr) {
     MsgDropReqPacket pkt;
     pkt.loadFromData(buf, len);
-    std::list<DataPacket::Ptr> list;
     // TraceL<<"drop "<<pkt.first_pkt_seq_num<<" last "<<pkt.last_pkt_seq_num;
-    _recv_buf->drop(pkt.first_pkt_seq_num, pkt.last_pkt_seq_num, list);
+    _recv_buf->drop(pkt.first_pkt_seq_num, pkt.last_pkt_seq_num, _recv_pkts);
     //checkAndSendAckNak();
-    if (list.empty()) {
+    if (_recv_pkts.empty()) {
         return;
     }
     // uint32_t max_seq = 0;
-    for (auto& data : list) {
+    for (auto& data : _recv_pkts) {
         // max_seq = data->packet_seq_number;
         if (_last_pkt_seq + 1 != data->packet_seq_number) {
             TraceL << "pkt lost " << _last_pkt_seq + 1 << "->" << data->packet_seq_number;
@@ -416,6 +419,7 @@ void SrtTransport::handleDropReq(uint8_t *buf, int len, struct sockaddr_storage
         _last_pkt_seq = data->packet_seq_number;
         onSRTData(std::move(data));
     }
+    _recv_pkts.clear();
     /*
     _recv_nack.drop(max_seq);
 
@@ -435,9 +439,9 @@ void SrtTransport::checkAndSendAckNak(){
         nak_interval = 20 * 1000;
     }
     if (_nak_ticker.elapsedTime(_now) > nak_interval) {
-        auto lost = _recv_buf->getLostSeq();
-        if (!lost.empty()) {
-            sendNAKPacket(lost);
+        _recv_buf->getLostSeq(_lost_list);
+        if (!_lost_list.empty()) {
+            sendNAKPacket(_lost_list);
         }
         _nak_ticker.resetTime(_now);
     }
@@ -559,9 +563,9 @@ void SrtTransport::sendLightACKPacket() {
     TraceL << "send  ack " << pkt->dump();
 }
 
-void SrtTransport::sendNAKPacket(std::list<PacketQueue::LostPair> &lost_list) {
+void SrtTransport::sendNAKPacket(const std::vector<PacketQueueInterface::LostPair> &lost_list) {
+    mediakit::Metrics::add(mediakit::Metrics::kSrtNakSent);
     NAKPacket::Ptr pkt = std::make_shared<NAKPacket>();
-    std::list<PacketQueue::LostPair> tmp;
     auto size = NAKPacket::getCIFSize(lost_list);
     size_t paylaod_size = getPayloadSize();
     if (size > paylaod_size) {
@@ -569,21 +573,12 @@ void SrtTransport::sendNAKPacket(std::list<PacketQueue::LostPair> &lost_list) {
         size_t num = paylaod_size / 8;
 
         size_t msgNum = (lost_list.size() + num - 1) / num;
-        decltype(lost_list.begin()) cur, next;
         for (size_t i = 0; i < msgNum; ++i) {
-            cur = lost_list.begin();
-            std::advance(cur, i * num);
-
-            if (i == msgNum - 1) {
-                next = lost_list.end();
-            } else {
-                next = lost_list.begin();
-                std::advance(next, (i + 1) * num);
-            }
-            tmp.assign(cur, next);
+            auto cur = lost_list.begin() + i * num;
+            auto next = (i == msgNum - 1) ? lost_list.end() : lost_list.begin() + (i + 1) * num;
             pkt->dst_socket_id = _peer_socket_id;
             pkt->timestamp = DurationCountMicroseconds(_now - _start_timestamp);
-            pkt->lost_list = tmp;
+            pkt->lost_list.assign(cur, next);
             pkt->storeToData();
             sendControlPacket(pkt, true);
         }
@@ -613,15 +608,14 @@ void SrtTransport::handleDataPacket(uint8_t *buf, int len, struct sockaddr_stora
 
     _estimated_link_capacity_context->inputPacket(_now,pkt);
 
-    std::list<DataPacket::Ptr> list;
     //TraceL<<" seq="<< pkt->packet_seq_number<<" ts="<<pkt->timestamp<<" size="<<pkt->payloadSize()<<\
     //" PP="<<(int)pkt->PP<<" O="<<(int)pkt->O<<" kK="<<(int)pkt->KK<<" R="<<(int)pkt->R;
-    _recv_buf->inputPacket(pkt, list);
-    if (list.empty()) {
+    _recv_buf->inputPacket(std::move(pkt), _recv_pkts);
+    if (_recv_pkts.empty()) {
         // when no data ok send nack to sender immediately
     } else {
         // uint32_t last_seq;
-        for (auto& data : list) {
+        for (auto& data : _recv_pkts) {
             // last_seq = data->packet_seq_number;
             if (_last_pkt_seq + 1 != data->packet_seq_number) {
                 TraceL << "pkt lost " << _last_pkt_seq + 1 << "->" << data->packet_seq_number;
@@ -629,6 +623,7 @@ void SrtTransport::handleDataPacket(uint8_t *buf, int len, struct sockaddr_stora
             _last_pkt_seq = data->packet_seq_number;
             onSRTData(std::move(data));
         }
+        _recv_pkts.clear();
 
         //_recv_nack.drop(last_seq);
     }
@@ -691,10 +686,14 @@ void SrtTransport::sendControlPacket(ControlPacket::Ptr pkt, bool flush) {
 
 void SrtTransport::sendPacket(Buffer::Ptr pkt, bool flush) {
     if (_selected_session) {
+        mediakit::Metrics::addBytesOut(mediakit::Metrics::kSrt, pkt->size());
         auto tmp = _packet_pool.obtain2();
         tmp->assign(pkt->data(), pkt->size());
-        _selected_session->setSendFlushFlag(flush);
-        _selected_session->send(std::move(tmp));
+        _udp_batch_sender.setSocket(_selected_session->getSock());
+        _udp_batch_sender.input(std::move(tmp));
+        if (flush) {
+            _udp_batch_sender.flush();
+        }
     } else {
         WarnL << "not reach this";
     }
@@ -764,9 +763,10 @@ void SrtTransport::onSendTSData(const Buffer::Ptr &buffer, bool flush) {
         pkt->msg_number = _send_msg_number++;
         pkt->dst_socket_id = _peer_socket_id;
         pkt->timestamp = DurationCountMicroseconds(SteadyClock::now() - _start_timestamp);
-        sendDataPacket(pkt, ptr, (int)payloadSize, flush);
         ptr += payloadSize;
         size -= payloadSize;
+        // 一个ts合并写缓存被切分为多个srt包，只在最后一个包时刷新
+        sendDataPacket(pkt, ptr - payloadSize, (int)payloadSize, flush && !size);
     }
 
     if (size > 0 && ptr < end) {
@@ -10,8 +10,8 @@
 #include "Poller/EventPoller.h"
 #include "Poller/Timer.h"
 #include "Common/Stamp.h"
+#include "Common/UdpBatchSender.h"
 #include "Common.hpp"
-#include "NackContext.hpp"
 #include "Packet.hpp"
 #include "PacketQueue.hpp"
 #include "PacketSendQueue.hpp"
@@ -82,7 +82,7 @@ private:
     void handlePeerError(uint8_t *buf, int len, struct sockaddr_storage *addr);
     void handleDataPacket(uint8_t *buf, int len, struct sockaddr_storage *addr);
 
-    void sendNAKPacket(std::list<PacketQueue::LostPair> &lost_list);
+    void sendNAKPacket(const std::vector<PacketQueueInterface::LostPair> &lost_list);
     void sendACKPacket();
     void sendLightACKPacket();
     void sendKeepLivePacket();
@@ -128,7 +128,10 @@ private:
     PacketSendQueue::Ptr _send_buf;
     uint32_t _buf_delay = 120;
     PacketQueueInterface::Ptr _recv_buf;
-    // NackContext _recv_nack;
+    // 收包、丢包统计、重传时复用的临时容器，避免每个包都分配内存
+    std::vector<DataPacket::Ptr> _recv_pkts;
+    std::vector<DataPacket::Ptr> _resend_pkts;
+    std::vector<PacketQueueInterface::LostPair> _lost_list;
     uint32_t _rtt = 100 * 1000;
     uint32_t _rtt_variance = 50 * 1000;
     uint32_t _light_ack_pkt_count = 0;
@@ -152,6 +155,7 @@ private:
     Timer::Ptr _handleshake_timer;
 
     ResourcePool<BufferRaw> _packet_pool;
+    UdpBatchSender _udp_batch_sender;
 
     //检测超时的定时器
     Timer::Ptr _timer;
@@ -0,0 +1,126 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_TESTS_FANOUTBENCH_H
+#define ZLMEDIAKIT_TESTS_FANOUTBENCH_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include "Util/util.h"
+#include "Util/List.h"
+#include "Network/Buffer.h"
+#include "Rtmp/RtmpMediaSource.h"
+
+// test_rtmp_fanout/test_flv_fanout/test_rtsp_fanout共用的分发测试工具
+
+/**
+ * 模拟播放器连接的发送队列，只缓存待发送数据，不真正发送
+ */
+class FanoutSendQueue {
+public:
+    void push(toolkit::Buffer::Ptr buffer) { _queue.emplace_back(std::move(buffer)); }
+
+    std::string dump() const {
+        std::string ret;
+        _queue.for_each([&](const toolkit::Buffer::Ptr &buf) { ret.append(buf->data(), buf->size()); });
+        return ret;
+    }
+
+    void clear() { _queue.clear(); }
+
+private:
+    toolkit::List<toolkit::Buffer::Ptr> _queue;
+};
+
+/**
+ * 模拟一个关键帧合并写后的rtmp包组(视频帧与音频帧交替)
+ */
+inline mediakit::RtmpPacketList::Ptr makeFanoutRtmpList(size_t count, uint32_t stamp) {
+    using namespace mediakit;
+    auto ret = std::make_shared<RtmpPacketList>();
+    for (size_t i = 0; i < count; ++i) {
+        auto pkt = RtmpPacket::create();
+        bool video = i % 2 == 0;
+        pkt->type_id = video ? MSG_VIDEO : MSG_AUDIO;
+        pkt->chunk_id = video ? CHUNK_VIDEO : CHUNK_AUDIO;
+        pkt->stream_index = STREAM_MEDIA;
+        pkt->time_stamp = stamp + (uint32_t)i * 20;
+        pkt->buffer.assign(video ? 16 * 1024 : 400, 'a' + i % 26);
+        pkt->body_size = pkt->buffer.size();
+        ret->emplace_back(std::move(pkt));
+    }
+    return ret;
+}
+
+/**
+ * 对比分发时每个播放器逐包处理与共享同一份序列化结果的cpu开销并打印
+ * @param title 测试名称
+ * @param readers 播放器个数
+ * @param per_packet 旧的方式，处理所有播放器
+ * @param shared 新的方式，处理所有播放器
+ */
+template <typename PerPacket, typename Shared>
+void benchFanout(const std::string &title, size_t readers, const char *per_packet_name, PerPacket &&per_packet,
+                 const char *shared_name, Shared &&shared) {
+    auto start = toolkit::getCurrentMicrosecond();
+    per_packet();
+    auto per_packet_us = toolkit::getCurrentMicrosecond() - start;
+
+    start = toolkit::getCurrentMicrosecond();
+    shared();
+    auto shared_us = toolkit::getCurrentMicrosecond() - start;
+
+    std::cout << title << " 播放器个数:" << readers
+              << " " << per_packet_name << "(ns/播放器):" << per_packet_us * 1000 / readers
+              << " " << shared_name << "(ns/播放器):" << shared_us * 1000 / readers << std::endl;
+}
+
+/**
+ * 模拟播放器版本的benchFanout，Session需实现sendPerPacket/sendShared/clear
+ */
+template <typename Session, typename List>
+void benchFanoutSessions(const std::string &title, std::vector<Session> &sessions, const List &list,
+                         const char *per_packet_name, const char *shared_name) {
+    auto run = [&](bool shared) {
+        for (auto &session : sessions) {
+            if (shared) {
+                session.sendShared(list);
+            } else {
+                session.sendPerPacket(list);
+            }
+        }
+        for (auto &session : sessions) {
+            session.clear();
+        }
+    };
+    benchFanout(title, sessions.size(), per_packet_name, [&]() { run(false); }, shared_name, [&]() { run(true); });
+}
+
+/**
+ * 校验模拟播放器共享序列化结果与逐包处理的输出一致
+ * @param expect 返回逐包处理的输出
+ */
+template <typename Session, typename List>
+bool checkFanoutSession(Session &session, const List &list, std::string *expect = nullptr) {
+    session.clear();
+    session.sendPerPacket(list);
+    auto per_packet = session.dump();
+    session.clear();
+    session.sendShared(list);
+    auto shared = session.dump();
+    session.clear();
+    if (expect) {
+        *expect = per_packet;
+    }
+    return shared == per_packet;
+}
+
+#endif // ZLMEDIAKIT_TESTS_FANOUTBENCH_H
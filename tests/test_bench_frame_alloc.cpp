@@ -0,0 +1,103 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <vector>
+#include <iostream>
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Common/config.h"
+#include "Common/ObjectPool.h"
+#include "Common/JemallocUtil.h"
+#include "Common/MultiMediaSourceMuxer.h"
+#include "Extension/Factory.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+// 1280x720 h264 high profile sps/pps
+static const char s_sps[] = "\x00\x00\x00\x01\x67\x64\x00\x1f\xac\xd9\x40\x50\x05\xbb\x01\x10\x00\x00\x03\x00\x10\x00\x00\x03\x03\xc0\xf1\x83\x19\x60";
+static const char s_pps[] = "\x00\x00\x00\x01\x68\xeb\xe3\xcb\x22\xc0";
+
+static Frame::Ptr makeFrame(uint8_t nal_type, size_t size, uint64_t stamp) {
+    auto buffer = BufferRaw::create();
+    buffer->setCapacity(size + 5);
+    // 负载不能包含00 00 01起始码
+    memset(buffer->data(), 0x55, size + 5);
+    memcpy(buffer->data(), "\x00\x00\x00\x01", 4);
+    buffer->data()[4] = nal_type;
+    // first_mb_in_slice为0，代表一帧的开始
+    buffer->data()[5] = (char)0x88;
+    buffer->setSize(size + 5);
+    return Factory::getFrameFromBuffer(CodecH264, buffer, stamp, stamp);
+}
+
+struct AllocCount {
+    uint64_t malloc_count;
+    ObjectPool::Statistic pool;
+};
+
+static AllocCount getAllocCount() {
+    AllocCount ret;
+    ret.malloc_count = JemallocUtil::get_malloc_count();
+    ret.pool = ObjectPool::getThreadStatistic();
+    return ret;
+}
+
+// 该测试程序统计稳定转发时(rtsp/rtmp/ts/fmp4复用)平均每帧的内存申请次数
+// 用法: test_bench_frame_alloc [预热帧数] [统计帧数]
+// 使用jemalloc编译时(-DENABLE_JEMALLOC_STATIC=ON)同时打印jemalloc统计的malloc次数
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LWarn));
+    size_t warm_up = argc > 1 ? atoi(argv[1]) : 500;
+    size_t count = argc > 2 ? atoi(argv[2]) : 2000;
+
+    // 模拟1Mbps 25fps流，gop为50帧，关键帧32KB，普通帧4KB
+    vector<Frame::Ptr> frames;
+    for (size_t i = 0; i < warm_up + count; ++i) {
+        auto key = i % 50 == 0;
+        frames.emplace_back(makeFrame(key ? 0x65 : 0x41, key ? 32 * 1024 : 4 * 1024, i * 40));
+    }
+
+    ProtocolOption option;
+    option.enable_rtsp = true;
+    option.enable_rtmp = true;
+    option.enable_ts = true;
+    option.enable_fmp4 = true;
+    option.enable_hls = false;
+    option.enable_hls_fmp4 = false;
+    option.enable_mp4 = false;
+    MediaTuple tuple { DEFAULT_VHOST, "bench", "alloc", "" };
+    auto muxer = std::make_shared<MultiMediaSourceMuxer>(tuple, 0, option);
+    muxer->addTrack(Factory::getTrackByCodecId(CodecH264));
+    muxer->addTrackCompleted();
+    muxer->inputFrame(Factory::getFrameFromPtr(CodecH264, s_sps, sizeof(s_sps) - 1, 0, 0));
+    muxer->inputFrame(Factory::getFrameFromPtr(CodecH264, s_pps, sizeof(s_pps) - 1, 0, 0));
+
+    for (size_t i = 0; i < warm_up; ++i) {
+        muxer->inputFrame(frames[i]);
+    }
+    auto start = getAllocCount();
+    for (size_t i = warm_up; i < frames.size(); ++i) {
+        muxer->inputFrame(frames[i]);
+    }
+    auto end = getAllocCount();
+
+    auto hit = end.pool.hit - start.pool.hit;
+    auto miss = end.pool.miss - start.pool.miss;
+    cout << "统计帧数:" << count
+         << " 对象池命中(次/帧):" << (double)hit / count
+         << " 对象池未命中(次/帧):" << (double)miss / count;
+    if (end.malloc_count) {
+        cout << " jemalloc malloc(次/帧):" << (double)(end.malloc_count - start.malloc_count) / count;
+    }
+    cout << endl;
+    return 0;
+}
@@ -0,0 +1,92 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <vector>
+#include <iostream>
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Common/config.h"
+#include "Common/MultiMediaSourceMuxer.h"
+#include "Extension/Factory.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+// 1280x720 h264 high profile sps/pps
+static const char s_sps[] = "\x00\x00\x00\x01\x67\x64\x00\x1f\xac\xd9\x40\x50\x05\xbb\x01\x10\x00\x00\x03\x00\x10\x00\x00\x03\x03\xc0\xf1\x83\x19\x60";
+static const char s_pps[] = "\x00\x00\x00\x01\x68\xeb\xe3\xcb\x22\xc0";
+
+static Frame::Ptr makeFrame(uint8_t nal_type, size_t size, uint64_t stamp) {
+    auto buffer = BufferRaw::create();
+    buffer->setCapacity(size + 5);
+    // 负载不能包含00 00 01起始码
+    memset(buffer->data(), 0x55, size + 5);
+    memcpy(buffer->data(), "\x00\x00\x00\x01", 4);
+    buffer->data()[4] = nal_type;
+    buffer->setSize(size + 5);
+    return Factory::getFrameFromBuffer(CodecH264, buffer, stamp, stamp);
+}
+
+// 模拟高码率流，gop为50帧，关键帧512KB，普通帧128KB
+static vector<Frame::Ptr> makeFrames(size_t count) {
+    vector<Frame::Ptr> ret;
+    for (size_t i = 0; i < count; ++i) {
+        auto key = i % 50 == 0;
+        ret.emplace_back(makeFrame(key ? 0x65 : 0x41, key ? 512 * 1024 : 128 * 1024, i * 40));
+    }
+    return ret;
+}
+
+static double bench(const string &stream, uint32_t threads, const vector<Frame::Ptr> &frames) {
+    mINI::Instance()[General::kParallelMuxThreads] = threads;
+    NOTICE_EMIT(BroadcastReloadConfigArgs, Broadcast::kBroadcastReloadConfig);
+
+    ProtocolOption option;
+    option.enable_rtsp = true;
+    option.enable_rtmp = true;
+    option.enable_ts = true;
+    option.enable_fmp4 = true;
+    option.enable_hls = true;
+    option.enable_hls_fmp4 = true;
+    option.enable_mp4 = false;
+    MediaTuple tuple { DEFAULT_VHOST, "bench", stream, "" };
+    auto muxer = std::make_shared<MultiMediaSourceMuxer>(tuple, 0, option);
+    auto track = Factory::getTrackByCodecId(CodecH264);
+    muxer->addTrack(track);
+    muxer->addTrackCompleted();
+    muxer->inputFrame(Factory::getFrameFromPtr(CodecH264, s_sps, sizeof(s_sps) - 1, 0, 0));
+    muxer->inputFrame(Factory::getFrameFromPtr(CodecH264, s_pps, sizeof(s_pps) - 1, 0, 0));
+
+    auto start = getCurrentMicrosecond();
+    for (auto &frame : frames) {
+        muxer->inputFrame(frame);
+    }
+    // resetTracks会等待并行复用线程处理完已经投递的帧
+    muxer->resetTracks();
+    auto elapsed = getCurrentMicrosecond() - start;
+    return frames.size() * 1000000.0 / elapsed;
+}
+
+// 该测试程序用于对比MultiMediaSourceMuxer串行复用与并行复用时的帧率
+// 用法: test_bench_mux [并行复用线程数] [帧数]
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LWarn));
+    uint32_t threads = argc > 1 ? atoi(argv[1]) : 4;
+    size_t count = argc > 2 ? atoi(argv[2]) : 2000;
+    auto frames = makeFrames(count);
+
+    auto serial = bench("serial", 0, frames);
+    auto parallel = bench("parallel", threads, frames);
+    cout << "帧数:" << count
+         << " 串行复用(帧/秒):" << (uint64_t)serial
+         << " 并行复用" << threads << "线程(帧/秒):" << (uint64_t)parallel << endl;
+    return 0;
+}
@@ -0,0 +1,113 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <random>
+#include <string>
+#include <iostream>
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Extension/NalScanner.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+// 最原始的逐字节查找，作为对比基准
+static const char *findNaive(const char *ptr, const char *end) {
+    for (; ptr + 2 < end; ++ptr) {
+        if (ptr[0] == 0 && ptr[1] == 0 && ptr[2] == 1) {
+            return ptr;
+        }
+    }
+    return nullptr;
+}
+
+// 生成随机数据，zero_ratio控制0字节密度，越大起始码与伪起始码(00 00 00, 00 00 02等)越多
+static string makeRandomData(std::mt19937 &rng, size_t size, int zero_ratio) {
+    string ret;
+    ret.resize(size);
+    for (auto &ch : ret) {
+        auto val = rng() % 256;
+        if ((int)(rng() % 100) < zero_ratio) {
+            val = rng() % 3 ? 0 : 1;
+        }
+        ch = (char)val;
+    }
+    return ret;
+}
+
+// 遍历所有起始位置与结束位置，对比所有命中结果
+static bool fuzz(std::mt19937 &rng, int rounds) {
+    for (int i = 0; i < rounds; ++i) {
+        auto data = makeRandomData(rng, 1 + rng() % 300, rng() % 100);
+        auto begin = data.data();
+        auto end = begin + data.size();
+        for (auto start = begin; start <= end; ++start) {
+            auto stop = start + rng() % (end - start + 1);
+            for (auto ptr = start;; ++ptr) {
+                auto expect = findNaive(ptr, stop);
+                if (findNalStartCode(ptr, stop) != expect || findNalStartCodeScalar(ptr, stop) != expect) {
+                    ErrorL << "查找结果不一致, size:" << data.size() << " offset:" << (ptr - begin) << " end:" << (stop - begin)
+                           << "\n" << hexdump(begin, data.size());
+                    return false;
+                }
+                if (!expect) {
+                    break;
+                }
+                ptr = expect;
+            }
+        }
+    }
+    return true;
+}
+
+static size_t countNal(const char *(*func)(const char *, const char *), const string &data) {
+    size_t count = 0;
+    auto end = data.data() + data.size();
+    for (auto ptr = func(data.data(), end); ptr; ptr = func(ptr + 3, end)) {
+        ++count;
+    }
+    return count;
+}
+
+static void bench(const char *name, const char *(*func)(const char *, const char *), const string &data, int loops) {
+    size_t count = 0;
+    auto start = getCurrentMicrosecond();
+    for (int i = 0; i < loops; ++i) {
+        count += countNal(func, data);
+    }
+    auto elapsed = getCurrentMicrosecond() - start;
+    cout << name << " 起始码个数:" << count / loops << " 吞吐量(MB/s):" << (uint64_t)(data.size() * loops / (double)elapsed) << endl;
+}
+
+// 该测试程序随机对比simd与标量起始码查找结果，并测试单核查找吞吐量
+// 用法: test_bench_nal_scan [fuzz轮数] [benchmark循环次数]
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    int rounds = argc > 1 ? atoi(argv[1]) : 2000;
+    int loops = argc > 2 ? atoi(argv[2]) : 20;
+
+    std::mt19937 rng(0x20240101);
+    InfoL << "起始码查找实现:" << getNalStartCodeScanner();
+    if (!fuzz(rng, rounds)) {
+        return -1;
+    }
+    InfoL << "fuzz测试通过, 轮数:" << rounds;
+
+    // 模拟码流: 64MB随机数据，平均每64KB一个nal
+    string data = makeRandomData(rng, 64 * 1024 * 1024, 0);
+    for (size_t pos = 0; pos + 4 < data.size(); pos += 1024 + rng() % (128 * 1024)) {
+        data.replace(pos, 4, "\x00\x00\x00\x01", 4);
+    }
+    bench("naive ", findNaive, data, loops);
+    bench("scalar", findNalStartCodeScalar, data, loops);
+    bench(getNalStartCodeScanner(), findNalStartCode, data, loops);
+    return 0;
+}
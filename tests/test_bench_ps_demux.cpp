@@ -0,0 +1,191 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include "Util/File.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Common/config.h"
+#include "Rtp/PSDecoder.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+#if defined(ENABLE_RTPPROXY)
+
+static void appendPESHeader(string &out, uint8_t stream_id, size_t payload_size, bool have_pts, int64_t pts) {
+    size_t header_len = have_pts ? 5 : 0;
+    size_t len = 3 + header_len + payload_size;
+    out.append("\x00\x00\x01", 3);
+    out.push_back(stream_id);
+    out.push_back((char)(len >> 8));
+    out.push_back((char)(len & 0xFF));
+    out.push_back((char)0x80);
+    out.push_back((char)(have_pts ? 0x80 : 0x00));
+    out.push_back((char)header_len);
+    if (have_pts) {
+        out.push_back((char)(0x21 | ((pts >> 29) & 0x0E)));
+        out.push_back((char)(pts >> 22));
+        out.push_back((char)(0x01 | ((pts >> 14) & 0xFE)));
+        out.push_back((char)(pts >> 7));
+        out.push_back((char)(0x01 | ((pts << 1) & 0xFE)));
+    }
+}
+
+// 生成一个ps包，包含一帧h264视频(关键帧附带psm)与一帧g711a音频
+static string makePSPacket(size_t frame_size, bool key, int64_t pts) {
+    string out;
+    // pack header, mpeg2, 无填充
+    out.append("\x00\x00\x01\xBA\x44\x00\x04\x00\x04\x01\x01\x89\xC3\xF8", 14);
+    if (key) {
+        // psm: h264(0xE0) + g711a(0xC0)
+        out.append("\x00\x00\x01\xBC\x00\x12\xE0\xFF\x00\x00\x00\x08\x1B\xE0\x00\x00\x90\xC0\x00\x00\x00\x00\x00\x00", 24);
+    }
+    string frame;
+    frame.append("\x00\x00\x00\x01", 4);
+    frame.push_back(key ? 0x65 : 0x41);
+    for (size_t i = frame.size(); i < frame_size; ++i) {
+        // 避免出现起始码
+        frame.push_back((char)(0x10 + i % 0xE0));
+    }
+    // 单个pes最大负载
+    static constexpr size_t kMaxPES = 65535 - 8;
+    for (size_t offset = 0; offset < frame.size(); offset += kMaxPES) {
+        auto size = MIN(kMaxPES, frame.size() - offset);
+        appendPESHeader(out, 0xE0, size, offset == 0, pts);
+        out.append(frame.data() + offset, size);
+    }
+    appendPESHeader(out, 0xC0, 320, true, pts);
+    out.append(320, (char)0xD5);
+    return out;
+}
+
+// 将ps文件按pack header拆分为多个输入块，模拟按rtp时间戳合并后的数据
+static vector<string> splitPS(const string &data) {
+    vector<string> ret;
+    size_t start = 0, pos = 0;
+    while (pos + 4 <= data.size()) {
+        auto ptr = (const uint8_t *)data.data() + pos;
+        if (ptr[0] || ptr[1] || ptr[2] != 1) {
+            // 结构错误，查找下一个pack header
+            auto next = data.find(string("\x00\x00\x01\xBA", 4), pos + 1);
+            pos = next == string::npos ? data.size() : next;
+            continue;
+        }
+        size_t len;
+        if (ptr[3] == 0xBA) {
+            if (pos != start) {
+                ret.emplace_back(data.substr(start, pos - start));
+                start = pos;
+            }
+            len = pos + 14 <= data.size() ? 14 + (ptr[13] & 0x07) : 4;
+        } else if (ptr[3] == 0xB9) {
+            len = 4;
+        } else {
+            len = pos + 6 <= data.size() ? 6 + ((ptr[4] << 8) | ptr[5]) : 4;
+        }
+        pos += len;
+    }
+    if (start < data.size()) {
+        ret.emplace_back(data.substr(start));
+    }
+    return ret;
+}
+
+// 模拟CommonRtpDecoder(CodecInvalid, 32 * 1024)：输入超过32KB时拆分，ps/pes包会跨越多次输入
+static vector<string> splitInput(const vector<string> &packets, size_t max_size) {
+    vector<string> ret;
+    for (auto &pkt : packets) {
+        for (size_t offset = 0; offset < pkt.size(); offset += max_size) {
+            ret.emplace_back(pkt.substr(offset, MIN(max_size, pkt.size() - offset)));
+        }
+    }
+    return ret;
+}
+
+struct BenchResult {
+    size_t frames = 0;
+    size_t bytes = 0;
+    uint64_t hash = 14695981039346656037ULL;
+    double mbps = 0;
+};
+
+static BenchResult bench(const vector<string> &packets, bool fast, int loops) {
+    mINI::Instance()[RtpProxy::kPSFastDemux] = fast;
+    NOTICE_EMIT(BroadcastReloadConfigArgs, Broadcast::kBroadcastReloadConfig);
+
+    BenchResult ret;
+    size_t total = 0;
+    auto start = getCurrentMicrosecond();
+    for (int i = 0; i < loops; ++i) {
+        auto decoder = std::make_shared<PSDecoder>();
+        decoder->setOnDecode([&](int stream, int codecid, int flags, int64_t pts, int64_t dts, const void *data, size_t bytes) {
+            if (i) {
+                return;
+            }
+            // 只在第一轮统计输出，用于对比两种解析方式结果是否一致
+            ++ret.frames;
+            ret.bytes += bytes;
+            for (size_t j = 0; j < bytes; ++j) {
+                ret.hash = (ret.hash ^ ((const uint8_t *)data)[j]) * 1099511628211ULL;
+            }
+        });
+        for (auto &pkt : packets) {
+            decoder->input((const uint8_t *)pkt.data(), pkt.size());
+            total += pkt.size();
+        }
+    }
+    auto elapsed = getCurrentMicrosecond() - start;
+    ret.mbps = total * 8.0 / elapsed;
+    return ret;
+}
+
+// 该测试程序对比通用ps_demuxer与快速ps解析的单核吞吐量
+// 用法: test_bench_ps_demux [rtp_proxy.dumpDir导出的ps文件] [循环次数]
+// 不指定文件时使用生成的4Mbps 25fps h264 + g711a ps流
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LWarn));
+    int loops = argc > 2 ? atoi(argv[2]) : 20;
+
+    vector<string> packets;
+    if (argc > 1) {
+        packets = splitPS(File::loadFile(argv[1]));
+    } else {
+        for (int i = 0; i < 25 * 60; ++i) {
+            bool key = i % 50 == 0;
+            packets.emplace_back(makePSPacket(key ? 150 * 1024 : 16 * 1024, key, i * 3600));
+        }
+    }
+    if (packets.empty()) {
+        ErrorL << "no ps data";
+        return -1;
+    }
+
+    auto split = splitInput(packets, 32 * 1024);
+    auto generic = bench(packets, false, loops);
+    auto fast = bench(packets, true, loops);
+    auto fast_split = bench(split, true, loops);
+    cout << "输入块数:" << packets.size() << " 32KB拆分后块数:" << split.size() << " 循环次数:" << loops << endl;
+    cout << "ps_demuxer 输出帧数:" << generic.frames << " 字节数:" << generic.bytes << " 吞吐量(Mbps):" << (uint64_t)generic.mbps << endl;
+    cout << "快速解析   输出帧数:" << fast.frames << " 字节数:" << fast.bytes << " 吞吐量(Mbps):" << (uint64_t)fast.mbps << endl;
+    cout << "32KB拆分   输出帧数:" << fast_split.frames << " 字节数:" << fast_split.bytes << " 吞吐量(Mbps):" << (uint64_t)fast_split.mbps << endl;
+    cout << "输出数据" << (generic.hash == fast.hash ? "一致" : "不一致") << ", 拆分输入输出数据" << (fast.hash == fast_split.hash ? "一致" : "不一致") << endl;
+    return generic.hash == fast.hash && fast.hash == fast_split.hash ? 0 : -1;
+}
+
+#else
+int main(int argc, char *argv[]) {
+    cout << "please ENABLE_RTPPROXY and then test" << endl;
+    return 0;
+}
+#endif // defined(ENABLE_RTPPROXY)
@@ -0,0 +1,151 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <map>
+#include <random>
+#include <vector>
+#include <iostream>
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "srt/PacketQueue.hpp"
+#include "srt/PacketSendQueue.hpp"
+
+using namespace std;
+using namespace toolkit;
+using namespace SRT;
+
+// ts负载大小
+static constexpr size_t kPayloadSize = 1316;
+
+struct BenchResult {
+    uint64_t sent = 0;
+    uint64_t lost = 0;
+    uint64_t reordered = 0;
+    uint64_t nak = 0;
+    uint64_t retransmit = 0;
+    uint64_t delivered = 0;
+    uint64_t disorder = 0;
+    double pps = 0;
+};
+
+static DataPacket::Ptr makePacket(uint32_t seq, uint32_t ts) {
+    auto pkt = std::make_shared<DataPacket>();
+    pkt->packet_seq_number = seq;
+    pkt->timestamp = ts;
+    return pkt;
+}
+
+// 模拟一路码率为mbps的srt推流，按loss概率丢包，按reorder概率乱序，
+// 接收端每nak_ms毫秒统计一次丢包，发送端经过rtt_ms后重传
+static BenchResult bench(uint32_t mbps, double loss, double reorder, uint32_t seconds, uint32_t init_seq) {
+    static constexpr uint32_t kLatencyMS = 120;
+    static constexpr uint32_t kRttMS = 20;
+    static constexpr uint32_t kNakMS = 20;
+    static constexpr uint32_t kBufSize = 8192;
+
+    BenchResult ret;
+    PacketRecvQueue recv_buf(kBufSize, init_seq, kLatencyMS * 1000);
+    PacketSendQueue send_buf(kBufSize, kLatencyMS * 1000);
+    mt19937 rng(1234);
+    uniform_real_distribution<double> dist(0, 1);
+
+    auto pkt_per_ms = mbps * 1000.0 * 1000 / 8 / kPayloadSize / 1000;
+    auto total = (uint64_t)(pkt_per_ms * 1000 * seconds);
+
+    vector<DataPacket::Ptr> out;
+    vector<PacketQueueInterface::LostPair> lost;
+    vector<DataPacket::Ptr> resend;
+    // 到达时间(微秒) -> 包
+    multimap<uint64_t, DataPacket::Ptr> in_flight;
+    uint32_t expected = init_seq;
+    uint64_t last_nak = 0;
+
+    auto deliver = [&]() {
+        for (auto &pkt : out) {
+            if (pkt->packet_seq_number != expected) {
+                ++ret.disorder;
+            }
+            expected = genExpectedSeq(pkt->packet_seq_number + 1);
+        }
+        ret.delivered += out.size();
+        out.clear();
+    };
+
+    auto start = getCurrentMicrosecond();
+    uint32_t seq = init_seq;
+    for (uint64_t i = 0; i < total; ++i) {
+        uint64_t now = (uint64_t)(i * 1000 / pkt_per_ms);
+        auto pkt = makePacket(seq, (uint32_t)now);
+        seq = genExpectedSeq(seq + 1);
+        send_buf.inputPacket(pkt);
+        ++ret.sent;
+
+        auto r = dist(rng);
+        if (r < loss) {
+            ++ret.lost;
+        } else if (r < loss + reorder) {
+            // 延后1~5ms到达
+            ++ret.reordered;
+            in_flight.emplace(now + 1000 + (uint64_t)(dist(rng) * 4000), std::move(pkt));
+        } else {
+            recv_buf.inputPacket(std::move(pkt), out);
+            deliver();
+        }
+
+        // 到期的乱序包与重传包
+        while (!in_flight.empty() && in_flight.begin()->first <= now) {
+            recv_buf.inputPacket(std::move(in_flight.begin()->second), out);
+            in_flight.erase(in_flight.begin());
+            deliver();
+        }
+
+        if (now - last_nak >= kNakMS * 1000) {
+            last_nak = now;
+            recv_buf.getLostSeq(lost);
+            if (!lost.empty()) {
+                ++ret.nak;
+            }
+            for (auto &pr : lost) {
+                send_buf.findPacketBySeq(pr.first, genExpectedSeq(pr.second - 1), resend);
+                for (auto &re : resend) {
+                    // 重传包同样可能丢失
+                    if (dist(rng) >= loss) {
+                        in_flight.emplace(now + kRttMS * 1000, re);
+                    }
+                    ++ret.retransmit;
+                }
+            }
+        }
+    }
+    auto elapsed = getCurrentMicrosecond() - start;
+    ret.pps = ret.sent * 1000000.0 / elapsed;
+    return ret;
+}
+
+// 该测试程序模拟srt接收端在丢包与乱序情况下的收包、丢包统计与重传，用于评估收发缓存的单核处理能力
+// 用法: test_bench_srt_queue [码率Mbps] [丢包率%] [乱序率%] [时长秒]
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LError));
+    uint32_t mbps = argc > 1 ? atoi(argv[1]) : 50;
+    double loss = (argc > 2 ? atof(argv[2]) : 2) / 100;
+    double reorder = (argc > 3 ? atof(argv[3]) : 1) / 100;
+    uint32_t seconds = argc > 4 ? atoi(argv[4]) : 60;
+
+    // 第二轮测试序号回环
+    for (auto init_seq : { (uint32_t)0, (uint32_t)(MAX_SEQ - 10000) }) {
+        auto ret = bench(mbps, loss, reorder, seconds, init_seq);
+        cout << "码率:" << mbps << "Mbps 时长:" << seconds << "s 起始序号:" << init_seq
+             << " 发送:" << ret.sent << " 丢包:" << ret.lost << " 乱序:" << ret.reordered
+             << " nak:" << ret.nak << " 重传:" << ret.retransmit
+             << " 交付:" << ret.delivered << " 交付乱序:" << ret.disorder
+             << " 处理速度(包/秒):" << (uint64_t)ret.pps << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <vector>
+#include <cstring>
+#include <iostream>
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Network/Buffer.h"
+#include "webrtc/SrtpSession.hpp"
+
+using namespace std;
+using namespace toolkit;
+using RTC::SrtpSession;
+
+// 即libsrtp的SRTP_MAX_TRAILER_LEN
+static constexpr size_t kMaxTrailerLen = 144;
+
+static vector<BufferRaw::Ptr> makePackets(size_t count, size_t size) {
+    vector<BufferRaw::Ptr> ret;
+    for (size_t i = 0; i < count; ++i) {
+        auto pkt = BufferRaw::create();
+        pkt->setCapacity(size + kMaxTrailerLen);
+        memset(pkt->data(), 0x55, size);
+        auto ptr = (uint8_t *)pkt->data();
+        // rtp头: v=2, pt=96, ssrc=0x12345678
+        ptr[0] = 0x80;
+        ptr[1] = 96;
+        ptr[2] = (i >> 8) & 0xFF;
+        ptr[3] = i & 0xFF;
+        memcpy(ptr + 8, "\x12\x34\x56\x78", 4);
+        pkt->setSize(size);
+        ret.emplace_back(std::move(pkt));
+    }
+    return ret;
+}
+
+static void makeKey(SrtpSession::CryptoSuite suite, vector<uint8_t> &key) {
+    key.resize(suite == SrtpSession::CryptoSuite::AEAD_AES_128_GCM ? 28 : (suite == SrtpSession::CryptoSuite::AEAD_AES_256_GCM ? 44 : 30));
+    for (size_t i = 0; i < key.size(); ++i) {
+        key[i] = (uint8_t)i;
+    }
+}
+
+// 返回每秒加密的包数，加密结果写入out
+static double bench(SrtpSession::CryptoSuite suite, const vector<BufferRaw::Ptr> &in, vector<BufferRaw::Ptr> &out) {
+    vector<uint8_t> key;
+    makeKey(suite, key);
+    SrtpSession session(SrtpSession::Type::OUTBOUND, suite, key.data(), key.size());
+
+    out.clear();
+    auto start = getCurrentMicrosecond();
+    for (auto &src : in) {
+        // 模拟WebRtcTransport::sendRtpPacket中的拷贝
+        auto pkt = BufferRaw::create();
+        pkt->setCapacity(src->size() + kMaxTrailerLen);
+        memcpy(pkt->data(), src->data(), src->size());
+        int size = (int)src->size();
+        session.EncryptRtp((uint8_t *)pkt->data(), &size);
+        pkt->setSize(size);
+        out.emplace_back(std::move(pkt));
+    }
+    auto elapsed = getCurrentMicrosecond() - start;
+    return in.size() * 1000000.0 / elapsed;
+}
+
+// 校验加密结果可以被正确解密
+static bool verify(SrtpSession::CryptoSuite suite, const vector<BufferRaw::Ptr> &in, const vector<BufferRaw::Ptr> &out) {
+    vector<uint8_t> key;
+    makeKey(suite, key);
+    SrtpSession session(SrtpSession::Type::INBOUND, suite, key.data(), key.size());
+    for (size_t i = 0; i < in.size(); ++i) {
+        int len = (int)out[i]->size();
+        if (!session.DecryptSrtp((uint8_t *)out[i]->data(), &len)) {
+            return false;
+        }
+        if ((size_t)len != in[i]->size() || memcmp(out[i]->data(), in[i]->data(), len)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 该测试程序用于对比webrtc下行各srtp加密套件单核的每秒加密包数
+// 用法: test_bench_srtp [包数] [包大小]
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LWarn));
+    size_t count = argc > 1 ? atoi(argv[1]) : 60000;
+    size_t size = argc > 2 ? atoi(argv[2]) : 1200;
+    // 序列号只有16位
+    count = MIN(count, (size_t)0xFFFF);
+    auto packets = makePackets(count, size);
+
+    static const pair<SrtpSession::CryptoSuite, const char *> suites[] = {
+        { SrtpSession::CryptoSuite::AEAD_AES_128_GCM, "AEAD_AES_128_GCM" },
+        { SrtpSession::CryptoSuite::AEAD_AES_256_GCM, "AEAD_AES_256_GCM" },
+        { SrtpSession::CryptoSuite::AES_CM_128_HMAC_SHA1_80, "AES_CM_128_HMAC_SHA1_80" },
+    };
+    vector<BufferRaw::Ptr> out;
+    for (auto &suite : suites) {
+        auto speed = bench(suite.first, packets, out);
+        cout << suite.second << " 包数:" << count << " 包大小:" << size
+             << " 加密(包/秒):" << (uint64_t)speed
+             << " 校验:" << (verify(suite.first, packets, out) ? "成功" : "失败") << endl;
+    }
+    return 0;
+}
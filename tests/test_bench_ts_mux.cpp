@@ -0,0 +1,150 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Common/config.h"
+#include "Extension/Factory.h"
+#include "Record/MPEG.h"
+#include "Rtp/TSDecoder.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+#if defined(ENABLE_HLS)
+
+// 1280x720 h264 high profile sps/pps
+static const char s_sps[] = "\x00\x00\x00\x01\x67\x64\x00\x1f\xac\xd9\x40\x50\x05\xbb\x01\x10\x00\x00\x03\x00\x10\x00\x00\x03\x03\xc0\xf1\x83\x19\x60";
+static const char s_pps[] = "\x00\x00\x00\x01\x68\xeb\xe3\xcb\x22\xc0";
+
+static Frame::Ptr makeVideoFrame(uint8_t nal_type, size_t size, uint64_t dts, uint64_t pts) {
+    auto buffer = BufferRaw::create();
+    buffer->setCapacity(size + 5);
+    memcpy(buffer->data(), "\x00\x00\x00\x01", 4);
+    buffer->data()[4] = nal_type;
+    for (size_t i = 5; i < size + 5; ++i) {
+        // 负载不能包含00 00 01起始码
+        buffer->data()[i] = (char)(0x10 + i % 0xE0);
+    }
+    buffer->setSize(size + 5);
+    return Factory::getFrameFromBuffer(CodecH264, buffer, dts, pts);
+}
+
+// 4Mbps 25fps h264(含b帧) + 8KHz g711a，gop为50帧
+static vector<Frame::Ptr> makeFrames(size_t count) {
+    static string s_audio(320, (char)0xD5);
+    vector<Frame::Ptr> ret;
+    ret.emplace_back(Factory::getFrameFromPtr(CodecH264, s_sps, sizeof(s_sps) - 1, 0, 0));
+    ret.emplace_back(Factory::getFrameFromPtr(CodecH264, s_pps, sizeof(s_pps) - 1, 0, 0));
+    for (size_t i = 0; i < count; ++i) {
+        auto key = i % 50 == 0;
+        auto dts = i * 40;
+        ret.emplace_back(makeVideoFrame(key ? 0x65 : 0x41, key ? 150 * 1024 : 16 * 1024, dts, key ? dts : dts + 80));
+        ret.emplace_back(Factory::getFrameFromPtr(CodecG711A, s_audio.data(), 320, dts, dts));
+        ret.emplace_back(Factory::getFrameFromPtr(CodecG711A, s_audio.data(), 320, dts + 20, dts + 20));
+    }
+    return ret;
+}
+
+class BenchMuxer : public MpegMuxer {
+public:
+    size_t bytes = 0;
+    bool dump = false;
+    string ts;
+
+protected:
+    void onWrite(std::shared_ptr<Buffer> buffer, uint64_t timestamp, bool key_pos) override {
+        if (!buffer) {
+            return;
+        }
+        bytes += buffer->size();
+        if (dump) {
+            ts.append(buffer->data(), buffer->size());
+        }
+    }
+};
+
+struct BenchResult {
+    size_t ts_bytes = 0;
+    size_t frames = 0;
+    uint64_t hash = 14695981039346656037ULL;
+    double fps = 0;
+};
+
+static BenchResult bench(const vector<Frame::Ptr> &frames, bool fast, int loops) {
+    mINI::Instance()[General::kTsFastMux] = fast;
+    NOTICE_EMIT(BroadcastReloadConfigArgs, Broadcast::kBroadcastReloadConfig);
+
+    BenchResult ret;
+    string ts;
+    auto start = getCurrentMicrosecond();
+    for (int i = 0; i < loops; ++i) {
+        BenchMuxer muxer;
+        // 只保存第一轮输出，用于对比两种复用方式解析后的结果是否一致
+        muxer.dump = !i;
+        muxer.addTrack(Factory::getTrackByCodecId(CodecH264));
+        muxer.addTrack(Factory::getTrackByCodecId(CodecG711A, 8000, 1, 16));
+        muxer.addTrackCompleted();
+        for (auto &frame : frames) {
+            muxer.inputFrame(frame);
+        }
+        muxer.flush();
+        ret.ts_bytes += muxer.bytes;
+        if (!i) {
+            ts = std::move(muxer.ts);
+        }
+    }
+    auto elapsed = getCurrentMicrosecond() - start;
+    ret.fps = frames.size() * loops * 1000000.0 / elapsed;
+
+    auto decoder = std::make_shared<TSDecoder>();
+    decoder->setOnDecode([&](int stream, int codecid, int flags, int64_t pts, int64_t dts, const void *data, size_t bytes) {
+        ++ret.frames;
+        auto hash = [&](const void *ptr, size_t len) {
+            for (size_t j = 0; j < len; ++j) {
+                ret.hash = (ret.hash ^ ((const uint8_t *)ptr)[j]) * 1099511628211ULL;
+            }
+        };
+        hash(&codecid, sizeof(codecid));
+        hash(&pts, sizeof(pts));
+        hash(&dts, sizeof(dts));
+        hash(data, bytes);
+    });
+    decoder->input((const uint8_t *)ts.data(), ts.size());
+    return ret;
+}
+
+// 该测试程序对比mpeg_muxer与快速ts复用的单核复用帧率，并校验两者输出的ts解析结果是否一致
+// 用法: test_bench_ts_mux [视频帧数] [循环次数]
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LWarn));
+    size_t count = argc > 1 ? atoi(argv[1]) : 25 * 60;
+    int loops = argc > 2 ? atoi(argv[2]) : 10;
+    auto frames = makeFrames(count);
+
+    auto generic = bench(frames, false, loops);
+    auto fast = bench(frames, true, loops);
+    cout << "输入帧数:" << frames.size() << " 循环次数:" << loops << endl;
+    cout << "mpeg_muxer 复用帧率(帧/秒):" << (uint64_t)generic.fps << " ts字节数:" << generic.ts_bytes << " 解析帧数:" << generic.frames << endl;
+    cout << "快速复用   复用帧率(帧/秒):" << (uint64_t)fast.fps << " ts字节数:" << fast.ts_bytes << " 解析帧数:" << fast.frames << endl;
+    cout << "解析结果" << (generic.hash == fast.hash ? "一致" : "不一致") << endl;
+    return 0;
+}
+
+#else
+int main(int argc, char *argv[]) {
+    cout << "please ENABLE_HLS and then test" << endl;
+    return 0;
+}
+#endif // defined(ENABLE_HLS)
@@ -0,0 +1,114 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <vector>
+#include "Util/logger.h"
+#include "Rtmp/utils.h"
+#include "Http/WebSocketSplitter.h"
+#include "FanoutBench.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+// 模拟一个http-flv/ws-flv播放器连接，只把待发送数据放入发送队列
+class FakeFlvSession : public WebSocketSplitter, public FanoutSendQueue {
+public:
+    FakeFlvSession(bool websocket = false) : _websocket(websocket) {}
+
+    // 旧的方式：每个播放器对每个rtmp包生成tag头与PreviousTagSize
+    void sendPerPacket(const RtmpPacketList &list) {
+        list.for_each([&](const RtmpPacket::Ptr &pkt) {
+            RtmpTagHeader header;
+            header.type = pkt->type_id;
+            set_be24(header.data_size, (uint32_t)pkt->size());
+            header.timestamp_ex = (pkt->time_stamp >> 24) & 0xff;
+            set_be24(header.timestamp, pkt->time_stamp & 0xFFFFFF);
+            write(std::make_shared<BufferString>(string((char *)&header, sizeof(header))));
+            write(pkt);
+            uint32_t size = htonl((uint32_t)(pkt->size() + sizeof(header)));
+            write(std::make_shared<BufferString>(string((char *)&size, 4)));
+        });
+    }
+
+    // 新的方式：所有播放器共享序列化好的flv tag(以及websocket帧头)
+    void sendShared(const RtmpPacketList &list) { push(list.getFlvTagBuffer(_websocket)); }
+
+protected:
+    void onWebSocketEncodeData(Buffer::Ptr buffer) override { push(std::move(buffer)); }
+
+private:
+    void write(const Buffer::Ptr &buffer) {
+        if (!_websocket) {
+            push(buffer);
+            return;
+        }
+        WebSocketHeader header;
+        header._fin = true;
+        header._reserved = 0;
+        header._opcode = WebSocketHeader::BINARY;
+        header._mask_flag = false;
+        encode(header, buffer);
+    }
+
+private:
+    bool _websocket;
+};
+
+// ws-flv播放器解析websocket帧，还原出flv数据
+class WebSocketPayload : public WebSocketSplitter {
+public:
+    string payload;
+
+protected:
+    void onWebSocketDecodePayload(const WebSocketHeader &header, const uint8_t *ptr, size_t len, size_t recved) override {
+        payload.append((char *)ptr, len);
+    }
+};
+
+// 该测试程序校验共享flv tag与逐包序列化的数据一致，并对比http-flv/ws-flv分发时每个播放器的cpu开销
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    // 包含需要扩展时间戳的情况
+    for (auto stamp : { 0u, 0xFFFFF0u }) {
+        auto pkt = makeFanoutRtmpList(16, stamp);
+        FakeFlvSession session;
+        string expect;
+        if (!checkFanoutSession(session, *pkt, &expect)) {
+            ErrorL << "共享flv tag与逐包序列化结果不一致, 时间戳:" << stamp;
+            return -1;
+        }
+
+        // ws-flv的帧划分不同，但是负载拼接后必须与http-flv一致
+        FakeFlvSession ws_session(true);
+        ws_session.sendShared(*pkt);
+        WebSocketPayload ws;
+        auto ws_data = ws_session.dump();
+        ws.decode((uint8_t *)ws_data.data(), ws_data.size());
+        if (ws.payload != expect) {
+            ErrorL << "共享ws-flv负载与逐包序列化结果不一致, 时间戳:" << stamp;
+            return -1;
+        }
+    }
+    InfoL << "共享flv tag与逐包序列化结果一致";
+
+    auto pkt = makeFanoutRtmpList(64, 0);
+    // 预先生成flv tag，它只在第一个播放器发送时生成一次
+    pkt->getFlvTagBuffer(false);
+    pkt->getFlvTagBuffer(true);
+    for (auto websocket : { false, true }) {
+        for (auto readers : { 1000, 3000, 10000 }) {
+            vector<FakeFlvSession> sessions(readers, FakeFlvSession(websocket));
+            benchFanoutSessions(string(websocket ? "ws-flv" : "http-flv") + " rtmp包个数:" + to_string(pkt->size()),
+                                sessions, *pkt, "逐包序列化", "共享flv tag");
+        }
+    }
+    return 0;
+}
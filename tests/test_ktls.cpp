@@ -0,0 +1,423 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <functional>
+#include "Util/logger.h"
+#include "Common/KtlsSession.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+#if defined(ENABLE_OPENSSL) && (defined(__linux__) || defined(__linux)) && defined(__has_include)
+#if __has_include(<linux/tls.h>)
+#include <cstring>
+#include <openssl/ssl.h>
+#include <openssl/pem.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+#include <linux/tls.h>
+#define TEST_KTLS 1
+#endif
+#endif
+
+#if defined(TEST_KTLS)
+
+static EVP_PKEY *makeKey(int type) {
+    EVP_PKEY *pkey = nullptr;
+    auto ctx = EVP_PKEY_CTX_new_id(type, nullptr);
+    EVP_PKEY_keygen_init(ctx);
+    if (type == EVP_PKEY_RSA) {
+        EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048);
+    } else {
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx, NID_X9_62_prime256v1);
+    }
+    EVP_PKEY_keygen(ctx, &pkey);
+    EVP_PKEY_CTX_free(ctx);
+    return pkey;
+}
+
+static X509 *makeCert(EVP_PKEY *pkey) {
+    auto cert = X509_new();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+    X509_set_pubkey(cert, pkey);
+    X509_NAME_add_entry_by_txt(X509_get_subject_name(cert), "CN", MBSTRING_ASC, (const uint8_t *)"localhost", -1, -1, 0);
+    X509_set_issuer_name(cert, X509_get_subject_name(cert));
+    X509_sign(cert, pkey, EVP_sha256());
+    return cert;
+}
+
+/**
+ * 加载自签名RSA证书作为默认证书，并在同一个SSL_CTX上追加ECDSA证书，
+ * 限制tls1.2加密套件为AES-GCM，以便校验kTLS专用SSL_CTX复制了所有证书与加密套件
+ */
+static bool loadCertificate() {
+    auto rsa_key = makeKey(EVP_PKEY_RSA);
+    auto rsa_cert = makeCert(rsa_key);
+    auto bio = BIO_new(BIO_s_mem());
+    PEM_write_bio_X509(bio, rsa_cert);
+    PEM_write_bio_PrivateKey(bio, rsa_key, nullptr, nullptr, 0, nullptr, nullptr);
+    char *data = nullptr;
+    auto size = BIO_get_mem_data(bio, &data);
+    string pem(data, size);
+    BIO_free(bio);
+    X509_free(rsa_cert);
+    EVP_PKEY_free(rsa_key);
+    if (!SSL_Initor::Instance().loadCertificate(pem, true, "", false)) {
+        return false;
+    }
+
+    auto ctx = SSL_Initor::Instance().getSSLCtx("", true);
+    auto ec_key = makeKey(EVP_PKEY_EC);
+    auto ec_cert = makeCert(ec_key);
+    auto ret = ctx && SSL_CTX_use_certificate(ctx.get(), ec_cert) == 1 && SSL_CTX_use_PrivateKey(ctx.get(), ec_key) == 1
+        && SSL_CTX_set_cipher_list(ctx.get(), "ECDHE-RSA-AES128-GCM-SHA256:ECDHE-RSA-AES256-GCM-SHA384:"
+                                              "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-ECDSA-AES256-GCM-SHA384") == 1;
+    X509_free(ec_cert);
+    EVP_PKEY_free(ec_key);
+    return ret;
+}
+
+static string gcmEncrypt(const string &key, const uint8_t nonce[12], const string &aad, const string &data) {
+    auto ctx = EVP_CIPHER_CTX_new();
+    EVP_EncryptInit_ex(ctx, key.size() == 16 ? EVP_aes_128_gcm() : EVP_aes_256_gcm(), nullptr, nullptr, nullptr);
+    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, 12, nullptr);
+    EVP_EncryptInit_ex(ctx, nullptr, nullptr, (const uint8_t *)key.data(), nonce);
+    int len = 0;
+    EVP_EncryptUpdate(ctx, nullptr, &len, (const uint8_t *)aad.data(), (int)aad.size());
+    string out(data.size() + 16, '\0');
+    EVP_EncryptUpdate(ctx, (uint8_t *)&out[0], &len, (const uint8_t *)data.data(), (int)data.size());
+    EVP_EncryptFinal_ex(ctx, (uint8_t *)&out[len], &len);
+    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, 16, &out[data.size()]);
+    EVP_CIPHER_CTX_free(ctx);
+    return out;
+}
+
+static uint64_t loadBE64(const uint8_t *ptr) {
+    uint64_t ret = 0;
+    for (int i = 0; i < 8; ++i) {
+        ret = ret << 8 | ptr[i];
+    }
+    return ret;
+}
+
+static void storeBE64(uint8_t *ptr, uint64_t val) {
+    for (int i = 7; i >= 0; --i) {
+        ptr[i] = val & 0xFF;
+        val >>= 8;
+    }
+}
+
+/**
+ * 用户态模拟内核kTLS：按设置的加密参数把明文与控制记录加密为tls记录，
+ * 并模拟会话发送队列与socket不可写，用于校验密钥推导、KeyUpdate与控制记录的发送顺序
+ */
+class TestKtlsBox : public KtlsBox {
+public:
+    TestKtlsBox(Socket::Ptr sock) : KtlsBox(std::move(sock)) {}
+
+    // 模拟内核加密一个tls记录并写入socket
+    void writeRecord(uint8_t type, const string &data) {
+        string header = { (char)(_version == TLS_1_3_VERSION ? 0x17 : type), 0x03, 0x03, 0, 0 };
+        uint8_t nonce[12];
+        memcpy(nonce, _salt.data(), 4);
+        string record;
+        if (_version == TLS_1_3_VERSION) {
+            // 隐式nonce为iv与记录序号异或，内层记录类型放在明文末尾
+            storeBE64(nonce + 4, loadBE64((const uint8_t *)_iv.data()) ^ _seq);
+            auto inner = data;
+            inner.push_back((char)type);
+            auto len = inner.size() + 16;
+            header[3] = (char)(len >> 8);
+            header[4] = (char)len;
+            record = header + gcmEncrypt(_key, nonce, header, inner);
+        } else {
+            // 显式nonce从设置的iv开始随记录递增，附加数据为序号与记录头
+            storeBE64(nonce + 4, loadBE64((const uint8_t *)_iv.data()) + _seq - _start_seq);
+            uint8_t seq[8];
+            storeBE64(seq, _seq);
+            header[3] = (char)(data.size() >> 8);
+            header[4] = (char)data.size();
+            auto aad = string((char *)seq, 8) + header;
+            auto payload = string((char *)nonce + 4, 8) + gcmEncrypt(_key, nonce, aad, data);
+            header[3] = (char)(payload.size() >> 8);
+            header[4] = (char)payload.size();
+            record = header + payload;
+        }
+        ++_seq;
+        wire.append(record);
+    }
+
+    string wire;
+    size_t queue_size = 0;
+    bool writable = true;
+    int rekeys = 0;
+
+protected:
+    size_t getSendQueueSize() override { return queue_size; }
+
+    ssize_t sendRaw(const char *data, size_t size) override {
+        wire.append(data, size);
+        return size;
+    }
+
+    bool setTxCryptoInfo(const void *info, size_t size, bool rekey) override {
+        auto crypto_info = (const tls_crypto_info *)info;
+        _version = crypto_info->version;
+        if (crypto_info->cipher_type == TLS_CIPHER_AES_GCM_128) {
+            auto gcm = (const tls12_crypto_info_aes_gcm_128 *)info;
+            setKey(gcm->key, sizeof(gcm->key), gcm->salt, gcm->iv, gcm->rec_seq);
+        } else {
+            auto gcm = (const tls12_crypto_info_aes_gcm_256 *)info;
+            setKey(gcm->key, sizeof(gcm->key), gcm->salt, gcm->iv, gcm->rec_seq);
+        }
+        rekeys += rekey;
+        return true;
+    }
+
+    ssize_t sendRecord(uint8_t type, const char *data, size_t size) override {
+        if (!writable) {
+            return 0;
+        }
+        writeRecord(type, string(data, size));
+        return size;
+    }
+
+private:
+    void setKey(const uint8_t *key, size_t key_len, const uint8_t *salt, const uint8_t *iv, const uint8_t *rec_seq) {
+        _key.assign((const char *)key, key_len);
+        _salt.assign((const char *)salt, 4);
+        _iv.assign((const char *)iv, 8);
+        _start_seq = _seq = loadBE64(rec_seq);
+    }
+
+private:
+    uint16_t _version = 0;
+    uint64_t _seq = 0;
+    uint64_t _start_seq = 0;
+    string _key;
+    string _salt;
+    string _iv;
+};
+
+// 通过内存BIO与kTLS会话通信的openssl客户端
+class TestClient {
+public:
+    TestClient(int max_version, const char *ciphers, const char *suites) {
+        _ctx.reset(SSL_CTX_new(TLS_client_method()), SSL_CTX_free);
+        SSL_CTX_set_max_proto_version(_ctx.get(), max_version);
+        if (ciphers) {
+            SSL_CTX_set_cipher_list(_ctx.get(), ciphers);
+        }
+        if (suites) {
+            SSL_CTX_set_ciphersuites(_ctx.get(), suites);
+        }
+        _ssl.reset(SSL_new(_ctx.get()), SSL_free);
+        _read_bio = BIO_new(BIO_s_mem());
+        _write_bio = BIO_new(BIO_s_mem());
+        SSL_set_bio(_ssl.get(), _read_bio, _write_bio);
+        SSL_set_connect_state(_ssl.get());
+    }
+
+    SSL *ssl() const { return _ssl.get(); }
+
+    // 收取服务器发送的数据，返回解密后的明文
+    string input(string &wire) {
+        BIO_write(_read_bio, wire.data(), (int)wire.size());
+        wire.clear();
+        string ret;
+        char buf[16 * 1024];
+        int size;
+        if (!SSL_is_init_finished(_ssl.get())) {
+            SSL_do_handshake(_ssl.get());
+        }
+        while (SSL_is_init_finished(_ssl.get()) && (size = SSL_read(_ssl.get(), buf, sizeof(buf))) > 0) {
+            ret.append(buf, size);
+        }
+        return ret;
+    }
+
+    // 取出需要发送给服务器的数据
+    Buffer::Ptr output() {
+        auto size = BIO_ctrl_pending(_write_bio);
+        auto ret = BufferRaw::create();
+        ret->setCapacity(size + 1);
+        ret->setSize(size ? BIO_read(_write_bio, ret->data(), (int)size) : 0);
+        return ret;
+    }
+
+private:
+    shared_ptr<SSL_CTX> _ctx;
+    shared_ptr<SSL> _ssl;
+    BIO *_read_bio;
+    BIO *_write_bio;
+};
+
+struct TestContext {
+    shared_ptr<TestKtlsBox> box;
+    shared_ptr<TestClient> client;
+    string received;
+};
+
+// 完成握手并开启(模拟的)kTLS
+static bool handshake(TestContext &ctx, int max_version, const char *ciphers, const char *suites) {
+    auto poller = EventPollerPool::Instance().getPoller();
+    ctx.box = std::make_shared<TestKtlsBox>(Socket::createSocket(poller, false));
+    ctx.client = std::make_shared<TestClient>(max_version, ciphers, suites);
+    auto box = ctx.box.get();
+    box->setOnEncData([box](const Buffer::Ptr &buf) {
+        if (box->isKtls()) {
+            // 模拟会话发送队列中的明文写入socket时由内核加密
+            box->writeRecord(0x17, string(buf->data(), buf->size()));
+        } else {
+            box->wire.append(buf->data(), buf->size());
+        }
+    });
+    box->setOnDecData([&ctx](const Buffer::Ptr &buf) { ctx.received.append(buf->data(), buf->size()); });
+    try {
+        for (int i = 0; i < 10 && !SSL_is_init_finished(ctx.client->ssl()); ++i) {
+            ctx.client->input(box->wire);
+            auto out = ctx.client->output();
+            if (out->size()) {
+                box->onRecv(out);
+            }
+        }
+    } catch (std::exception &ex) {
+        WarnL << "handshake failed:" << ex.what();
+        return false;
+    }
+    return SSL_is_init_finished(ctx.client->ssl()) && box->isKtls();
+}
+
+// 服务器以kTLS发送数据，客户端发送数据给服务器，双方都能正确解密
+static bool testTransfer(int max_version, const char *ciphers, const char *suites) {
+    TestContext ctx;
+    if (!handshake(ctx, max_version, ciphers, suites)) {
+        ErrorL << "ktls handshake failed, ciphers:" << (ciphers ? ciphers : suites);
+        return false;
+    }
+    string expect;
+    for (int i = 0; i < 3; ++i) {
+        auto data = "ktls-record-" + to_string(i) + "|";
+        ctx.box->onSend(std::make_shared<BufferString>(data));
+        expect.append(data);
+    }
+    auto got = ctx.client->input(ctx.box->wire);
+    SSL_write(ctx.client->ssl(), "ping", 4);
+    ctx.box->onRecv(ctx.client->output());
+    InfoL << SSL_get_version(ctx.client->ssl()) << " " << SSL_get_cipher_name(ctx.client->ssl()) << ": "
+          << (got == expect && ctx.received == "ping" ? "OK" : "FAILED");
+    return got == expect && ctx.received == "ping";
+}
+
+// kTLS专用SSL_CTX复制了加密套件限制，客户端只支持被禁用的套件时握手失败
+static bool testCipherList() {
+    TestContext ctx;
+    auto ret = !handshake(ctx, TLS1_2_VERSION, "ECDHE-RSA-CHACHA20-POLY1305", nullptr);
+    InfoL << "cipher list copied: " << (ret ? "OK" : "FAILED");
+    return ret;
+}
+
+/**
+ * 对端请求更新密钥：回复的KeyUpdate排在会话发送队列中已有的明文之后，socket不可写时重试，
+ * KeyUpdate发送后更新内核发送密钥，期间缓存的明文以新密钥发送
+ */
+static bool testKeyUpdate() {
+    TestContext ctx;
+    if (!handshake(ctx, TLS1_3_VERSION, nullptr, "TLS_AES_128_GCM_SHA256")) {
+        ErrorL << "ktls handshake failed";
+        return false;
+    }
+    auto poller = EventPollerPool::Instance().getPoller();
+    auto box = ctx.box;
+    bool ret = true;
+    auto check = [&](bool ok, const char *what) {
+        if (!ok) {
+            ErrorL << "key update: " << what;
+            ret = false;
+        }
+    };
+    poller->sync([&]() {
+        // 会话发送队列中还有明文
+        box->queue_size = 1;
+        SSL_key_update(ctx.client->ssl(), SSL_KEY_UPDATE_REQUESTED);
+        SSL_write(ctx.client->ssl(), "x", 1);
+        box->onRecv(ctx.client->output());
+        box->onSend(std::make_shared<BufferString>("after-key-update"));
+        check(box->wire.empty() && !box->rekeys, "control record overtook queued data");
+    });
+    this_thread::sleep_for(chrono::milliseconds(100));
+    poller->sync([&]() {
+        check(box->wire.empty() && !box->rekeys, "control record overtook queued data");
+        // 队列中的明文写入socket后，socket不可写
+        box->queue_size = 0;
+        box->writable = false;
+    });
+    this_thread::sleep_for(chrono::milliseconds(100));
+    poller->sync([&]() {
+        check(box->wire.empty() && !box->rekeys, "control record sent while socket not writable");
+        box->writable = true;
+    });
+    this_thread::sleep_for(chrono::milliseconds(100));
+    poller->sync([&]() {
+        check(box->rekeys == 1, "tx key not updated");
+        auto got = ctx.client->input(box->wire);
+        check(got == "after-key-update", "data after key update not decrypted");
+        box->onSend(std::make_shared<BufferString>("|again"));
+        got = ctx.client->input(box->wire);
+        check(got == "|again", "data after key update not sent directly");
+        check(ctx.received == "x", "client data not decrypted");
+        // 定时器在poller线程中释放
+        ctx.box = nullptr;
+        box = nullptr;
+    });
+    InfoL << "key update: " << (ret ? "OK" : "FAILED");
+    return ret;
+}
+
+// 该测试程序通过内存BIO完成tls握手，用户态模拟内核加密，校验kTLS发送密钥推导、KeyUpdate处理与证书/加密套件复制
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    if (!KtlsBox::isSupported()) {
+        WarnL << "ktls not supported, skipped";
+        return 0;
+    }
+    if (!loadCertificate()) {
+        ErrorL << "load certificate failed";
+        return -1;
+    }
+    bool ok = true;
+    ok = testTransfer(TLS1_2_VERSION, "ECDHE-RSA-AES128-GCM-SHA256", nullptr) && ok;
+    ok = testTransfer(TLS1_2_VERSION, "ECDHE-RSA-AES256-GCM-SHA384", nullptr) && ok;
+    // 需要复制第二个(ECDSA)证书
+    ok = testTransfer(TLS1_2_VERSION, "ECDHE-ECDSA-AES128-GCM-SHA256", nullptr) && ok;
+    ok = testTransfer(TLS1_3_VERSION, nullptr, "TLS_AES_128_GCM_SHA256") && ok;
+    ok = testTransfer(TLS1_3_VERSION, nullptr, "TLS_AES_256_GCM_SHA384") && ok;
+    ok = testCipherList() && ok;
+    ok = testKeyUpdate() && ok;
+    return ok ? 0 : -1;
+}
+
+#else
+
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    WarnL << "ktls not supported, skipped";
+    return 0;
+}
+
+#endif
@@ -0,0 +1,57 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <vector>
+#include "Util/logger.h"
+#include "Rtmp/RtmpProtocol.h"
+#include "FanoutBench.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+// 模拟一个rtmp播放器连接，只把待发送数据放入发送队列
+class FakeRtmpSession : public RtmpProtocol, public FanoutSendQueue {
+public:
+    // 旧的方式：每个播放器对每个rtmp包分块
+    void sendPerPacket(const RtmpPacketList &list) {
+        list.for_each([&](const RtmpPacket::Ptr &pkt) { sendRtmp(pkt->type_id, pkt->stream_index, pkt, pkt->time_stamp, pkt->chunk_id); });
+    }
+
+    // 新的方式：所有播放器共享分块好的chunk流
+    void sendShared(const RtmpPacketList &list) { sendChunkStream(list.getChunkBuffer(getChunkSizeOut())); }
+
+protected:
+    void onSendRawData(Buffer::Ptr buffer) override { push(std::move(buffer)); }
+    void onRtmpChunk(RtmpPacket::Ptr chunk_data) override {}
+};
+
+// 该测试程序校验共享chunk流与逐包分块发送的数据一致，并对比rtmp分发时每个播放器的cpu开销
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    // 包含需要扩展时间戳的情况
+    for (auto stamp : { 0u, 0xFFFFF0u }) {
+        FakeRtmpSession session;
+        if (!checkFanoutSession(session, *makeFanoutRtmpList(16, stamp))) {
+            ErrorL << "共享chunk流与逐包分块结果不一致, 时间戳:" << stamp;
+            return -1;
+        }
+    }
+    InfoL << "共享chunk流与逐包分块结果一致";
+
+    auto pkt = makeFanoutRtmpList(64, 0);
+    // 预先生成chunk流，它只在第一个播放器发送时生成一次
+    pkt->getChunkBuffer(DEFAULT_CHUNK_LEN);
+    for (auto readers : { 1000, 3000, 10000 }) {
+        vector<FakeRtmpSession> sessions(readers);
+        benchFanoutSessions("rtmp包个数:" + to_string(pkt->size()), sessions, *pkt, "逐包分块", "共享chunk流");
+    }
+    return 0;
+}
@@ -0,0 +1,118 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <iostream>
+#include "Util/util.h"
+#include "Rtsp/RtpCodec.h"
+#include "Rtsp/RtspMediaSource.h"
+#include "FanoutBench.h"
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#endif
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+#if !defined(_WIN32)
+
+// 模拟一个关键帧合并写后的rtp包组
+static RtpPacketList::Ptr makeRtpList(size_t count) {
+    RtpInfo info(0x12345678, 1400, 90000, 96, 0, 0);
+    auto ret = std::make_shared<RtpPacketList>();
+    string payload(1400 - RtpPacket::kRtpHeaderSize, 'a');
+    for (size_t i = 0; i < count; ++i) {
+        ret->emplace_back(info.makeRtp(TrackVideo, payload.data(), payload.size(), i + 1 == count, 40));
+    }
+    return ret;
+}
+
+// 与socket发送一样通过writev发送所有Buffer，处理部分发送
+static void sendBuffers(int fd, const vector<Buffer::Ptr> &buffers) {
+    vector<struct iovec> iovs(buffers.size());
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        iovs[i].iov_base = buffers[i]->data();
+        iovs[i].iov_len = buffers[i]->size();
+    }
+    size_t index = 0;
+    while (index < iovs.size()) {
+        auto sent = ::writev(fd, &iovs[index], (int)MIN(iovs.size() - index, (size_t)1024));
+        if (sent <= 0) {
+            throw std::runtime_error("writev failed");
+        }
+        while (sent > 0) {
+            if ((size_t)sent >= iovs[index].iov_len) {
+                sent -= iovs[index++].iov_len;
+                continue;
+            }
+            iovs[index].iov_base = (char *)iovs[index].iov_base + sent;
+            iovs[index].iov_len -= sent;
+            sent = 0;
+        }
+    }
+}
+
+static void bench(int fd, size_t readers, size_t rtp_count) {
+    auto per_packet_list = makeRtpList(rtp_count);
+    auto shared_list = makeRtpList(rtp_count);
+    benchFanout("rtp包个数:" + to_string(rtp_count), readers, "逐包发送", [&]() {
+        // 旧的方式：每个播放器每个rtp包占用一个iovec，零拷贝
+        for (size_t i = 0; i < readers; ++i) {
+            vector<Buffer::Ptr> buffers;
+            per_packet_list->for_each([&](const RtpPacket::Ptr &rtp) { buffers.emplace_back(rtp); });
+            sendBuffers(fd, buffers);
+        }
+    }, "共享连续内存", [&]() {
+        // 新的方式：所有播放器共享本组rtp包的连续内存，拼接开销由所有播放器均摊
+        for (size_t i = 0; i < readers; ++i) {
+            sendBuffers(fd, { shared_list->getTcpBuffer() });
+        }
+    });
+}
+
+// 该测试程序用于对比rtsp over tcp分发时每个播放器的发送开销(writev到本地socket)
+// 只有一个播放器时RtspSession逐包发送，多个播放器时才共享连续内存
+int main(int argc, char *argv[]) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+        cout << "socketpair failed" << endl;
+        return -1;
+    }
+    // 模拟播放器接收，持续读空socket
+    std::atomic<bool> exit { false };
+    std::thread reader([&]() {
+        char buf[64 * 1024];
+        while (!exit && ::read(fds[1], buf, sizeof(buf)) > 0) {
+        }
+    });
+
+    for (auto readers : { 1, 10, 100, 1000, 5000, 10000 }) {
+        bench(fds[0], readers, 256);
+    }
+    exit = true;
+    ::shutdown(fds[0], SHUT_RDWR);
+    reader.join();
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return 0;
+}
+
+#else
+int main(int argc, char *argv[]) {
+    cout << "not supported on windows" << endl;
+    return 0;
+}
+#endif // !defined(_WIN32)
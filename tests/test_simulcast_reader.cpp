@@ -0,0 +1,135 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <thread>
+#include <iostream>
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Poller/EventPoller.h"
+#include "Rtsp/RtpCodec.h"
+#include "Rtsp/RtspMediaSource.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+static const char kSdp[] = "v=0\r\n"
+                           "o=- 0 0 IN IP4 0.0.0.0\r\n"
+                           "s=test\r\n"
+                           "t=0 0\r\n"
+                           "m=audio 0 RTP/AVP 8\r\n"
+                           "a=rtpmap:8 PCMA/8000\r\n"
+                           "a=control:trackID=0\r\n";
+
+// 模拟webrtc simulcast推流端: 原始流与各层的观看人数由推流端累加统计
+class TestPusher : public MediaSourceEvent {
+public:
+    TestPusher(EventPoller::Ptr poller) : _poller(std::move(poller)) {}
+
+    int totalReaderCount(MediaSource &sender) override {
+        // 与WebRtcPusher::totalReaderCount一致
+        auto total = _base ? _base->readerCount() : 0;
+        if (_layer) {
+            total += _layer->readerCount() - _layer->simulcastReaderCount();
+        }
+        return total;
+    }
+
+    void onReaderChanged(MediaSource &sender, int size) override {
+        if (&sender == _base.get()) {
+            _base_readers = size;
+            ++_base_events;
+        }
+    }
+
+    EventPoller::Ptr getOwnerPoller(MediaSource &sender) override { return _poller; }
+
+public:
+    RtspMediaSource::Ptr _base;
+    RtspMediaSource::Ptr _layer;
+    atomic<int> _base_readers { -1 };
+    atomic<int> _base_events { 0 };
+
+private:
+    EventPoller::Ptr _poller;
+};
+
+static RtspMediaSource::Ptr makeSource(const string &stream, RtpInfo &info) {
+    auto src = std::make_shared<RtspMediaSource>(MediaTuple { DEFAULT_VHOST, "live", stream, "" });
+    src->setSdp(kSdp);
+    // 输入rtp后才创建环形缓冲
+    char payload[160] = { 0 };
+    src->onWrite(info.makeRtp(TrackAudio, payload, sizeof(payload), false, 0), true);
+    return src;
+}
+
+template <typename Func>
+static bool waitFor(Func &&func) {
+    for (int i = 0; i < 200 && !func(); ++i) {
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    return func();
+}
+
+#define CHECK_TEST(expr)                                                                                                                   \
+    if (!(expr)) {                                                                                                                         \
+        cout << "failed: " << #expr << endl;                                                                                              \
+        return -1;                                                                                                                         \
+    }
+
+// 该测试程序用于校验simulcast自适应播放器改为从某一层读取rtp后，
+// 仍然计入原始流的观看人数(任何类型的媒体源都能正确触发无人观看事件)，且推流端统计总观看人数时不重复计算
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LWarn));
+    auto poller = EventPollerPool::Instance().getPoller();
+    auto pusher = std::make_shared<TestPusher>(poller);
+    RtpInfo info(0, 1400, 8000, 8, 0, 0);
+    pusher->_base = makeSource("simulcast_test", info);
+    pusher->_layer = makeSource("simulcast_test_h", info);
+    pusher->_base->setListener(pusher);
+    pusher->_layer->setListener(pusher);
+
+    RtspMediaSource::RingType::RingReader::Ptr base_reader;
+    RtspMediaSource::RingType::RingReader::Ptr layer_reader;
+    std::shared_ptr<void> layer_token;
+
+    // 播放器先从原始流读取
+    poller->sync([&]() { base_reader = pusher->_base->getRing()->attach(poller, true); });
+    CHECK_TEST(waitFor([&]() { return pusher->_base_readers == 1; }));
+    CHECK_TEST(pusher->_base->totalReaderCount() == 1);
+
+    // 切换到simulcast层，原始流的reader保持attach
+    poller->sync([&]() {
+        layer_reader = pusher->_layer->getRing()->attach(poller, true);
+        layer_token = pusher->_layer->addSimulcastReader();
+    });
+    CHECK_TEST(waitFor([&]() { return pusher->_layer->readerCount() == 1; }));
+    CHECK_TEST(pusher->_layer->simulcastReaderCount() == 1);
+    CHECK_TEST(pusher->_base->readerCount() == 1);
+    // 同一个播放器只计算一次
+    CHECK_TEST(pusher->_base->totalReaderCount() == 1);
+    CHECK_TEST(pusher->_layer->totalReaderCount() == 1);
+
+    // 播放器结束，原始流触发无人观看
+    auto events = pusher->_base_events.load();
+    poller->sync([&]() {
+        layer_token = nullptr;
+        layer_reader = nullptr;
+        base_reader = nullptr;
+    });
+    CHECK_TEST(waitFor([&]() { return pusher->_base_readers == 0 && pusher->_base_events > events; }));
+    CHECK_TEST(waitFor([&]() { return pusher->_layer->readerCount() == 0; }));
+    CHECK_TEST(pusher->_layer->simulcastReaderCount() == 0);
+    CHECK_TEST(pusher->_base->totalReaderCount() == 0);
+
+    cout << "simulcast reader test passed" << endl;
+    return 0;
+}
@@ -10,8 +10,10 @@
 
 #include <map>
 #include <list>
+#include <vector>
 #include <iostream>
 #include <functional>
+#include "Util/util.h"
 #include "Rtsp/RtpReceiver.h"
 
 using namespace std;
@@ -269,6 +271,94 @@ void test_rand(){
 #endif
 }
 
+//推流端重置seq(回退)后应该重新计数，而不是把之后的包都当做回退包丢弃
+bool test_reset(uint16_t from, uint16_t to) {
+    PacketSortor<uint16_t, uint16_t> sortor;
+    vector<uint16_t> sorted_list;
+    sortor.setOnSort([&](uint16_t seq, uint16_t packet) {
+        sorted_list.push_back(seq);
+    });
+    for (uint16_t seq = from - 100; seq != from; ++seq) {
+        sortor.sortPacket(seq, seq);
+    }
+    for (uint16_t seq = to; seq != (uint16_t)(to + 100); ++seq) {
+        sortor.sortPacket(seq, seq);
+    }
+    sortor.flush();
+    size_t after_reset = 0;
+    for (auto seq : sorted_list) {
+        if ((uint16_t)(seq - to) < 100) {
+            ++after_reset;
+        }
+    }
+    cout << "seq重置:" << from << " -> " << to << " 输出数据个数:" << sorted_list.size() << " 重置后输出个数:" << after_reset << endl;
+    // 无论回退距离多远，都需要连续收到多个回退包才能确认seq被重置
+    auto expect = 100 - PacketSortor<uint16_t, uint16_t>::kMaxOldCount + 1;
+    return after_reset == expect && sorted_list.size() == 100 + expect;
+}
+
+//单个迟到或重复的包即使回退距离超出排序窗口，也不能导致seq重置
+bool test_single_old(uint16_t old_seq) {
+    PacketSortor<uint16_t, uint16_t> sortor;
+    vector<uint16_t> sorted_list;
+    sortor.setOnSort([&](uint16_t seq, uint16_t packet) {
+        sorted_list.push_back(seq);
+    });
+    for (uint16_t seq = 0; seq < 1000; ++seq) {
+        sortor.sortPacket(seq, seq);
+    }
+    sortor.sortPacket(old_seq, old_seq);
+    for (uint16_t seq = 1000; seq < 2000; ++seq) {
+        sortor.sortPacket(seq, seq);
+    }
+    sortor.flush();
+    cout << "迟到包:" << old_seq << " 输出数据个数:" << sorted_list.size() << endl;
+    if (sorted_list.size() != 2000) {
+        return false;
+    }
+    for (uint16_t i = 0; i < 2000; ++i) {
+        if (sorted_list[i] != i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//排序性能测试，loss_percent为丢包率，reorder为最大连续乱序个数
+void test_bench(const char *name, int loss_percent, int reorder) {
+    static constexpr int kPacketCount = 1000 * 1000;
+    vector<uint16_t> input_list;
+    input_list.reserve(kPacketCount);
+    for (int i = 0; i < kPacketCount;) {
+        int count = reorder ? rand() % (reorder + 1) : 0;
+        for (int j = i + count; j >= i; --j) {
+            if (loss_percent && rand() % 100 < loss_percent) {
+                continue;
+            }
+            input_list.emplace_back(j);
+        }
+        i += (count + 1);
+    }
+
+    PacketSortor<uint16_t, uint16_t> sortor;
+    size_t output = 0;
+    sortor.setOnSort([&](uint16_t seq, uint16_t packet) {
+        ++output;
+    });
+
+    auto start = toolkit::getCurrentMicrosecond();
+    for (auto &seq : input_list) {
+        sortor.sortPacket(seq, seq);
+    }
+    sortor.flush();
+    auto elapsed = toolkit::getCurrentMicrosecond() - start;
+
+    cout << name << " 输入数据个数:" << input_list.size()
+         << " 输出数据个数:" << output
+         << " 耗时(us):" << elapsed
+         << " 性能(万包/秒):" << (elapsed ? input_list.size() * 100 / elapsed : 0) << endl;
+}
+
 //该测试程序用于检验rtp排序算法的正确性
 int main(int argc, char *argv[]) {
     //测试真实的rtp seq
@@ -278,5 +368,27 @@ int main(int argc, char *argv[]) {
     //模拟rtp乱序、回环、丢包、重复情况
     cout << "###### 模拟的rtp seq #####" << endl;
     test_rand();
+
+    //推流端重置seq
+    cout << "###### seq重置 #####" << endl;
+    if (!test_reset(30000, 100) || !test_reset(1000, 800) || !test_reset(100, 65000)) {
+        cout << "seq重置测试失败" << endl;
+        return -1;
+    }
+
+    //单个迟到包、重复包
+    cout << "###### 迟到包 #####" << endl;
+    if (!test_single_old(999) || !test_single_old(500) || !test_single_old(10) || !test_single_old(40000)) {
+        cout << "迟到包测试失败" << endl;
+        return -1;
+    }
+
+    //各种丢包、乱序情况下的排序性能
+    cout << "###### 排序性能 #####" << endl;
+    test_bench("顺序", 0, 0);
+    test_bench("丢包1%", 1, 0);
+    test_bench("乱序8", 0, 8);
+    test_bench("丢包1%乱序8", 1, 8);
+    test_bench("丢包5%乱序32", 5, 32);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,187 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <unordered_set>
+#include "Util/logger.h"
+#include "Network/Session.h"
+#include "Common/Metrics.h"
+#include "Common/TcpBatchSender.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+// 模拟一个tcp会话，不连接socket，只记录每次刷新放入发送队列的Buffer
+class FakeSession : public Session {
+public:
+    FakeSession() : Session(nullptr) {}
+
+    ssize_t send(Buffer::Ptr buf) override {
+        auto size = buf->size();
+        _pending.emplace_back(std::move(buf));
+        return size;
+    }
+
+    // 取出上次调用以来放入发送队列的Buffer，TcpBatchSender只在刷新时同步发送，所以这些Buffer属于同一批
+    vector<Buffer::Ptr> takeBatch() {
+        vector<Buffer::Ptr> ret;
+        ret.swap(_pending);
+        return ret;
+    }
+
+    void onRecv(const Buffer::Ptr &buf) override {}
+    void onError(const SockException &err) override {}
+    void onManager() override {}
+
+private:
+    vector<Buffer::Ptr> _pending;
+};
+
+static uint64_t getSendCounter(const string &metrics, const string &name) {
+    auto key = name + "{protocol=\"rtp\"} ";
+    auto pos = metrics.find(key);
+    if (pos == string::npos) {
+        return 0;
+    }
+    return strtoull(metrics.data() + pos + key.size(), nullptr, 10);
+}
+
+// 按TcpBatchSender的合并规则独立计算每批的iovec个数：大Buffer独占一个iovec，连续的小Buffer合并为一个iovec
+static vector<size_t> expectBatches(const vector<size_t> &sizes) {
+    vector<size_t> ret;
+    size_t iovecs = 0;
+    bool last_small = false;
+    for (auto size : sizes) {
+        auto small = size <= TcpBatchSender::kCopySize;
+        auto need_iovec = !small || !last_small;
+        if (need_iovec && iovecs >= TcpBatchSender::kMaxIovecs) {
+            ret.emplace_back(iovecs);
+            iovecs = 0;
+        }
+        if (need_iovec) {
+            ++iovecs;
+        }
+        last_small = small;
+    }
+    if (iovecs) {
+        ret.emplace_back(iovecs);
+    }
+    return ret;
+}
+
+// 该测试程序校验tcp合并写的发送顺序、每批iovec个数与合并写指标
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+
+    // 大小Buffer混合：连续的小Buffer(rtsp interleaved头、rtcp等)、大Buffer(rtp/flv数据)，
+    // 以及一段超过iovec上限的连续大Buffer与一段超过上限的大小交替Buffer
+    vector<size_t> sizes;
+    uint32_t seed = 12345;
+    auto rand_size = [&](size_t min_size, size_t max_size) {
+        seed = seed * 1103515245 + 12345;
+        return min_size + (seed >> 8) % (max_size - min_size + 1);
+    };
+    for (int i = 0; i < 300; ++i) {
+        auto small = rand_size(0, 2) == 0;
+        sizes.emplace_back(small ? rand_size(1, TcpBatchSender::kCopySize) : rand_size(TcpBatchSender::kCopySize + 1, 1500));
+    }
+    for (size_t i = 0; i < TcpBatchSender::kMaxIovecs + 10; ++i) {
+        sizes.emplace_back(rand_size(TcpBatchSender::kCopySize + 1, 1500));
+    }
+    for (size_t i = 0; i < TcpBatchSender::kMaxIovecs * 2; ++i) {
+        sizes.emplace_back(i % 2 ? rand_size(1, TcpBatchSender::kCopySize) : rand_size(TcpBatchSender::kCopySize + 1, 1500));
+    }
+    for (int i = 0; i < 50; ++i) {
+        sizes.emplace_back(rand_size(1, 16));
+    }
+
+    auto before = Metrics::toPrometheus();
+    FakeSession session;
+    TcpBatchSender sender(&session, Metrics::kRtp);
+    string expect;
+    vector<Buffer::Ptr> inputs;
+    vector<vector<Buffer::Ptr>> batches;
+    for (auto size : sizes) {
+        string data;
+        for (size_t i = 0; i < size; ++i) {
+            data.push_back((char)(expect.size() + i));
+        }
+        expect.append(data);
+        auto buf = std::make_shared<BufferString>(std::move(data));
+        inputs.emplace_back(buf);
+        sender.input(std::move(buf));
+        // 达到iovec上限时input内部会先发送本批
+        auto batch = session.takeBatch();
+        if (!batch.empty()) {
+            batches.emplace_back(std::move(batch));
+        }
+    }
+    sender.flush();
+    batches.emplace_back(session.takeBatch());
+    auto after = Metrics::toPrometheus();
+
+    // 发送数据与输入数据字节顺序一致
+    string sent;
+    size_t iovecs = 0;
+    for (auto &batch : batches) {
+        for (auto &buf : batch) {
+            sent.append(buf->data(), buf->size());
+        }
+        iovecs += batch.size();
+    }
+    if (sent != expect) {
+        ErrorL << "发送数据与输入数据不一致, 输入字节数:" << expect.size() << ", 发送字节数:" << sent.size();
+        return -1;
+    }
+
+    // 每批iovec个数不超过上限，并且与合并规则一致
+    auto expect_batches = expectBatches(sizes);
+    if (batches.size() != expect_batches.size()) {
+        ErrorL << "批次数不一致:" << batches.size() << " != " << expect_batches.size();
+        return -1;
+    }
+    for (size_t i = 0; i < batches.size(); ++i) {
+        if (batches[i].size() > TcpBatchSender::kMaxIovecs || batches[i].size() != expect_batches[i]) {
+            ErrorL << "第" << i << "批iovec个数不一致:" << batches[i].size() << " != " << expect_batches[i];
+            return -1;
+        }
+    }
+
+    // 大Buffer不拷贝，直接放入发送队列
+    unordered_set<Buffer *> sent_buffers;
+    for (auto &batch : batches) {
+        for (auto &buf : batch) {
+            sent_buffers.emplace(buf.get());
+        }
+    }
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (inputs[i]->size() > TcpBatchSender::kCopySize && !sent_buffers.count(inputs[i].get())) {
+            ErrorL << "大Buffer被拷贝发送, 序号:" << i;
+            return -1;
+        }
+    }
+
+    // 合并写指标
+    auto delta = [&](const char *name) { return getSendCounter(after, name) - getSendCounter(before, name); };
+    if (delta("zlm_send_batches_total") != batches.size() || delta("zlm_send_iovecs_total") != iovecs
+        || delta("zlm_send_buffers_total") != sizes.size()) {
+        ErrorL << "合并写指标不一致, batches:" << delta("zlm_send_batches_total") << "/" << batches.size()
+               << ", iovecs:" << delta("zlm_send_iovecs_total") << "/" << iovecs
+               << ", buffers:" << delta("zlm_send_buffers_total") << "/" << sizes.size();
+        return -1;
+    }
+
+    InfoL << "输入Buffer个数:" << sizes.size() << ", 字节数:" << expect.size() << ", 批次数:" << batches.size()
+          << ", iovec个数:" << iovecs;
+    return 0;
+}
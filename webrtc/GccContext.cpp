@@ -0,0 +1,261 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <cmath>
+#include <algorithm>
+#include "GccContext.h"
+#include "Rtcp/RtcpFCI.h"
+
+using namespace std;
+
+namespace mediakit {
+
+// 已发送rtp环形缓存大小
+static constexpr size_t kMaxSentPackets = 4096;
+// 发送间隔在该值以内的包归为同一个包组，单位微秒
+static constexpr uint64_t kBurstIntervalUs = 5000;
+// trendline滤波参数
+static constexpr size_t kTrendWindowSize = 20;
+static constexpr double kTrendSmoothing = 0.9;
+static constexpr double kTrendGain = 4;
+// 过载持续该时长后才判定为过载，单位毫秒
+static constexpr double kOverUsingTimeThreshold = 10;
+// 过载时码率降为对端确认码率的比例
+static constexpr double kDecreaseFactor = 0.85;
+// 码率每秒上升比例
+static constexpr double kIncreaseFactor = 1.08;
+// 统计对端确认码率的时间窗口，单位毫秒
+static constexpr uint64_t kAckedWindowMs = 1000;
+// 超过该时长未收到twcc反馈时，使用rr汇报的丢包率，单位毫秒
+static constexpr uint64_t kTwccTimeoutMs = 2000;
+
+GccContext::GccContext(uint32_t start_bitrate, uint32_t min_bitrate, uint32_t max_bitrate) {
+    _min_bitrate = min_bitrate;
+    _max_bitrate = std::max(max_bitrate, min_bitrate);
+    _target_bitrate = start_bitrate;
+    _sent.resize(kMaxSentPackets);
+    clampTarget();
+}
+
+void GccContext::onSendRtp(uint16_t twcc_seq, size_t size, uint64_t now_ms) {
+    auto &pkt = _sent[twcc_seq % kMaxSentPackets];
+    pkt.valid = true;
+    pkt.seq = twcc_seq;
+    pkt.size = (uint32_t)size;
+    pkt.send_ms = now_ms;
+}
+
+void GccContext::onTwcc(const FCI_TWCC &fci, size_t fci_size, uint64_t now_ms) {
+    auto status = fci.getPacketChunkList(fci_size);
+    // 参考时间单位为64ms，接收时间增量单位为250us
+    auto arrival_us = (int64_t)fci.getReferenceTime() * 64000;
+    auto seq = fci.getBaseSeq();
+    auto count = fci.getPacketCount();
+    size_t total = 0, lost = 0;
+    for (uint16_t i = 0; i < count; ++i, ++seq) {
+        auto it = status.find(seq);
+        if (it == status.end()) {
+            continue;
+        }
+        auto &pkt = _sent[seq % kMaxSentPackets];
+        if (!pkt.valid || pkt.seq != seq) {
+            // 太老或非本端发送的包
+            continue;
+        }
+        ++total;
+        if (it->second.first != SymbolStatus::small_delta && it->second.first != SymbolStatus::large_delta) {
+            ++lost;
+            continue;
+        }
+        arrival_us += it->second.second * 250;
+        pkt.valid = false;
+        onPacketArrival(pkt.send_ms * 1000, arrival_us, pkt.size, now_ms);
+    }
+    if (!total) {
+        return;
+    }
+    _last_twcc_ms = now_ms;
+    updateLoss((double)lost / total, now_ms);
+    updateRate(now_ms);
+}
+
+void GccContext::onRtcpLoss(uint8_t fraction, uint64_t now_ms) {
+    if (_last_twcc_ms && now_ms - _last_twcc_ms < kTwccTimeoutMs) {
+        // twcc反馈更及时，优先使用
+        return;
+    }
+    auto loss = fraction / 256.0;
+    updateLoss(loss, now_ms);
+    if (loss < 0.02) {
+        // 丢包率很低，缓慢提高码率
+        _target_bitrate = (uint32_t)(_target_bitrate * 1.05);
+        clampTarget();
+    }
+}
+
+void GccContext::onPacketArrival(uint64_t send_us, int64_t arrival_us, uint32_t size, uint64_t now_ms) {
+    _acked.emplace_back(now_ms, size);
+    _acked_bytes += size;
+
+    if (!_has_group) {
+        _group.first_send_us = _group.last_send_us = send_us;
+        _group.last_arrival_us = arrival_us;
+        _has_group = true;
+        return;
+    }
+    if (send_us < _group.first_send_us) {
+        // 乱序包，忽略
+        return;
+    }
+    if (send_us - _group.first_send_us <= kBurstIntervalUs) {
+        // 属于当前包组
+        _group.last_send_us = std::max(_group.last_send_us, send_us);
+        _group.last_arrival_us = std::max(_group.last_arrival_us, arrival_us);
+        return;
+    }
+
+    // 当前包组结束，计算与上个包组的单向时延变化
+    if (_has_prev_group) {
+        auto send_delta_ms = (double)(_group.last_send_us - _prev_group.last_send_us) / 1000;
+        auto arrival_delta_ms = (double)(_group.last_arrival_us - _prev_group.last_arrival_us) / 1000;
+        onGroupDelta(arrival_delta_ms - send_delta_ms, send_delta_ms, _group.last_arrival_us / 1000.0, now_ms);
+    }
+    _prev_group = _group;
+    _has_prev_group = true;
+    _group.first_send_us = _group.last_send_us = send_us;
+    _group.last_arrival_us = arrival_us;
+}
+
+void GccContext::onGroupDelta(double delay_delta_ms, double send_delta_ms, double arrival_ms, uint64_t now_ms) {
+    if (_first_arrival_ms < 0) {
+        _first_arrival_ms = arrival_ms;
+    }
+    _num_deltas = std::min<size_t>(_num_deltas + 1, 1000);
+    _accumulated_delay += delay_delta_ms;
+    _smoothed_delay = kTrendSmoothing * _smoothed_delay + (1 - kTrendSmoothing) * _accumulated_delay;
+    _trend_samples.emplace_back(arrival_ms - _first_arrival_ms, _smoothed_delay);
+    if (_trend_samples.size() > kTrendWindowSize) {
+        _trend_samples.pop_front();
+    }
+
+    auto trend = _prev_trend;
+    if (_trend_samples.size() == kTrendWindowSize) {
+        // 最小二乘法计算时延随时间变化的斜率
+        double sum_x = 0, sum_y = 0;
+        for (auto &pr : _trend_samples) {
+            sum_x += pr.first;
+            sum_y += pr.second;
+        }
+        auto avg_x = sum_x / _trend_samples.size();
+        auto avg_y = sum_y / _trend_samples.size();
+        double numerator = 0, denominator = 0;
+        for (auto &pr : _trend_samples) {
+            numerator += (pr.first - avg_x) * (pr.second - avg_y);
+            denominator += (pr.first - avg_x) * (pr.first - avg_x);
+        }
+        if (denominator != 0) {
+            trend = numerator / denominator;
+        }
+    }
+
+    auto modified_trend = std::min<size_t>(_num_deltas, 60) * trend * kTrendGain;
+    if (modified_trend > _threshold) {
+        if (_time_over_using < 0) {
+            _time_over_using = send_delta_ms / 2;
+        } else {
+            _time_over_using += send_delta_ms;
+        }
+        ++_overuse_counter;
+        if (_time_over_using > kOverUsingTimeThreshold && _overuse_counter > 1 && trend >= _prev_trend) {
+            _time_over_using = 0;
+            _overuse_counter = 0;
+            _usage = Usage::over;
+        }
+    } else if (modified_trend < -_threshold) {
+        _time_over_using = -1;
+        _overuse_counter = 0;
+        _usage = Usage::under;
+    } else {
+        _time_over_using = -1;
+        _overuse_counter = 0;
+        _usage = Usage::normal;
+    }
+    _prev_trend = trend;
+    updateThreshold(modified_trend, now_ms);
+}
+
+void GccContext::updateThreshold(double modified_trend, uint64_t now_ms) {
+    if (!_last_threshold_update_ms) {
+        _last_threshold_update_ms = now_ms;
+    }
+    auto abs_trend = std::fabs(modified_trend);
+    if (abs_trend > _threshold + 15) {
+        // 突发的大时延抖动不参与阈值调整
+        _last_threshold_update_ms = now_ms;
+        return;
+    }
+    // 阈值自适应，避免与基于丢包的tcp流竞争时饿死
+    auto k = abs_trend < _threshold ? 0.039 : 0.0087;
+    auto dt = std::min<uint64_t>(now_ms - _last_threshold_update_ms, 100);
+    _threshold += k * (abs_trend - _threshold) * dt;
+    _threshold = std::min(std::max(_threshold, 6.0), 600.0);
+    _last_threshold_update_ms = now_ms;
+}
+
+void GccContext::updateRate(uint64_t now_ms) {
+    while (!_acked.empty() && _acked.front().first + kAckedWindowMs < now_ms) {
+        _acked_bytes -= _acked.front().second;
+        _acked.pop_front();
+    }
+    _acked_bitrate = (uint32_t)(_acked_bytes * 8 * 1000 / kAckedWindowMs);
+
+    if (!_last_rate_update_ms) {
+        _last_rate_update_ms = now_ms;
+        return;
+    }
+    auto dt = std::min<uint64_t>(now_ms - _last_rate_update_ms, 1000);
+    _last_rate_update_ms = now_ms;
+
+    switch (_usage) {
+        case Usage::over: {
+            // 过载，降低码率(间隔至少一个rtt级别的时长，避免连续降低)
+            if (now_ms - _last_decrease_ms > 200) {
+                auto base = _acked_bitrate ? _acked_bitrate : _target_bitrate;
+                _target_bitrate = std::min(_target_bitrate, (uint32_t)(base * kDecreaseFactor));
+                _last_decrease_ms = now_ms;
+            }
+            break;
+        }
+        case Usage::normal: {
+            // 网络正常，码率乘性上升；发送端受限于当前simulcast层码率时不做上限约束，切换到更高层即是探测
+            _target_bitrate = (uint32_t)(_target_bitrate * std::pow(kIncreaseFactor, dt / 1000.0));
+            break;
+        }
+        case Usage::under:
+        default: /*时延下降，队列正在排空，保持码率*/ break;
+    }
+    clampTarget();
+}
+
+void GccContext::updateLoss(double loss, uint64_t now_ms) {
+    _loss = loss;
+    if (loss > 0.1 && now_ms - _last_loss_decrease_ms > 300) {
+        // 丢包严重，按丢包率降低码率
+        _target_bitrate = (uint32_t)(_target_bitrate * (1 - 0.5 * loss));
+        _last_loss_decrease_ms = now_ms;
+        clampTarget();
+    }
+}
+
+void GccContext::clampTarget() {
+    _target_bitrate = std::min(std::max(_target_bitrate, _min_bitrate), _max_bitrate);
+}
+
+} // namespace mediakit
@@ -0,0 +1,138 @@
+﻿/*
+ * Copyright (c) 2016-present The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/ZLMediaKit/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT-like license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_GCCCONTEXT_H
+#define ZLMEDIAKIT_GCCCONTEXT_H
+
+#include <deque>
+#include <memory>
+#include <vector>
+#include <stdint.h>
+
+namespace mediakit {
+
+class FCI_TWCC;
+
+/**
+ * 发送端拥塞控制(简化版GCC)
+ * 根据twcc反馈计算单向时延梯度(trendline)判断网络是否过载，结合丢包率按AIMD调整目标码率
+ * 未收到twcc反馈时，退化为根据rtcp rr汇报的丢包率调整目标码率
+ */
+class GccContext {
+public:
+    using Ptr = std::shared_ptr<GccContext>;
+
+    /**
+     * @param start_bitrate 初始目标码率，单位bps
+     * @param min_bitrate 最小目标码率，单位bps
+     * @param max_bitrate 最大目标码率，单位bps
+     */
+    GccContext(uint32_t start_bitrate, uint32_t min_bitrate, uint32_t max_bitrate);
+
+    /**
+     * 发送了一个携带transport-cc扩展的rtp
+     * @param twcc_seq transport-cc扩展序号
+     * @param size rtp大小(加密前)
+     * @param now_ms 发送时间
+     */
+    void onSendRtp(uint16_t twcc_seq, size_t size, uint64_t now_ms);
+
+    /**
+     * 收到对端的transport-cc反馈
+     * @param fci twcc fci
+     * @param fci_size fci长度
+     * @param now_ms 当前时间
+     */
+    void onTwcc(const FCI_TWCC &fci, size_t fci_size, uint64_t now_ms);
+
+    /**
+     * 收到对端rtcp rr汇报的丢包率
+     * @param fraction 丢包比例，单位1/256
+     * @param now_ms 当前时间
+     */
+    void onRtcpLoss(uint8_t fraction, uint64_t now_ms);
+
+    /**
+     * 获取目标码率，单位bps
+     */
+    uint32_t getTargetBitrate() const { return _target_bitrate; }
+
+    /**
+     * 获取对端确认收到的码率，单位bps
+     */
+    uint32_t getAckedBitrate() const { return _acked_bitrate; }
+
+private:
+    enum class Usage { normal, over, under };
+
+    struct SentPacket {
+        bool valid = false;
+        uint16_t seq = 0;
+        uint32_t size = 0;
+        uint64_t send_ms = 0;
+    };
+
+    struct PacketGroup {
+        uint64_t first_send_us = 0;
+        uint64_t last_send_us = 0;
+        int64_t last_arrival_us = 0;
+    };
+
+    void onPacketArrival(uint64_t send_us, int64_t arrival_us, uint32_t size, uint64_t now_ms);
+    void onGroupDelta(double delay_delta_ms, double send_delta_ms, double arrival_ms, uint64_t now_ms);
+    void updateThreshold(double modified_trend, uint64_t now_ms);
+    void updateRate(uint64_t now_ms);
+    void updateLoss(double loss, uint64_t now_ms);
+    void clampTarget();
+
+private:
+    uint32_t _min_bitrate;
+    uint32_t _max_bitrate;
+    uint32_t _target_bitrate;
+    uint32_t _acked_bitrate = 0;
+
+    // 已发送rtp环形缓存，通过twcc序号索引
+    std::vector<SentPacket> _sent;
+
+    // 包组(发送间隔5ms内的包为一组)
+    bool _has_group = false;
+    bool _has_prev_group = false;
+    PacketGroup _group;
+    PacketGroup _prev_group;
+
+    // trendline滤波
+    double _first_arrival_ms = -1;
+    size_t _num_deltas = 0;
+    double _accumulated_delay = 0;
+    double _smoothed_delay = 0;
+    double _prev_trend = 0;
+    std::deque<std::pair<double /*arrival ms*/, double /*smoothed delay ms*/>> _trend_samples;
+
+    // 过载检测
+    double _threshold = 12.5;
+    double _time_over_using = -1;
+    int _overuse_counter = 0;
+    uint64_t _last_threshold_update_ms = 0;
+    Usage _usage = Usage::normal;
+
+    // 码率控制
+    uint64_t _last_rate_update_ms = 0;
+    uint64_t _last_decrease_ms = 0;
+    std::deque<std::pair<uint64_t /*arrival ms*/, uint32_t /*bytes*/>> _acked;
+    size_t _acked_bytes = 0;
+
+    // 丢包控制
+    double _loss = 0;
+    uint64_t _last_twcc_ms = 0;
+    uint64_t _last_loss_decrease_ms = 0;
+};
+
+} // namespace mediakit
+#endif // ZLMEDIAKIT_GCCCONTEXT_H
@@ -564,6 +564,20 @@ RtpExtContext::RtpExtContext(const RtcMedia &m){
     }
 }
 
+string RtpExtContext::getSendExtProfile() const {
+    string ret;
+    for (auto &pr : _rtp_ext_type_to_id) {
+        ret.push_back((char)pr.first);
+        ret.push_back((char)pr.second);
+    }
+    return ret;
+}
+
+uint8_t RtpExtContext::getSendExtId(RtpExtType type) const {
+    auto it = _rtp_ext_type_to_id.find(type);
+    return it == _rtp_ext_type_to_id.end() ? 0 : it->second;
+}
+
 string RtpExtContext::getRid(uint32_t ssrc) const{
     auto it = _ssrc_to_rid.find(ssrc);
     if (it == _ssrc_to_rid.end()) {
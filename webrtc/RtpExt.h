@@ -124,6 +124,16 @@ public:
     void setRid(uint32_t ssrc, const std::string &rid);
     RtpExt changeRtpExtId(const RtpHeader *header, bool is_recv, std::string *rid_ptr = nullptr, RtpExtType type = RtpExtType::padding);
 
+    /**
+     * 获取发送rtp时ext id映射关系的序列化值，映射关系相同的播放器改写后的rtp ext一致
+     */
+    std::string getSendExtProfile() const;
+
+    /**
+     * 获取发送rtp时客户端sdp声明的ext id，未协商该ext时返回0
+     */
+    uint8_t getSendExtId(RtpExtType type) const;
+
 private:
     void onGetRtp(uint8_t pt, uint32_t ssrc, const std::string &rid);
 
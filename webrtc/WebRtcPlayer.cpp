@@ -13,11 +13,122 @@
 #include "Common/config.h"
 #include "Extension/Factory.h"
 #include "Util/base64.h"
+#include <algorithm>
 
 using namespace std;
 
 namespace mediakit {
 
+namespace Rtc {
+#define RTC_FIELD "rtc."
+// 播放webrtc simulcast推流时，根据发送端带宽估计自动选择simulcast层
+const string kSimulcastAdaptive = RTC_FIELD "simulcastAdaptive";
+
+static onceToken token([]() {
+    mINI::Instance()[kSimulcastAdaptive] = 0;
+});
+} // namespace Rtc
+
+// 判断rtp是否为视频关键帧的起始包(包括关键帧前的sps/vps)，simulcast只能在关键帧处切换层
+static bool isKeyFrameStart(CodecId codec, const RtpPacket::Ptr &rtp) {
+    auto payload = rtp->getPayload();
+    auto size = rtp->getPayloadSize();
+    switch (codec) {
+        case CodecH264: {
+            if (size < 2) {
+                return false;
+            }
+            switch (payload[0] & 0x1F) {
+                case 5:
+                case 7: return true;
+                // STAP-A
+                case 24: return size > 3 && ((payload[3] & 0x1F) == 5 || (payload[3] & 0x1F) == 7);
+                // FU-A
+                case 28: return (payload[1] & 0x80) && ((payload[1] & 0x1F) == 5 || (payload[1] & 0x1F) == 7);
+                default: return false;
+            }
+        }
+        case CodecH265: {
+            if (size < 3) {
+                return false;
+            }
+            auto is_key = [](int type) { return (type >= 16 && type <= 21) || (type >= 32 && type <= 34); };
+            switch ((payload[0] >> 1) & 0x3F) {
+                // AP
+                case 48: return size > 4 && is_key((payload[4] >> 1) & 0x3F);
+                // FU
+                case 49: return (payload[2] & 0x80) && is_key(payload[2] & 0x3F);
+                default: return is_key((payload[0] >> 1) & 0x3F);
+            }
+        }
+        case CodecVP8: {
+            // 帧的第一个分片: S=1 且 PID=0
+            if (size < 1 || !(payload[0] & 0x10) || (payload[0] & 0x07)) {
+                return false;
+            }
+            size_t offset = 1;
+            if (payload[0] & 0x80) {
+                // 扩展控制位
+                if (size < 2) {
+                    return false;
+                }
+                auto x = payload[1];
+                offset = 2;
+                if (x & 0x80) {
+                    // picture id
+                    if (size <= offset) {
+                        return false;
+                    }
+                    offset += (payload[offset] & 0x80) ? 2 : 1;
+                }
+                if (x & 0x40) {
+                    // TL0PICIDX
+                    ++offset;
+                }
+                if (x & 0x30) {
+                    // TID/KEYIDX
+                    ++offset;
+                }
+            }
+            // vp8 payload header P位为0代表关键帧
+            return size > offset && !(payload[offset] & 0x01);
+        }
+        default: return false;
+    }
+}
+
+// 获取改写seq与时间戳后的rtp
+// 同一线程上在同一关键帧处切换到同一层的播放器偏移量相同，共享改写结果，这样协商改写缓存(getRewrittenRtp)也能继续共享
+static RtpPacket::Ptr getOffsetRtp(const RtpPacket::Ptr &rtp, uint16_t seq_offset, uint32_t stamp_offset) {
+    struct Entry {
+        uint16_t seq_offset = 0;
+        uint32_t stamp_offset = 0;
+        RtpPacket::Ptr rtp;
+        RtpPacket::Ptr out;
+    };
+    static constexpr size_t kCacheSize = 256;
+    static thread_local vector<Entry> s_cache(kCacheSize);
+
+    auto &entry = s_cache[(((uintptr_t)rtp.get() >> 4) ^ ((seq_offset ^ stamp_offset) * 0x9E3779B1u)) % kCacheSize];
+    if (entry.rtp == rtp && entry.seq_offset == seq_offset && entry.stamp_offset == stamp_offset) {
+        return entry.out;
+    }
+    auto out = RtpPacket::create();
+    out->assign(rtp->data(), rtp->size());
+    out->type = rtp->type;
+    out->sample_rate = rtp->sample_rate;
+    out->ntp_stamp = rtp->ntp_stamp;
+    out->track_index = rtp->track_index;
+    auto header = out->getHeader();
+    header->seq = htons(rtp->getSeq() + seq_offset);
+    header->stamp = htonl(rtp->getStamp() + stamp_offset);
+    entry.seq_offset = seq_offset;
+    entry.stamp_offset = stamp_offset;
+    entry.rtp = rtp;
+    entry.out = out;
+    return out;
+}
+
 WebRtcPlayer::Ptr WebRtcPlayer::create(const EventPoller::Ptr &poller,
                                        const RtspMediaSource::Ptr &src,
                                        const MediaInfo &info) {
@@ -59,7 +170,8 @@ void WebRtcPlayer::onStartWebRTC() {
         });
         _reader->setReadCB([weak_self](const RtspMediaSource::RingDataType &pkt) {
             auto strong_self = weak_self.lock();
-            if (!strong_self) {
+            if (!strong_self || strong_self->_layer_reader) {
+                // simulcast自适应时从各simulcast层读取rtp
                 return;
             }
 
@@ -84,27 +196,277 @@ void WebRtcPlayer::onStartWebRTC() {
         });
 
         _reader->setMessageCB([weak_self] (const toolkit::Any &data) {
-            auto strong_self = weak_self.lock();
-            if (!strong_self) {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->onReaderMessage(data);
+            }
+        });
+
+        GET_CONFIG(bool, simulcast_adaptive, Rtc::kSimulcastAdaptive);
+        if (simulcast_adaptive && playSrc->getOriginType() == MediaOriginType::rtc_push) {
+            SdpParser parser(playSrc->getSdp());
+            auto video_sdp = parser.getTrack(TrackVideo);
+            auto video_track = video_sdp ? Factory::getTrackBySdp(video_sdp) : nullptr;
+            _video_codec = video_track ? video_track->getCodecId() : CodecInvalid;
+            checkSimulcastLayer();
+            getPoller()->doDelayTask(1000, [weak_self]() -> uint64_t {
+                auto strong_self = weak_self.lock();
+                if (!strong_self) {
+                    return 0;
+                }
+                strong_self->checkSimulcastLayer();
+                return 1000;
+            });
+        }
+    }
+}
+
+void WebRtcPlayer::onReaderMessage(const toolkit::Any &data) {
+    if (data.is<Buffer>()) {
+        auto &buffer = data.get<Buffer>();
+        // PPID 51: 文本string
+        // PPID 53: 二进制
+        sendDatachannel(0, 51, buffer.data(), buffer.size());
+    } else {
+        WarnL << "Send unknown message type to webrtc player: " << data.type_name();
+    }
+}
+
+vector<RtspMediaSource::Ptr> WebRtcPlayer::getSimulcastLayers(const RtspMediaSource::Ptr &play_src) {
+    vector<RtspMediaSource::Ptr> ret;
+    vector<pair<int /*bytes speed*/, RtspMediaSource::Ptr>> layers;
+    for (auto &weak_src : _layers) {
+        auto src = weak_src.lock();
+        if (!src) {
+            // 有层注销了，重新查找
+            layers.clear();
+            break;
+        }
+        layers.emplace_back(src->getBytesSpeed(TrackVideo), std::move(src));
+    }
+    // simulcast至少2层，层数不足时可能是部分层尚未注册，继续查找
+    if (layers.size() < 2) {
+        layers.clear();
+        _layers.clear();
+        // webrtc simulcast推流的各层流id为: 流id_rid
+        auto &tuple = play_src->getMediaTuple();
+        auto prefix = tuple.stream + '_';
+        auto origin = play_src->getOriginSock();
+        MediaSource::for_each_media([&](const MediaSource::Ptr &src) {
+            auto &stream = src->getMediaTuple().stream;
+            if (stream.size() <= prefix.size() || stream.compare(0, prefix.size(), prefix) || src->getOriginSock() != origin) {
                 return;
             }
-            if (data.is<Buffer>()) {
-                auto &buffer = data.get<Buffer>();
-                // PPID 51: 文本string
-                // PPID 53: 二进制
-                strong_self->sendDatachannel(0, 51, buffer.data(), buffer.size());
-            } else {
-                WarnL << "Send unknown message type to webrtc player: " << data.type_name();
+            if (auto rtsp_src = dynamic_pointer_cast<RtspMediaSource>(src)) {
+                _layers.emplace_back(rtsp_src);
+                layers.emplace_back(rtsp_src->getBytesSpeed(TrackVideo), std::move(rtsp_src));
+            }
+        }, RTSP_SCHEMA, tuple.vhost, tuple.app);
+    }
+    std::sort(layers.begin(), layers.end(), [](const pair<int, RtspMediaSource::Ptr> &a, const pair<int, RtspMediaSource::Ptr> &b) {
+        return a.first < b.first;
+    });
+    for (auto &pr : layers) {
+        ret.emplace_back(std::move(pr.second));
+    }
+    return ret;
+}
+
+void WebRtcPlayer::checkSimulcastLayer() {
+    auto play_src = _play_src.lock();
+    auto layers = play_src ? getSimulcastLayers(play_src) : vector<RtspMediaSource::Ptr>();
+    if (layers.empty()) {
+        if (_layer_reader) {
+            // 已经改为从各层读取，推流结束后各层都已注销
+            onShutdown(SockException(Err_shutdown, "simulcast layers were shutdown"));
+        }
+        return;
+    }
+    enableBwe();
+
+    // 选择视频码率不超过目标码率85%的最高层，留出余量给音频与重传
+    auto target = getTargetBitrate() * 0.85;
+    auto selected = layers.front();
+    RtspMediaSource::Ptr current;
+    for (auto &src : layers) {
+        if (src->getBytesSpeed(TrackVideo) * 8 <= target) {
+            selected = src;
+        }
+        if (src->getMediaTuple().stream == _layer_stream) {
+            current = src;
+        }
+    }
+    auto &stream = selected->getMediaTuple().stream;
+
+    if (!current) {
+        // 首次播放或者当前层已经消失，从最近的关键帧开始播放
+        InfoL << "simulcast layer select:" << stream << ", target bitrate:" << getTargetBitrate();
+        _layer_stream = stream;
+        _layer_reader = attachLayer(selected, true, _layer_token);
+        _pending_stream.clear();
+        _pending_reader = nullptr;
+        _pending_token = nullptr;
+        _layer_ticker.resetTime();
+        _layer_rebase = true;
+        // 原始流的reader保持attach但不再转发rtp，这样任何类型的媒体源都能正确统计观看人数与触发无人观看事件
+        return;
+    }
+    if (stream == _layer_stream) {
+        // 带宽恢复，取消等待中的切换
+        _pending_stream.clear();
+        _pending_reader = nullptr;
+        _pending_token = nullptr;
+        return;
+    }
+    if (stream == _pending_stream || (_video_codec != CodecH264 && _video_codec != CodecH265 && _video_codec != CodecVP8)) {
+        // 等待关键帧中，或者该编码格式不支持关键帧识别，无法无缝切换
+        return;
+    }
+
+    auto up = selected->getBytesSpeed(TrackVideo) > current->getBytesSpeed(TrackVideo);
+    if (up && (_layer_ticker.elapsedTime() < 3 * 1000 || _layer_down_ticker.elapsedTime() < 10 * 1000)) {
+        // 升层前需要带宽稳定一段时间
+        return;
+    }
+    if (!up) {
+        _layer_down_ticker.resetTime();
+    }
+    DebugL << "simulcast layer switching:" << _layer_stream << " -> " << stream << ", target bitrate:" << getTargetBitrate();
+    _pending_stream = stream;
+    _pending_reader = attachLayer(selected, false, _pending_token);
+}
+
+RtspMediaSource::RingType::RingReader::Ptr WebRtcPlayer::attachLayer(const RtspMediaSource::Ptr &src, bool use_cache, std::shared_ptr<void> &token) {
+    auto reader = src->getRing()->attach(getPoller(), use_cache);
+    token = src->addSimulcastReader();
+    weak_ptr<WebRtcPlayer> weak_self = static_pointer_cast<WebRtcPlayer>(shared_from_this());
+    weak_ptr<Session> weak_session = static_pointer_cast<Session>(getSession());
+    auto stream = src->getMediaTuple().stream;
+    reader->setGetInfoCB([weak_session]() {
+        Any ret;
+        ret.set(static_pointer_cast<SockInfo>(weak_session.lock()));
+        return ret;
+    });
+    reader->setReadCB([weak_self, stream](const RtspMediaSource::RingDataType &pkt) {
+        if (auto strong_self = weak_self.lock()) {
+            strong_self->onLayerRtp(stream, pkt);
+        }
+    });
+    reader->setMessageCB([weak_self](const toolkit::Any &data) {
+        if (auto strong_self = weak_self.lock()) {
+            strong_self->onReaderMessage(data);
+        }
+    });
+    reader->setDetachCB([weak_self, stream]() {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return;
+        }
+        // 该层推流停止，下次检查时重新选择(reader在回调中不能释放)
+        if (stream == strong_self->_layer_stream) {
+            strong_self->_layer_stream.clear();
+        } else if (stream == strong_self->_pending_stream) {
+            strong_self->_pending_stream.clear();
+        }
+    });
+    return reader;
+}
+
+void WebRtcPlayer::onLayerRtp(const string &stream, const RtspMediaSource::RingDataType &pkt) {
+    // 从该位置开始转发视频
+    size_t start = 0;
+    if (stream == _pending_stream) {
+        // 新层收到视频关键帧后才切换过去
+        size_t i = 0;
+        bool found = false;
+        pkt->for_each([&](const RtpPacket::Ptr &rtp) {
+            if (!found && rtp->type == TrackVideo && isKeyFrameStart(_video_codec, rtp)) {
+                found = true;
+                start = i;
             }
+            ++i;
         });
+        if (found) {
+            InfoL << "simulcast layer switched:" << _layer_stream << " -> " << _pending_stream;
+            _layer_stream = std::move(_pending_stream);
+            _pending_stream.clear();
+            // 旧层的reader随之释放
+            _layer_reader = std::move(_pending_reader);
+            _layer_token = std::move(_pending_token);
+            _layer_ticker.resetTime();
+            _layer_rebase = true;
+        } else {
+            // 尚未切换，只转发其中的音频
+            start = pkt->size();
+        }
+    } else if (stream != _layer_stream) {
+        // 已经切走的层
+        return;
+    }
+
+    // 最后一个转发的rtp才flush
+    RtpPacket::Ptr last;
+    size_t i = 0;
+    pkt->for_each([&](const RtpPacket::Ptr &rtp) {
+        auto index = i++;
+        if (rtp->type == TrackVideo) {
+            if (index < start) {
+                return;
+            }
+        } else {
+            // 音频不按视频层的批次位置过滤，当前层与等待切换的层中先到达的音频转发，重复的丢弃
+            auto seq = rtp->getSeq();
+            if (_has_last_audio && (int16_t)(seq - _last_audio_seq) <= 0) {
+                return;
+            }
+            _has_last_audio = true;
+            _last_audio_seq = seq;
+        }
+        if (last) {
+            sendLayerRtp(last, false);
+        }
+        last = rtp;
+    });
+    if (last) {
+        sendLayerRtp(last, true);
+    }
+}
+
+void WebRtcPlayer::sendLayerRtp(const RtpPacket::Ptr &rtp, bool flush) {
+    if (rtp->type != TrackVideo) {
+        // 各层的音频是同一份rtp
+        onSendRtp(rtp, flush);
+        return;
+    }
+    if (_layer_rebase) {
+        _layer_rebase = false;
+        if (_has_last_video) {
+            // 各层rtp的seq与时间戳起始值是随机的，需要改写得与上一层衔接，两层的时间间隔通过ntp时间戳估算
+            auto sample_rate = rtp->sample_rate ? rtp->sample_rate : 90000;
+            uint32_t delta = sample_rate / 30;
+            if (rtp->ntp_stamp > _last_video_ntp && rtp->ntp_stamp - _last_video_ntp < 1000) {
+                delta = std::max<uint32_t>((rtp->ntp_stamp - _last_video_ntp) * sample_rate / 1000, 1);
+            }
+            _video_seq_offset = _last_video_seq + 1 - rtp->getSeq();
+            _video_stamp_offset = _last_video_stamp + delta - rtp->getStamp();
+        }
+    }
+
+    auto out = rtp;
+    if (_video_seq_offset || _video_stamp_offset) {
+        out = getOffsetRtp(rtp, _video_seq_offset, _video_stamp_offset);
     }
+    _has_last_video = true;
+    _last_video_seq = out->getSeq();
+    _last_video_stamp = out->getStamp();
+    _last_video_ntp = rtp->ntp_stamp;
+    onSendRtp(out, flush);
 }
 void WebRtcPlayer::onDestory() {
     auto duration = getDuration();
     auto bytes_usage = getBytesUsage();
     //流量统计事件广播
     GET_CONFIG(uint32_t, iFlowThreshold, General::kFlowThreshold);
-    if (_reader && getSession()) {
+    if ((_reader || _layer_reader) && getSession()) {
         WarnL << "RTC播放器(" << _media_info.shortUrl() << ")结束播放,耗时(s):" << duration;
         if (bytes_usage >= iFlowThreshold * 1024) {
             NOTICE_EMIT(BroadcastFlowReportArgs, Broadcast::kBroadcastFlowReport, _media_info, bytes_usage, duration, true, *getSession());
@@ -33,6 +33,26 @@ private:
 
     void sendConfigFrames(uint32_t before_seq, uint32_t sample_rate, uint32_t timestamp, uint64_t ntp_timestamp);
 
+    /**
+     * 根据带宽估计选择simulcast层，定时调用
+     */
+    void checkSimulcastLayer();
+
+    /**
+     * 获取同一个webrtc推流的各simulcast层媒体源，按视频码率从低到高排序
+     * 各层只查找一次并缓存，有层注销或层数不足时才重新查找
+     */
+    std::vector<RtspMediaSource::Ptr> getSimulcastLayers(const RtspMediaSource::Ptr &play_src);
+
+    void onReaderMessage(const toolkit::Any &data);
+
+    /**
+     * attach simulcast层，token存活期间该reader不计入推流的总观看人数(已经计入原始流)
+     */
+    RtspMediaSource::RingType::RingReader::Ptr attachLayer(const RtspMediaSource::Ptr &src, bool use_cache, std::shared_ptr<void> &token);
+    void onLayerRtp(const std::string &stream, const RtspMediaSource::RingDataType &pkt);
+    void sendLayerRtp(const RtpPacket::Ptr &rtp, bool flush);
+
 private:
     //媒体相关元数据
     MediaInfo _media_info;
@@ -42,8 +62,33 @@ private:
     // rtp 直接转发情况下通常会缺少 sps/pps, 在转发 rtp 前, 先发送一次相关帧信息, 部分情况下是可以播放的
     bool _send_config_frames_once { false };
 
-    //播放rtsp源的reader对象
+    //播放rtsp源的reader对象，从simulcast层读取rtp时也保持attach(不转发数据)，以便原始流的观看人数统计与无人观看处理
     RtspMediaSource::RingType::RingReader::Ptr _reader;
+
+    //simulcast自适应，当前播放层与等待关键帧切换的层
+    CodecId _video_codec = CodecInvalid;
+    std::vector<std::weak_ptr<RtspMediaSource>> _layers;
+    std::string _layer_stream;
+    std::string _pending_stream;
+    RtspMediaSource::RingType::RingReader::Ptr _layer_reader;
+    RtspMediaSource::RingType::RingReader::Ptr _pending_reader;
+    std::shared_ptr<void> _layer_token;
+    std::shared_ptr<void> _pending_token;
+    //上次切换层的时间
+    toolkit::Ticker _layer_ticker;
+    //上次降层的时间，降层后一段时间内不升层，避免来回切换
+    toolkit::Ticker _layer_down_ticker;
+    //切换层后需要重新计算视频rtp seq与时间戳偏移量，使其与上一层衔接
+    bool _layer_rebase = false;
+    bool _has_last_video = false;
+    uint16_t _last_video_seq = 0;
+    uint32_t _last_video_stamp = 0;
+    uint64_t _last_video_ntp = 0;
+    uint16_t _video_seq_offset = 0;
+    uint32_t _video_stamp_offset = 0;
+    //各层的音频是同一份rtp，各层环形缓冲独立flush，按seq去重，不依赖当前视频层
+    bool _has_last_audio = false;
+    uint16_t _last_audio_seq = 0;
 };
 
 }// namespace mediakit
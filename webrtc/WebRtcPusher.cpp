@@ -61,7 +61,8 @@ int WebRtcPusher::totalReaderCount(MediaSource &sender) {
     if (_simulcast) {
         std::lock_guard<std::recursive_mutex> lock(_mtx);
         for (auto &src : _push_src_sim) {
-            total_count += src.second->totalReaderCount();
+            // simulcast自适应播放器已经计入原始流的观看人数
+            total_count += src.second->totalReaderCount() - src.second->simulcastReaderCount();
         }
     }
     return total_count;
@@ -90,6 +90,7 @@ void WebRtcSession::onRecv_l(const char *data, size_t len) {
 }
 
 void WebRtcSession::onRecv(const Buffer::Ptr &buffer) {
+    Metrics::addBytesIn(Metrics::kWebRtc, buffer->size());
     if (_over_tcp) {
         input(buffer->data(), buffer->size());
     } else {
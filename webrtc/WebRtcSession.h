@@ -15,6 +15,7 @@
 #include "WebRtcTransport.h"
 #include "Network/Session.h"
 #include "Http/HttpRequestSplitter.h"
+#include "Common/Metrics.h"
 
 namespace toolkit {
     class TcpServer;
@@ -49,6 +50,8 @@ private:
     bool _find_transport = true;
     Ticker _ticker;
     std::weak_ptr<toolkit::TcpServer> _server;
+    //会话个数统计
+    Metrics::SessionCounter _metrics { Metrics::kWebRtc };
 };
 
 }// namespace mediakit
@@ -13,6 +13,7 @@
 #include "Util/base64.h"
 #include "Network/sockutil.h"
 #include "Common/config.h"
+#include "Common/Metrics.h"
 #include "Nack.h"
 #include "RtpExt.h"
 #include "Rtcp/Rtcp.h"
@@ -472,8 +473,8 @@ void WebRtcTransport::inputSockData(char *buf, int len, RTC::TransportTuple *tup
 void WebRtcTransport::sendRtpPacket(const char *buf, int len, bool flush, void *ctx) {
     if (_srtp_session_send) {
         auto pkt = _packet_pool.obtain2();
-        // 预留rtx加入的两个字节
-        pkt->setCapacity((size_t)len + SRTP_MAX_TRAILER_LEN + 2);
+        // 预留rtx加入的两个字节以及transport-cc扩展的8个字节
+        pkt->setCapacity((size_t)len + SRTP_MAX_TRAILER_LEN + 2 + 8);
         memcpy(pkt->data(), buf, len);
         onBeforeEncryptRtp(pkt->data(), len, ctx);
         if (_srtp_session_send->EncryptRtp(reinterpret_cast<uint8_t *>(pkt->data()), &len)) {
@@ -515,6 +516,8 @@ void WebRtcTransportImp::onCreate() {
             if (strong_self->_alive_ticker.elapsedTime() > timeoutSec * 1000) {
                 strong_self->onShutdown(SockException(Err_timeout, "接受rtp/rtcp/datachannel超时"));
             }
+            // 调用者一直未flush时，也定时把等待记录发送时间的rtp交给带宽估计，防止堆积
+            strong_self->onTwccSent();
             return true;
         },
         getPoller());
@@ -552,8 +555,19 @@ void WebRtcTransportImp::onSendSockData(Buffer::Ptr buf, bool flush, RTC::Transp
             return;
         }
     }
+    Metrics::addBytesOut(Metrics::kWebRtc, buf->size());
 
     // 一次性发送一帧的rtp数据，提高网络io性能
+    if (tuple->getSock()->sockType() == SockNum::Sock_UDP) {
+        _udp_batch_sender.setSocket(tuple->getSock());
+        _udp_batch_sender.input(std::move(buf));
+        if (flush) {
+            _udp_batch_sender.flush();
+            onTwccSent();
+        }
+        return;
+    }
+
     if (tuple->getSock()->sockType() == SockNum::Sock_TCP) {
         // 增加tcp两字节头
         auto len = buf->size();
@@ -566,9 +580,22 @@ void WebRtcTransportImp::onSendSockData(Buffer::Ptr buf, bool flush, RTC::Transp
 
     if (flush) {
         tuple->flushAll();
+        onTwccSent();
     }
 }
 
+void WebRtcTransportImp::onTwccSent() {
+    if (!_gcc_ctx || _twcc_pending.empty()) {
+        return;
+    }
+    // 批量发送时rtp在flush时才真正交给socket，此时再记录发送时间，否则包组间隔与时延梯度会失真
+    auto now = getCurrentMillisecond();
+    for (auto &pr : _twcc_pending) {
+        _gcc_ctx->onSendRtp(pr.first, pr.second, now);
+    }
+    _twcc_pending.clear();
+}
+
 ///////////////////////////////////////////////////////////////////
 
 bool WebRtcTransportImp::canSendRtp() const {
@@ -589,6 +616,90 @@ bool WebRtcTransportImp::canRecvRtp() const {
     return false;
 }
 
+// 获取发送rtp改写方案编号，pt、ssrc、ext id映射关系都一致的track编号相同
+// 方案由引用它的track共享，最后一个track释放时从表中移除；编号递增不复用，改写缓存不会误命中已回收的方案
+static std::shared_ptr<uint32_t> getRewriteProfile(const MediaTrack &track) {
+    string key;
+    key.push_back((char)track.plan_rtp->pt);
+    key.append((char *)&track.answer_ssrc_rtp, sizeof(track.answer_ssrc_rtp));
+    key.append(track.rtp_ext_ctx->getSendExtProfile());
+
+    static mutex s_mtx;
+    static unordered_map<string, std::weak_ptr<uint32_t>> s_profiles;
+    static uint32_t s_next_profile = 0;
+    lock_guard<mutex> lck(s_mtx);
+    auto &ref = s_profiles[key];
+    auto ret = ref.lock();
+    if (ret) {
+        return ret;
+    }
+    ret.reset(new uint32_t(++s_next_profile), [key](uint32_t *ptr) {
+        delete ptr;
+        lock_guard<mutex> lck(s_mtx);
+        auto it = s_profiles.find(key);
+        if (it != s_profiles.end() && it->second.expired()) {
+            // 期间可能已经有新的track重新创建了该方案
+            s_profiles.erase(it);
+        }
+    });
+    ref = ret;
+    return ret;
+}
+
+// 修改发送rtp的pt、ssrc与ext id为对方协商的值
+static void changeRtpHeader(RtpHeader *header, MediaTrack &track, uint32_t ssrc, uint8_t pt) {
+    track.rtp_ext_ctx->changeRtpExtId(header, false);
+    header->pt = pt;
+    header->ssrc = htonl(ssrc);
+}
+
+// 获取改写后的明文rtp
+// 同一个rtp包会被本线程内所有播放器连续发送，协商结果一致的播放器只需改写一次，
+// 所以很小的直接映射缓存即可有很高的命中率；缓存项持有rtp包，地址不会被复用
+// 缓存项只在短时间内有用，由本线程定时清理，防止停播后继续占用rtp包
+static Buffer::Ptr getRewrittenRtp(MediaTrack &track, const RtpPacket::Ptr &rtp) {
+    struct Entry {
+        uint32_t profile = 0;
+        uint64_t stamp = 0;
+        RtpPacket::Ptr rtp;
+        BufferRaw::Ptr buf;
+    };
+    static constexpr size_t kCacheSize = 1024;
+    static constexpr uint64_t kCacheExpireMS = 2000;
+    static thread_local vector<Entry> s_cache(kCacheSize);
+    static thread_local bool s_clean_timer = false;
+
+    if (!s_clean_timer) {
+        s_clean_timer = true;
+        if (auto poller = EventPoller::getCurrentPoller()) {
+            poller->doDelayTask(kCacheExpireMS, []() {
+                // 定时任务在本线程执行，访问的是同一个缓存
+                auto now = getCurrentMillisecond();
+                for (auto &entry : s_cache) {
+                    if (entry.rtp && now - entry.stamp >= kCacheExpireMS) {
+                        entry = Entry();
+                    }
+                }
+                return kCacheExpireMS;
+            });
+        }
+    }
+
+    auto profile = *track.rewrite_profile;
+    auto &entry = s_cache[(((uintptr_t)rtp.get() >> 4) ^ (profile * 0x9E3779B1u)) % kCacheSize];
+    if (entry.rtp == rtp && entry.profile == profile) {
+        return entry.buf;
+    }
+    auto buf = BufferRaw::create();
+    buf->assign(rtp->data() + RtpPacket::kRtpTcpHeaderSize, rtp->size() - RtpPacket::kRtpTcpHeaderSize);
+    changeRtpHeader((RtpHeader *)buf->data(), track, track.answer_ssrc_rtp, track.plan_rtp->pt);
+    entry.profile = profile;
+    entry.stamp = getCurrentMillisecond();
+    entry.rtp = rtp;
+    entry.buf = buf;
+    return buf;
+}
+
 void WebRtcTransportImp::onStartWebRTC() {
     // 获取ssrc和pt相关信息,届时收到rtp和rtcp时分别可以根据pt和ssrc找到相关的信息
     for (auto &m_answer : _answer_sdp->media) {
@@ -629,6 +740,7 @@ void WebRtcTransportImp::onStartWebRTC() {
         }
         // 记录rtp ext类型与id的关系，方便接收或发送rtp时修改rtp ext id
         track->rtp_ext_ctx = std::make_shared<RtpExtContext>(m_answer);
+        track->rewrite_profile = getRewriteProfile(*track);
         weak_ptr<MediaTrack> weak_track = track;
         track->rtp_ext_ctx->setOnGetRtp([this, weak_track](uint8_t pt, uint32_t ssrc, const string &rid) {
             // ssrc --> MediaTrack
@@ -923,6 +1035,9 @@ void WebRtcTransportImp::onRtcp(const char *buf, size_t len) {
                 if (it != _ssrc_to_track.end()) {
                     auto &track = it->second;
                     track->rtcp_context_send->onRtcp(rtcp);
+                    if (_gcc_ctx) {
+                        _gcc_ctx->onRtcpLoss(item->fraction, getCurrentMillisecond());
+                    }
                     auto sr = track->rtcp_context_send->createRtcpSR(track->answer_ssrc_rtp);
                     sendRtcpPacket(sr->data(), sr->size(), true);
                 } else {
@@ -962,12 +1077,22 @@ void WebRtcTransportImp::onRtcp(const char *buf, size_t len) {
                 }
                 auto &track = it->second;
                 auto &fci = fb->getFci<FCI_NACK>();
+                Metrics::add(Metrics::kRtcNackRecv);
                 track->nack_list.forEach(fci, [&](const RtpPacket::Ptr &rtp) {
                     // rtp重传
                     onSendRtp(rtp, true, true);
                 });
                 break;
             }
+            case RTPFBType::RTCP_RTPFB_TWCC: {
+                if (_gcc_ctx) {
+                    // 先记录尚未flush的rtp的发送时间，否则反馈中的这些包会被当作未知包忽略
+                    onTwccSent();
+                    RtcpFB *fb = (RtcpFB *)rtcp;
+                    _gcc_ctx->onTwcc(fb->getFci<FCI_TWCC>(), fb->getFciSize(), getCurrentMillisecond());
+                }
+                break;
+            }
             default:
                 break;
             }
@@ -1075,6 +1200,7 @@ void WrappedRtxTrack::inputRtp(const char *buf, size_t len, uint64_t stamp_ms, R
 
     // 这里是rtx重传包
     //  https://datatracker.ietf.org/doc/html/rfc4588#section-4
+    Metrics::add(Metrics::kRtcRtxRecv);
     auto payload = rtp->getPayloadData();
     auto size = rtp->getPayloadSize(len);
     if (size < 2) {
@@ -1095,6 +1221,7 @@ void WrappedRtxTrack::inputRtp(const char *buf, size_t len, uint64_t stamp_ms, R
 }
 
 void WebRtcTransportImp::onSendNack(MediaTrack &track, const FCI_NACK &nack, uint32_t ssrc) {
+    Metrics::add(Metrics::kRtcNackSent);
     auto rtcp = RtcpFB::create(RTPFBType::RTCP_RTPFB_NACK, &nack, FCI_NACK::kSize);
     rtcp->ssrc = htonl(track.answer_ssrc_rtp);
     rtcp->ssrc_media = htonl(ssrc);
@@ -1146,35 +1273,127 @@ void WebRtcTransportImp::onSendRtp(const RtpPacket::Ptr &rtp, bool flush, bool r
             return;
         }
 #endif
+        // 协商结果一致的播放器共享改写后的rtp，每个播放器只需拷贝与加密
+        auto buf = getRewrittenRtp(*track, rtp);
+        sendRtpPacket(buf->data(), buf->size(), flush, nullptr);
     } else {
         // 发送rtx重传包
         // TraceL << "send rtx rtp:" << rtp->getSeq();
+        Metrics::add(Metrics::kRtcRtxSent);
+        pair<bool /*rtx*/, MediaTrack *> ctx { rtx, track.get() };
+        sendRtpPacket(rtp->data() + RtpPacket::kRtpTcpHeaderSize, rtp->size() - RtpPacket::kRtpTcpHeaderSize, flush, &ctx);
     }
-    pair<bool /*rtx*/, MediaTrack *> ctx { rtx, track.get() };
-    sendRtpPacket(rtp->data() + RtpPacket::kRtpTcpHeaderSize, rtp->size() - RtpPacket::kRtpTcpHeaderSize, flush, &ctx);
     _bytes_usage += rtp->size() - RtpPacket::kRtpTcpHeaderSize;
 }
 
+// 写入transport-cc扩展序号，rtp中没有该扩展时插入(最多增加8个字节)
+static bool setTransportCCSeq(char *buf, int &len, uint8_t ext_id, uint16_t seq) {
+    auto header = (RtpHeader *)buf;
+    auto ext_ptr = (uint8_t *)buf + RtpPacket::kRtpHeaderSize + header->csrc * 4;
+    auto tail_size = len - (ext_ptr - (uint8_t *)buf);
+    if (!header->ext) {
+        // 插入扩展头，one-byte扩展头只支持1~14的id
+        memmove(ext_ptr + 8, ext_ptr, tail_size);
+        auto one_byte = ext_id < 15;
+        ext_ptr[0] = one_byte ? 0xBE : 0x10;
+        ext_ptr[1] = one_byte ? 0xDE : 0x00;
+        ext_ptr[2] = 0;
+        ext_ptr[3] = 1;
+        if (one_byte) {
+            ext_ptr[4] = (ext_id << 4) | 1;
+            ext_ptr[5] = seq >> 8;
+            ext_ptr[6] = seq & 0xFF;
+            ext_ptr[7] = 0;
+        } else {
+            ext_ptr[4] = ext_id;
+            ext_ptr[5] = 2;
+            ext_ptr[6] = seq >> 8;
+            ext_ptr[7] = seq & 0xFF;
+        }
+        header->ext = 1;
+        len += 8;
+        return true;
+    }
+
+    auto profile = (ext_ptr[0] << 8) | ext_ptr[1];
+    auto one_byte = profile == 0xBEDE;
+    if (!one_byte && (profile & 0xFFF0) != 0x1000) {
+        // 不识别的扩展头
+        return false;
+    }
+    auto ext_size = ((ext_ptr[2] << 8) | ext_ptr[3]) * 4;
+    auto ptr = ext_ptr + 4;
+    auto end = ptr + ext_size;
+    while (ptr < end) {
+        if (!*ptr) {
+            // padding
+            ++ptr;
+            continue;
+        }
+        uint8_t id, size;
+        if (one_byte) {
+            id = *ptr >> 4;
+            size = (*ptr & 0x0F) + 1;
+            if (id == 15) {
+                break;
+            }
+            ptr += 1;
+        } else {
+            if (ptr + 1 >= end) {
+                break;
+            }
+            id = ptr[0];
+            size = ptr[1];
+            ptr += 2;
+        }
+        if (ptr + size > end) {
+            break;
+        }
+        if (id == ext_id && size == 2) {
+            // 已经有该扩展(比如webrtc推流透传过来的)，直接覆盖序号
+            ptr[0] = seq >> 8;
+            ptr[1] = seq & 0xFF;
+            return true;
+        }
+        ptr += size;
+    }
+
+    if (one_byte && ext_id >= 15) {
+        return false;
+    }
+    // 在扩展末尾追加4个字节
+    memmove(end + 4, end, tail_size - 4 - ext_size);
+    if (one_byte) {
+        end[0] = (ext_id << 4) | 1;
+        end[1] = seq >> 8;
+        end[2] = seq & 0xFF;
+        end[3] = 0;
+    } else {
+        end[0] = ext_id;
+        end[1] = 2;
+        end[2] = seq >> 8;
+        end[3] = seq & 0xFF;
+    }
+    ext_size += 4;
+    ext_ptr[2] = (ext_size / 4) >> 8;
+    ext_ptr[3] = (ext_size / 4) & 0xFF;
+    len += 4;
+    return true;
+}
+
 void WebRtcTransportImp::onBeforeEncryptRtp(const char *buf, int &len, void *ctx) {
+    // 普通的rtp已经在共享缓存中改写过了，只有重传的rtp需要改写
     auto pr = (pair<bool /*rtx*/, MediaTrack *> *)ctx;
     auto header = (RtpHeader *)buf;
 
-    if (!pr->first || !pr->second->plan_rtx) {
-        // 普通的rtp,或者不支持rtx, 修改目标pt和ssrc
-        pr->second->rtp_ext_ctx->changeRtpExtId(header, false);
-        header->pt = pr->second->plan_rtp->pt;
-        header->ssrc = htonl(pr->second->answer_ssrc_rtp);
-    } else {
+    if (pr && (!pr->first || !pr->second->plan_rtx)) {
+        // 不支持rtx, 修改目标pt和ssrc
+        changeRtpHeader(header, *pr->second, pr->second->answer_ssrc_rtp, pr->second->plan_rtp->pt);
+    } else if (pr) {
         // 重传的rtp, rtx
-        pr->second->rtp_ext_ctx->changeRtpExtId(header, false);
-        header->pt = pr->second->plan_rtx->pt;
-        if (pr->second->answer_ssrc_rtx) {
-            // 有rtx单独的ssrc,有些情况下，浏览器支持rtx，但是未指定rtx单独的ssrc
-            header->ssrc = htonl(pr->second->answer_ssrc_rtx);
-        } else {
-            // 未单独指定rtx的ssrc，那么使用rtp的ssrc
-            header->ssrc = htonl(pr->second->answer_ssrc_rtp);
-        }
+        // 有rtx单独的ssrc,有些情况下，浏览器支持rtx，但是未指定rtx单独的ssrc；未单独指定rtx的ssrc，那么使用rtp的ssrc
+        auto ssrc = pr->second->answer_ssrc_rtx ? pr->second->answer_ssrc_rtx : pr->second->answer_ssrc_rtp;
+        changeRtpHeader(header, *pr->second, ssrc, pr->second->plan_rtx->pt);
 
         auto origin_seq = ntohs(header->seq);
         // seq跟原来的不一样
@@ -1192,6 +1411,38 @@ void WebRtcTransportImp::onBeforeEncryptRtp(const char *buf, int &len, void *ctx
         payload[1] = origin_seq & 0xFF;
         len += 2;
     }
+
+    if (_gcc_ctx && _twcc_send_ext_id && setTransportCCSeq((char *)buf, len, _twcc_send_ext_id, _twcc_send_seq)) {
+        // 发送时间在socket flush时记录
+        _twcc_pending.emplace_back(_twcc_send_seq++, len);
+    }
+}
+
+void WebRtcTransportImp::enableBwe() {
+    if (_gcc_ctx) {
+        return;
+    }
+    // 单位kbps，与sdp中x-google-*-bitrate一致
+    GET_CONFIG(uint32_t, start_bitrate, Rtc::kStartBitrate);
+    GET_CONFIG(uint32_t, max_bitrate, Rtc::kMaxBitrate);
+    GET_CONFIG(uint32_t, min_bitrate, Rtc::kMinBitrate);
+    _gcc_ctx = std::make_shared<GccContext>((start_bitrate ? start_bitrate : 300) * 1000,
+                                            (min_bitrate ? min_bitrate : 50) * 1000,
+                                            (max_bitrate ? max_bitrate : 20 * 1000) * 1000);
+    // bundle时各track的transport-cc扩展id一致
+    for (auto &track : _type_to_track) {
+        if (track && !_twcc_send_ext_id) {
+            _twcc_send_ext_id = track->rtp_ext_ctx->getSendExtId(RtpExtType::transport_cc);
+        }
+    }
+    if (!_twcc_send_ext_id) {
+        // 比如开启了remb，此时只能根据rr汇报的丢包率估计带宽
+        WarnL << "transport-cc未协商, 发送端带宽估计仅依赖丢包率";
+    }
+}
+
+uint32_t WebRtcTransportImp::getTargetBitrate() const {
+    return _gcc_ctx ? _gcc_ctx->getTargetBitrate() : 0;
 }
 
 void WebRtcTransportImp::safeShutdown(const SockException &ex) {
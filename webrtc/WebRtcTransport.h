@@ -23,8 +23,10 @@
 #include "Network/Session.h"
 #include "Nack.h"
 #include "TwccContext.h"
+#include "GccContext.h"
 #include "SctpAssociation.hpp"
 #include "Rtcp/RtcpContext.h"
+#include "Common/UdpBatchSender.h"
 
 namespace mediakit {
 
@@ -202,6 +204,9 @@ public:
     uint32_t answer_ssrc_rtx = 0;
     const RtcMedia *media;
     RtpExtContext::Ptr rtp_ext_ctx;
+    //发送rtp改写(pt/ssrc/ext id)方案编号，协商结果一致的播放器共享改写后的rtp；
+    //所有引用该方案的track释放后方案被回收
+    std::shared_ptr<uint32_t> rewrite_profile;
 
     //for send rtp
     NackList nack_list;
@@ -277,10 +282,22 @@ protected:
     float getLossRate(TrackType type);
     void onRtcpBye() override;
 
+    /**
+     * 开启发送端带宽估计，开启后发送的rtp会携带transport-cc扩展序号
+     */
+    void enableBwe();
+
+    /**
+     * 获取发送端带宽估计的目标码率，单位bps，未开启带宽估计时返回0
+     */
+    uint32_t getTargetBitrate() const;
+
 private:
     void onSortedRtp(MediaTrack &track, const std::string &rid, RtpPacket::Ptr rtp);
     void onSendNack(MediaTrack &track, const FCI_NACK &nack, uint32_t ssrc);
     void onSendTwcc(uint32_t ssrc, const std::string &twcc_fci);
+    // socket flush后记录待发送rtp的transport-cc发送时间
+    void onTwccSent();
 
     void registerSelf();
     void unregisterSelf();
@@ -292,6 +309,8 @@ private:
     uint16_t _rtx_seq[2] = {0, 0};
     //用掉的总流量
     uint64_t _bytes_usage = 0;
+    //udp批量发送器
+    UdpBatchSender _udp_batch_sender;
     //保持自我强引用
     Ptr _self;
     //检测超时的定时器
@@ -302,6 +321,13 @@ private:
     Ticker _pli_ticker;
     //twcc rtcp发送上下文对象
     TwccContext _twcc_ctx;
+    //发送端带宽估计
+    GccContext::Ptr _gcc_ctx;
+    //发送rtp时的transport-cc扩展id与序号
+    uint8_t _twcc_send_ext_id = 0;
+    uint16_t _twcc_send_seq = 0;
+    //已写入transport-cc序号但尚未flush的rtp(序号与长度)
+    std::vector<std::pair<uint16_t, size_t>> _twcc_pending;
     //根据发送rtp的track类型获取相关信息
     MediaTrack::Ptr _type_to_track[2];
     //根据rtcp的ssrc获取相关信息，收发rtp和rtx的ssrc都会记录